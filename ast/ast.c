@@ -1,8 +1,7 @@
 #include "ast.h"
 #include <stdlib.h>
 #include <string.h>
-
-ASTNode *ast_root = NULL;
+#include "../tagged_alloc.h"
 
 void init_node_list(NodeList *list) {
     list->items = NULL;
@@ -13,7 +12,9 @@ void init_node_list(NodeList *list) {
 void add_to_list(NodeList *list, ASTNode *node) {
     if (list->size >= list->capacity) {
         size_t new_capacity = list->capacity == 0 ? 4 : list->capacity * 2;
-        ASTNode **new_items = (ASTNode **) realloc(list->items, new_capacity * sizeof(ASTNode *));
+        ASTNode **new_items = (ASTNode **) tagged_realloc(ALLOC_AST, list->items,
+                                                          list->capacity * sizeof(ASTNode *),
+                                                          new_capacity * sizeof(ASTNode *));
         if (new_items) {
             list->items = new_items;
             list->capacity = new_capacity;
@@ -27,26 +28,42 @@ void add_to_list(NodeList *list, ASTNode *node) {
 char *strdup_custom(const char *str) {
     if (!str) return NULL;
     size_t len = strlen(str);
-    char *new_str = (char *) malloc(len + 1);
+    char *new_str = (char *) tagged_malloc(ALLOC_AST, len + 1);
     if (new_str) {
         strcpy(new_str, str);
     }
     return new_str;
 }
 
+// Новый узел без позиции в исходном тексте (line и column равны 0)
+static ASTNode *new_node(NodeType type) {
+    ASTNode *node = (ASTNode *) tagged_malloc(ALLOC_AST, sizeof(ASTNode));
+    if (node) {
+        node->type = type;
+        node->line = 0;
+        node->column = 0;
+    }
+    return node;
+}
+
+void set_node_location(ASTNode *node, int line, int column) {
+    if (node) {
+        node->line = line;
+        node->column = column;
+    }
+}
+
 ASTNode *create_program_node() {
-    ASTNode *node = (ASTNode *) malloc(sizeof(ASTNode));
+    ASTNode *node = new_node(NODE_PROGRAM);
     if (node) {
-        node->type = NODE_PROGRAM;
         init_node_list(&node->block.children);
     }
     return node;
 }
 
 ASTNode *create_variable_declaration(const char *name, const char *var_type, int is_global) {
-    ASTNode *node = (ASTNode *) malloc(sizeof(ASTNode));
+    ASTNode *node = new_node(NODE_VARIABLE_DECLARATION);
     if (node) {
-        node->type = NODE_VARIABLE_DECLARATION;
         node->variable.name = strdup_custom(name);
         node->variable.var_type = strdup_custom(var_type);
         node->variable.is_global = is_global;
@@ -65,9 +82,8 @@ create_variable_declaration_with_init(const char *name, const char *var_type, in
 }
 
 ASTNode *create_binary_operation(const char *op_type, ASTNode *left, ASTNode *right) {
-    ASTNode *node = (ASTNode *) malloc(sizeof(ASTNode));
+    ASTNode *node = new_node(NODE_BINARY_OPERATION);
     if (node) {
-        node->type = NODE_BINARY_OPERATION;
         node->binary_op.op_type = strdup_custom(op_type);
         node->binary_op.left = left;
         node->binary_op.right = right;
@@ -76,9 +92,8 @@ ASTNode *create_binary_operation(const char *op_type, ASTNode *left, ASTNode *ri
 }
 
 ASTNode *create_literal_int(int value) {
-    ASTNode *node = (ASTNode *) malloc(sizeof(ASTNode));
+    ASTNode *node = new_node(NODE_LITERAL);
     if (node) {
-        node->type = NODE_LITERAL;
         node->literal.int_value = value;
         node->literal.type = strdup_custom("int");
     }
@@ -86,9 +101,8 @@ ASTNode *create_literal_int(int value) {
 }
 
 ASTNode *create_literal_float(float value) {
-    ASTNode *node = (ASTNode *) malloc(sizeof(ASTNode));
+    ASTNode *node = new_node(NODE_LITERAL);
     if (node) {
-        node->type = NODE_LITERAL;
         node->literal.float_value = value;
         node->literal.type = strdup_custom("float");
     }
@@ -96,9 +110,8 @@ ASTNode *create_literal_float(float value) {
 }
 
 ASTNode *create_literal_string(const char *value) {
-    ASTNode *node = (ASTNode *) malloc(sizeof(ASTNode));
+    ASTNode *node = new_node(NODE_LITERAL);
     if (node) {
-        node->type = NODE_LITERAL;
         node->literal.string_value = strdup_custom(value);
         node->literal.type = strdup_custom("string");
     }
@@ -106,18 +119,16 @@ ASTNode *create_literal_string(const char *value) {
 }
 
 ASTNode *create_identifier_node(const char *name) {
-    ASTNode *node = (ASTNode *) malloc(sizeof(ASTNode));
+    ASTNode *node = new_node(NODE_IDENTIFIER);
     if (node) {
-        node->type = NODE_IDENTIFIER;
         node->identifier.name = strdup_custom(name);
     }
     return node;
 }
 
 ASTNode *create_assignment_node(const char *target, ASTNode *value) {
-    ASTNode *node = (ASTNode *) malloc(sizeof(ASTNode));
+    ASTNode *node = new_node(NODE_ASSIGNMENT);
     if (node) {
-        node->type = NODE_ASSIGNMENT;
         node->assignment.target = strdup_custom(target);
         node->assignment.value = value;
     }
@@ -125,9 +136,8 @@ ASTNode *create_assignment_node(const char *target, ASTNode *value) {
 }
 
 ASTNode *create_if_node(ASTNode *condition, ASTNode *then_branch, ASTNode *else_branch) {
-    ASTNode *node = (ASTNode *) malloc(sizeof(ASTNode));
+    ASTNode *node = new_node(NODE_IF_STATEMENT);
     if (node) {
-        node->type = NODE_IF_STATEMENT;
         node->if_stmt.condition = condition;
         node->if_stmt.then_branch = then_branch;
         node->if_stmt.else_branch = else_branch;
@@ -136,9 +146,8 @@ ASTNode *create_if_node(ASTNode *condition, ASTNode *then_branch, ASTNode *else_
 }
 
 ASTNode *create_while_node(ASTNode *condition, ASTNode *body) {
-    ASTNode *node = (ASTNode *) malloc(sizeof(ASTNode));
+    ASTNode *node = new_node(NODE_WHILE_LOOP);
     if (node) {
-        node->type = NODE_WHILE_LOOP;
         node->while_loop.condition = condition;
         node->while_loop.body = body;
     }
@@ -146,9 +155,8 @@ ASTNode *create_while_node(ASTNode *condition, ASTNode *body) {
 }
 
 ASTNode *create_round_node(const char *variable, ASTNode *start, ASTNode *end, ASTNode *step, ASTNode *body) {
-    ASTNode *node = (ASTNode *) malloc(sizeof(ASTNode));
+    ASTNode *node = new_node(NODE_ROUND_LOOP);
     if (node) {
-        node->type = NODE_ROUND_LOOP;
         node->round_loop.variable = strdup_custom(variable);
         node->round_loop.start = start;
         node->round_loop.end = end;
@@ -159,18 +167,16 @@ ASTNode *create_round_node(const char *variable, ASTNode *start, ASTNode *end, A
 }
 
 ASTNode *create_block_node() {
-    ASTNode *node = (ASTNode *) malloc(sizeof(ASTNode));
+    ASTNode *node = new_node(NODE_BLOCK);
     if (node) {
-        node->type = NODE_BLOCK;
         init_node_list(&node->block.children);
     }
     return node;
 }
 
 ASTNode *create_print_node(ASTNode *expression) {
-    ASTNode *node = (ASTNode *) malloc(sizeof(ASTNode));
+    ASTNode *node = new_node(NODE_PRINT);
     if (node) {
-        node->type = NODE_PRINT;
         node->print.expression = expression;
     }
     return node;
@@ -182,73 +188,104 @@ void add_child(ASTNode *parent, ASTNode *child) {
     }
 }
 
+// Узлы, ожидающие освобождения; первые FREE_STACK_LOCAL лежат на стеке потока
+#define FREE_STACK_LOCAL 64
+
+typedef struct {
+    ASTNode **items;
+    size_t count;
+    size_t capacity;
+    ASTNode *local[FREE_STACK_LOCAL];
+} FreeStack;
+
+// При нехватке памяти поддерево остаётся неосвобождённым
+static void free_stack_push(FreeStack *stack, ASTNode *node) {
+    if (!node) return;
+    if (stack->count >= stack->capacity) {
+        size_t new_capacity = stack->capacity * 2;
+        ASTNode **new_items = (ASTNode **) tagged_malloc(ALLOC_TEMP, new_capacity * sizeof(ASTNode *));
+        if (!new_items) return;
+        memcpy(new_items, stack->items, stack->count * sizeof(ASTNode *));
+        if (stack->items != stack->local) tagged_free(ALLOC_TEMP, stack->items);
+        stack->items = new_items;
+        stack->capacity = new_capacity;
+    }
+    stack->items[stack->count++] = node;
+}
+
+// Обход с явным стеком: глубина дерева (длинные цепочки "a + b + ...")
+// не ограничена размером стека потока
 void free_node(ASTNode *node) {
     if (!node) return;
+    FreeStack stack;
+    stack.items = stack.local;
+    stack.count = 0;
+    stack.capacity = FREE_STACK_LOCAL;
+    free_stack_push(&stack, node);
+
+    while (stack.count > 0) {
+        node = stack.items[--stack.count];
+        switch (node->type) {
+            case NODE_PROGRAM:
+            case NODE_BLOCK:
+                for (size_t i = 0; i < node->block.children.size; i++) {
+                    free_stack_push(&stack, node->block.children.items[i]);
+                }
+                tagged_free(ALLOC_AST, node->block.children.items);
+                break;
+
+            case NODE_VARIABLE_DECLARATION:
+                tagged_free(ALLOC_AST, node->variable.name);
+                tagged_free(ALLOC_AST, node->variable.var_type);
+                free_stack_push(&stack, node->variable.initializer);
+                break;
+
+            case NODE_BINARY_OPERATION:
+                tagged_free(ALLOC_AST, node->binary_op.op_type);
+                free_stack_push(&stack, node->binary_op.left);
+                free_stack_push(&stack, node->binary_op.right);
+                break;
+
+            case NODE_LITERAL:
+                if (strcmp(node->literal.type, "string") == 0) {
+                    tagged_free(ALLOC_AST, node->literal.string_value);
+                }
+                tagged_free(ALLOC_AST, node->literal.type);
+                break;
+
+            case NODE_IDENTIFIER:
+                tagged_free(ALLOC_AST, node->identifier.name);
+                break;
 
-    switch (node->type) {
-        case NODE_PROGRAM:
-        case NODE_BLOCK:
-            for (size_t i = 0; i < node->block.children.size; i++) {
-                free_node(node->block.children.items[i]);
-            }
-            free(node->block.children.items);
-            break;
-
-        case NODE_VARIABLE_DECLARATION:
-            free(node->variable.name);
-            free(node->variable.var_type);
-            if (node->variable.initializer) {
-                free_node(node->variable.initializer);
-            }
-            break;
-
-        case NODE_BINARY_OPERATION:
-            free(node->binary_op.op_type);
-            free_node(node->binary_op.left);
-            free_node(node->binary_op.right);
-            break;
-
-        case NODE_LITERAL:
-            if (strcmp(node->literal.type, "string") == 0) {
-                free(node->literal.string_value);
-            }
-            free(node->literal.type);
-            break;
-
-        case NODE_IDENTIFIER:
-            free(node->identifier.name);
-            break;
-
-        case NODE_ASSIGNMENT:
-            free(node->assignment.target);
-            free_node(node->assignment.value);
-            break;
-
-        case NODE_IF_STATEMENT:
-            free_node(node->if_stmt.condition);
-            free_node(node->if_stmt.then_branch);
-            if (node->if_stmt.else_branch) {
-                free_node(node->if_stmt.else_branch);
-            }
-            break;
-
-        case NODE_WHILE_LOOP:
-            free_node(node->while_loop.condition);
-            free_node(node->while_loop.body);
-            break;
-
-        case NODE_ROUND_LOOP:
-            free(node->round_loop.variable);
-            free_node(node->round_loop.start);
-            free_node(node->round_loop.end);
-            free_node(node->round_loop.step);
-            free_node(node->round_loop.body);
-            break;
-
-        case NODE_PRINT:
-            free_node(node->print.expression);
-            break;
-    }
-
-    free(node);
-} 
\ No newline at end of file
+            case NODE_ASSIGNMENT:
+                tagged_free(ALLOC_AST, node->assignment.target);
+                free_stack_push(&stack, node->assignment.value);
+                break;
+
+            case NODE_IF_STATEMENT:
+                free_stack_push(&stack, node->if_stmt.condition);
+                free_stack_push(&stack, node->if_stmt.then_branch);
+                free_stack_push(&stack, node->if_stmt.else_branch);
+                break;
+
+            case NODE_WHILE_LOOP:
+                free_stack_push(&stack, node->while_loop.condition);
+                free_stack_push(&stack, node->while_loop.body);
+                break;
+
+            case NODE_ROUND_LOOP:
+                tagged_free(ALLOC_AST, node->round_loop.variable);
+                free_stack_push(&stack, node->round_loop.start);
+                free_stack_push(&stack, node->round_loop.end);
+                free_stack_push(&stack, node->round_loop.step);
+                free_stack_push(&stack, node->round_loop.body);
+                break;
+
+            case NODE_PRINT:
+                free_stack_push(&stack, node->print.expression);
+                break;
+        }
+        tagged_free(ALLOC_AST, node);
+    }
+    if (stack.items != stack.local) tagged_free(ALLOC_TEMP, stack.items);
+}
@@ -28,6 +28,9 @@ typedef struct {
 
 struct ASTNode {
     NodeType type;
+    // Позиция первого токена узла (для бинарной операции — знака), с 1; 0 — неизвестна
+    int line;
+    int column;
     union {
         struct {
             char *name;
@@ -120,6 +123,8 @@ ASTNode *create_print_node(ASTNode *expression);
 
 void add_child(ASTNode *parent, ASTNode *child);
 
+void set_node_location(ASTNode *node, int line, int column);
+
 void free_node(ASTNode *node);
 
 extern ASTNode *ast_root;
@@ -1,58 +1,100 @@
 #include "ast_visualizer.h"
+#include "../tagged_alloc.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
-// Вспомогательная функция для отображения отступов
+// Отступ не растёт глубже VISUALIZE_MAX_INDENT уровней, иначе дерево цепочки
+// из N операций занимало бы O(N^2) байт
+#define VISUALIZE_MAX_INDENT 32
+
+// Вспомогательная функция для отображения отступов; глубокие уровни помечаются номером
 static void print_indent(int indent, FILE *output) {
-    for (int i = 0; i < indent; i++) {
+    int shown = indent > VISUALIZE_MAX_INDENT ? VISUALIZE_MAX_INDENT : indent;
+    for (int i = 0; i < shown; i++) {
         fprintf(output, "  ");
     }
+    if (indent > shown) {
+        fprintf(output, "[%d] ", indent);
+    }
 }
 
-// Рекурсивная функция для визуализации AST с отступами
-static void visualize_ast_with_indent(ASTNode *node, int indent, FILE *output) {
+// Отложенная строка вывода: узел или заголовок ветви ("LEFT:", "BODY:" ...)
+typedef struct {
+    ASTNode *node;
+    const char *label;
+    int indent;
+} VisualizeTask;
+
+#define VISUALIZE_STACK_LOCAL 64
+
+typedef struct {
+    VisualizeTask *items;
+    size_t count;
+    size_t capacity;
+    VisualizeTask local[VISUALIZE_STACK_LOCAL];
+} VisualizeStack;
+
+static int push_task(VisualizeStack *stack, ASTNode *node, const char *label, int indent) {
+    if (stack->count >= stack->capacity) {
+        size_t new_capacity = stack->capacity * 2;
+        VisualizeTask *new_items = (VisualizeTask *) tagged_malloc(ALLOC_TEMP,
+                                                                   new_capacity * sizeof(VisualizeTask));
+        if (!new_items) return -1;
+        memcpy(new_items, stack->items, stack->count * sizeof(VisualizeTask));
+        if (stack->items != stack->local) tagged_free(ALLOC_TEMP, stack->items);
+        stack->items = new_items;
+        stack->capacity = new_capacity;
+    }
+    stack->items[stack->count].node = node;
+    stack->items[stack->count].label = label;
+    stack->items[stack->count].indent = indent;
+    stack->count++;
+    return 0;
+}
+
+// Ветвь узла: заголовок на indent + 1 и поддерево на indent + 2.
+// Задачи снимаются со стека в обратном порядке, поэтому ветви кладутся с конца
+static int push_branch(VisualizeStack *stack, const char *label, ASTNode *node, int indent) {
+    if (push_task(stack, node, NULL, indent + 2) != 0) return -1;
+    return push_task(stack, NULL, label, indent + 1);
+}
+
+// Печатает сам узел и кладёт на стек его ветви
+static int visualize_node(VisualizeStack *stack, ASTNode *node, int indent, FILE *output) {
+    print_indent(indent, output);
     if (!node) {
-        print_indent(indent, output);
         fprintf(output, "NULL\n");
-        return;
+        return 0;
     }
 
+    int status = 0;
     switch (node->type) {
         case NODE_PROGRAM:
-            print_indent(indent, output);
-            fprintf(output, "PROGRAM\n");
-            for (size_t i = 0; i < node->block.children.size; i++) {
-                visualize_ast_with_indent(node->block.children.items[i], indent + 1, output);
+        case NODE_BLOCK:
+            fprintf(output, node->type == NODE_PROGRAM ? "PROGRAM\n" : "BLOCK\n");
+            for (size_t i = node->block.children.size; i > 0 && status == 0; i--) {
+                status = push_task(stack, node->block.children.items[i - 1], NULL, indent + 1);
             }
             break;
 
         case NODE_VARIABLE_DECLARATION:
-            print_indent(indent, output);
             fprintf(output, "VAR_DECL: %s (type: %s, global: %s)\n",
                    node->variable.name,
                    node->variable.var_type,
                    node->variable.is_global ? "yes" : "no");
             if (node->variable.initializer) {
-                print_indent(indent + 1, output);
-                fprintf(output, "INIT:\n");
-                visualize_ast_with_indent(node->variable.initializer, indent + 2, output);
+                status = push_branch(stack, "INIT:", node->variable.initializer, indent);
             }
             break;
 
         case NODE_BINARY_OPERATION:
-            print_indent(indent, output);
             fprintf(output, "BIN_OP: %s\n", node->binary_op.op_type);
-            print_indent(indent + 1, output);
-            fprintf(output, "LEFT:\n");
-            visualize_ast_with_indent(node->binary_op.left, indent + 2, output);
-            print_indent(indent + 1, output);
-            fprintf(output, "RIGHT:\n");
-            visualize_ast_with_indent(node->binary_op.right, indent + 2, output);
+            status = push_branch(stack, "RIGHT:", node->binary_op.right, indent);
+            if (status == 0) status = push_branch(stack, "LEFT:", node->binary_op.left, indent);
             break;
 
         case NODE_LITERAL:
-            print_indent(indent, output);
             if (strcmp(node->literal.type, "int") == 0) {
                 fprintf(output, "LITERAL: %d (type: int)\n", node->literal.int_value); 
             } else if (strcmp(node->literal.type, "string") == 0) {
@@ -63,85 +105,69 @@ static void visualize_ast_with_indent(ASTNode *node, int indent, FILE *output) {
             break;
 
         case NODE_IDENTIFIER:
-            print_indent(indent, output);
             fprintf(output, "ID: %s\n", node->identifier.name);
             break;
 
         case NODE_ASSIGNMENT:
-            print_indent(indent, output);
             fprintf(output, "ASSIGN: %s\n", node->assignment.target);
-            print_indent(indent + 1, output);
-            fprintf(output, "VALUE:\n");
-            visualize_ast_with_indent(node->assignment.value, indent + 2, output);
+            status = push_branch(stack, "VALUE:", node->assignment.value, indent);
             break;
 
         case NODE_IF_STATEMENT:
-            print_indent(indent, output);
             fprintf(output, "IF\n");
-            print_indent(indent + 1, output);
-            fprintf(output, "CONDITION:\n");
-            visualize_ast_with_indent(node->if_stmt.condition, indent + 2, output);
-            print_indent(indent + 1, output);
-            fprintf(output, "THEN:\n");
-            visualize_ast_with_indent(node->if_stmt.then_branch, indent + 2, output);
             if (node->if_stmt.else_branch) {
-                print_indent(indent + 1, output);
-                fprintf(output, "ELSE:\n");
-                visualize_ast_with_indent(node->if_stmt.else_branch, indent + 2, output);
+                status = push_branch(stack, "ELSE:", node->if_stmt.else_branch, indent);
             }
+            if (status == 0) status = push_branch(stack, "THEN:", node->if_stmt.then_branch, indent);
+            if (status == 0) status = push_branch(stack, "CONDITION:", node->if_stmt.condition, indent);
             break;
 
         case NODE_WHILE_LOOP:
-            print_indent(indent, output);
             fprintf(output, "WHILE\n");
-            print_indent(indent + 1, output);
-            fprintf(output, "CONDITION:\n");
-            visualize_ast_with_indent(node->while_loop.condition, indent + 2, output);
-            print_indent(indent + 1, output);
-            fprintf(output, "BODY:\n");
-            visualize_ast_with_indent(node->while_loop.body, indent + 2, output);
+            status = push_branch(stack, "BODY:", node->while_loop.body, indent);
+            if (status == 0) status = push_branch(stack, "CONDITION:", node->while_loop.condition, indent);
             break;
 
         case NODE_ROUND_LOOP:
-            print_indent(indent, output);
             fprintf(output, "ROUND: %s\n", node->round_loop.variable);
-            print_indent(indent + 1, output);
-            fprintf(output, "START:\n");
-            visualize_ast_with_indent(node->round_loop.start, indent + 2, output);
-            print_indent(indent + 1, output);
-            fprintf(output, "END:\n");
-            visualize_ast_with_indent(node->round_loop.end, indent + 2, output);
-            if (node->round_loop.step) {
-                print_indent(indent + 1, output);
-                fprintf(output, "STEP:\n");
-                visualize_ast_with_indent(node->round_loop.step, indent + 2, output);
-            }
-            print_indent(indent + 1, output);
-            fprintf(output, "BODY:\n");
-            visualize_ast_with_indent(node->round_loop.body, indent + 2, output);
-            break;
-
-        case NODE_BLOCK:
-            print_indent(indent, output);
-            fprintf(output, "BLOCK\n");
-            for (size_t i = 0; i < node->block.children.size; i++) {
-                visualize_ast_with_indent(node->block.children.items[i], indent + 1, output);
+            status = push_branch(stack, "BODY:", node->round_loop.body, indent);
+            if (status == 0 && node->round_loop.step) {
+                status = push_branch(stack, "STEP:", node->round_loop.step, indent);
             }
+            if (status == 0) status = push_branch(stack, "END:", node->round_loop.end, indent);
+            if (status == 0) status = push_branch(stack, "START:", node->round_loop.start, indent);
             break;
 
         case NODE_PRINT:
-            print_indent(indent, output);
             fprintf(output, "PRINT\n");
-            print_indent(indent + 1, output);
-            fprintf(output, "EXPRESSION:\n");
-            visualize_ast_with_indent(node->print.expression, indent + 2, output);
+            status = push_branch(stack, "EXPRESSION:", node->print.expression, indent);
             break;
 
         default:
-            print_indent(indent, output);
             fprintf(output, "UNKNOWN NODE TYPE: %d\n", node->type);
             break;
     }
+    return status;
+}
+
+// Обход в глубину с явным стеком, чтобы глубина дерева не ограничивалась
+// стеком потока; при нехватке памяти вывод обрывается
+static void visualize_ast_with_indent(ASTNode *node, int indent, FILE *output) {
+    VisualizeStack stack;
+    stack.items = stack.local;
+    stack.count = 0;
+    stack.capacity = VISUALIZE_STACK_LOCAL;
+    int status = push_task(&stack, node, NULL, indent);
+    while (stack.count > 0 && status == 0) {
+        VisualizeTask task = stack.items[--stack.count];
+        if (task.label) {
+            print_indent(task.indent, output);
+            fprintf(output, "%s\n", task.label);
+        } else {
+            status = visualize_node(&stack, task.node, task.indent, output);
+        }
+    }
+    if (stack.items != stack.local) tagged_free(ALLOC_TEMP, stack.items);
 }
 
 void visualize_ast(ASTNode *node, FILE *output) {
@@ -0,0 +1,600 @@
+#include "flat_ast.h"
+#include "../tagged_alloc.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Состояние построения: ёмкости массивов и таблица интернирования строк
+typedef struct {
+    FlatAST *ast;
+    size_t node_capacity;
+    size_t children_capacity;
+    size_t strings_capacity;
+    uint32_t *slots;            // смещение строки + 1, 0 — пусто
+    size_t slot_count;
+    size_t string_count;
+} FlatBuilder;
+
+// Узел, ожидающий номера, и место в children, куда этот номер записать
+typedef struct {
+    const ASTNode *node;
+    size_t slot;
+} FlatTask;
+
+#define FLAT_NO_SLOT ((size_t) -1)
+
+// Число детей узла данного вида; у блоков оно своё у каждого узла (-1)
+static int kind_arity(int kind) {
+    switch (kind) {
+        case NODE_PROGRAM:
+        case NODE_BLOCK:
+            return -1;
+        case NODE_VARIABLE_DECLARATION:
+        case NODE_ASSIGNMENT:
+        case NODE_PRINT:
+            return 1;
+        case NODE_BINARY_OPERATION:
+        case NODE_WHILE_LOOP:
+            return 2;
+        case NODE_IF_STATEMENT:
+            return 3;
+        case NODE_ROUND_LOOP:
+            return 4;
+        default:
+            return 0;
+    }
+}
+
+// Ребёнок, которого может не быть: инициализатор, else и шаг цикла
+static int slot_optional(int kind, uint32_t k) {
+    return kind == NODE_VARIABLE_DECLARATION || (kind == NODE_IF_STATEMENT && k == 2)
+           || (kind == NODE_ROUND_LOOP && k == 2);
+}
+
+// Значение узла — смещение строки
+static int has_string(int kind, int flags) {
+    switch (kind) {
+        case NODE_VARIABLE_DECLARATION:
+        case NODE_BINARY_OPERATION:
+        case NODE_IDENTIFIER:
+        case NODE_ASSIGNMENT:
+        case NODE_ROUND_LOOP:
+            return 1;
+        case NODE_LITERAL:
+            return (flags & FLAT_TYPE_MASK) == FLAT_TYPE_STRING;
+        default:
+            return 0;
+    }
+}
+
+static size_t node_arity(const ASTNode *node) {
+    int arity = kind_arity(node->type);
+    return arity < 0 ? node->block.children.size : (size_t) arity;
+}
+
+static const ASTNode *node_child(const ASTNode *node, size_t k) {
+    switch (node->type) {
+        case NODE_PROGRAM:
+        case NODE_BLOCK:
+            return node->block.children.items[k];
+        case NODE_VARIABLE_DECLARATION:
+            return node->variable.initializer;
+        case NODE_ASSIGNMENT:
+            return node->assignment.value;
+        case NODE_PRINT:
+            return node->print.expression;
+        case NODE_BINARY_OPERATION:
+            return k == 0 ? node->binary_op.left : node->binary_op.right;
+        case NODE_WHILE_LOOP:
+            return k == 0 ? node->while_loop.condition : node->while_loop.body;
+        case NODE_IF_STATEMENT:
+            return k == 0 ? node->if_stmt.condition : k == 1 ? node->if_stmt.then_branch : node->if_stmt.else_branch;
+        case NODE_ROUND_LOOP:
+            return k == 0 ? node->round_loop.start : k == 1 ? node->round_loop.end
+                 : k == 2 ? node->round_loop.step : node->round_loop.body;
+        default:
+            return NULL;
+    }
+}
+
+static int type_flags(const char *type) {
+    if (!type) return FLAT_TYPE_INT;
+    if (strcmp(type, "string") == 0) return FLAT_TYPE_STRING;
+    if (strcmp(type, "float") == 0) return FLAT_TYPE_FLOAT;
+    return FLAT_TYPE_INT;
+}
+
+static const char *type_name(int flags) {
+    switch (flags & FLAT_TYPE_MASK) {
+        case FLAT_TYPE_STRING: return "string";
+        case FLAT_TYPE_FLOAT: return "float";
+        default: return "int";
+    }
+}
+
+static uint32_t hash_string(const char *str) {
+    uint32_t hash = 2166136261u;
+    for (; *str; str++) {
+        hash = (hash ^ (unsigned char) *str) * 16777619u;
+    }
+    return hash;
+}
+
+static int grow_slots(FlatBuilder *builder) {
+    size_t new_count = builder->slot_count == 0 ? 256 : builder->slot_count * 2;
+    uint32_t *new_slots = (uint32_t *) tagged_calloc(ALLOC_TEMP, new_count, sizeof(uint32_t));
+    if (!new_slots) return -1;
+    for (size_t i = 0; i < builder->slot_count; i++) {
+        uint32_t entry = builder->slots[i];
+        if (entry == 0) continue;
+        size_t j = hash_string(builder->ast->strings + entry - 1) & (new_count - 1);
+        while (new_slots[j] != 0) j = (j + 1) & (new_count - 1);
+        new_slots[j] = entry;
+    }
+    tagged_free(ALLOC_TEMP, builder->slots);
+    builder->slots = new_slots;
+    builder->slot_count = new_count;
+    return 0;
+}
+
+// Смещение строки в strings; одинаковые имена и операции хранятся один раз
+static int intern_string(FlatBuilder *builder, const char *str, uint32_t *offset) {
+    FlatAST *ast = builder->ast;
+    if (!str) str = "";
+    if ((builder->string_count + 1) * 2 > builder->slot_count && grow_slots(builder) != 0) return -1;
+    size_t mask = builder->slot_count - 1;
+    size_t j = hash_string(str) & mask;
+    while (builder->slots[j] != 0) {
+        if (strcmp(ast->strings + builder->slots[j] - 1, str) == 0) {
+            *offset = builder->slots[j] - 1;
+            return 0;
+        }
+        j = (j + 1) & mask;
+    }
+    size_t length = strlen(str) + 1;
+    if (ast->strings_size + length >= UINT32_MAX) return -1;
+    if (ast->strings_size + length > builder->strings_capacity) {
+        size_t new_capacity = builder->strings_capacity == 0 ? 1024 : builder->strings_capacity * 2;
+        while (new_capacity < ast->strings_size + length) new_capacity *= 2;
+        char *new_strings = (char *) tagged_realloc(ALLOC_AST, ast->strings, builder->strings_capacity, new_capacity);
+        if (!new_strings) return -1;
+        ast->strings = new_strings;
+        builder->strings_capacity = new_capacity;
+    }
+    memcpy(ast->strings + ast->strings_size, str, length);
+    *offset = (uint32_t) ast->strings_size;
+    builder->slots[j] = *offset + 1;
+    builder->string_count++;
+    ast->strings_size += length;
+    return 0;
+}
+
+static int grow_nodes(FlatBuilder *builder) {
+    FlatAST *ast = builder->ast;
+    size_t old_capacity = builder->node_capacity;
+    size_t new_capacity = old_capacity == 0 ? 256 : old_capacity * 2;
+    size_t old_words = old_capacity * sizeof(uint32_t);
+    size_t new_words = new_capacity * sizeof(uint32_t);
+    uint8_t *kinds = (uint8_t *) tagged_realloc(ALLOC_AST, ast->kinds, old_capacity, new_capacity);
+    if (kinds) ast->kinds = kinds;
+    uint8_t *flags = (uint8_t *) tagged_realloc(ALLOC_AST, ast->flags, old_capacity, new_capacity);
+    if (flags) ast->flags = flags;
+    uint32_t *values = (uint32_t *) tagged_realloc(ALLOC_AST, ast->values, old_words, new_words);
+    if (values) ast->values = values;
+    uint32_t *first_child = (uint32_t *) tagged_realloc(ALLOC_AST, ast->first_child, old_words, new_words);
+    if (first_child) ast->first_child = first_child;
+    uint32_t *child_count = (uint32_t *) tagged_realloc(ALLOC_AST, ast->child_count, old_words, new_words);
+    if (child_count) ast->child_count = child_count;
+    uint32_t *lines = (uint32_t *) tagged_realloc(ALLOC_AST, ast->lines, old_words, new_words);
+    if (lines) ast->lines = lines;
+    uint32_t *columns = (uint32_t *) tagged_realloc(ALLOC_AST, ast->columns, old_words, new_words);
+    if (columns) ast->columns = columns;
+    if (!kinds || !flags || !values || !first_child || !child_count || !lines || !columns) return -1;
+    builder->node_capacity = new_capacity;
+    return 0;
+}
+
+// Резервирует диапазон детей, заполненный FLAT_NONE
+static int reserve_children(FlatBuilder *builder, size_t count) {
+    FlatAST *ast = builder->ast;
+    if (ast->children_size + count >= UINT32_MAX) return -1;
+    if (ast->children_size + count > builder->children_capacity) {
+        size_t new_capacity = builder->children_capacity == 0 ? 256 : builder->children_capacity * 2;
+        while (new_capacity < ast->children_size + count) new_capacity *= 2;
+        uint32_t *children = (uint32_t *) tagged_realloc(ALLOC_AST, ast->children,
+                                                             builder->children_capacity * sizeof(uint32_t),
+                                                             new_capacity * sizeof(uint32_t));
+        if (!children) return -1;
+        ast->children = children;
+        builder->children_capacity = new_capacity;
+    }
+    for (size_t i = 0; i < count; i++) {
+        ast->children[ast->children_size + i] = FLAT_NONE;
+    }
+    ast->children_size += count;
+    return 0;
+}
+
+// Вид, флаги и значение узла
+static int add_payload(FlatBuilder *builder, const ASTNode *node, uint32_t index) {
+    FlatAST *ast = builder->ast;
+    uint8_t flags = 0;
+    uint32_t value = 0;
+    const char *str = NULL;
+    switch (node->type) {
+        case NODE_VARIABLE_DECLARATION:
+            flags = (uint8_t) type_flags(node->variable.var_type);
+            if (node->variable.is_global) flags |= FLAT_GLOBAL;
+            str = node->variable.name;
+            break;
+        case NODE_BINARY_OPERATION:
+            str = node->binary_op.op_type;
+            break;
+        case NODE_LITERAL:
+            flags = (uint8_t) type_flags(node->literal.type);
+            if (flags == FLAT_TYPE_STRING) {
+                str = node->literal.string_value;
+            } else if (flags == FLAT_TYPE_FLOAT) {
+                memcpy(&value, &node->literal.float_value, sizeof(value));
+            } else {
+                value = (uint32_t) node->literal.int_value;
+            }
+            break;
+        case NODE_IDENTIFIER:
+            str = node->identifier.name;
+            break;
+        case NODE_ASSIGNMENT:
+            str = node->assignment.target;
+            break;
+        case NODE_ROUND_LOOP:
+            str = node->round_loop.variable;
+            break;
+        default:
+            break;
+    }
+    if (str && intern_string(builder, str, &value) != 0) return -1;
+    ast->kinds[index] = (uint8_t) node->type;
+    ast->flags[index] = flags;
+    ast->values[index] = value;
+    ast->lines[index] = node->line > 0 ? (uint32_t) node->line : 0;
+    ast->columns[index] = node->column > 0 ? (uint32_t) node->column : 0;
+    return 0;
+}
+
+static int push_task(FlatTask **stack, size_t *count, size_t *capacity, const ASTNode *node, size_t slot) {
+    if (*count >= *capacity) {
+        size_t new_capacity = *capacity == 0 ? 64 : *capacity * 2;
+        FlatTask *new_stack = (FlatTask *) tagged_realloc(ALLOC_TEMP, *stack, *capacity * sizeof(FlatTask),
+                                                           new_capacity * sizeof(FlatTask));
+        if (!new_stack) return -1;
+        *stack = new_stack;
+        *capacity = new_capacity;
+    }
+    (*stack)[*count].node = node;
+    (*stack)[*count].slot = slot;
+    (*count)++;
+    return 0;
+}
+
+// Прямой обход с явным стеком: номер узла — порядок, в котором он снят
+// со стека, а дети кладутся справа налево
+FlatAST *flat_ast_from_node(const ASTNode *root) {
+    FlatAST *ast = (FlatAST *) tagged_calloc(ALLOC_AST, 1, sizeof(FlatAST));
+    if (!ast) return NULL;
+    ast->owns_arrays = 1;
+    FlatBuilder builder;
+    memset(&builder, 0, sizeof(builder));
+    builder.ast = ast;
+    FlatTask *stack = NULL;
+    size_t stack_count = 0;
+    size_t stack_capacity = 0;
+    int status = 0;
+    if (root) status = push_task(&stack, &stack_count, &stack_capacity, root, FLAT_NO_SLOT);
+
+    while (status == 0 && stack_count > 0) {
+        FlatTask task = stack[--stack_count];
+        const ASTNode *node = task.node;
+        if (ast->node_count + 1 >= UINT32_MAX ||
+            (ast->node_count >= builder.node_capacity && grow_nodes(&builder) != 0)) {
+            status = -1;
+            break;
+        }
+        uint32_t index = (uint32_t) ast->node_count++;
+        if (task.slot != FLAT_NO_SLOT) ast->children[task.slot] = index;
+        size_t arity = node_arity(node);
+        size_t first = ast->children_size;
+        if (add_payload(&builder, node, index) != 0 || reserve_children(&builder, arity) != 0) {
+            status = -1;
+            break;
+        }
+        ast->first_child[index] = (uint32_t) first;
+        ast->child_count[index] = (uint32_t) arity;
+        for (size_t k = arity; k > 0 && status == 0; k--) {
+            const ASTNode *child = node_child(node, k - 1);
+            if (child) status = push_task(&stack, &stack_count, &stack_capacity, child, first + k - 1);
+        }
+    }
+    tagged_free(ALLOC_TEMP, stack);
+    tagged_free(ALLOC_TEMP, builder.slots);
+    if (status != 0) {
+        flat_ast_free(ast);
+        return NULL;
+    }
+    return ast;
+}
+
+// Забирает готовый узел-ребёнок: владелец теперь родитель
+static ASTNode *take_child(ASTNode **built, const FlatAST *ast, uint32_t node, uint32_t k) {
+    uint32_t child = flat_child(ast, node, k);
+    if (child == FLAT_NONE) return NULL;
+    ASTNode *result = built[child];
+    built[child] = NULL;
+    return result;
+}
+
+static ASTNode *build_block(ASTNode **built, const FlatAST *ast, uint32_t node) {
+    ASTNode *block = flat_kind(ast, node) == NODE_PROGRAM ? create_program_node() : create_block_node();
+    if (!block) return NULL;
+    size_t count = ast->child_count[node];
+    if (count > 0) {
+        block->block.children.items = (ASTNode **) tagged_malloc(ALLOC_AST, count * sizeof(ASTNode *));
+        if (!block->block.children.items) {
+            tagged_free(ALLOC_AST, block);
+            return NULL;
+        }
+        block->block.children.capacity = count;
+        for (uint32_t k = 0; k < count; k++) {
+            ASTNode *child = take_child(built, ast, node, k);
+            if (child) block->block.children.items[block->block.children.size++] = child;
+        }
+    }
+    return block;
+}
+
+static ASTNode *build_node(ASTNode **built, const FlatAST *ast, uint32_t node) {
+    uint8_t flags = ast->flags[node];
+    switch (flat_kind(ast, node)) {
+        case NODE_PROGRAM:
+        case NODE_BLOCK:
+            return build_block(built, ast, node);
+        case NODE_VARIABLE_DECLARATION:
+            {
+                ASTNode *result = create_variable_declaration(flat_string(ast, node), type_name(flags),
+                                                              (flags & FLAT_GLOBAL) != 0);
+                if (result) result->variable.initializer = take_child(built, ast, node, 0);
+                return result;
+            }
+        case NODE_BINARY_OPERATION:
+            {
+                ASTNode *result = create_binary_operation(flat_string(ast, node), NULL, NULL);
+                if (result) {
+                    result->binary_op.left = take_child(built, ast, node, 0);
+                    result->binary_op.right = take_child(built, ast, node, 1);
+                }
+                return result;
+            }
+        case NODE_LITERAL:
+            if ((flags & FLAT_TYPE_MASK) == FLAT_TYPE_STRING) {
+                return create_literal_string(flat_string(ast, node));
+            }
+            if ((flags & FLAT_TYPE_MASK) == FLAT_TYPE_FLOAT) {
+                float value;
+                memcpy(&value, &ast->values[node], sizeof(value));
+                return create_literal_float(value);
+            }
+            return create_literal_int((int) ast->values[node]);
+        case NODE_IDENTIFIER:
+            return create_identifier_node(flat_string(ast, node));
+        case NODE_ASSIGNMENT:
+            {
+                ASTNode *result = create_assignment_node(flat_string(ast, node), NULL);
+                if (result) result->assignment.value = take_child(built, ast, node, 0);
+                return result;
+            }
+        case NODE_IF_STATEMENT:
+            {
+                ASTNode *result = create_if_node(NULL, NULL, NULL);
+                if (result) {
+                    result->if_stmt.condition = take_child(built, ast, node, 0);
+                    result->if_stmt.then_branch = take_child(built, ast, node, 1);
+                    result->if_stmt.else_branch = take_child(built, ast, node, 2);
+                }
+                return result;
+            }
+        case NODE_WHILE_LOOP:
+            {
+                ASTNode *result = create_while_node(NULL, NULL);
+                if (result) {
+                    result->while_loop.condition = take_child(built, ast, node, 0);
+                    result->while_loop.body = take_child(built, ast, node, 1);
+                }
+                return result;
+            }
+        case NODE_ROUND_LOOP:
+            {
+                ASTNode *result = create_round_node(flat_string(ast, node), NULL, NULL, NULL, NULL);
+                if (result) {
+                    result->round_loop.start = take_child(built, ast, node, 0);
+                    result->round_loop.end = take_child(built, ast, node, 1);
+                    result->round_loop.step = take_child(built, ast, node, 2);
+                    result->round_loop.body = take_child(built, ast, node, 3);
+                }
+                return result;
+            }
+        case NODE_PRINT:
+            {
+                ASTNode *result = create_print_node(NULL);
+                if (result) result->print.expression = take_child(built, ast, node, 0);
+                return result;
+            }
+        default:
+            return NULL;
+    }
+}
+
+// Дети всегда имеют большие номера, чем родитель, поэтому узлы строятся
+// одним проходом с конца массива, без рекурсии
+ASTNode *flat_ast_to_node(const FlatAST *ast) {
+    if (!ast || ast->node_count == 0) return NULL;
+    ASTNode **built = (ASTNode **) tagged_calloc(ALLOC_TEMP, ast->node_count, sizeof(ASTNode *));
+    if (!built) return NULL;
+    size_t i = ast->node_count;
+    while (i > 0) {
+        i--;
+        built[i] = build_node(built, ast, (uint32_t) i);
+        if (!built[i]) break;
+        set_node_location(built[i], (int) ast->lines[i], (int) ast->columns[i]);
+    }
+    ASTNode *root = built[0];
+    if (!root) {
+        // Нехватка памяти: освобождаются узлы, ещё не забранные родителем
+        for (size_t j = 0; j < ast->node_count; j++) {
+            free_node(built[j]);
+        }
+    }
+    tagged_free(ALLOC_TEMP, built);
+    return root;
+}
+
+void flat_ast_free(FlatAST *ast) {
+    if (!ast) return;
+    if (ast->owns_arrays) {
+        tagged_free(ALLOC_AST, ast->kinds);
+        tagged_free(ALLOC_AST, ast->flags);
+        tagged_free(ALLOC_AST, ast->values);
+        tagged_free(ALLOC_AST, ast->first_child);
+        tagged_free(ALLOC_AST, ast->child_count);
+        tagged_free(ALLOC_AST, ast->lines);
+        tagged_free(ALLOC_AST, ast->columns);
+        tagged_free(ALLOC_AST, ast->children);
+        tagged_free(ALLOC_AST, ast->strings);
+    }
+    source_buffer_close(&ast->file);
+    tagged_free(ALLOC_AST, ast);
+}
+
+size_t flat_ast_memory(const FlatAST *ast) {
+    if (!ast) return 0;
+    return ast->node_count * (2 * sizeof(uint8_t) + 5 * sizeof(uint32_t))
+         + ast->children_size * sizeof(uint32_t) + ast->strings_size;
+}
+
+static int write_array(FILE *fp, const void *data, size_t size) {
+    return size == 0 || fwrite(data, 1, size, fp) == size ? 0 : -1;
+}
+
+int flat_ast_save(const FlatAST *ast, const char *filename) {
+    FlatFileHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, FLAT_AST_MAGIC, sizeof(header.magic));
+    header.version = FLAT_AST_VERSION;
+    header.byte_order = 0x01020304;
+    header.node_count = (uint32_t) ast->node_count;
+    header.children_size = (uint32_t) ast->children_size;
+    header.strings_size = (uint32_t) ast->strings_size;
+    FILE *fp = fopen(filename, "wb");
+    if (!fp) return -1;
+    size_t n = ast->node_count;
+    int status = write_array(fp, &header, sizeof(header));
+    if (status == 0) status = write_array(fp, ast->values, n * sizeof(uint32_t));
+    if (status == 0) status = write_array(fp, ast->first_child, n * sizeof(uint32_t));
+    if (status == 0) status = write_array(fp, ast->child_count, n * sizeof(uint32_t));
+    if (status == 0) status = write_array(fp, ast->lines, n * sizeof(uint32_t));
+    if (status == 0) status = write_array(fp, ast->columns, n * sizeof(uint32_t));
+    if (status == 0) status = write_array(fp, ast->children, ast->children_size * sizeof(uint32_t));
+    if (status == 0) status = write_array(fp, ast->kinds, n);
+    if (status == 0) status = write_array(fp, ast->flags, n);
+    if (status == 0) status = write_array(fp, ast->strings, ast->strings_size);
+    if (fclose(fp) != 0) status = -1;
+    return status;
+}
+
+// Проверка загруженного файла: после неё flat_ast_to_node и обход
+// по номерам не выходят за массивы, а узлы образуют одно дерево с программой в корне
+static int validate(const FlatAST *ast) {
+    size_t n = ast->node_count;
+    if (n == 0 || ast->kinds[0] != NODE_PROGRAM) return -1;
+    if (ast->strings_size > 0 && ast->strings[ast->strings_size - 1] != '\0') return -1;
+    uint8_t *referenced = (uint8_t *) tagged_calloc(ALLOC_TEMP, n, 1);
+    if (!referenced) return -1;
+    int status = 0;
+    for (size_t i = 0; i < n && status == 0; i++) {
+        int kind = ast->kinds[i];
+        int arity = kind_arity(kind);
+        uint32_t first = ast->first_child[i];
+        uint32_t count = ast->child_count[i];
+        if (kind > NODE_PRINT || (arity >= 0 && count != (uint32_t) arity)
+            || first > ast->children_size || count > ast->children_size - first
+            || (has_string(kind, ast->flags[i]) && ast->values[i] >= ast->strings_size)) {
+            status = -1;
+            break;
+        }
+        for (uint32_t k = 0; k < count; k++) {
+            uint32_t child = ast->children[first + k];
+            if (child == FLAT_NONE && slot_optional(kind, k)) continue;
+            // Дети идут после родителя: так исключены циклы
+            if (child == FLAT_NONE || child <= i || child >= n || referenced[child]) {
+                status = -1;
+                break;
+            }
+            referenced[child] = 1;
+        }
+    }
+    for (size_t i = 1; i < n && status == 0; i++) {
+        if (!referenced[i]) status = -1;
+    }
+    tagged_free(ALLOC_TEMP, referenced);
+    return status;
+}
+
+FlatAST *flat_ast_load(const char *filename) {
+    FlatAST *ast = (FlatAST *) tagged_calloc(ALLOC_AST, 1, sizeof(FlatAST));
+    if (!ast) return NULL;
+    if (source_buffer_open(&ast->file, filename) != 0) {
+        tagged_free(ALLOC_AST, ast);
+        return NULL;
+    }
+    FlatFileHeader header;
+    char *data = ast->file.data;
+    size_t length = ast->file.length;
+    if (length < sizeof(header)) {
+        flat_ast_free(ast);
+        return NULL;
+    }
+    memcpy(&header, data, sizeof(header));
+    size_t n = header.node_count;
+    size_t expected = sizeof(header) + n * (5 * sizeof(uint32_t) + 2)
+                      + (size_t) header.children_size * sizeof(uint32_t) + header.strings_size;
+    if (memcmp(header.magic, FLAT_AST_MAGIC, sizeof(header.magic)) != 0 || header.version != FLAT_AST_VERSION
+        || header.byte_order != 0x01020304 || length != expected) {
+        flat_ast_free(ast);
+        return NULL;
+    }
+    // Заголовок кратен 4 байтам, поэтому массивы uint32_t выровнены
+    char *p = data + sizeof(header);
+    ast->node_count = n;
+    ast->children_size = header.children_size;
+    ast->strings_size = header.strings_size;
+    ast->values = (uint32_t *) p;
+    p += n * sizeof(uint32_t);
+    ast->first_child = (uint32_t *) p;
+    p += n * sizeof(uint32_t);
+    ast->child_count = (uint32_t *) p;
+    p += n * sizeof(uint32_t);
+    ast->lines = (uint32_t *) p;
+    p += n * sizeof(uint32_t);
+    ast->columns = (uint32_t *) p;
+    p += n * sizeof(uint32_t);
+    ast->children = (uint32_t *) p;
+    p += ast->children_size * sizeof(uint32_t);
+    ast->kinds = (uint8_t *) p;
+    p += n;
+    ast->flags = (uint8_t *) p;
+    p += n;
+    ast->strings = p;
+    if (validate(ast) != 0) {
+        flat_ast_free(ast);
+        return NULL;
+    }
+    return ast;
+}
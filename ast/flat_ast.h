@@ -0,0 +1,114 @@
+#ifndef FLAT_AST_H
+#define FLAT_AST_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "ast.h"
+#include "../lexer/source_buffer.h"
+
+/**
+ * Плоское представление AST: узлы лежат в массивах по номеру в прямом
+ * порядке обхода (родитель раньше детей, дети слева направо), вид узла —
+ * в отдельном массиве байтов, дети — 32-битные номера в общем массиве
+ * children, у каждого узла свой непрерывный диапазон.
+ *
+ * Число детей определяется видом узла; отсутствующий ребёнок — FLAT_NONE:
+ *   NODE_PROGRAM, NODE_BLOCK    операторы блока
+ *   NODE_VARIABLE_DECLARATION   [инициализатор]
+ *   NODE_BINARY_OPERATION       [левый, правый]
+ *   NODE_ASSIGNMENT             [значение]
+ *   NODE_IF_STATEMENT           [условие, then, else]
+ *   NODE_WHILE_LOOP             [условие, тело]
+ *   NODE_ROUND_LOOP             [начало, конец, шаг, тело]
+ *   NODE_PRINT                  [выражение]
+ * values — смещение строки в strings (имя, операция, текст строкового
+ * литерала) или значение числового литерала.
+ */
+#define FLAT_NONE UINT32_MAX
+
+// Биты flags
+#define FLAT_TYPE_MASK 0x03     // тип литерала или переменной
+#define FLAT_TYPE_INT 0
+#define FLAT_TYPE_STRING 1
+#define FLAT_TYPE_FLOAT 2
+#define FLAT_GLOBAL 0x04        // evere-переменная
+
+typedef struct {
+    size_t node_count;
+    uint8_t *kinds;             // NodeType
+    uint8_t *flags;
+    uint32_t *values;
+    uint32_t *first_child;      // начало диапазона в children
+    uint32_t *child_count;
+    uint32_t *lines;            // позиция узла в исходном тексте; 0 — неизвестна
+    uint32_t *columns;
+    uint32_t *children;
+    size_t children_size;
+    char *strings;              // строки через '\0', одинаковые хранятся один раз
+    size_t strings_size;
+    // Массивы выделены вместе с FlatAST и освобождаются flat_ast_free;
+    // иначе они указывают в file — загруженный файл двоичного AST
+    int owns_arrays;
+    SourceBuffer file;
+} FlatAST;
+
+/**
+ * Строит плоское представление дерева без рекурсии.
+ * @return NULL при нехватке памяти или если дерево не помещается в 32-битные номера
+ */
+FlatAST *flat_ast_from_node(const ASTNode *root);
+
+/**
+ * Восстанавливает обычное дерево из плоского (например, для генератора кода).
+ * @return Корень или NULL при нехватке памяти; освобождается free_node
+ */
+ASTNode *flat_ast_to_node(const FlatAST *ast);
+
+void flat_ast_free(FlatAST *ast);
+
+/**
+ * Двоичный файл AST: заголовок FlatFileHeader, затем массивы values,
+ * first_child, child_count, lines, columns, children (uint32_t), kinds, flags (байты)
+ * и strings. Числа записаны в порядке байтов машины, которая писала
+ * файл; файл с другим порядком или версией не загружается.
+ */
+#define FLAT_AST_MAGIC "RAST"
+#define FLAT_AST_VERSION 2
+
+typedef struct {
+    char magic[4];
+    uint32_t version;
+    uint32_t byte_order;        // 0x01020304
+    uint32_t node_count;
+    uint32_t children_size;
+    uint32_t strings_size;
+} FlatFileHeader;
+
+// 0 при успехе, -1 при ошибке записи
+int flat_ast_save(const FlatAST *ast, const char *filename);
+
+/**
+ * Отображает файл двоичного AST в память; массивы указывают прямо в
+ * отображение. Файл проверяется целиком: номера детей и смещения строк
+ * в пределах массивов, каждый узел, кроме корня, — ребёнок ровно одного узла.
+ * @return NULL, если файл не открыт, повреждён или другой версии
+ */
+FlatAST *flat_ast_load(const char *filename);
+
+// Байты, занятые массивами узлов, детей и строк
+size_t flat_ast_memory(const FlatAST *ast);
+
+static inline NodeType flat_kind(const FlatAST *ast, uint32_t node) {
+    return (NodeType) ast->kinds[node];
+}
+
+// k-й ребёнок узла или FLAT_NONE
+static inline uint32_t flat_child(const FlatAST *ast, uint32_t node, uint32_t k) {
+    return k < ast->child_count[node] ? ast->children[ast->first_child[node] + k] : FLAT_NONE;
+}
+
+static inline const char *flat_string(const FlatAST *ast, uint32_t node) {
+    return ast->strings + ast->values[node];
+}
+
+#endif /* FLAT_AST_H */
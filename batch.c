@@ -0,0 +1,79 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "batch.h"
+#include "thread_pool.h"
+
+typedef struct {
+    const char *input;
+    char output[512];
+    const BatchOptions *options;
+    int status;
+} BatchJob;
+
+static const char *base_name(const char *path) {
+    const char *name = path;
+    for (const char *p = path; *p; p++) {
+        if (*p == '/' || *p == '\\') name = p + 1;
+    }
+    return name;
+}
+
+static int write_output(const char *path, const char *code) {
+    FILE *fp = fopen(path, "w");
+    if (!fp) {
+        fprintf(stderr, "Failed to open file %s for writing\n", path);
+        return -1;
+    }
+    fprintf(fp, "%s", code);
+    fclose(fp);
+    return 0;
+}
+
+static void compile_job(void *arg) {
+    BatchJob *job = (BatchJob *) arg;
+    CompileResult *result = job->options->load_ast ? compile_ast_file(job->options->compiler, job->input)
+                                                   : compile_file(job->options->compiler, job->input);
+    if (!result) {
+        fprintf(stderr, "Cannot open file: %s\n", job->input);
+        job->status = -1;
+        return;
+    }
+    job->status = result->status == COMPILE_OK ? write_output(job->output, result->code) : -1;
+    compile_result_free(result);
+}
+
+int compile_batch(const char **files, int count, const BatchOptions *options) {
+    BatchJob *jobs = (BatchJob *) calloc(count > 0 ? count : 1, sizeof(BatchJob));
+    if (!jobs) return count;
+    ThreadPool *pool = thread_pool_create(options->threads);
+    if (!pool) {
+        free(jobs);
+        return count;
+    }
+    for (int i = 0; i < count; i++) {
+        jobs[i].input = files[i];
+        jobs[i].options = options;
+        jobs[i].status = -1;
+        snprintf(jobs[i].output, sizeof(jobs[i].output), "%s/%s",
+                 options->output_dir, base_name(files[i]));
+        if (thread_pool_submit(pool, compile_job, &jobs[i]) != 0) {
+            compile_job(&jobs[i]);
+        }
+    }
+    thread_pool_wait(pool);
+
+    int failed = 0;
+    for (int i = 0; i < count; i++) {
+        if (jobs[i].status == 0) {
+            printf("%s -> %s\n", jobs[i].input, jobs[i].output);
+        } else {
+            printf("%s: compilation failed\n", jobs[i].input);
+            failed++;
+        }
+    }
+    printf("Compiled %d of %d files on %d threads\n", count - failed, count, thread_pool_size(pool));
+    thread_pool_free(pool);
+    free(jobs);
+    return failed;
+}
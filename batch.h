@@ -0,0 +1,20 @@
+#ifndef BATCH_H
+#define BATCH_H
+
+#include "libcompiler.h"
+
+typedef struct {
+    Compiler *compiler;
+    const char *output_dir;     // результат файла пишется в output_dir/<имя файла>
+    int threads;                // 0 — по числу ядер
+    int load_ast;               // файлы — двоичный AST (compile_ast_file)
+} BatchOptions;
+
+/**
+ * Компилирует файлы параллельно на пуле потоков через compile_file();
+ * у каждого файла собственный контекст компиляции.
+ * @return Количество файлов, которые не удалось скомпилировать
+ */
+int compile_batch(const char **files, int count, const BatchOptions *options);
+
+#endif /* BATCH_H */
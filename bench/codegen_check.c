@@ -0,0 +1,324 @@
+// Регрессия качества сгенерированного кода: программы компилируются библиотекой,
+// код выполняется симулятором, и число команд, обращений к памяти и переходов
+// сравнивается с сохранённым базовым файлом.
+// Использование: codegen_check [-baseline файл] [-threshold проценты] [-update]
+//                              [-max-steps N] [-same-output префикс] [-O0|-O1|-O2|-Os]... файл...
+// Без уровней оптимизации программы проверяются с -O1. Проверка не проходит,
+// если метрика выросла больше чем на -threshold процентов (по умолчанию 2),
+// изменился вывод программы или исход компиляции и выполнения, а также если
+// у программы из -same-output вывод или исход на разных уровнях не совпадают.
+// -update перезаписывает базовый файл текущими результатами. Листинг каждой
+// программы проверяется после каждого прохода, как с -fverify-ir.
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../libcompiler.h"
+#include "../simulator/risc_sim.h"
+
+#define MAX_BASELINE 1024
+#define MAX_LEVELS 4
+
+// Метрики в порядке столбцов CSV
+enum {
+    METRIC_INSTRUCTIONS = 0,
+    METRIC_LOADS,
+    METRIC_STORES,
+    METRIC_BRANCHES,
+    METRIC_TAKEN,
+    METRIC_JUMPS,
+    METRIC_COUNT
+};
+
+static const char *metric_names[METRIC_COUNT] = {
+    "instructions", "loads", "stores", "branches", "taken_branches", "jumps"
+};
+
+typedef struct {
+    char program[256];
+    char level[4];
+    char status[32];            // "ok", "compile-error", "parse-error" или статус симулятора
+    long metrics[METRIC_COUNT];
+    unsigned long output_hash;
+    int seen;                   // строка встретилась в текущем запуске
+} CheckRow;
+
+typedef struct {
+    const char *name;
+    OptLevel level;
+} LevelOption;
+
+static const LevelOption level_options[] = {
+    {"-O0", OPT_LEVEL_0}, {"-O1", OPT_LEVEL_1}, {"-O2", OPT_LEVEL_2}, {"-Os", OPT_LEVEL_S}
+};
+
+static CheckRow baseline[MAX_BASELINE];
+static int baseline_count;
+
+static int load_baseline(const char *path) {
+    FILE *fp = fopen(path, "r");
+    if (!fp) return -1;
+    char line[1024];
+    while (fgets(line, sizeof(line), fp) && baseline_count < MAX_BASELINE) {
+        char *fields[10];
+        int count = 0;
+        line[strcspn(line, "\r\n")] = '\0';
+        for (char *p = line; count < 10 && p; count++) {
+            fields[count] = p;
+            p = strchr(p, ',');
+            if (p) *p++ = '\0';
+        }
+        if (count < 10 || strcmp(fields[0], "program") == 0) continue;
+        CheckRow *row = &baseline[baseline_count++];
+        memset(row, 0, sizeof(*row));
+        snprintf(row->program, sizeof(row->program), "%s", fields[0]);
+        snprintf(row->level, sizeof(row->level), "%s", fields[1]);
+        snprintf(row->status, sizeof(row->status), "%s", fields[2]);
+        for (int m = 0; m < METRIC_COUNT; m++) row->metrics[m] = atol(fields[3 + m]);
+        row->output_hash = strtoul(fields[9], NULL, 16);
+    }
+    fclose(fp);
+    return 0;
+}
+
+static CheckRow *find_baseline(const char *program, const char *level) {
+    for (int i = 0; i < baseline_count; i++) {
+        if (strcmp(baseline[i].program, program) == 0 && strcmp(baseline[i].level, level) == 0) {
+            return &baseline[i];
+        }
+    }
+    return NULL;
+}
+
+// Компилирует и выполняет одну программу; результат в row
+static void measure(Compiler *compiler, const char *filename, long max_steps, CheckRow *row) {
+    memset(row, 0, sizeof(*row));
+    snprintf(row->program, sizeof(row->program), "%s", filename);
+    CompileResult *result = compile_file(compiler, filename);
+    if (!result || result->status != COMPILE_OK) {
+        snprintf(row->status, sizeof(row->status), "compile-error");
+        compile_result_free(result);
+        return;
+    }
+    char error[256];
+    RiscProgram *program = risc_program_parse(result->code, result->code_length, error, sizeof(error));
+    compile_result_free(result);
+    if (!program) {
+        fprintf(stderr, "%s: %s\n", filename, error);
+        snprintf(row->status, sizeof(row->status), "parse-error");
+        return;
+    }
+    SimOptions options;
+    sim_options_init(&options);
+    options.max_steps = max_steps;
+    SimStats stats;
+    SimStatus status = risc_simulate(program, &options, &stats);
+    risc_program_free(program);
+    snprintf(row->status, sizeof(row->status), "%s", sim_status_name(status));
+    if (status != SIM_OK && stats.fault_line > 0) {
+        fprintf(stderr, "%s: %s at line %d of the generated code\n", filename, row->status, stats.fault_line);
+    }
+    row->metrics[METRIC_INSTRUCTIONS] = stats.instructions;
+    row->metrics[METRIC_LOADS] = stats.loads;
+    row->metrics[METRIC_STORES] = stats.stores;
+    row->metrics[METRIC_BRANCHES] = stats.branches;
+    row->metrics[METRIC_TAKEN] = stats.taken_branches;
+    row->metrics[METRIC_JUMPS] = stats.jumps;
+    row->output_hash = stats.output_hash;
+}
+
+static double change_percent(long before, long after) {
+    if (before == 0) return after == 0 ? 0.0 : 100.0;
+    return (double) (after - before) * 100.0 / (double) before;
+}
+
+/**
+ * Сравнивает строку с базовой и печатает итог.
+ * @return 1, если найдена регрессия
+ */
+static int compare(const CheckRow *row, const CheckRow *base, double threshold) {
+    printf("%-36s %-4s %-13s %12ld %10ld %10ld %10ld  ", row->program, row->level, row->status,
+           row->metrics[METRIC_INSTRUCTIONS], row->metrics[METRIC_LOADS], row->metrics[METRIC_STORES],
+           row->metrics[METRIC_BRANCHES]);
+    if (!base) {
+        printf("new\n");
+        return 0;
+    }
+    if (strcmp(row->status, base->status) != 0) {
+        printf("FAIL: status was %s\n", base->status);
+        return 1;
+    }
+    if (row->output_hash != base->output_hash) {
+        printf("FAIL: program output changed\n");
+        return 1;
+    }
+    int regressed = 0;
+    int improved = 0;
+    for (int m = 0; m < METRIC_COUNT; m++) {
+        double change = change_percent(base->metrics[m], row->metrics[m]);
+        if (change > threshold) regressed = 1;
+        if (change < -threshold) improved = 1;
+    }
+    printf("%s\n", regressed ? "FAIL" : improved ? "improved" : "ok");
+    if (!regressed && !improved) return 0;
+    for (int m = 0; m < METRIC_COUNT; m++) {
+        if (row->metrics[m] == base->metrics[m]) continue;
+        printf("    %-16s %12ld -> %-12ld %+.1f%%\n", metric_names[m], base->metrics[m], row->metrics[m],
+               change_percent(base->metrics[m], row->metrics[m]));
+    }
+    return regressed;
+}
+
+/**
+ * Оптимизации не должны менять поведение программы: исход и вывод на каждом
+ * уровне сравниваются с первым уровнем. Проверяются только программы, путь
+ * которых начинается с prefix: примеры печатают адреса конкатенаций, а они
+ * зависят от раскладки данных. Строки rows идут по уровням.
+ * @return Число расхождений
+ */
+static int compare_levels(const CheckRow *rows, int file_count, int level_count, const char *prefix) {
+    int mismatches = 0;
+    for (int i = 0; i < file_count && prefix; i++) {
+        const CheckRow *first = &rows[i];
+        if (strncmp(first->program, prefix, strlen(prefix)) != 0) continue;
+        for (int l = 1; l < level_count; l++) {
+            const CheckRow *row = &rows[l * file_count + i];
+            if (strcmp(row->status, first->status) == 0 && row->output_hash == first->output_hash) continue;
+            printf("%-36s %-4s FAIL: status or output differs from %s\n", row->program, row->level,
+                   first->level);
+            mismatches++;
+        }
+    }
+    return mismatches;
+}
+
+static int write_baseline(const char *path, const CheckRow *rows, int count) {
+    FILE *fp = fopen(path, "w");
+    if (!fp) return -1;
+    fprintf(fp, "program,level,status");
+    for (int m = 0; m < METRIC_COUNT; m++) fprintf(fp, ",%s", metric_names[m]);
+    fprintf(fp, ",output_hash\n");
+    for (int i = 0; i < count; i++) {
+        const CheckRow *row = &rows[i];
+        fprintf(fp, "%s,%s,%s", row->program, row->level, row->status);
+        for (int m = 0; m < METRIC_COUNT; m++) fprintf(fp, ",%ld", row->metrics[m]);
+        fprintf(fp, ",%08lx\n", row->output_hash);
+    }
+    return fclose(fp);
+}
+
+static void show_usage(const char *program_name) {
+    fprintf(stderr, "Usage: %s [options] <file>...\n", program_name);
+    fprintf(stderr, "Options:\n");
+    fprintf(stderr, "  -baseline <file>   Metrics to compare with (default bench/codegen_baseline.csv)\n");
+    fprintf(stderr, "  -threshold <pct>   Allowed growth of a metric in percent (default 2)\n");
+    fprintf(stderr, "  -update            Rewrite the baseline with the current results\n");
+    fprintf(stderr, "  -max-steps <n>     Instruction budget per program (default %ld)\n",
+            RISC_SIM_DEFAULT_MAX_STEPS);
+    fprintf(stderr, "  -same-output <prefix>  Programs under prefix must behave the same at all levels\n");
+    fprintf(stderr, "  -O0 | -O1 | -O2 | -Os  Optimization levels to check, may repeat (default -O1)\n");
+}
+
+int main(int argc, char *argv[]) {
+    const char *baseline_path = "bench/codegen_baseline.csv";
+    double threshold = 2.0;
+    int update = 0;
+    long max_steps = RISC_SIM_DEFAULT_MAX_STEPS;
+    const char *same_output = NULL;
+    const LevelOption *levels[MAX_LEVELS];
+    int level_count = 0;
+    int first_file = argc;
+
+    for (int i = 1; i < argc; i++) {
+        int has_value = i + 1 < argc;
+        const LevelOption *level = NULL;
+        for (int l = 0; l < MAX_LEVELS; l++) {
+            if (strcmp(argv[i], level_options[l].name) == 0) level = &level_options[l];
+        }
+        if (level) {
+            if (level_count < MAX_LEVELS) levels[level_count++] = level;
+        } else if (strcmp(argv[i], "-baseline") == 0 && has_value) {
+            baseline_path = argv[++i];
+        } else if (strcmp(argv[i], "-threshold") == 0 && has_value) {
+            threshold = atof(argv[++i]);
+        } else if (strcmp(argv[i], "-update") == 0) {
+            update = 1;
+        } else if (strcmp(argv[i], "-max-steps") == 0 && has_value) {
+            max_steps = atol(argv[++i]);
+        } else if (strcmp(argv[i], "-same-output") == 0 && has_value) {
+            same_output = argv[++i];
+        } else if (argv[i][0] == '-') {
+            show_usage(argv[0]);
+            return 1;
+        } else {
+            first_file = i;
+            break;
+        }
+    }
+    if (first_file == argc) {
+        show_usage(argv[0]);
+        return 1;
+    }
+    if (level_count == 0) levels[level_count++] = &level_options[1];
+    if (!update && load_baseline(baseline_path) != 0) {
+        fprintf(stderr, "No baseline %s: run with -update to create it\n", baseline_path);
+    }
+
+    int row_capacity = (argc - first_file) * level_count;
+    CheckRow *rows = (CheckRow *) calloc((size_t) row_capacity, sizeof(CheckRow));
+    if (!rows) {
+        fprintf(stderr, "Out of memory\n");
+        return 1;
+    }
+    int row_count = 0;
+    int failures = 0;
+    printf("%-36s %-4s %-13s %12s %10s %10s %10s  %s\n",
+           "Program", "Opt", "Status", "Instructions", "Loads", "Stores", "Branches", "Result");
+    for (int l = 0; l < level_count; l++) {
+        PassManager *pass_manager = pass_manager_create(levels[l]->level);
+        CompilerOptions options;
+        compiler_options_init(&options);
+        options.pass_manager = pass_manager;
+        Compiler *compiler = pass_manager ? compiler_create(&options) : NULL;
+        if (!compiler) {
+            fprintf(stderr, "Out of memory\n");
+            pass_manager_free(pass_manager);
+            free(rows);
+            return 1;
+        }
+        pass_manager_set_verify(pass_manager, 1);
+        for (int i = first_file; i < argc; i++) {
+            CheckRow *row = &rows[row_count++];
+            measure(compiler, argv[i], max_steps, row);
+            snprintf(row->level, sizeof(row->level), "%s", levels[l]->name + 1);
+            if (update) continue;
+            CheckRow *base = find_baseline(row->program, row->level);
+            if (base) base->seen = 1;
+            failures += compare(row, base, threshold);
+        }
+        compiler_free(compiler);
+        pass_manager_free(pass_manager);
+    }
+
+    if (update) {
+        int status = write_baseline(baseline_path, rows, row_count);
+        if (status != 0) fprintf(stderr, "Cannot write %s\n", baseline_path);
+        else printf("Baseline %s updated: %d programs\n", baseline_path, row_count);
+        free(rows);
+        return status != 0;
+    }
+    int unchecked = 0;
+    for (int i = 0; i < baseline_count; i++) {
+        if (!baseline[i].seen) unchecked++;
+    }
+    if (unchecked > 0) printf("%d baseline entries were not checked in this run\n", unchecked);
+    int mismatches = compare_levels(rows, argc - first_file, level_count, same_output);
+    free(rows);
+    if (mismatches > 0) {
+        printf("%d results differ from the first optimization level\n", mismatches);
+    }
+    if (failures > 0) {
+        printf("%d regressions beyond %.1f%%; if intended, update the baseline (make update-codegen-baseline)\n",
+               failures, threshold);
+    }
+    return failures > 0 || mismatches > 0;
+}
@@ -0,0 +1,584 @@
+// Пропускная способность компилятора на сгенерированных программах разной формы и размера.
+// Использование: compile_bench [-compiler путь] [-shapes форма,...] [-min-lines N] [-max-lines N]
+//                              [-repeat N] [-timeout секунд] [-dir каталог] [-keep]
+//                              [-results файл] [-label имя] [-baseline имя] [-- параметры компилятора]
+//                compile_bench -generate <форма> <строк> <файл>
+// Размер растёт от -min-lines в 10 раз до -max-lines; форма, не уложившаяся в -timeout,
+// дальше не растёт. Компилятор запускается отдельным процессом: время и пик RSS — его собственные.
+// Результаты дописываются в CSV (по умолчанию bench/results.csv); -baseline сравнивает
+// с прошлым запуском под этим именем.
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <time.h>
+#ifdef _WIN32
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#endif
+#include "../compile_context.h"
+#include "../parser/parser.tab.h"
+
+#define EXPR_LINES 200          // строк в одном выражении формы expr
+#define CONCAT_LINES 100        // строк в одной цепочке формы concat
+#define BLOCK_DECL_EVERY 8      // каждая восьмая строка формы block — объявление
+#define MIXED_CHUNK 1000        // строк подряд одной формы в mixed
+#define MAX_BASELINE 256
+
+typedef struct {
+    FILE *fp;
+    long lines;
+    long next_id;               // номер для уникальных имён переменных
+} Writer;
+
+static void emit(Writer *w, const char *format, ...) {
+    va_list args;
+    va_start(args, format);
+    vfprintf(w->fp, format, args);
+    va_end(args);
+    w->lines++;
+}
+
+// Много глобальных переменных; каждая десятая строка — присваивание из последних двух
+static void generate_globals(Writer *w, long until) {
+    long first = w->next_id;
+    while (w->lines < until) {
+        long id = w->next_id;
+        if (id - first >= 2 && w->lines % 10 == 9) {
+            emit(w, "g%ld = g%ld + g%ld;\n", id - 1, id - 1, id - 2);
+        } else {
+            emit(w, "int evere g%ld = %ld;\n", id, id % 1000);
+            w->next_id++;
+        }
+    }
+}
+
+// Длинные левоассоциативные выражения: глубина дерева растёт с длиной цепочки
+static void generate_expr(Writer *w, long until) {
+    while (w->lines < until) {
+        long id = w->next_id++;
+        emit(w, "int evere e%ld = %ld\n", id, id % 7 + 1);
+        for (int i = 1; i < EXPR_LINES - 1 && w->lines < until; i++) {
+            emit(w, "    + total * %d - (total %% %d)\n", i % 9 + 1, i % 5 + 2);
+        }
+        emit(w, "    ;\n");
+    }
+}
+
+// Цепочки конкатенации строковых литералов
+static void generate_concat(Writer *w, long until) {
+    while (w->lines < until) {
+        long id = w->next_id++;
+        emit(w, "string evere s%ld = \"part%ld\"\n", id, id);
+        for (int i = 1; i < CONCAT_LINES - 2 && w->lines < until; i++) {
+            emit(w, "    . \"chunk%d\"\n", i);
+        }
+        emit(w, "    ;\n");
+        emit(w, "print(s%ld);\n", id);
+    }
+}
+
+// Вложенные циклы while и round с ветвлением в теле
+static void generate_loops(Writer *w, long until) {
+    while (w->lines < until) {
+        long id = w->next_id++;
+        emit(w, "int evere i%ld = 0;\n", id);
+        emit(w, "int evere j%ld = 0;\n", id);
+        emit(w, "while (i%ld < 3) {\n", id);
+        emit(w, "    round j%ld in range(0, 3, 1) {\n", id);
+        emit(w, "        if (i%ld > 1) {\n", id);
+        emit(w, "            total = total + i%ld + j%ld;\n", id, id);
+        emit(w, "        } else {\n");
+        emit(w, "            total = total - 1;\n");
+        emit(w, "        }\n");
+        emit(w, "    }\n");
+        emit(w, "    i%ld = i%ld + 1;\n", id, id);
+        emit(w, "}\n");
+    }
+}
+
+// Один большой блок с локальными переменными
+static void generate_block(Writer *w, long until) {
+    long last = w->next_id++;
+    emit(w, "{\n");
+    emit(w, "    int lim b%ld = total;\n", last);
+    while (w->lines < until - 2) {
+        if (w->lines % BLOCK_DECL_EVERY == 0) {
+            long id = w->next_id++;
+            emit(w, "    int lim b%ld = b%ld + %ld;\n", id, last, w->lines % 100);
+            last = id;
+        } else {
+            emit(w, "    b%ld = b%ld + %ld;\n", last, last, w->lines % 9);
+        }
+    }
+    emit(w, "    total = b%ld;\n", last);
+    emit(w, "}\n");
+}
+
+static void generate_mixed(Writer *w, long until);
+
+typedef struct {
+    const char *name;
+    void (*generate)(Writer *w, long until);
+} Shape;
+
+static const Shape shapes[] = {
+    {"globals", generate_globals},
+    {"expr", generate_expr},
+    {"concat", generate_concat},
+    {"loops", generate_loops},
+    {"block", generate_block},
+    {"mixed", generate_mixed},
+};
+
+#define SHAPE_COUNT (sizeof(shapes) / sizeof(shapes[0]))
+
+static void generate_mixed(Writer *w, long until) {
+    for (size_t s = 0; w->lines < until; s = (s + 1) % (SHAPE_COUNT - 1)) {
+        long chunk_end = w->lines + MIXED_CHUNK;
+        shapes[s].generate(w, chunk_end < until ? chunk_end : until);
+    }
+}
+
+static const Shape *find_shape(const char *name, size_t length) {
+    for (size_t i = 0; i < SHAPE_COUNT; i++) {
+        if (strlen(shapes[i].name) == length && strncmp(shapes[i].name, name, length) == 0) return &shapes[i];
+    }
+    return NULL;
+}
+
+// Пишет программу формы shape примерно из lines строк; возвращает число строк или -1
+static long generate_program(const Shape *shape, long lines, const char *filename) {
+    Writer w = {fopen(filename, "w"), 0, 0};
+    if (!w.fp) return -1;
+    emit(&w, "int evere total = 0;\n");
+    shape->generate(&w, lines - 1);
+    emit(&w, "print(total);\n");
+    int failed = ferror(w.fp);
+    if (fclose(w.fp) != 0) failed = 1;
+    return failed ? -1 : w.lines;
+}
+
+// Число токенов файла по лексеру компилятора (как в lexer_bench)
+static long count_tokens(const char *filename, size_t *bytes) {
+    SourceBuffer source;
+    if (source_buffer_open(&source, filename) != 0) return -1;
+    *bytes = source.length;
+    CompileContext ctx;
+    compile_context_init(&ctx, filename);
+    ctx.source = source.data;
+    ctx.source_length = source.length;
+    CompileContext *previous = compile_context_bind(&ctx);
+    yyscan_t scanner;
+    long tokens = 0;
+    if (yylex_init_extra(&ctx, &scanner) == 0) {
+        if (yy_scan_buffer(source.data, source_buffer_scan_size(&source), scanner)) {
+            YYSTYPE value;
+            YYLTYPE location;
+            while (yylex(&value, &location, scanner) != 0) tokens++;
+        }
+        yylex_destroy(scanner);
+    }
+    compile_context_bind(previous);
+    compile_context_free(&ctx);
+    source_buffer_close(&source);
+    return tokens;
+}
+
+enum {
+    RUN_OK = 0,
+    RUN_FAILED,
+    RUN_TIMEOUT
+};
+
+static const char *run_status_names[] = {"ok", "failed", "timeout"};
+
+typedef struct {
+    double wall;                // с
+    double cpu;                 // с, процесс компилятора
+    long peak_rss;              // КБ, процесс компилятора
+    int status;
+} RunResult;
+
+static double wall_seconds(void) {
+#ifdef _WIN32
+    LARGE_INTEGER counter, frequency;
+    QueryPerformanceCounter(&counter);
+    QueryPerformanceFrequency(&frequency);
+    return (double) counter.QuadPart / (double) frequency.QuadPart;
+#else
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (double) now.tv_sec + (double) now.tv_nsec / 1e9;
+#endif
+}
+
+#ifdef _WIN32
+
+static void append_argument(char *line, size_t size, const char *arg) {
+    size_t length = strlen(line);
+    snprintf(line + length, length < size ? size - length : 0, "%s\"%s\"", length > 0 ? " " : "", arg);
+}
+
+static int run_compiler(const char **argv, int timeout, RunResult *result) {
+    char line[8192] = "";
+    for (int i = 0; argv[i]; i++) append_argument(line, sizeof(line), argv[i]);
+    SECURITY_ATTRIBUTES inherit = {sizeof(inherit), NULL, TRUE};
+    HANDLE null_output = CreateFileA("NUL", GENERIC_WRITE, FILE_SHARE_WRITE, &inherit, OPEN_EXISTING, 0, NULL);
+    STARTUPINFOA startup;
+    PROCESS_INFORMATION process;
+    memset(&startup, 0, sizeof(startup));
+    startup.cb = sizeof(startup);
+    startup.dwFlags = STARTF_USESTDHANDLES;
+    startup.hStdInput = GetStdHandle(STD_INPUT_HANDLE);
+    startup.hStdOutput = null_output;
+    startup.hStdError = null_output;
+    double start = wall_seconds();
+    if (!CreateProcessA(NULL, line, NULL, NULL, TRUE, 0, NULL, NULL, &startup, &process)) {
+        CloseHandle(null_output);
+        return -1;
+    }
+    DWORD waited = WaitForSingleObject(process.hProcess, timeout > 0 ? (DWORD) timeout * 1000 : INFINITE);
+    if (waited == WAIT_TIMEOUT) {
+        TerminateProcess(process.hProcess, 1);
+        WaitForSingleObject(process.hProcess, INFINITE);
+    }
+    result->wall = wall_seconds() - start;
+    DWORD exit_code = 1;
+    GetExitCodeProcess(process.hProcess, &exit_code);
+    FILETIME created, exited, kernel, user;
+    GetProcessTimes(process.hProcess, &created, &exited, &kernel, &user);
+    ULARGE_INTEGER k, u;
+    k.LowPart = kernel.dwLowDateTime;
+    k.HighPart = kernel.dwHighDateTime;
+    u.LowPart = user.dwLowDateTime;
+    u.HighPart = user.dwHighDateTime;
+    result->cpu = (double) (k.QuadPart + u.QuadPart) / 1e7;
+    PROCESS_MEMORY_COUNTERS memory;
+    result->peak_rss = GetProcessMemoryInfo(process.hProcess, &memory, sizeof(memory))
+                       ? (long) (memory.PeakWorkingSetSize / 1024) : 0;
+    result->status = waited == WAIT_TIMEOUT ? RUN_TIMEOUT : exit_code == 0 ? RUN_OK : RUN_FAILED;
+    CloseHandle(process.hThread);
+    CloseHandle(process.hProcess);
+    CloseHandle(null_output);
+    return 0;
+}
+
+#else
+
+// SIGALRM только прерывает ожидание дочернего процесса
+static void on_alarm(int signal_number) {
+    (void) signal_number;
+}
+
+static int run_compiler(const char **argv, int timeout, RunResult *result) {
+    struct sigaction action;
+    memset(&action, 0, sizeof(action));
+    action.sa_handler = on_alarm;
+    sigemptyset(&action.sa_mask);
+    sigaction(SIGALRM, &action, NULL);
+    double start = wall_seconds();
+    pid_t pid = fork();
+    if (pid < 0) return -1;
+    if (pid == 0) {
+        int null_output = open("/dev/null", O_WRONLY);
+        if (null_output >= 0) {
+            dup2(null_output, STDOUT_FILENO);
+            dup2(null_output, STDERR_FILENO);
+        }
+        execv(argv[0], (char *const *) argv);
+        _exit(127);
+    }
+    if (timeout > 0) alarm((unsigned) timeout);
+    int status = 0;
+    struct rusage usage;
+    int timed_out = 0;
+    while (wait4(pid, &status, 0, &usage) < 0) {
+        if (errno != EINTR) return -1;
+        timed_out = 1;
+        kill(pid, SIGKILL);
+    }
+    alarm(0);
+    result->wall = wall_seconds() - start;
+    result->cpu = (double) usage.ru_utime.tv_sec + (double) usage.ru_utime.tv_usec / 1e6 +
+                  (double) usage.ru_stime.tv_sec + (double) usage.ru_stime.tv_usec / 1e6;
+#ifdef __APPLE__
+    result->peak_rss = (long) (usage.ru_maxrss / 1024);
+#else
+    result->peak_rss = (long) usage.ru_maxrss;
+#endif
+    if (timed_out) {
+        result->status = RUN_TIMEOUT;
+    } else {
+        result->status = WIFEXITED(status) && WEXITSTATUS(status) == 0 ? RUN_OK : RUN_FAILED;
+    }
+    return 0;
+}
+
+#endif /* _WIN32 */
+
+typedef struct {
+    char shape[32];
+    long lines;
+    double lines_per_second;
+    long peak_rss;
+} BaselineRow;
+
+typedef struct {
+    const char *compiler;
+    const char **options;
+    int option_count;
+    int repeat;
+    int timeout;
+    const char *dir;
+    int keep;
+    FILE *results;
+    const char *label;
+    BaselineRow baseline[MAX_BASELINE];
+    int baseline_count;
+} BenchConfig;
+
+// Строки прошлого запуска с меткой label из CSV результатов
+static int load_baseline(BenchConfig *config, const char *path, const char *label) {
+    FILE *fp = fopen(path, "r");
+    if (!fp) return -1;
+    char line[1024];
+    while (fgets(line, sizeof(line), fp) && config->baseline_count < MAX_BASELINE) {
+        char *fields[11];
+        int count = 0;
+        for (char *p = line; count < 11 && p; count++) {
+            fields[count] = p;
+            p = strchr(p, ',');
+            if (p) *p++ = '\0';
+        }
+        if (count < 11 || strcmp(fields[0], label) != 0 || strncmp(fields[10], "ok", 2) != 0) continue;
+        BaselineRow *row = &config->baseline[config->baseline_count++];
+        snprintf(row->shape, sizeof(row->shape), "%s", fields[1]);
+        row->lines = atol(fields[2]);
+        row->lines_per_second = atof(fields[7]);
+        row->peak_rss = atol(fields[9]);
+    }
+    fclose(fp);
+    return 0;
+}
+
+static const BaselineRow *find_baseline(const BenchConfig *config, const char *shape, long lines) {
+    for (int i = 0; i < config->baseline_count; i++) {
+        if (config->baseline[i].lines == lines && strcmp(config->baseline[i].shape, shape) == 0) {
+            return &config->baseline[i];
+        }
+    }
+    return NULL;
+}
+
+/**
+ * Генерирует программу, компилирует её repeat раз и печатает лучший результат.
+ * @return Статус лучшего запуска или -1, если запустить компилятор не удалось
+ */
+static int bench_one(const BenchConfig *config, const Shape *shape, long target_lines) {
+    char source[1024], output[1024];
+    snprintf(source, sizeof(source), "%s/%s_%ld.txt", config->dir, shape->name, target_lines);
+    snprintf(output, sizeof(output), "%s/%s_%ld.risc", config->dir, shape->name, target_lines);
+    long lines = generate_program(shape, target_lines, source);
+    if (lines < 0) {
+        fprintf(stderr, "Cannot write %s\n", source);
+        return -1;
+    }
+    size_t bytes = 0;
+    long tokens = count_tokens(source, &bytes);
+
+    const char *argv[64];
+    int argc = 0;
+    argv[argc++] = config->compiler;
+    argv[argc++] = source;
+    argv[argc++] = "-o";
+    argv[argc++] = output;
+    for (int i = 0; i < config->option_count && argc < 63; i++) argv[argc++] = config->options[i];
+    argv[argc] = NULL;
+
+    RunResult best;
+    memset(&best, 0, sizeof(best));
+    best.status = RUN_FAILED;
+    for (int r = 0; r < config->repeat; r++) {
+        RunResult run;
+        if (run_compiler(argv, config->timeout, &run) != 0) {
+            fprintf(stderr, "Cannot run %s\n", config->compiler);
+            remove(source);
+            return -1;
+        }
+        if (r == 0 || (run.status == RUN_OK && (best.status != RUN_OK || run.wall < best.wall))) {
+            long peak_rss = best.peak_rss > run.peak_rss ? best.peak_rss : run.peak_rss;
+            best = run;
+            best.peak_rss = peak_rss;
+        }
+        if (run.status != RUN_OK) break;
+    }
+    if (!config->keep) {
+        remove(source);
+        remove(output);
+    }
+
+    // Скорость имеет смысл только для завершившейся компиляции
+    int measured = best.status == RUN_OK && best.wall > 0;
+    double lines_per_second = measured ? (double) lines / best.wall : 0.0;
+    double tokens_per_second = measured ? (double) tokens / best.wall : 0.0;
+    printf("%-8s %10ld %11ld %9.2f %9.3f %9.3f %12.0f %12.0f %10.1f  %-7s",
+           shape->name, lines, tokens, (double) bytes / (1024.0 * 1024.0), best.wall, best.cpu,
+           lines_per_second, tokens_per_second, (double) best.peak_rss / 1024.0, run_status_names[best.status]);
+    const BaselineRow *base = find_baseline(config, shape->name, target_lines);
+    if (base && best.status == RUN_OK && base->lines_per_second > 0 && base->peak_rss > 0) {
+        printf(" speed x%.2f, RSS x%.2f", lines_per_second / base->lines_per_second,
+               (double) best.peak_rss / (double) base->peak_rss);
+    }
+    printf("\n");
+    fflush(stdout);
+    if (config->results) {
+        fprintf(config->results, "%s,%s,%ld,%ld,%lu,%.6f,%.6f,%.1f,%.1f,%ld,%s\n",
+                config->label, shape->name, target_lines, tokens, (unsigned long) bytes, best.wall, best.cpu,
+                lines_per_second, tokens_per_second, best.peak_rss, run_status_names[best.status]);
+        fflush(config->results);
+    }
+    return best.status;
+}
+
+static void show_usage(const char *program_name) {
+    fprintf(stderr, "Usage: %s [options] [-- compiler options]\n", program_name);
+    fprintf(stderr, "       %s -generate <shape> <lines> <file>\n", program_name);
+    fprintf(stderr, "Options:\n");
+    fprintf(stderr, "  -compiler <path>   Compiler to run (default ./compiler.exe)\n");
+    fprintf(stderr, "  -shapes <a,b,...>  Program shapes (default all):");
+    for (size_t i = 0; i < SHAPE_COUNT; i++) fprintf(stderr, " %s", shapes[i].name);
+    fprintf(stderr, "\n");
+    fprintf(stderr, "  -min-lines <n>     Smallest program (default 1000)\n");
+    fprintf(stderr, "  -max-lines <n>     Largest program, sizes grow x10 (default 1000000; up to 10000000)\n");
+    fprintf(stderr, "  -repeat <n>        Runs per program, best time is reported (default 3)\n");
+    fprintf(stderr, "  -timeout <s>       Stop a shape once a run takes longer (default 120, 0 = none)\n");
+    fprintf(stderr, "  -dir <path>        Directory for generated programs (default .)\n");
+    fprintf(stderr, "  -keep              Keep generated programs and compiler output\n");
+    fprintf(stderr, "  -results <file>    Append results to CSV file (default bench/results.csv)\n");
+    fprintf(stderr, "  -label <name>      Name of this run in the results (default current time)\n");
+    fprintf(stderr, "  -baseline <name>   Compare with an earlier run from the results file\n");
+}
+
+int main(int argc, char *argv[]) {
+    if (argc == 5 && strcmp(argv[1], "-generate") == 0) {
+        const Shape *shape = find_shape(argv[2], strlen(argv[2]));
+        long lines = atol(argv[3]);
+        if (!shape || lines < 2) {
+            show_usage(argv[0]);
+            return 1;
+        }
+        if (generate_program(shape, lines, argv[4]) < 0) {
+            fprintf(stderr, "Cannot write %s\n", argv[4]);
+            return 1;
+        }
+        return 0;
+    }
+
+    BenchConfig config;
+    memset(&config, 0, sizeof(config));
+    config.compiler = "./compiler.exe";
+    config.repeat = 3;
+    config.timeout = 120;
+    config.dir = ".";
+    const char *shape_list = NULL;
+    const char *results_path = "bench/results.csv";
+    const char *baseline_label = NULL;
+    long min_lines = 1000;
+    long max_lines = 1000000;
+    char default_label[32];
+    time_t now = time(NULL);
+    strftime(default_label, sizeof(default_label), "%Y-%m-%dT%H:%M:%S", localtime(&now));
+    config.label = default_label;
+
+    for (int i = 1; i < argc; i++) {
+        int has_value = i + 1 < argc;
+        if (strcmp(argv[i], "--") == 0) {
+            config.options = (const char **) (argv + i + 1);
+            config.option_count = argc - i - 1;
+            break;
+        } else if (strcmp(argv[i], "-compiler") == 0 && has_value) {
+            config.compiler = argv[++i];
+        } else if (strcmp(argv[i], "-shapes") == 0 && has_value) {
+            shape_list = argv[++i];
+        } else if (strcmp(argv[i], "-min-lines") == 0 && has_value) {
+            min_lines = atol(argv[++i]);
+        } else if (strcmp(argv[i], "-max-lines") == 0 && has_value) {
+            max_lines = atol(argv[++i]);
+        } else if (strcmp(argv[i], "-repeat") == 0 && has_value) {
+            config.repeat = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-timeout") == 0 && has_value) {
+            config.timeout = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-dir") == 0 && has_value) {
+            config.dir = argv[++i];
+        } else if (strcmp(argv[i], "-keep") == 0) {
+            config.keep = 1;
+        } else if (strcmp(argv[i], "-results") == 0 && has_value) {
+            results_path = argv[++i];
+        } else if (strcmp(argv[i], "-label") == 0 && has_value) {
+            config.label = argv[++i];
+        } else if (strcmp(argv[i], "-baseline") == 0 && has_value) {
+            baseline_label = argv[++i];
+        } else {
+            show_usage(argv[0]);
+            return 1;
+        }
+    }
+    if (config.repeat < 1) config.repeat = 1;
+    if (min_lines < 10) min_lines = 10;
+    if (strpbrk(config.label, ",\n")) {
+        fprintf(stderr, "Label must not contain commas or newlines\n");
+        return 1;
+    }
+
+    const Shape *selected[SHAPE_COUNT];
+    size_t selected_count = 0;
+    for (const char *p = shape_list; p && *p;) {
+        size_t length = strcspn(p, ",");
+        const Shape *shape = find_shape(p, length);
+        if (!shape) {
+            fprintf(stderr, "Unknown shape: %.*s\n", (int) length, p);
+            return 1;
+        }
+        if (selected_count < SHAPE_COUNT) selected[selected_count++] = shape;
+        p += length;
+        if (*p == ',') p++;
+    }
+    if (!shape_list) {
+        for (size_t i = 0; i < SHAPE_COUNT; i++) selected[selected_count++] = &shapes[i];
+    }
+
+    if (baseline_label && load_baseline(&config, results_path, baseline_label) != 0) {
+        fprintf(stderr, "Cannot read results file %s\n", results_path);
+    } else if (baseline_label && config.baseline_count == 0) {
+        fprintf(stderr, "No results labeled %s in %s\n", baseline_label, results_path);
+    }
+    config.results = fopen(results_path, "a");
+    if (!config.results) {
+        fprintf(stderr, "Cannot open results file %s; results are not saved\n", results_path);
+    } else if (ftell(config.results) == 0) {
+        fprintf(config.results, "label,shape,lines,tokens,bytes,wall_s,cpu_s,lines_per_s,tokens_per_s,"
+                                "peak_rss_kb,status\n");
+    }
+
+    printf("compiler: %s, repeat: %d, label: %s\n", config.compiler, config.repeat, config.label);
+    printf("%-8s %10s %11s %9s %9s %9s %12s %12s %10s  %s\n", "Shape", "Lines", "Tokens", "MB",
+           "Wall s", "CPU s", "Lines/s", "Tokens/s", "Peak MB", "Status");
+    int status = 0;
+    for (size_t s = 0; s < selected_count; s++) {
+        for (long lines = min_lines; lines <= max_lines; lines *= 10) {
+            int result = bench_one(&config, selected[s], lines);
+            if (result < 0 || result == RUN_FAILED) status = 1;
+            if (result != RUN_OK) break;
+        }
+    }
+    if (config.results) fclose(config.results);
+    return status;
+}
@@ -0,0 +1,115 @@
+// Пропускная способность лексера без парсера: yylex по буферу в памяти.
+// Использование: lexer_bench [-mb N] [-repeat N] [файл...]
+// Без файлов генерируется текст с длинными комментариями, отступами и именами.
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "../compile_context.h"
+#include "../parser/parser.tab.h"
+#include "../lexer/prescan.h"
+
+static const char *sample_lines[] = {
+    "int evere counter_with_a_rather_long_descriptive_name = 0;\n",
+    "        // комментарий на всю строку, какие оставляет генератор программ ............\n",
+    "    /* многострочный комментарий\n       со второй строкой и отступом */\n",
+    "while (counter_with_a_rather_long_descriptive_name < 100) {\n",
+    "\t\tcounter_with_a_rather_long_descriptive_name = counter_with_a_rather_long_descriptive_name + 1;\n",
+    "    string lim message_buffer_for_output = \"value: \" . \"text\";\n",
+    "}\n",
+    "\n",
+};
+
+static char *generate_source(size_t size, size_t *length) {
+    char *text = (char *) malloc(size + 256);
+    if (!text) return NULL;
+    size_t used = 0;
+    size_t line_count = sizeof(sample_lines) / sizeof(sample_lines[0]);
+    for (size_t i = 0; used < size; i++) {
+        const char *line = sample_lines[i % line_count];
+        size_t len = strlen(line);
+        memcpy(text + used, line, len);
+        used += len;
+    }
+    *length = used;
+    return text;
+}
+
+// Один проход лексера; возвращает количество токенов
+static long lex_buffer(SourceBuffer *source) {
+    CompileContext ctx;
+    compile_context_init(&ctx, "bench");
+    ctx.source = source->data;
+    ctx.source_length = source->length;
+    CompileContext *previous = compile_context_bind(&ctx);
+    yyscan_t scanner;
+    long tokens = 0;
+    if (yylex_init_extra(&ctx, &scanner) == 0) {
+        if (yy_scan_buffer(source->data, source_buffer_scan_size(source), scanner)) {
+            YYSTYPE value;
+            YYLTYPE location;
+            while (yylex(&value, &location, scanner) != 0) tokens++;
+        }
+        yylex_destroy(scanner);
+    }
+    compile_context_bind(previous);
+    compile_context_free(&ctx);
+    return tokens;
+}
+
+static void run(const char *name, SourceBuffer *source, int repeat) {
+    long tokens = 0;
+    clock_t start = clock();
+    for (int i = 0; i < repeat; i++) {
+        tokens = lex_buffer(source);
+    }
+    double seconds = (double) (clock() - start) / CLOCKS_PER_SEC;
+    double megabytes = (double) source->length * repeat / (1024.0 * 1024.0);
+    printf("%-24s %10.2f MB %10ld tokens %10.1f MB/s %12.0f tokens/s\n",
+           name, (double) source->length / (1024.0 * 1024.0), tokens,
+           seconds > 0 ? megabytes / seconds : 0.0,
+           seconds > 0 ? (double) tokens * repeat / seconds : 0.0);
+}
+
+int main(int argc, char *argv[]) {
+    size_t size_mb = 16;
+    int repeat = 5;
+    int first_file = argc;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-mb") == 0 && i + 1 < argc) {
+            size_mb = (size_t) atol(argv[++i]);
+        } else if (strcmp(argv[i], "-repeat") == 0 && i + 1 < argc) {
+            repeat = atoi(argv[++i]);
+        } else {
+            first_file = i;
+            break;
+        }
+    }
+    if (repeat < 1) repeat = 1;
+    printf("prescan: %s, repeat: %d\n", prescan_implementation(), repeat);
+
+    if (first_file == argc) {
+        size_t length;
+        char *text = generate_source(size_mb * 1024 * 1024, &length);
+        SourceBuffer source;
+        if (!text || source_buffer_from_memory(&source, text, length) != 0) {
+            fprintf(stderr, "Out of memory\n");
+            free(text);
+            return 1;
+        }
+        free(text);
+        run("generated", &source, repeat);
+        source_buffer_close(&source);
+        return 0;
+    }
+    for (int i = first_file; i < argc; i++) {
+        SourceBuffer source;
+        if (source_buffer_open(&source, argv[i]) != 0) {
+            fprintf(stderr, "Cannot open file: %s\n", argv[i]);
+            return 1;
+        }
+        run(argv[i], &source, repeat);
+        source_buffer_close(&source);
+    }
+    return 0;
+}
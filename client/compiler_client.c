@@ -0,0 +1,139 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "compile_protocol.h"
+#include "libcompiler.h"
+
+// Клиент сервера компиляции (compiler.exe -server): читает файл, отправляет его
+// с параметрами командной строки и выводит ответ так же, как compiler.exe
+
+static void show_usage(const char *program_name) {
+    fprintf(stderr, "Usage: %s <file> [options]\n", program_name);
+    fprintf(stderr, "       %s -stop [-socket <path>]   (stop the server)\n", program_name);
+    fprintf(stderr, "Options:\n");
+    fprintf(stderr, "  -socket <path>  Server socket (default %s)\n", COMPILE_SERVER_DEFAULT_SOCKET);
+    fprintf(stderr, "  -o <file>    Save RISC code to file\n");
+    fprintf(stderr, "  -O0 | -O1 | -O2 | -Os, -f<pass> | -fno-<pass>, -print-passes,\n");
+    fprintf(stderr, "  -g, -eval, -eval-steps <n>, -eval-memory <n>, -j <n>  As in compiler.exe\n");
+}
+
+// Режимы compiler.exe, которые читают или пишут файлы на его стороне
+static int local_only_option(const char *arg) {
+    static const char *options[] = {
+        "-ast", "-ast-file", "-emit-ast", "-load-ast", "-pipeline",
+        "-incremental", "-incremental-stats", "-cache", "-cache-size", "-cache-stats"
+    };
+    for (size_t i = 0; i < sizeof(options) / sizeof(options[0]); i++) {
+        if (strcmp(arg, options[i]) == 0) return 1;
+    }
+    return 0;
+}
+
+static char *read_file(const char *filename, size_t *length) {
+    FILE *fp = fopen(filename, "rb");
+    if (!fp) return NULL;
+    size_t capacity = 4096;
+    size_t size = 0;
+    char *data = (char *) malloc(capacity);
+    size_t count;
+    while (data && (count = fread(data + size, 1, capacity - size, fp)) > 0) {
+        size += count;
+        if (size == capacity) {
+            char *new_data = (char *) realloc(data, capacity * 2);
+            if (!new_data) {
+                free(data);
+                data = NULL;
+                break;
+            }
+            data = new_data;
+            capacity *= 2;
+        }
+    }
+    fclose(fp);
+    *length = size;
+    return data;
+}
+
+int main(int argc, char **argv) {
+    if (argc < 2) {
+        show_usage(argv[0]);
+        return 1;
+    }
+
+    int stop = strcmp(argv[1], "-stop") == 0;
+    const char *filename = argv[1];
+    const char *socket_path = COMPILE_SERVER_DEFAULT_SOCKET;
+    const char *output_file = NULL;
+    const char **options = (const char **) malloc(argc * sizeof(const char *));
+    int option_count = 0;
+    if (!options) {
+        fprintf(stderr, "Out of memory\n");
+        return 1;
+    }
+
+    for (int i = 2; i < argc; i++) {
+        if (strcmp(argv[i], "-socket") == 0 && i + 1 < argc) {
+            socket_path = argv[++i];
+        } else if (strcmp(argv[i], "-o") == 0 && i + 1 < argc) {
+            output_file = argv[++i];
+        } else if (local_only_option(argv[i])) {
+            fprintf(stderr, "Option %s is not supported by the compile server\n", argv[i]);
+            free(options);
+            return 1;
+        } else {
+            options[option_count++] = argv[i];
+        }
+    }
+
+    CompileRequest request;
+    memset(&request, 0, sizeof(request));
+    request.kind = stop ? COMPILE_REQUEST_SHUTDOWN : COMPILE_REQUEST_COMPILE;
+    request.options = options;
+    request.option_count = option_count;
+    request.name = filename;
+    char *source = NULL;
+    if (!stop) {
+        source = read_file(filename, &request.source_length);
+        if (!source) {
+            fprintf(stderr, "Cannot open file: %s\n", filename);
+            free(options);
+            return 1;
+        }
+        request.source = source;
+    }
+
+    CompileSocket socket = compile_socket_connect(socket_path);
+    if (socket == COMPILE_SOCKET_INVALID) {
+        fprintf(stderr, "Cannot connect to compile server at %s\n", socket_path);
+        free(source);
+        free(options);
+        return 1;
+    }
+    CompileResponse response;
+    int received = compile_request_send(socket, &request) == 0 && compile_response_receive(socket, &response) == 0;
+    compile_socket_close(socket);
+    free(source);
+    free(options);
+    if (!received) {
+        fprintf(stderr, "Compile server at %s closed the connection\n", socket_path);
+        return 1;
+    }
+
+    fputs(response.diagnostics, stderr);
+    if (response.status == COMPILE_OK && response.code) {
+        printf("#RISC-code:\n%s\n", response.code);
+        if (output_file) {
+            FILE *fp = fopen(output_file, "w");
+            if (fp) {
+                fprintf(fp, "%s", response.code);
+                fclose(fp);
+                printf("RISC code saved to file %s\n", output_file);
+            } else {
+                fprintf(stderr, "Failed to open file %s for writing\n", output_file);
+            }
+        }
+    }
+    int status = response.status == COMPILE_OK ? 0 : 1;
+    compile_response_free(&response);
+    return status;
+}
@@ -0,0 +1,307 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+#include <dirent.h>
+#include <sys/stat.h>
+#include <utime.h>
+#ifdef _WIN32
+#include <windows.h>
+#include <direct.h>
+#include <process.h>
+#else
+#include <unistd.h>
+#endif
+#include "compile_cache.h"
+#include "compiler_version.h"
+
+#define CACHE_MAGIC "RCCH"
+#define CACHE_FORMAT_VERSION 1
+#define CACHE_SUFFIX ".rc"
+// Вытеснение освобождает место с запасом, чтобы не сканировать каталог при каждой записи
+#define CACHE_EVICT_PERCENT 75
+// Временные файлы прерванных записей старше этого удаляются при вытеснении
+#define CACHE_STALE_SECONDS 3600
+
+typedef struct {
+    char magic[4];
+    uint32_t version;
+    uint64_t source_length;
+    uint64_t code_length;
+    uint64_t ast_length;
+    uint32_t has_ast;
+    uint32_t reserved;
+} CacheEntryHeader;
+
+struct CompileCache {
+    char dir[512];
+    size_t max_size;
+    CacheStats stats;
+    unsigned long temp_counter;
+    pthread_mutex_t lock;
+};
+
+// FNV-1a, 128 бит
+static const unsigned __int128 FNV128_PRIME = ((unsigned __int128) 1 << 88) + 0x13b;
+
+static unsigned __int128 key_value(const CacheKey *key) {
+    return ((unsigned __int128) key->high << 64) | key->low;
+}
+
+void compile_cache_key_init(CacheKey *key) {
+    key->high = 0x6c62272e07bb0142ULL;
+    key->low = 0x62b821756295c58dULL;
+    compile_cache_key_add_long(key, COMPILER_VERSION);
+}
+
+void compile_cache_key_add(CacheKey *key, const void *data, size_t length) {
+    unsigned __int128 hash = key_value(key);
+    const unsigned char *bytes = (const unsigned char *) data;
+    for (size_t i = 0; i < length; i++) {
+        hash = (hash ^ bytes[i]) * FNV128_PRIME;
+    }
+    key->high = (uint64_t) (hash >> 64);
+    key->low = (uint64_t) hash;
+}
+
+void compile_cache_key_add_long(CacheKey *key, long value) {
+    compile_cache_key_add(key, &value, sizeof(value));
+}
+
+static void entry_path(const CompileCache *cache, const CacheKey *key, char *path, size_t size) {
+    snprintf(path, size, "%s/%016llx%016llx" CACHE_SUFFIX, cache->dir,
+             (unsigned long long) key->high, (unsigned long long) key->low);
+}
+
+static int has_suffix(const char *name, const char *suffix) {
+    size_t name_length = strlen(name);
+    size_t suffix_length = strlen(suffix);
+    return name_length >= suffix_length && strcmp(name + name_length - suffix_length, suffix) == 0;
+}
+
+static int make_dir(const char *dir) {
+#ifdef _WIN32
+    return _mkdir(dir);
+#else
+    return mkdir(dir, 0777);
+#endif
+}
+
+// Переименование с заменой существующего файла
+static int replace_file(const char *from, const char *to) {
+#ifdef _WIN32
+    return MoveFileExA(from, to, MOVEFILE_REPLACE_EXISTING) ? 0 : -1;
+#else
+    return rename(from, to);
+#endif
+}
+
+static long process_id(void) {
+#ifdef _WIN32
+    return (long) _getpid();
+#else
+    return (long) getpid();
+#endif
+}
+
+typedef struct {
+    char *name;
+    time_t used;
+    size_t size;
+} CacheFile;
+
+static int compare_by_use(const void *a, const void *b) {
+    const CacheFile *fa = (const CacheFile *) a;
+    const CacheFile *fb = (const CacheFile *) b;
+    return fa->used < fb->used ? -1 : fa->used > fb->used;
+}
+
+/**
+ * Читает каталог: записи кэша попадают в files (если не NULL),
+ * брошенные временные файлы удаляются.
+ * @return Суммарный размер записей или (size_t) -1, если каталог не открыт
+ */
+static size_t scan_dir(CompileCache *cache, CacheFile **files, size_t *count) {
+    DIR *dir = opendir(cache->dir);
+    if (!dir) return (size_t) -1;
+    size_t total = 0;
+    size_t capacity = 0;
+    time_t now = time(NULL);
+    if (count) *count = 0;
+    char path[1024];
+    struct dirent *item;
+    while ((item = readdir(dir)) != NULL) {
+        int entry = has_suffix(item->d_name, CACHE_SUFFIX);
+        int temp = has_suffix(item->d_name, ".tmp");
+        if (!entry && !temp) continue;
+        snprintf(path, sizeof(path), "%s/%s", cache->dir, item->d_name);
+        struct stat st;
+        if (stat(path, &st) != 0) continue;
+        if (temp) {
+            if (now - st.st_mtime > CACHE_STALE_SECONDS) remove(path);
+            continue;
+        }
+        total += (size_t) st.st_size;
+        if (!files) continue;
+        if (*count >= capacity) {
+            size_t new_capacity = capacity == 0 ? 64 : capacity * 2;
+            CacheFile *new_files = (CacheFile *) realloc(*files, new_capacity * sizeof(CacheFile));
+            if (!new_files) break;
+            *files = new_files;
+            capacity = new_capacity;
+        }
+        CacheFile *file = &(*files)[*count];
+        file->name = (char *) malloc(strlen(item->d_name) + 1);
+        if (!file->name) break;
+        strcpy(file->name, item->d_name);
+        file->used = st.st_mtime;
+        file->size = (size_t) st.st_size;
+        (*count)++;
+    }
+    closedir(dir);
+    return total;
+}
+
+CompileCache *compile_cache_open(const char *dir, size_t max_size) {
+    if (strlen(dir) >= sizeof(((CompileCache *) 0)->dir)) return NULL;
+    CompileCache *cache = (CompileCache *) calloc(1, sizeof(CompileCache));
+    if (!cache) return NULL;
+    strcpy(cache->dir, dir);
+    cache->max_size = max_size;
+    make_dir(dir);
+    size_t size = scan_dir(cache, NULL, NULL);
+    if (size == (size_t) -1 || pthread_mutex_init(&cache->lock, NULL) != 0) {
+        free(cache);
+        return NULL;
+    }
+    cache->stats.size = size;
+    return cache;
+}
+
+void compile_cache_close(CompileCache *cache) {
+    if (!cache) return;
+    pthread_mutex_destroy(&cache->lock);
+    free(cache);
+}
+
+CacheEntry *compile_cache_lookup(CompileCache *cache, const CacheKey *key, size_t source_length) {
+    char path[1024];
+    entry_path(cache, key, path, sizeof(path));
+    CacheEntry *entry = (CacheEntry *) calloc(1, sizeof(CacheEntry));
+    int found = 0;
+    if (entry && source_buffer_open(&entry->file, path) == 0) {
+        CacheEntryHeader header;
+        size_t length = entry->file.length;
+        if (length >= sizeof(header)) {
+            memcpy(&header, entry->file.data, sizeof(header));
+            uint64_t body = (uint64_t) (length - sizeof(header));
+            found = memcmp(header.magic, CACHE_MAGIC, sizeof(header.magic)) == 0
+                    && header.version == CACHE_FORMAT_VERSION && header.source_length == source_length
+                    && header.code_length < body && header.ast_length < body - header.code_length
+                    && header.code_length + header.ast_length + 2 == body;
+        }
+        if (found) {
+            const char *data = entry->file.data + sizeof(header);
+            entry->code = data;
+            entry->code_length = (size_t) header.code_length;
+            if (header.has_ast) {
+                entry->ast = data + header.code_length + 1;
+                entry->ast_length = (size_t) header.ast_length;
+            }
+            // Время изменения служит временем использования для вытеснения
+            utime(path, NULL);
+        }
+    }
+    if (!found) {
+        compile_cache_entry_free(entry);
+        entry = NULL;
+    }
+    pthread_mutex_lock(&cache->lock);
+    if (found) {
+        cache->stats.hits++;
+    } else {
+        cache->stats.misses++;
+    }
+    pthread_mutex_unlock(&cache->lock);
+    return entry;
+}
+
+void compile_cache_entry_free(CacheEntry *entry) {
+    if (!entry) return;
+    source_buffer_close(&entry->file);
+    free(entry);
+}
+
+// Удаляет давно не использованные записи, пока кэш не уменьшится до
+// CACHE_EVICT_PERCENT предела; вызывается под cache->lock
+static void evict(CompileCache *cache) {
+    CacheFile *files = NULL;
+    size_t count = 0;
+    size_t total = scan_dir(cache, &files, &count);
+    if (total == (size_t) -1) return;
+    size_t target = cache->max_size / 100 * CACHE_EVICT_PERCENT;
+    qsort(files, count, sizeof(CacheFile), compare_by_use);
+    char path[1024];
+    for (size_t i = 0; i < count; i++) {
+        if (total > target) {
+            snprintf(path, sizeof(path), "%s/%s", cache->dir, files[i].name);
+            if (remove(path) == 0) {
+                total -= files[i].size;
+                cache->stats.evictions++;
+            }
+        }
+        free(files[i].name);
+    }
+    free(files);
+    cache->stats.size = total;
+}
+
+int compile_cache_store(CompileCache *cache, const CacheKey *key, size_t source_length,
+                        const char *code, size_t code_length, const char *ast, size_t ast_length) {
+    CacheEntryHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, CACHE_MAGIC, sizeof(header.magic));
+    header.version = CACHE_FORMAT_VERSION;
+    header.source_length = source_length;
+    header.code_length = code_length;
+    header.ast_length = ast ? ast_length : 0;
+    header.has_ast = ast != NULL;
+
+    char path[1024];
+    char temp[1100];
+    entry_path(cache, key, path, sizeof(path));
+    pthread_mutex_lock(&cache->lock);
+    unsigned long counter = cache->temp_counter++;
+    pthread_mutex_unlock(&cache->lock);
+    snprintf(temp, sizeof(temp), "%s.%ld.%lu.tmp", path, process_id(), counter);
+
+    FILE *fp = fopen(temp, "wb");
+    if (!fp) return -1;
+    static const char zero = '\0';
+    int status = fwrite(&header, sizeof(header), 1, fp) == 1
+                 && fwrite(code, 1, code_length, fp) == code_length && fwrite(&zero, 1, 1, fp) == 1
+                 && (header.ast_length == 0 || fwrite(ast, 1, ast_length, fp) == ast_length)
+                 && fwrite(&zero, 1, 1, fp) == 1 ? 0 : -1;
+    if (fclose(fp) != 0) status = -1;
+    if (status == 0 && replace_file(temp, path) != 0) status = -1;
+    if (status != 0) {
+        remove(temp);
+        return -1;
+    }
+
+    pthread_mutex_lock(&cache->lock);
+    cache->stats.stores++;
+    cache->stats.size += sizeof(header) + code_length + header.ast_length + 2;
+    if (cache->stats.size > cache->max_size) {
+        evict(cache);
+    }
+    pthread_mutex_unlock(&cache->lock);
+    return 0;
+}
+
+void compile_cache_get_stats(CompileCache *cache, CacheStats *stats) {
+    pthread_mutex_lock(&cache->lock);
+    *stats = cache->stats;
+    pthread_mutex_unlock(&cache->lock);
+}
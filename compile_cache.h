@@ -0,0 +1,77 @@
+#ifndef COMPILE_CACHE_H
+#define COMPILE_CACHE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "lexer/source_buffer.h"
+
+#define COMPILE_CACHE_DEFAULT_SIZE (256L * 1024 * 1024)
+
+/**
+ * Кэш результатов компиляции в каталоге: запись <ключ>.rc хранит
+ * RISC-код и, если его просили, текст AST. Ключ — хэш исходного текста,
+ * версии компилятора (COMPILER_VERSION) и всех настроек, влияющих на вывод.
+ * Записи пишутся во временный файл и переименовываются, поэтому
+ * кэш можно одновременно использовать из нескольких потоков и процессов.
+ */
+typedef struct CompileCache CompileCache;
+
+typedef struct {
+    uint64_t high;
+    uint64_t low;
+} CacheKey;
+
+typedef struct {
+    long hits;
+    long misses;
+    long stores;
+    long evictions;
+    size_t size;                // байт в каталоге по оценке этого процесса
+} CacheStats;
+
+// Запись, найденная в кэше: файл отображён в память, строки завершены нулём
+typedef struct CacheEntry {
+    SourceBuffer file;
+    const char *code;
+    size_t code_length;
+    const char *ast;            // NULL, если текст AST не сохранялся
+    size_t ast_length;
+} CacheEntry;
+
+/**
+ * Открывает (и при необходимости создаёт) каталог кэша.
+ * @param max_size Предел суммарного размера записей; при превышении
+ *                 удаляются давно не использованные записи
+ * @return NULL, если каталог не удалось создать или прочитать
+ */
+CompileCache *compile_cache_open(const char *dir, size_t max_size);
+
+void compile_cache_close(CompileCache *cache);
+
+// Ключ строится по частям: COMPILER_VERSION добавляется в compile_cache_key_init
+void compile_cache_key_init(CacheKey *key);
+
+void compile_cache_key_add(CacheKey *key, const void *data, size_t length);
+
+void compile_cache_key_add_long(CacheKey *key, long value);
+
+/**
+ * Ищет запись и отображает её в память; обновляет время использования.
+ * @param source_length Длина исходного текста (дополнительная проверка ключа)
+ * @return Запись или NULL при промахе; освобождается compile_cache_entry_free
+ */
+CacheEntry *compile_cache_lookup(CompileCache *cache, const CacheKey *key, size_t source_length);
+
+void compile_cache_entry_free(CacheEntry *entry);
+
+/**
+ * Сохраняет результат атомарно: читатели видят либо старую запись, либо новую.
+ * @param ast Текст AST или NULL
+ * @return 0 при успехе, -1 при ошибке записи
+ */
+int compile_cache_store(CompileCache *cache, const CacheKey *key, size_t source_length,
+                        const char *code, size_t code_length, const char *ast, size_t ast_length);
+
+void compile_cache_get_stats(CompileCache *cache, CacheStats *stats);
+
+#endif /* COMPILE_CACHE_H */
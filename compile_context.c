@@ -0,0 +1,53 @@
+#include <stdlib.h>
+#include <string.h>
+#include "compile_context.h"
+#include "tagged_alloc.h"
+
+static CompileContext default_context = {
+    .filename = "unknown",
+    .line_num = 1,
+    .column_num = 1,
+    .errors = {.current_scope_is_global = 1},
+};
+
+static _Thread_local CompileContext *current_context = NULL;
+
+void compile_context_init(CompileContext *ctx, const char *filename) {
+    memset(ctx, 0, sizeof(*ctx));
+    if (filename) {
+        strncpy(ctx->filename, filename, sizeof(ctx->filename) - 1);
+        ctx->filename[sizeof(ctx->filename) - 1] = '\0';
+    } else {
+        strcpy(ctx->filename, "unknown");
+    }
+    ctx->line_num = 1;
+    ctx->column_num = 1;
+    ctx->errors.current_scope_is_global = 1;
+}
+
+void compile_context_free(CompileContext *ctx) {
+    if (ctx->ast_root) {
+        free_node(ctx->ast_root);
+        ctx->ast_root = NULL;
+    }
+    for (int i = 0; i < ctx->errors.symbol_count; i++) {
+        tagged_free(ALLOC_SYMBOLS, ctx->errors.symbols[i].name);
+        tagged_free(ALLOC_SYMBOLS, ctx->errors.symbols[i].type);
+    }
+    ctx->errors.symbol_count = 0;
+    free(ctx->errors.text);
+    ctx->errors.text = NULL;
+    free(ctx->token_text);
+    ctx->token_text = NULL;
+    ctx->token_text_capacity = 0;
+}
+
+CompileContext *compile_context_current(void) {
+    return current_context ? current_context : &default_context;
+}
+
+CompileContext *compile_context_bind(CompileContext *ctx) {
+    CompileContext *previous = current_context;
+    current_context = ctx;
+    return previous;
+}
@@ -0,0 +1,56 @@
+#ifndef COMPILE_CONTEXT_H
+#define COMPILE_CONTEXT_H
+
+#include "error_handler.h"
+#include "ast/ast.h"
+#include "compiler/evaluator.h"
+#include "compiler/pass_manager.h"
+#include "compiler/incremental.h"
+#include "lexer/source_buffer.h"
+#include "time_report.h"
+
+// Всё состояние одной компиляции: лексер, парсер, ошибки и настройки генератора.
+// Разные контексты можно использовать одновременно из разных потоков.
+typedef struct CompileContext {
+    char filename[256];
+    ASTNode *ast_root;
+    // Позиция лексера
+    int line_num;
+    int column_num;
+    // Текст, который сканирует лексер; токены — срезы SourceSlice этого текста.
+    // При чтении из потока source — окно, начинающееся со смещения source_offset
+    const char *source;
+    size_t source_length;
+    size_t source_offset;
+    // Буфер, в котором парсер собирает строку из среза для конструкторов AST
+    char *token_text;
+    size_t token_text_capacity;
+    ErrorState errors;
+    // Настройки генератора кода; pass_manager не принадлежит контексту
+    // и только читается, поэтому может быть общим для нескольких контекстов
+    EvalBudget eval_budget;
+    const PassManager *pass_manager;
+    int codegen_threads;        // > 1 — генерация кода участками на нескольких потоках
+    int line_info;              // перед командами строки ".loc строка столбец" их оператора
+    IncrementalState *incremental;  // фрагменты прошлой компиляции или NULL; не принадлежит контексту
+    TimeReport *time_report;    // -ftime-report или NULL; не принадлежит контексту
+} CompileContext;
+
+void compile_context_init(CompileContext *ctx, const char *filename);
+
+// Освобождает AST, таблицу символов и буфер токенов контекста
+void compile_context_free(CompileContext *ctx);
+
+/**
+ * Контекст, с которым работает текущий поток.
+ * Пока поток не привязал свой контекст, используется общий контекст по умолчанию.
+ */
+CompileContext *compile_context_current(void);
+
+/**
+ * Привязывает контекст к текущему потоку.
+ * @return Ранее привязанный контекст (NULL — контекст по умолчанию)
+ */
+CompileContext *compile_context_bind(CompileContext *ctx);
+
+#endif /* COMPILE_CONTEXT_H */
@@ -0,0 +1,353 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <sys/stat.h>
+#ifdef _WIN32
+#include <winsock2.h>
+#include <afunix.h>
+#else
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/time.h>
+#include <unistd.h>
+#endif
+#include "compile_protocol.h"
+
+#define REQUEST_MAGIC "RCSQ"
+#define RESPONSE_MAGIC "RCSA"
+#define PROTOCOL_VERSION 1
+
+typedef struct {
+    char magic[4];
+    uint32_t version;
+    uint32_t kind;
+    uint32_t option_count;
+    uint64_t options_length;    // строки параметров вместе с завершающими нулями
+    uint64_t name_length;
+    uint64_t source_length;
+} RequestHeader;
+
+typedef struct {
+    char magic[4];
+    uint32_t version;
+    int32_t status;
+    uint32_t has_code;
+    uint64_t code_length;
+    uint64_t diagnostics_length;
+} ResponseHeader;
+
+#ifdef _WIN32
+typedef SOCKET RawSocket;
+
+// Winsock нужно инициализировать один раз на процесс
+static int socket_startup(void) {
+    static int started = 0;
+    WSADATA data;
+    if (!started && WSAStartup(MAKEWORD(2, 2), &data) != 0) return -1;
+    started = 1;
+    return 0;
+}
+#else
+typedef int RawSocket;
+
+static int socket_startup(void) {
+    return 0;
+}
+#endif
+
+static RawSocket raw_socket(CompileSocket socket) {
+    return (RawSocket) socket;
+}
+
+static int make_address(const char *path, struct sockaddr_un *address) {
+    if (strlen(path) >= sizeof(address->sun_path)) return -1;
+    memset(address, 0, sizeof(*address));
+    address->sun_family = AF_UNIX;
+    strcpy(address->sun_path, path);
+    return 0;
+}
+
+static CompileSocket open_socket(void) {
+    if (socket_startup() != 0) return COMPILE_SOCKET_INVALID;
+    RawSocket s = socket(AF_UNIX, SOCK_STREAM, 0);
+#ifdef _WIN32
+    return s == INVALID_SOCKET ? COMPILE_SOCKET_INVALID : (CompileSocket) s;
+#else
+    return s < 0 ? COMPILE_SOCKET_INVALID : (CompileSocket) s;
+#endif
+}
+
+void compile_socket_close(CompileSocket socket) {
+    if (socket == COMPILE_SOCKET_INVALID) return;
+#ifdef _WIN32
+    closesocket(raw_socket(socket));
+#else
+    close(raw_socket(socket));
+#endif
+}
+
+CompileSocket compile_socket_connect(const char *path) {
+    struct sockaddr_un address;
+    if (make_address(path, &address) != 0) return COMPILE_SOCKET_INVALID;
+    CompileSocket s = open_socket();
+    if (s == COMPILE_SOCKET_INVALID) return s;
+    if (connect(raw_socket(s), (struct sockaddr *) &address, sizeof(address)) != 0) {
+        compile_socket_close(s);
+        return COMPILE_SOCKET_INVALID;
+    }
+    return s;
+}
+
+// Удаляет только файл сокета: путь с обычным файлом оставляет, и bind вернёт ошибку
+static void remove_stale_socket(const char *path) {
+#ifdef S_ISSOCK
+    struct stat st;
+    if (lstat(path, &st) == 0 && S_ISSOCK(st.st_mode)) remove(path);
+#else
+    (void) path;
+#endif
+}
+
+CompileSocket compile_socket_listen(const char *path) {
+    struct sockaddr_un address;
+    if (make_address(path, &address) != 0) return COMPILE_SOCKET_INVALID;
+    // Файл сокета остаётся после аварийного завершения сервера; занятый не трогаем
+    CompileSocket running = compile_socket_connect(path);
+    if (running != COMPILE_SOCKET_INVALID) {
+        compile_socket_close(running);
+        return COMPILE_SOCKET_INVALID;
+    }
+    remove_stale_socket(path);
+    CompileSocket s = open_socket();
+    if (s == COMPILE_SOCKET_INVALID) return s;
+    if (bind(raw_socket(s), (struct sockaddr *) &address, sizeof(address)) != 0
+        || listen(raw_socket(s), SOMAXCONN) != 0) {
+        compile_socket_close(s);
+        return COMPILE_SOCKET_INVALID;
+    }
+    return s;
+}
+
+// Без тайм-аута recv и send на соединении ждут бесконечно; ошибка установки не фатальна
+static void set_timeouts(RawSocket s) {
+#ifdef _WIN32
+    DWORD timeout = COMPILE_PROTOCOL_TIMEOUT_SECONDS * 1000;
+    setsockopt(s, SOL_SOCKET, SO_RCVTIMEO, (const char *) &timeout, sizeof(timeout));
+    setsockopt(s, SOL_SOCKET, SO_SNDTIMEO, (const char *) &timeout, sizeof(timeout));
+#else
+    struct timeval timeout;
+    timeout.tv_sec = COMPILE_PROTOCOL_TIMEOUT_SECONDS;
+    timeout.tv_usec = 0;
+    setsockopt(s, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    setsockopt(s, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+#endif
+}
+
+CompileSocket compile_socket_accept(CompileSocket listener) {
+    RawSocket s = accept(raw_socket(listener), NULL, NULL);
+#ifdef _WIN32
+    if (s == INVALID_SOCKET) return COMPILE_SOCKET_INVALID;
+#else
+    if (s < 0) return COMPILE_SOCKET_INVALID;
+#endif
+    set_timeouts(s);
+    return (CompileSocket) s;
+}
+
+int compile_socket_accept_error(void) {
+#ifdef _WIN32
+    switch (WSAGetLastError()) {
+        case WSAEINTR:
+        case WSAECONNRESET:
+            return 0;
+        case WSAEMFILE:
+        case WSAENOBUFS:
+            return 1;
+        default:
+            return -1;
+    }
+#else
+    switch (errno) {
+        case EINTR:
+        case ECONNABORTED:
+            return 0;
+        case EMFILE:
+        case ENFILE:
+        case ENOBUFS:
+        case ENOMEM:
+            return 1;
+        default:
+            return -1;
+    }
+#endif
+}
+
+static int write_all(CompileSocket socket, const void *data, size_t length) {
+    const char *p = (const char *) data;
+    while (length > 0) {
+        int chunk = length > (1 << 30) ? (1 << 30) : (int) length;
+#ifdef _WIN32
+        int written = send(raw_socket(socket), p, chunk, 0);
+#elif defined(MSG_NOSIGNAL)
+        // Закрытое клиентом соединение — ошибка записи, а не SIGPIPE
+        ssize_t written = send(raw_socket(socket), p, (size_t) chunk, MSG_NOSIGNAL);
+#else
+        ssize_t written = send(raw_socket(socket), p, (size_t) chunk, 0);
+#endif
+        if (written < 0 && errno == EINTR) continue;
+        if (written <= 0) return -1;
+        p += written;
+        length -= (size_t) written;
+    }
+    return 0;
+}
+
+static int read_all(CompileSocket socket, void *data, size_t length) {
+    char *p = (char *) data;
+    while (length > 0) {
+        int chunk = length > (1 << 30) ? (1 << 30) : (int) length;
+#ifdef _WIN32
+        int received = recv(raw_socket(socket), p, chunk, 0);
+#else
+        ssize_t received = recv(raw_socket(socket), p, (size_t) chunk, 0);
+#endif
+        if (received < 0 && errno == EINTR) continue;
+        if (received <= 0) return -1;
+        p += received;
+        length -= (size_t) received;
+    }
+    return 0;
+}
+
+int compile_request_send(CompileSocket socket, const CompileRequest *request) {
+    RequestHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, REQUEST_MAGIC, sizeof(header.magic));
+    header.version = PROTOCOL_VERSION;
+    header.kind = (uint32_t) request->kind;
+    header.option_count = (uint32_t) request->option_count;
+    for (int i = 0; i < request->option_count; i++) {
+        header.options_length += strlen(request->options[i]) + 1;
+    }
+    const char *name = request->name ? request->name : "";
+    header.name_length = strlen(name);
+    header.source_length = request->source_length;
+    if (write_all(socket, &header, sizeof(header)) != 0) return -1;
+    for (int i = 0; i < request->option_count; i++) {
+        if (write_all(socket, request->options[i], strlen(request->options[i]) + 1) != 0) return -1;
+    }
+    if (write_all(socket, name, (size_t) header.name_length) != 0) return -1;
+    return request->source_length == 0 ? 0 : write_all(socket, request->source, request->source_length);
+}
+
+int compile_request_receive(CompileSocket socket, CompileRequest *request,
+                            char **buffer, size_t *capacity) {
+    RequestHeader header;
+    if (read_all(socket, &header, sizeof(header)) != 0) return -1;
+    if (memcmp(header.magic, REQUEST_MAGIC, sizeof(header.magic)) != 0
+        || header.version != PROTOCOL_VERSION || header.option_count > COMPILE_PROTOCOL_MAX_OPTIONS
+        || header.options_length > COMPILE_PROTOCOL_MAX_PAYLOAD
+        || header.name_length > COMPILE_PROTOCOL_MAX_PAYLOAD
+        || header.source_length > COMPILE_PROTOCOL_MAX_PAYLOAD) {
+        return -1;
+    }
+    // [указатели параметров][параметры][имя '\0'][исходный текст '\0']
+    size_t pointers = header.option_count * sizeof(const char *);
+    size_t payload = (size_t) (header.options_length + header.name_length + header.source_length);
+    size_t needed = pointers + payload + 2;
+    if (needed > *capacity) {
+        char *new_buffer = (char *) realloc(*buffer, needed);
+        if (!new_buffer) return -1;
+        *buffer = new_buffer;
+        *capacity = needed;
+    }
+    const char **options = (const char **) *buffer;
+    char *text = *buffer + pointers;
+    if (read_all(socket, text, (size_t) header.options_length) != 0) return -1;
+    char *name = text + header.options_length;
+    if (read_all(socket, name, (size_t) header.name_length) != 0) return -1;
+    name[header.name_length] = '\0';
+    char *source = name + header.name_length + 1;
+    if (read_all(socket, source, (size_t) header.source_length) != 0) return -1;
+    source[header.source_length] = '\0';
+
+    const char *p = text;
+    const char *end = text + header.options_length;
+    for (uint32_t i = 0; i < header.option_count; i++) {
+        const char *zero = p < end ? (const char *) memchr(p, '\0', (size_t) (end - p)) : NULL;
+        if (!zero) return -1;
+        options[i] = p;
+        p = zero + 1;
+    }
+    if (p != end) return -1;
+
+    request->kind = (CompileRequestKind) header.kind;
+    request->options = options;
+    request->option_count = (int) header.option_count;
+    request->name = name;
+    request->source = source;
+    request->source_length = (size_t) header.source_length;
+    return request->kind == COMPILE_REQUEST_COMPILE || request->kind == COMPILE_REQUEST_SHUTDOWN ? 0 : -1;
+}
+
+int compile_response_send(CompileSocket socket, const CompileResponse *response) {
+    ResponseHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, RESPONSE_MAGIC, sizeof(header.magic));
+    header.version = PROTOCOL_VERSION;
+    header.status = response->status;
+    header.has_code = response->code != NULL;
+    header.code_length = response->code ? response->code_length : 0;
+    header.diagnostics_length = response->diagnostics ? response->diagnostics_length : 0;
+    if (write_all(socket, &header, sizeof(header)) != 0) return -1;
+    if (header.code_length > 0 && write_all(socket, response->code, response->code_length) != 0) return -1;
+    if (header.diagnostics_length > 0
+        && write_all(socket, response->diagnostics, response->diagnostics_length) != 0) {
+        return -1;
+    }
+    return 0;
+}
+
+// Читает length байт в новую строку, завершённую нулём
+static char *read_string(CompileSocket socket, uint64_t length) {
+    if (length > COMPILE_PROTOCOL_MAX_PAYLOAD) return NULL;
+    char *text = (char *) malloc((size_t) length + 1);
+    if (!text) return NULL;
+    if (read_all(socket, text, (size_t) length) != 0) {
+        free(text);
+        return NULL;
+    }
+    text[length] = '\0';
+    return text;
+}
+
+int compile_response_receive(CompileSocket socket, CompileResponse *response) {
+    memset(response, 0, sizeof(*response));
+    ResponseHeader header;
+    if (read_all(socket, &header, sizeof(header)) != 0
+        || memcmp(header.magic, RESPONSE_MAGIC, sizeof(header.magic)) != 0
+        || header.version != PROTOCOL_VERSION) {
+        return -1;
+    }
+    response->status = header.status;
+    if (header.has_code) {
+        response->code = read_string(socket, header.code_length);
+        if (!response->code) return -1;
+        response->code_length = (size_t) header.code_length;
+    }
+    response->diagnostics = read_string(socket, header.diagnostics_length);
+    if (!response->diagnostics) {
+        compile_response_free(response);
+        return -1;
+    }
+    response->diagnostics_length = (size_t) header.diagnostics_length;
+    return 0;
+}
+
+void compile_response_free(CompileResponse *response) {
+    free(response->code);
+    free(response->diagnostics);
+    response->code = NULL;
+    response->diagnostics = NULL;
+}
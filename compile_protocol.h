@@ -0,0 +1,90 @@
+#ifndef COMPILE_PROTOCOL_H
+#define COMPILE_PROTOCOL_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define COMPILE_SERVER_DEFAULT_SOCKET "compiler.sock"
+// Больше этого сервер не читает: запрос отклоняется без выделения памяти
+#define COMPILE_PROTOCOL_MAX_PAYLOAD (256UL * 1024 * 1024)
+#define COMPILE_PROTOCOL_MAX_OPTIONS 1024
+// Ожидание данных на принятом соединении: клиент, который замолчал, не держит поток сервера
+#define COMPILE_PROTOCOL_TIMEOUT_SECONDS 30
+
+/**
+ * Обмен с сервером компиляции (-server) по Unix-сокету: клиент отправляет
+ * один запрос и читает один ответ, затем соединение закрывается.
+ * Запрос — заголовок, параметры командной строки строками через '\0',
+ * имя источника и исходный текст. Ответ — заголовок, RISC-код и текст
+ * диагностики, который клиент выводит в stderr.
+ */
+typedef enum {
+    COMPILE_REQUEST_COMPILE = 0,
+    COMPILE_REQUEST_SHUTDOWN    // завершить сервер после текущих запросов
+} CompileRequestKind;
+
+typedef struct {
+    CompileRequestKind kind;
+    const char **options;       // параметры как в командной строке compiler.exe
+    int option_count;
+    const char *name;           // имя источника для сообщений об ошибках
+    const char *source;
+    size_t source_length;
+} CompileRequest;
+
+typedef struct {
+    int status;                 // CompileStatus
+    char *code;                 // NULL, если кода нет
+    size_t code_length;
+    char *diagnostics;          // всегда завершена нулём
+    size_t diagnostics_length;
+} CompileResponse;
+
+// Дескриптор сокета; на Windows — SOCKET, приведённый к intptr_t
+typedef intptr_t CompileSocket;
+
+#define COMPILE_SOCKET_INVALID ((CompileSocket) -1)
+
+// Подключается к серверу; COMPILE_SOCKET_INVALID, если сервер не отвечает
+CompileSocket compile_socket_connect(const char *path);
+
+/**
+ * Создаёт слушающий сокет. Оставшийся от завершившегося сервера файл
+ * сокета удаляется; если по пути отвечает работающий сервер, возвращается ошибка.
+ */
+CompileSocket compile_socket_listen(const char *path);
+
+/**
+ * Принимает соединение с тайм-аутом COMPILE_PROTOCOL_TIMEOUT_SECONDS на чтение и запись.
+ * @return COMPILE_SOCKET_INVALID при ошибке; прерывание сигналом тоже ошибка
+ */
+CompileSocket compile_socket_accept(CompileSocket listener);
+
+/**
+ * Причина последней ошибки compile_socket_accept в этом потоке.
+ * @return 0 — можно повторить сразу (сигнал, клиент оборвал соединение),
+ *         1 — повторить после паузы (нет дескрипторов или памяти), -1 — сокет неисправен
+ */
+int compile_socket_accept_error(void);
+
+void compile_socket_close(CompileSocket socket);
+
+// 0 при успехе, -1 при ошибке или обрыве соединения
+int compile_request_send(CompileSocket socket, const CompileRequest *request);
+
+/**
+ * Читает запрос. Массив options и строки запроса лежат в *buffer, который
+ * растёт по необходимости и может переиспользоваться между запросами.
+ * @return 0 при успехе, -1 при ошибке или повреждённом запросе
+ */
+int compile_request_receive(CompileSocket socket, CompileRequest *request,
+                            char **buffer, size_t *capacity);
+
+int compile_response_send(CompileSocket socket, const CompileResponse *response);
+
+// Ответ освобождается compile_response_free; 0 при успехе
+int compile_response_receive(CompileSocket socket, CompileResponse *response);
+
+void compile_response_free(CompileResponse *response);
+
+#endif /* COMPILE_PROTOCOL_H */
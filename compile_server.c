@@ -0,0 +1,351 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <errno.h>
+#include <signal.h>
+#include <time.h>
+#include <pthread.h>
+#ifdef _WIN32
+#include <windows.h>
+#endif
+#include "compile_server.h"
+#include "compile_protocol.h"
+#include "libcompiler.h"
+#include "thread_pool.h"
+
+// Буферы запроса и диагностики: после первых запросов память уже выделена
+typedef struct RequestBuffer {
+    char *data;
+    size_t capacity;
+    char *text;
+    size_t text_length;
+    size_t text_capacity;
+    struct RequestBuffer *next;
+} RequestBuffer;
+
+typedef struct {
+    const CompileServerOptions *options;
+    CompileServerStats stats;
+    RequestBuffer *free_buffers;
+    int stopping;
+    pthread_mutex_t lock;
+} CompileServer;
+
+typedef struct {
+    CompileServer *server;
+    CompileSocket socket;
+} Connection;
+
+#ifndef _WIN32
+static volatile sig_atomic_t stop_signal = 0;
+
+static void on_stop_signal(int signal_number) {
+    (void) signal_number;
+    stop_signal = 1;
+}
+#endif
+
+#define ACCEPT_BACKOFF_MS 100
+
+static void accept_backoff(void) {
+#ifdef _WIN32
+    Sleep(ACCEPT_BACKOFF_MS);
+#else
+    struct timespec delay;
+    delay.tv_sec = 0;
+    delay.tv_nsec = ACCEPT_BACKOFF_MS * 1000000L;
+    nanosleep(&delay, NULL);
+#endif
+}
+
+static int server_stopping(CompileServer *server) {
+#ifndef _WIN32
+    if (stop_signal) return 1;
+#endif
+    pthread_mutex_lock(&server->lock);
+    int stopping = server->stopping;
+    pthread_mutex_unlock(&server->lock);
+    return stopping;
+}
+
+static RequestBuffer *take_buffer(CompileServer *server) {
+    pthread_mutex_lock(&server->lock);
+    RequestBuffer *buffer = server->free_buffers;
+    if (buffer) server->free_buffers = buffer->next;
+    pthread_mutex_unlock(&server->lock);
+    if (!buffer) buffer = (RequestBuffer *) calloc(1, sizeof(RequestBuffer));
+    if (buffer) buffer->text_length = 0;
+    return buffer;
+}
+
+static void give_buffer(CompileServer *server, RequestBuffer *buffer) {
+    pthread_mutex_lock(&server->lock);
+    buffer->next = server->free_buffers;
+    server->free_buffers = buffer;
+    pthread_mutex_unlock(&server->lock);
+}
+
+static void append_text(RequestBuffer *buffer, const char *text, size_t length) {
+    if (buffer->text_length + length + 1 > buffer->text_capacity) {
+        size_t new_capacity = buffer->text_capacity == 0 ? 256 : buffer->text_capacity;
+        while (new_capacity < buffer->text_length + length + 1) new_capacity *= 2;
+        char *new_text = (char *) realloc(buffer->text, new_capacity);
+        // Без памяти диагностика обрезается, ответ всё равно отправляется
+        if (!new_text) return;
+        buffer->text = new_text;
+        buffer->text_capacity = new_capacity;
+    }
+    memcpy(buffer->text + buffer->text_length, text, length);
+    buffer->text_length += length;
+    buffer->text[buffer->text_length] = '\0';
+}
+
+static void append_format(RequestBuffer *buffer, const char *format, ...) {
+    char line[768];
+    va_list args;
+    va_start(args, format);
+    int length = vsnprintf(line, sizeof(line), format, args);
+    va_end(args);
+    if (length < 0) return;
+    append_text(buffer, line, (size_t) length < sizeof(line) ? (size_t) length : sizeof(line) - 1);
+}
+
+// Список проходов, как его печатает -print-passes
+static void append_passes(RequestBuffer *buffer, const PassManager *pm) {
+    FILE *tmp = tmpfile();
+    if (!tmp) return;
+    pass_manager_print(pm, tmp);
+    rewind(tmp);
+    char chunk[512];
+    size_t length;
+    while ((length = fread(chunk, 1, sizeof(chunk), tmp)) > 0) {
+        append_text(buffer, chunk, length);
+    }
+    fclose(tmp);
+}
+
+/**
+ * Разбирает параметры запроса так же, как их разбирает compiler.exe.
+ * @return 0 при успехе, -1 с сообщением в buffer при неизвестном параметре
+ */
+static int parse_options(const CompileRequest *request, PassManager *pm, CompilerOptions *options,
+                         int *print_passes, RequestBuffer *buffer) {
+    for (int i = 0; i < request->option_count; i++) {
+        const char *arg = request->options[i];
+        int has_value = i + 1 < request->option_count;
+        int parsed = pass_manager_parse_option(pm, arg);
+        if (parsed > 0) continue;
+        if (parsed < 0) {
+            append_format(buffer, "Unknown optimization option: %s\n", arg);
+            return -1;
+        }
+        if (strcmp(arg, "-print-passes") == 0) {
+            *print_passes = 1;
+        } else if (strcmp(arg, "-g") == 0) {
+            options->line_info = 1;
+        } else if (strcmp(arg, "-eval") == 0) {
+            pass_manager_set_enabled(pm, "partial-eval", 1);
+        } else if (strcmp(arg, "-eval-steps") == 0 && has_value) {
+            pass_manager_set_enabled(pm, "partial-eval", 1);
+            options->eval_steps = atol(request->options[++i]);
+        } else if (strcmp(arg, "-eval-memory") == 0 && has_value) {
+            pass_manager_set_enabled(pm, "partial-eval", 1);
+            options->eval_memory = (size_t) atol(request->options[++i]);
+        } else if (strcmp(arg, "-j") == 0 && has_value) {
+            int threads = atoi(request->options[++i]);
+            options->codegen_threads = threads > 0 ? threads : thread_pool_cpu_count();
+        } else {
+            append_format(buffer, "Unknown option: %s\n", arg);
+            return -1;
+        }
+    }
+    return 0;
+}
+
+// Диагностика в том виде, в каком compiler.exe печатает её в stderr. Если текст
+// не удалось собрать (нет памяти), выводятся первые MAX_ERRORS ошибок и число остальных
+static void append_errors(RequestBuffer *buffer, const CompileResult *result, const char *name) {
+    if (result->diagnostics) {
+        append_text(buffer, result->diagnostics, result->diagnostics_length);
+    } else {
+        int stored = result->error_count < MAX_ERRORS ? result->error_count : MAX_ERRORS;
+        for (int i = 0; i < stored; i++) {
+            char line[640];
+            error_format(&result->errors[i], line, sizeof(line));
+            append_text(buffer, line, strlen(line));
+        }
+        if (result->error_count > stored) {
+            append_format(buffer, "... %d more errors\n", result->error_count - stored);
+        }
+        if (result->status == COMPILE_SEMANTIC_ERROR) {
+            append_format(buffer, "Critical errors found during code generation. Output aborted.\n");
+        }
+    }
+    if (result->status == COMPILE_SYNTAX_ERROR) {
+        append_format(buffer, "Error parsing file %s\n", name);
+        return;
+    }
+    append_format(buffer, "Error generating RISC code\n");
+}
+
+static void serve_compile(CompileServer *server, CompileSocket socket, const CompileRequest *request,
+                          RequestBuffer *buffer) {
+    CompileResponse response;
+    memset(&response, 0, sizeof(response));
+    response.status = COMPILE_INTERNAL_ERROR;
+    CompileResult *result = NULL;
+    Compiler *compiler = NULL;
+    PassManager *pm = pass_manager_create(OPT_LEVEL_1);
+    CompilerOptions options;
+    compiler_options_init(&options);
+    options.pass_manager = pm;
+    options.cache = server->options->cache;
+    options.collect_diagnostics = 1;
+    int print_passes = 0;
+    if (!pm) {
+        append_format(buffer, "Out of memory\n");
+    } else if (parse_options(request, pm, &options, &print_passes, buffer) == 0) {
+        if (print_passes) append_passes(buffer, pm);
+        compiler = compiler_create(&options);
+        result = compiler ? compile(compiler, request->name, request->source, request->source_length) : NULL;
+        if (!result) {
+            append_format(buffer, "Out of memory\n");
+        } else if (result->status == COMPILE_OK) {
+            // Предупреждения генератора
+            if (result->diagnostics) append_text(buffer, result->diagnostics, result->diagnostics_length);
+            response.status = COMPILE_OK;
+            response.code = result->code;
+            response.code_length = result->code_length;
+        } else {
+            response.status = result->status;
+            append_errors(buffer, result, request->name);
+        }
+    }
+    response.diagnostics = buffer->text;
+    response.diagnostics_length = buffer->text_length;
+    // Клиент, не дождавшийся ответа, на сервер не влияет
+    compile_response_send(socket, &response);
+
+    pthread_mutex_lock(&server->lock);
+    server->stats.requests++;
+    if (response.status != COMPILE_OK) server->stats.failed++;
+    pthread_mutex_unlock(&server->lock);
+
+    compile_result_free(result);
+    compiler_free(compiler);
+    pass_manager_free(pm);
+}
+
+// Останавливает сервер: новое соединение будит поток, ждущий в accept
+static void request_stop(CompileServer *server) {
+    pthread_mutex_lock(&server->lock);
+    server->stopping = 1;
+    pthread_mutex_unlock(&server->lock);
+    compile_socket_close(compile_socket_connect(server->options->socket_path));
+}
+
+static void serve_connection(void *arg) {
+    Connection *connection = (Connection *) arg;
+    CompileServer *server = connection->server;
+    RequestBuffer *buffer = take_buffer(server);
+    CompileRequest request;
+    if (buffer && compile_request_receive(connection->socket, &request, &buffer->data, &buffer->capacity) == 0) {
+        if (request.kind == COMPILE_REQUEST_SHUTDOWN) {
+            CompileResponse response;
+            memset(&response, 0, sizeof(response));
+            response.status = COMPILE_OK;
+            compile_response_send(connection->socket, &response);
+            request_stop(server);
+        } else {
+            serve_compile(server, connection->socket, &request, buffer);
+        }
+    }
+    compile_socket_close(connection->socket);
+    if (buffer) give_buffer(server, buffer);
+    free(connection);
+}
+
+int compile_server_run(const CompileServerOptions *options, CompileServerStats *stats) {
+    CompileServer server;
+    memset(&server, 0, sizeof(server));
+    server.options = options;
+    if (pthread_mutex_init(&server.lock, NULL) != 0) return -1;
+    CompileSocket listener = compile_socket_listen(options->socket_path);
+    if (listener == COMPILE_SOCKET_INVALID) {
+        pthread_mutex_destroy(&server.lock);
+        return -1;
+    }
+
+#ifndef _WIN32
+    // Сигналы остановки получает только этот поток: accept прерывается,
+    // и цикл видит stop_signal. Рабочие потоки наследуют маску
+    stop_signal = 0;
+    struct sigaction action, old_int, old_term, old_pipe;
+    memset(&action, 0, sizeof(action));
+    sigemptyset(&action.sa_mask);
+    action.sa_handler = on_stop_signal;
+    sigaction(SIGINT, &action, &old_int);
+    sigaction(SIGTERM, &action, &old_term);
+    action.sa_handler = SIG_IGN;
+    sigaction(SIGPIPE, &action, &old_pipe);
+    sigset_t stop_signals, old_mask;
+    sigemptyset(&stop_signals);
+    sigaddset(&stop_signals, SIGINT);
+    sigaddset(&stop_signals, SIGTERM);
+    pthread_sigmask(SIG_BLOCK, &stop_signals, &old_mask);
+#endif
+    ThreadPool *pool = thread_pool_create(options->threads);
+#ifndef _WIN32
+    pthread_sigmask(SIG_SETMASK, &old_mask, NULL);
+#endif
+
+    int status = pool ? 0 : -1;
+    while (pool && !server_stopping(&server)) {
+        CompileSocket socket = compile_socket_accept(listener);
+        if (socket == COMPILE_SOCKET_INVALID) {
+            int error = compile_socket_accept_error();
+            if (error < 0) {
+                status = -2;
+                break;
+            }
+            // Без дескрипторов accept сразу вернёт ту же ошибку: ждём, пока запросы их освободят
+            if (error > 0) accept_backoff();
+            continue;
+        }
+        if (server_stopping(&server)) {
+            compile_socket_close(socket);
+            break;
+        }
+        Connection *connection = (Connection *) malloc(sizeof(Connection));
+        if (!connection) {
+            compile_socket_close(socket);
+            continue;
+        }
+        connection->server = &server;
+        connection->socket = socket;
+        if (thread_pool_submit(pool, serve_connection, connection) != 0) {
+            serve_connection(connection);
+        }
+    }
+    // Начатые запросы отвечают клиентам до закрытия сокета
+    thread_pool_free(pool);
+    compile_socket_close(listener);
+    remove(options->socket_path);
+
+#ifndef _WIN32
+    sigaction(SIGINT, &old_int, NULL);
+    sigaction(SIGTERM, &old_term, NULL);
+    sigaction(SIGPIPE, &old_pipe, NULL);
+#endif
+    while (server.free_buffers) {
+        RequestBuffer *next = server.free_buffers->next;
+        free(server.free_buffers->data);
+        free(server.free_buffers->text);
+        free(server.free_buffers);
+        server.free_buffers = next;
+    }
+    pthread_mutex_destroy(&server.lock);
+    if (stats) *stats = server.stats;
+    return status;
+}
@@ -0,0 +1,30 @@
+#ifndef COMPILE_SERVER_H
+#define COMPILE_SERVER_H
+
+#include "compile_cache.h"
+
+typedef struct {
+    const char *socket_path;
+    int threads;                // запросов одновременно; 0 — по числу ядер
+    CompileCache *cache;        // общий для всех запросов или NULL
+} CompileServerOptions;
+
+typedef struct {
+    long requests;              // обработано запросов компиляции
+    long failed;                // из них без кода: ошибки в программе или в запросе
+} CompileServerStats;
+
+/**
+ * Сервер компиляции: принимает запросы compile_protocol.h на Unix-сокете
+ * и компилирует их на пуле потоков через compile(). Процесс не завершается
+ * между запросами, поэтому запуск, кэш и выделенные буферы запросов
+ * переиспользуются. Параметры компиляции приходят в каждом запросе.
+ * Работает до запроса COMPILE_REQUEST_SHUTDOWN или SIGINT/SIGTERM;
+ * начатые запросы перед выходом завершаются.
+ * @param stats Итоги работы (может быть NULL)
+ * @return 0 при штатном завершении, -1 если сокет не удалось создать,
+ *         -2 если сокет перестал принимать соединения (начатые запросы завершены)
+ */
+int compile_server_run(const CompileServerOptions *options, CompileServerStats *stats);
+
+#endif /* COMPILE_SERVER_H */
@@ -0,0 +1,146 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "block_layout.h"
+#include "listing.h"
+#include "../tagged_alloc.h"
+
+#define MAX_LAYOUT_ROUNDS 8
+#define MAX_THREAD_STEPS 16
+
+static const char *invert_branch(const char *op) {
+    if (strcmp(op, "beq") == 0) return "bne";
+    if (strcmp(op, "bne") == 0) return "beq";
+    if (strcmp(op, "blt") == 0) return "bge";
+    if (strcmp(op, "bge") == 0) return "blt";
+    return NULL;
+}
+
+static int label_matches(const char *line, const char *name, size_t len) {
+    return strncmp(line, name, len) == 0 && line[len] == ':' && line[len + 1] == '\0';
+}
+
+// Первая инструкция начиная с позиции from (метки и комментарии пропускаются)
+static size_t next_instruction(char **lines, size_t count, size_t from) {
+    for (size_t i = from; i < count; i++) {
+        if (lines[i] && listing_is_instruction(lines[i])) return i;
+    }
+    return count;
+}
+
+// Есть ли метка name среди строк между from и следующей инструкцией
+static int label_follows(char **lines, size_t count, size_t from, const char *name) {
+    size_t len = strlen(name);
+    for (size_t i = from; i < count; i++) {
+        if (!lines[i]) continue;
+        if (listing_is_instruction(lines[i])) return 0;
+        if (label_matches(lines[i], name, len)) return 1;
+    }
+    return 0;
+}
+
+// Конечная цель цепочки переходов jal -> jal -> ...
+static int thread_target(const LabelIndex *index, char **lines, size_t count, const char *target, char *out, size_t size) {
+    char current[256];
+    char next[256];
+    int changed = 0;
+    snprintf(current, sizeof(current), "%s", target);
+    for (int step = 0; step < MAX_THREAD_STEPS; step++) {
+        size_t label = label_index_find(index, lines, current);
+        if (label == (size_t) -1) break;
+        size_t first = next_instruction(lines, count, label + 1);
+        if (first >= count || !listing_parse_jump(lines[first], next, sizeof(next))) break;
+        if (strcmp(next, current) == 0 || strcmp(next, target) == 0) break;
+        snprintf(current, sizeof(current), "%s", next);
+        changed = 1;
+    }
+    if (changed) snprintf(out, size, "%s", current);
+    return changed;
+}
+
+static void replace_line(char **lines, size_t i, const char *text) {
+    char *copy = tagged_strdup(ALLOC_OUTPUT, text);
+    if (!copy) return;
+    tagged_free(ALLOC_OUTPUT, lines[i]);
+    lines[i] = copy;
+}
+
+static void delete_line(char **lines, size_t i) {
+    tagged_free(ALLOC_OUTPUT, lines[i]);
+    lines[i] = NULL;
+}
+
+static int layout_round(char **lines, size_t count, const LabelIndex *labels) {
+    LabelIndex own;
+    char buffer[512];
+    char op[8], r1[16], r2[16], target[256], threaded[256], jump_target[256];
+    int changed = 0;
+    if (!labels) {
+        if (label_index_build(&own, lines, count) != 0) return 0;
+        labels = &own;
+    }
+
+    for (size_t i = 0; i < count; i++) {
+        if (!lines[i]) continue;
+        if (listing_parse_jump(lines[i], target, sizeof(target))) {
+            // Сшивание цепочек и удаление перехода на следующую строку
+            if (thread_target(labels, lines, count, target, threaded, sizeof(threaded))) {
+                snprintf(buffer, sizeof(buffer), "jal x0, %s", threaded);
+                replace_line(lines, i, buffer);
+                snprintf(target, sizeof(target), "%s", threaded);
+                changed = 1;
+            }
+            if (label_follows(lines, count, i + 1, target)) {
+                delete_line(lines, i);
+                changed = 1;
+                continue;
+            }
+            // Инструкции после безусловного перехода до ближайшей метки недостижимы
+            for (size_t j = i + 1; j < count; j++) {
+                if (!lines[j]) continue;
+                if (listing_is_label(lines[j])) break;
+                if (listing_is_instruction(lines[j])) {
+                    delete_line(lines, j);
+                    changed = 1;
+                }
+            }
+        } else if (listing_parse_branch(lines[i], op, r1, r2, target, sizeof(target))) {
+            if (thread_target(labels, lines, count, target, threaded, sizeof(threaded))) {
+                snprintf(target, sizeof(target), "%s", threaded);
+                snprintf(buffer, sizeof(buffer), "%s %s, %s, %s", op, r1, r2, target);
+                replace_line(lines, i, buffer);
+                changed = 1;
+            }
+            // bXX L1; jal x0, L2; L1:  =>  bINV L2; L1:
+            size_t next = next_instruction(lines, count, i + 1);
+            if (next < count && listing_parse_jump(lines[next], jump_target, sizeof(jump_target)) &&
+                label_follows(lines, count, next + 1, target)) {
+                int crosses_label = 0;
+                for (size_t j = i + 1; j < next; j++) {
+                    if (lines[j] && listing_is_label(lines[j])) crosses_label = 1;
+                }
+                if (!crosses_label) {
+                    snprintf(buffer, sizeof(buffer), "%s %s, %s, %s", invert_branch(op), r1, r2, jump_target);
+                    replace_line(lines, i, buffer);
+                    delete_line(lines, next);
+                    changed = 1;
+                }
+            }
+        }
+    }
+
+    if (labels == &own) label_index_free(&own);
+    return changed;
+}
+
+size_t block_layout(char **lines, size_t count, const LabelIndex *labels) {
+    if (!lines || count == 0) return count;
+    for (int round = 0; round < MAX_LAYOUT_ROUNDS; round++) {
+        // Готовый индекс годится только для первого прохода: после сжатия
+        // номера строк меняются
+        int changed = layout_round(lines, count, round == 0 ? labels : NULL);
+        count = listing_compact(lines, count);
+        if (!changed) break;
+    }
+    return count;
+}
@@ -0,0 +1,19 @@
+#ifndef BLOCK_LAYOUT_H
+#define BLOCK_LAYOUT_H
+
+#include <stddef.h>
+#include "listing.h"
+
+/**
+ * Проход раскладки базовых блоков над готовым листингом RISC-кода.
+ * Сшивает цепочки переходов (jump-to-jump), разворачивает условный переход
+ * через безусловный так, чтобы горячий путь шёл «проваливанием», удаляет
+ * переходы на следующую строку и недостижимые инструкции.
+ * @param lines Массив строк листинга (строки выделены через malloc)
+ * @param count Количество строк
+ * @param labels Индекс меток, построенный по этим строкам, или NULL
+ * @return Новое количество строк; удалённые строки освобождаются
+ */
+size_t block_layout(char **lines, size_t count, const LabelIndex *labels);
+
+#endif /* BLOCK_LAYOUT_H */
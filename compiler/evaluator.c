@@ -0,0 +1,746 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "evaluator.h"
+#include "../tagged_alloc.h"
+
+#define EVAL_OK 0
+#define EVAL_STOP -1
+// Вычисление при компиляции рекурсивно; более глубокие выражения и блоки
+// не вычисляются и компилируются как обычно
+#define EVAL_MAX_NESTING 4096
+// Генератор отводит под результат конкатенации 100 слов (concatenate_strings)
+#define EVAL_CONCAT_MAX_LENGTH 99
+
+typedef struct {
+    int is_string;
+    int int_value;
+    char *str;
+} Value;
+
+typedef struct {
+    ASTNode *decl;
+    int depth;
+    int live;
+    Value value;
+} Var;
+
+typedef struct {
+    size_t index;
+    Value old;
+} UndoEntry;
+
+typedef struct {
+    Var *vars;
+    size_t var_count;
+    size_t var_capacity;
+    // Индекс первой переменной с данным именем (поиск как в генераторе)
+    // и индекс переменной по узлу объявления
+    size_t *names;
+    size_t *decls;
+    size_t name_capacity;
+    size_t *scope_stack;
+    size_t scope_count;
+    size_t scope_capacity;
+    UndoEntry *undo;
+    size_t undo_count;
+    size_t undo_capacity;
+    size_t statement_mark;
+    char *out;
+    size_t out_len;
+    size_t out_capacity;
+    long steps_left;
+    long steps_used;
+    size_t memory_used;
+    size_t max_memory;
+    int depth;
+    int nesting;            // глубина рекурсии eval_expression и exec_block
+    int round_depth;        // выполняемые сейчас циклы round
+    int in_expression;      // регистры выражения уже проверены (codegen_keeps)
+    int out_of_memory;
+} Evaluator;
+
+static int exec_statement(Evaluator *ev, ASTNode *node);
+
+static const char *var_name(const Var *var) {
+    return var->decl->variable.name;
+}
+
+static int step(Evaluator *ev) {
+    if (ev->steps_left <= 0) return EVAL_STOP;
+    ev->steps_left--;
+    ev->steps_used++;
+    return EVAL_OK;
+}
+
+static int charge(Evaluator *ev, size_t bytes) {
+    if (ev->memory_used + bytes > ev->max_memory) return EVAL_STOP;
+    ev->memory_used += bytes;
+    return EVAL_OK;
+}
+
+static void release(Evaluator *ev, Value *value) {
+    if (value->str) {
+        ev->memory_used -= strlen(value->str) + 1;
+        tagged_free(ALLOC_TEMP, value->str);
+        value->str = NULL;
+    }
+}
+
+static int make_string(Evaluator *ev, const char *text, size_t len, Value *out) {
+    if (charge(ev, len + 1) != EVAL_OK) return EVAL_STOP;
+    out->str = (char *) tagged_malloc(ALLOC_TEMP, len + 1);
+    if (!out->str) {
+        ev->out_of_memory = 1;
+        return EVAL_STOP;
+    }
+    memcpy(out->str, text, len);
+    out->str[len] = '\0';
+    out->is_string = 1;
+    out->int_value = 0;
+    return EVAL_OK;
+}
+
+static int make_concat(Evaluator *ev, const char *left, size_t left_len,
+                       const char *right, size_t right_len, Value *out) {
+    size_t len = left_len + right_len;
+    if (charge(ev, len + 1) != EVAL_OK) return EVAL_STOP;
+    out->str = (char *) tagged_malloc(ALLOC_TEMP, len + 1);
+    if (!out->str) {
+        ev->out_of_memory = 1;
+        return EVAL_STOP;
+    }
+    memcpy(out->str, left, left_len);
+    memcpy(out->str + left_len, right, right_len + 1);
+    out->is_string = 1;
+    out->int_value = 0;
+    return EVAL_OK;
+}
+
+static int copy_value(Evaluator *ev, const Value *src, Value *dst) {
+    if (!src->is_string) {
+        *dst = *src;
+        return EVAL_OK;
+    }
+    return make_string(ev, src->str, strlen(src->str), dst);
+}
+
+static unsigned long hash_name(const char *name) {
+    unsigned long h = 2166136261u;
+    for (; *name; name++) {
+        h = (h ^ (unsigned char) *name) * 16777619u;
+    }
+    return h;
+}
+
+static unsigned long hash_decl(const ASTNode *decl) {
+    unsigned long h = (unsigned long) (size_t) decl;
+    return (h >> 4) * 2654435761u;
+}
+
+static void index_var(Evaluator *ev, size_t index) {
+    size_t mask = ev->name_capacity - 1;
+    size_t pos = hash_name(var_name(&ev->vars[index])) & mask;
+    while (ev->names[pos] != (size_t) -1 &&
+           strcmp(var_name(&ev->vars[ev->names[pos]]), var_name(&ev->vars[index])) != 0) {
+        pos = (pos + 1) & mask;
+    }
+    if (ev->names[pos] == (size_t) -1) ev->names[pos] = index;
+    pos = hash_decl(ev->vars[index].decl) & mask;
+    while (ev->decls[pos] != (size_t) -1) pos = (pos + 1) & mask;
+    ev->decls[pos] = index;
+}
+
+static int rebuild_index(Evaluator *ev, size_t capacity) {
+    size_t *names = (size_t *) tagged_malloc(ALLOC_TEMP, capacity * sizeof(size_t));
+    size_t *decls = (size_t *) tagged_malloc(ALLOC_TEMP, capacity * sizeof(size_t));
+    if (!names || !decls) {
+        tagged_free(ALLOC_TEMP, names);
+        tagged_free(ALLOC_TEMP, decls);
+        ev->out_of_memory = 1;
+        return EVAL_STOP;
+    }
+    tagged_free(ALLOC_TEMP, ev->names);
+    tagged_free(ALLOC_TEMP, ev->decls);
+    ev->names = names;
+    ev->decls = decls;
+    ev->name_capacity = capacity;
+    for (size_t i = 0; i < capacity; i++) {
+        names[i] = (size_t) -1;
+        decls[i] = (size_t) -1;
+    }
+    for (size_t i = 0; i < ev->var_count; i++) index_var(ev, i);
+    return EVAL_OK;
+}
+
+static Var *find_decl(Evaluator *ev, const ASTNode *decl) {
+    if (!ev->decls) return NULL;
+    size_t pos = hash_decl(decl) & (ev->name_capacity - 1);
+    while (ev->decls[pos] != (size_t) -1) {
+        if (ev->vars[ev->decls[pos]].decl == decl) return &ev->vars[ev->decls[pos]];
+        pos = (pos + 1) & (ev->name_capacity - 1);
+    }
+    return NULL;
+}
+
+static Var *find_var(Evaluator *ev, const char *name) {
+    if (!ev->names) return NULL;
+    size_t pos = hash_name(name) & (ev->name_capacity - 1);
+    while (ev->names[pos] != (size_t) -1) {
+        Var *var = &ev->vars[ev->names[pos]];
+        if (strcmp(var_name(var), name) == 0) return var->live ? var : NULL;
+        pos = (pos + 1) & (ev->name_capacity - 1);
+    }
+    return NULL;
+}
+
+static int push_scope_entry(Evaluator *ev, size_t index) {
+    if (ev->scope_count >= ev->scope_capacity) {
+        size_t new_capacity = ev->scope_capacity == 0 ? 16 : ev->scope_capacity * 2;
+        size_t *new_stack = (size_t *) tagged_realloc(ALLOC_TEMP, ev->scope_stack,
+                                                      ev->scope_capacity * sizeof(size_t),
+                                                      new_capacity * sizeof(size_t));
+        if (!new_stack) {
+            ev->out_of_memory = 1;
+            return EVAL_STOP;
+        }
+        ev->scope_stack = new_stack;
+        ev->scope_capacity = new_capacity;
+    }
+    ev->scope_stack[ev->scope_count++] = index;
+    return EVAL_OK;
+}
+
+// Присваивание существующей переменной; старое значение переменных из уже
+// зафиксированных операторов сохраняется для отката
+static int assign(Evaluator *ev, Var *var, Value value) {
+    size_t index = (size_t) (var - ev->vars);
+    if (index < ev->statement_mark) {
+        if (ev->undo_count >= ev->undo_capacity) {
+            size_t new_capacity = ev->undo_capacity == 0 ? 16 : ev->undo_capacity * 2;
+            UndoEntry *new_undo = (UndoEntry *) tagged_realloc(ALLOC_TEMP, ev->undo,
+                                                               ev->undo_capacity * sizeof(UndoEntry),
+                                                               new_capacity * sizeof(UndoEntry));
+            if (!new_undo) {
+                release(ev, &value);
+                ev->out_of_memory = 1;
+                return EVAL_STOP;
+            }
+            ev->undo = new_undo;
+            ev->undo_capacity = new_capacity;
+        }
+        ev->undo[ev->undo_count].index = index;
+        ev->undo[ev->undo_count].old = var->value;
+        ev->undo_count++;
+    } else {
+        release(ev, &var->value);
+    }
+    var->value = value;
+    return EVAL_OK;
+}
+
+static int declare(Evaluator *ev, ASTNode *decl, Value value) {
+    // Повторное выполнение объявления в цикле переиспользует ту же переменную
+    Var *existing = find_decl(ev, decl);
+    if (existing) {
+        release(ev, &existing->value);
+        existing->value = value;
+        existing->live = 1;
+        return push_scope_entry(ev, (size_t) (existing - ev->vars));
+    }
+    if (charge(ev, sizeof(Var)) != EVAL_OK) {
+        release(ev, &value);
+        return EVAL_STOP;
+    }
+    if (ev->var_count >= ev->var_capacity) {
+        size_t new_capacity = ev->var_capacity == 0 ? 16 : ev->var_capacity * 2;
+        Var *new_vars = (Var *) tagged_realloc(ALLOC_SYMBOLS, ev->vars, ev->var_capacity * sizeof(Var),
+                                               new_capacity * sizeof(Var));
+        if (!new_vars) {
+            release(ev, &value);
+            ev->out_of_memory = 1;
+            return EVAL_STOP;
+        }
+        ev->vars = new_vars;
+        ev->var_capacity = new_capacity;
+    }
+    Var *var = &ev->vars[ev->var_count];
+    var->decl = decl;
+    var->depth = ev->depth;
+    var->live = 1;
+    var->value = value;
+    ev->var_count++;
+    if (ev->var_count * 2 > ev->name_capacity) {
+        if (rebuild_index(ev, ev->name_capacity == 0 ? 64 : ev->name_capacity * 2) != EVAL_OK) {
+            return EVAL_STOP;
+        }
+    } else {
+        index_var(ev, ev->var_count - 1);
+    }
+    return push_scope_entry(ev, ev->var_count - 1);
+}
+
+static int write_output(Evaluator *ev, const char *text, size_t len) {
+    if (charge(ev, len) != EVAL_OK) return EVAL_STOP;
+    if (ev->out_len + len > ev->out_capacity) {
+        size_t new_capacity = ev->out_capacity == 0 ? 256 : ev->out_capacity;
+        while (new_capacity < ev->out_len + len) new_capacity *= 2;
+        char *new_out = (char *) tagged_realloc(ALLOC_OUTPUT, ev->out, ev->out_capacity, new_capacity);
+        if (!new_out) {
+            ev->out_of_memory = 1;
+            return EVAL_STOP;
+        }
+        ev->out = new_out;
+        ev->out_capacity = new_capacity;
+    }
+    memcpy(ev->out + ev->out_len, text, len);
+    ev->out_len += len;
+    return EVAL_OK;
+}
+
+// Целочисленные операции повторяют семантику сгенерированного кода:
+// 32-битное переполнение, деление и остаток на ноль дают 0
+static int apply_int_op(const char *op, int l, int r, int *result) {
+    unsigned ul = (unsigned) l, ur = (unsigned) r;
+    if (strcmp(op, "+") == 0) *result = (int) (ul + ur);
+    else if (strcmp(op, "-") == 0) *result = (int) (ul - ur);
+    else if (strcmp(op, "*") == 0) *result = (int) (ul * ur);
+    else if (strcmp(op, "/") == 0) {
+        if (r == 0) *result = 0;
+        else if (l == -2147483647 - 1 && r == -1) *result = l;
+        else *result = l / r;
+    } else if (strcmp(op, "%") == 0) {
+        if (r == 0 || r == -1) *result = 0;
+        else *result = l % r;
+    }
+    else if (strcmp(op, "<") == 0) *result = l < r;
+    else if (strcmp(op, ">") == 0) *result = l > r;
+    else if (strcmp(op, "<=") == 0) *result = l <= r;
+    else if (strcmp(op, ">=") == 0) *result = l >= r;
+    else if (strcmp(op, "=") == 0 || strcmp(op, "==") == 0) *result = l == r;
+    else if (strcmp(op, "!=") == 0) *result = l != r;
+    else if (strcmp(op, "and") == 0) *result = l != 0 && r != 0;
+    else if (strcmp(op, "or") == 0) *result = l != 0 || r != 0;
+    else return EVAL_STOP;
+    return EVAL_OK;
+}
+
+static int eval_expression(Evaluator *ev, ASTNode *node, Value *out);
+
+static int eval_node(Evaluator *ev, ASTNode *node, Value *out) {
+    switch (node->type) {
+        case NODE_LITERAL:
+            if (strcmp(node->literal.type, "int") == 0) {
+                out->int_value = node->literal.int_value;
+                return EVAL_OK;
+            }
+            if (strcmp(node->literal.type, "string") == 0) {
+                const char *start = node->literal.string_value;
+                if (*start == '"') start++;
+                const char *end = strchr(start, '"');
+                return make_string(ev, start, end ? (size_t) (end - start) : strlen(start), out);
+            }
+            return EVAL_STOP;
+        case NODE_IDENTIFIER:
+            {
+                Var *var = find_var(ev, node->identifier.name);
+                if (!var) return EVAL_STOP;
+                return copy_value(ev, &var->value, out);
+            }
+        case NODE_BINARY_OPERATION:
+            {
+                Value left, right;
+                if (eval_expression(ev, node->binary_op.left, &left) != EVAL_OK) {
+                    release(ev, &left);
+                    return EVAL_STOP;
+                }
+                if (eval_expression(ev, node->binary_op.right, &right) != EVAL_OK) {
+                    release(ev, &left);
+                    release(ev, &right);
+                    return EVAL_STOP;
+                }
+                int status = EVAL_STOP;
+                if (strcmp(node->binary_op.op_type, ".") == 0) {
+                    if (left.is_string && right.is_string) {
+                        size_t left_len = strlen(left.str);
+                        size_t right_len = strlen(right.str);
+                        // Длинный результат сгенерированный код пишет поверх следующих данных
+                        if (left_len + right_len <= EVAL_CONCAT_MAX_LENGTH &&
+                            make_concat(ev, left.str, left_len, right.str, right_len, out) == EVAL_OK) {
+                            status = EVAL_OK;
+                        }
+                    }
+                } else if (!left.is_string && !right.is_string) {
+                    status = apply_int_op(node->binary_op.op_type, left.int_value, right.int_value,
+                                          &out->int_value);
+                }
+                release(ev, &left);
+                release(ev, &right);
+                return status;
+            }
+        default:
+            return EVAL_STOP;
+    }
+}
+
+#define REG(n) (1UL << (n))
+
+static int is_int_literal(const ASTNode *node) {
+    return node && node->type == NODE_LITERAL && strcmp(node->literal.type, "int") == 0;
+}
+
+// "and" с нулём и "or" с ненулевым литералом генератор заменяет на li, не читая операнды
+static int codegen_reads_operands(const ASTNode *node) {
+    const char *op = node->binary_op.op_type;
+    const ASTNode *left = node->binary_op.left;
+    const ASTNode *right = node->binary_op.right;
+    if (strcmp(op, "and") == 0) {
+        return !(is_int_literal(left) && left->literal.int_value == 0) &&
+               !(is_int_literal(right) && right->literal.int_value == 0);
+    }
+    if (strcmp(op, "or") == 0) {
+        return !(is_int_literal(left) && left->literal.int_value != 0) &&
+               !(is_int_literal(right) && right->literal.int_value != 0);
+    }
+    return 1;
+}
+
+/**
+ * Повторяет выбор регистров в expression_step генератора кода: операнды
+ * арифметики — x3/x4 при цели x1, иначе x1/x2; загрузка переменной портит x2
+ * и x31, логические операции — x5/x6; конкатенация вычисляет операнды в x5/x6
+ * и копирует строки через x1-x4. Если код выражения затирает регистр, где ещё
+ * лежит операнд, он считает не то, что вычислил бы вычислитель.
+ * @param live Регистры с операндами, ожидающими своей операции
+ * @return 1, если код выражения не пишет в live
+ */
+static int codegen_keeps(const ASTNode *node, int target, unsigned long live, int depth) {
+    if (!node || depth >= EVAL_MAX_NESTING) return 0;
+    unsigned long writes = REG(target);
+    switch (node->type) {
+        case NODE_LITERAL:
+            // Без образа данных строковый литерал записывается в память через x1 и x2
+            if (strcmp(node->literal.type, "string") == 0) writes |= REG(1) | REG(2);
+            break;
+        case NODE_IDENTIFIER:
+            writes |= REG(2) | REG(31);
+            break;
+        case NODE_BINARY_OPERATION:
+            if (strcmp(node->binary_op.op_type, ".") == 0) {
+                if (!codegen_keeps(node->binary_op.left, 5, live, depth + 1) ||
+                    !codegen_keeps(node->binary_op.right, 6, live | REG(5), depth + 1)) {
+                    return 0;
+                }
+                writes |= REG(1) | REG(2) | REG(3) | REG(4);
+            } else {
+                int left = target == 1 ? 3 : 1;
+                int right = target == 1 ? 4 : 2;
+                unsigned long right_live = codegen_reads_operands(node) ? live | REG(left) : live;
+                if (!codegen_keeps(node->binary_op.left, left, live, depth + 1) ||
+                    !codegen_keeps(node->binary_op.right, right, right_live, depth + 1)) {
+                    return 0;
+                }
+                writes |= REG(5) | REG(6);
+            }
+            break;
+        default:
+            return 0;
+    }
+    return (writes & live) == 0;
+}
+
+static int eval_expression(Evaluator *ev, ASTNode *node, Value *out) {
+    out->is_string = 0;
+    out->int_value = 0;
+    out->str = NULL;
+    if (!node || ev->nesting >= EVAL_MAX_NESTING || step(ev) != EVAL_OK) return EVAL_STOP;
+    // Операторы вычисляют выражения в x1
+    int root = !ev->in_expression;
+    if (root && !codegen_keeps(node, 1, 0, ev->nesting)) return EVAL_STOP;
+    ev->in_expression = 1;
+    ev->nesting++;
+    int status = eval_node(ev, node, out);
+    ev->nesting--;
+    if (root) ev->in_expression = 0;
+    return status;
+}
+
+static int matches_type(const char *type, const Value *value) {
+    return value->is_string ? strcmp(type, "string") == 0 : strcmp(type, "int") == 0;
+}
+
+static int exec_block(Evaluator *ev, ASTNode *node) {
+    size_t scope_mark = ev->scope_count;
+    int status = EVAL_OK;
+    if (ev->nesting >= EVAL_MAX_NESTING) return EVAL_STOP;
+    ev->nesting++;
+    ev->depth++;
+    if (node->type == NODE_BLOCK) {
+        for (size_t i = 0; i < node->block.children.size && status == EVAL_OK; i++) {
+            status = exec_statement(ev, node->block.children.items[i]);
+        }
+    } else {
+        status = exec_statement(ev, node);
+    }
+    // Переменные блока умирают при выходе из него
+    while (ev->scope_count > scope_mark) {
+        ev->vars[ev->scope_stack[--ev->scope_count]].live = 0;
+    }
+    ev->depth--;
+    ev->nesting--;
+    return status;
+}
+
+static int exec_print(Evaluator *ev, ASTNode *node) {
+    ASTNode *expr = node->print.expression;
+    Value value;
+    if (eval_expression(ev, expr, &value) != EVAL_OK) {
+        release(ev, &value);
+        return EVAL_STOP;
+    }
+    int status;
+    if (value.is_string) {
+        // Сгенерированный код печатает как строку только литерал или строковую
+        // переменную; остальные строковые выражения не поддерживаются
+        if (expr->type != NODE_LITERAL && expr->type != NODE_IDENTIFIER) {
+            release(ev, &value);
+            return EVAL_STOP;
+        }
+        status = write_output(ev, value.str, strlen(value.str));
+    } else {
+        char buffer[16];
+        if (value.int_value == -2147483647 - 1) return EVAL_STOP;
+        int len = snprintf(buffer, sizeof(buffer), "%d", value.int_value);
+        status = write_output(ev, buffer, (size_t) len);
+    }
+    release(ev, &value);
+    if (status != EVAL_OK) return EVAL_STOP;
+    return write_output(ev, "\n", 1);
+}
+
+static int exec_round(Evaluator *ev, ASTNode *node) {
+    Var *var = find_var(ev, node->round_loop.variable);
+    if (!var || var->value.is_string) return EVAL_STOP;
+    size_t index = (size_t) (var - ev->vars);
+    Value start, end, stepv;
+    if (eval_expression(ev, node->round_loop.start, &start) != EVAL_OK || start.is_string) {
+        release(ev, &start);
+        return EVAL_STOP;
+    }
+    if (eval_expression(ev, node->round_loop.end, &end) != EVAL_OK || end.is_string) {
+        release(ev, &end);
+        return EVAL_STOP;
+    }
+    stepv.is_string = 0;
+    stepv.int_value = 1;
+    stepv.str = NULL;
+    if (node->round_loop.step &&
+        (eval_expression(ev, node->round_loop.step, &stepv) != EVAL_OK || stepv.is_string)) {
+        release(ev, &stepv);
+        return EVAL_STOP;
+    }
+    // Сгенерированный код держит счётчик, конец и шаг любого round в x20-x22,
+    // и вложенный round затирает состояние внешнего: такое не вычисляется
+    if (ev->round_depth > 0) return EVAL_STOP;
+    // Счётчик живёт в регистре: присваивания переменной в теле его не меняют
+    int counter = start.int_value;
+    Value value = {0, counter, NULL};
+    if (assign(ev, &ev->vars[index], value) != EVAL_OK) return EVAL_STOP;
+    // При EVAL_STOP оператор откатывается вместе с round_depth
+    ev->round_depth++;
+    while (counter < end.int_value) {
+        if (step(ev) != EVAL_OK) return EVAL_STOP;
+        value.int_value = counter;
+        if (assign(ev, &ev->vars[index], value) != EVAL_OK) return EVAL_STOP;
+        if (exec_block(ev, node->round_loop.body) != EVAL_OK) return EVAL_STOP;
+        counter = (int) ((unsigned) counter + (unsigned) stepv.int_value);
+        value.int_value = counter;
+        if (assign(ev, &ev->vars[index], value) != EVAL_OK) return EVAL_STOP;
+    }
+    ev->round_depth--;
+    return EVAL_OK;
+}
+
+static int exec_statement(Evaluator *ev, ASTNode *node) {
+    if (!node || step(ev) != EVAL_OK) return EVAL_STOP;
+    switch (node->type) {
+        case NODE_VARIABLE_DECLARATION:
+            {
+                Value value = {0, 0, NULL};
+                if (node->variable.initializer) {
+                    if (eval_expression(ev, node->variable.initializer, &value) != EVAL_OK) {
+                        release(ev, &value);
+                        return EVAL_STOP;
+                    }
+                } else if (strcmp(node->variable.var_type, "string") == 0) {
+                    if (make_string(ev, "", 0, &value) != EVAL_OK) return EVAL_STOP;
+                }
+                if (!matches_type(node->variable.var_type, &value)) {
+                    release(ev, &value);
+                    return EVAL_STOP;
+                }
+                return declare(ev, node, value);
+            }
+        case NODE_ASSIGNMENT:
+            {
+                Var *var = find_var(ev, node->assignment.target);
+                if (!var) return EVAL_STOP;
+                size_t index = (size_t) (var - ev->vars);
+                Value value;
+                if (eval_expression(ev, node->assignment.value, &value) != EVAL_OK) {
+                    release(ev, &value);
+                    return EVAL_STOP;
+                }
+                if (!matches_type(ev->vars[index].decl->variable.var_type, &value)) {
+                    release(ev, &value);
+                    return EVAL_STOP;
+                }
+                return assign(ev, &ev->vars[index], value);
+            }
+        case NODE_PRINT:
+            return exec_print(ev, node);
+        case NODE_IF_STATEMENT:
+            {
+                Value cond;
+                if (eval_expression(ev, node->if_stmt.condition, &cond) != EVAL_OK || cond.is_string) {
+                    release(ev, &cond);
+                    return EVAL_STOP;
+                }
+                if (cond.int_value != 0) return exec_block(ev, node->if_stmt.then_branch);
+                if (node->if_stmt.else_branch) return exec_block(ev, node->if_stmt.else_branch);
+                return EVAL_OK;
+            }
+        case NODE_WHILE_LOOP:
+            for (;;) {
+                Value cond;
+                if (eval_expression(ev, node->while_loop.condition, &cond) != EVAL_OK || cond.is_string) {
+                    release(ev, &cond);
+                    return EVAL_STOP;
+                }
+                if (cond.int_value == 0) return EVAL_OK;
+                if (exec_block(ev, node->while_loop.body) != EVAL_OK) return EVAL_STOP;
+            }
+        case NODE_ROUND_LOOP:
+            return exec_round(ev, node);
+        case NODE_BLOCK:
+            return exec_block(ev, node);
+        default:
+            return EVAL_STOP;
+    }
+}
+
+static void commit_statement(Evaluator *ev) {
+    for (size_t i = 0; i < ev->undo_count; i++) {
+        release(ev, &ev->undo[i].old);
+    }
+    ev->undo_count = 0;
+    ev->statement_mark = ev->var_count;
+}
+
+// Откат незавершённого оператора к состоянию до его начала
+static void rollback_statement(Evaluator *ev, size_t out_mark, size_t memory_mark) {
+    for (size_t i = ev->undo_count; i > 0; i--) {
+        UndoEntry *entry = &ev->undo[i - 1];
+        tagged_free(ALLOC_TEMP, ev->vars[entry->index].value.str);
+        ev->vars[entry->index].value = entry->old;
+    }
+    ev->undo_count = 0;
+    for (size_t i = ev->statement_mark; i < ev->var_count; i++) {
+        tagged_free(ALLOC_TEMP, ev->vars[i].value.str);
+    }
+    if (ev->var_count != ev->statement_mark) {
+        ev->var_count = ev->statement_mark;
+        rebuild_index(ev, ev->name_capacity);
+    }
+    ev->scope_count = 0;
+    ev->depth = 0;
+    ev->nesting = 0;
+    ev->round_depth = 0;
+    ev->in_expression = 0;
+    ev->out_len = out_mark;
+    ev->memory_used = memory_mark;
+}
+
+static void free_evaluator(Evaluator *ev) {
+    for (size_t i = 0; i < ev->var_count; i++) {
+        tagged_free(ALLOC_TEMP, ev->vars[i].value.str);
+    }
+    tagged_free(ALLOC_SYMBOLS, ev->vars);
+    tagged_free(ALLOC_TEMP, ev->names);
+    tagged_free(ALLOC_TEMP, ev->decls);
+    tagged_free(ALLOC_TEMP, ev->scope_stack);
+    tagged_free(ALLOC_TEMP, ev->undo);
+    tagged_free(ALLOC_OUTPUT, ev->out);
+}
+
+static int export_state(Evaluator *ev, EvalResult *result) {
+    size_t count = 0;
+    for (size_t i = 0; i < ev->var_count; i++) {
+        if (ev->vars[i].depth == 0) count++;
+    }
+    result->variables = (EvalVariable *) tagged_calloc(ALLOC_SYMBOLS, count ? count : 1,
+                                                       sizeof(EvalVariable));
+    if (!result->variables) return -1;
+    for (size_t i = 0; i < ev->var_count; i++) {
+        Var *var = &ev->vars[i];
+        if (var->depth != 0) continue;
+        EvalVariable *out = &result->variables[result->variable_count++];
+        out->name = tagged_strdup(ALLOC_SYMBOLS, var->decl->variable.name);
+        out->type = tagged_strdup(ALLOC_SYMBOLS, var->decl->variable.var_type);
+        out->is_global = var->decl->variable.is_global;
+        out->is_string = var->value.is_string;
+        out->int_value = var->value.int_value;
+        out->string_value = var->value.str ? tagged_strdup(ALLOC_SYMBOLS, var->value.str) : NULL;
+        if (!out->name || !out->type || (var->value.str && !out->string_value)) return -1;
+    }
+    return 0;
+}
+
+int evaluate_program(ASTNode *program, const EvalBudget *budget, EvalResult *result) {
+    memset(result, 0, sizeof(*result));
+    if (!program || program->type != NODE_PROGRAM || !budget) return -1;
+    Evaluator ev;
+    memset(&ev, 0, sizeof(ev));
+    ev.steps_left = budget->max_steps;
+    ev.max_memory = budget->max_memory;
+
+    size_t index = 0;
+    for (; index < program->block.children.size; index++) {
+        size_t out_mark = ev.out_len;
+        size_t memory_mark = ev.memory_used;
+        if (exec_statement(&ev, program->block.children.items[index]) != EVAL_OK) {
+            rollback_statement(&ev, out_mark, memory_mark);
+            break;
+        }
+        commit_statement(&ev);
+    }
+    if (ev.out_of_memory) {
+        free_evaluator(&ev);
+        return -1;
+    }
+
+    result->resume_index = index;
+    result->steps_used = ev.steps_used;
+    result->output = ev.out;
+    result->output_length = ev.out_len;
+    ev.out = NULL;
+    int status = export_state(&ev, result);
+    free_evaluator(&ev);
+    if (status != 0) {
+        eval_result_free(result);
+        return -1;
+    }
+    return 0;
+}
+
+void eval_result_free(EvalResult *result) {
+    if (!result) return;
+    tagged_free(ALLOC_OUTPUT, result->output);
+    for (size_t i = 0; i < result->variable_count; i++) {
+        tagged_free(ALLOC_SYMBOLS, result->variables[i].name);
+        tagged_free(ALLOC_SYMBOLS, result->variables[i].type);
+        tagged_free(ALLOC_SYMBOLS, result->variables[i].string_value);
+    }
+    tagged_free(ALLOC_SYMBOLS, result->variables);
+    memset(result, 0, sizeof(*result));
+}
@@ -0,0 +1,48 @@
+#ifndef EVALUATOR_H
+#define EVALUATOR_H
+
+#include <stddef.h>
+#include "../ast/ast.h"
+
+// Бюджет вычисления программы во время компиляции
+typedef struct {
+    long max_steps;
+    size_t max_memory;
+} EvalBudget;
+
+// Переменная верхнего уровня после выполненной части программы
+typedef struct {
+    char *name;
+    char *type;
+    int is_global;
+    int is_string;
+    int int_value;
+    char *string_value;
+} EvalVariable;
+
+typedef struct {
+    char *output;
+    size_t output_length;
+    size_t resume_index;
+    EvalVariable *variables;
+    size_t variable_count;
+    long steps_used;
+} EvalResult;
+
+/**
+ * Выполняет операторы верхнего уровня программы, пока хватает бюджета.
+ * Оператор фиксируется только если выполнен целиком; при нехватке бюджета
+ * или неподдерживаемой конструкции его эффекты откатываются.
+ * Программа должна быть заранее проверена генератором кода.
+ * @param program Узел NODE_PROGRAM
+ * @param budget Ограничения по шагам и памяти
+ * @param result Вывод и состояние переменных; resume_index — первый
+ *               невыполненный оператор (равен числу операторов, если
+ *               программа выполнена полностью)
+ * @return 0 при успехе, -1 при ошибке выделения памяти
+ */
+int evaluate_program(ASTNode *program, const EvalBudget *budget, EvalResult *result);
+
+void eval_result_free(EvalResult *result);
+
+#endif /* EVALUATOR_H */
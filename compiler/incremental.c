@@ -0,0 +1,579 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "incremental.h"
+#include "../tagged_alloc.h"
+#ifdef _WIN32
+#include <windows.h>
+#endif
+
+#define STATE_MAGIC "RINC"
+#define STATE_VERSION 1
+
+// Заголовок файла состояния; checksum — ключ compile_cache_key_init,
+// дополненный всеми байтами после заголовка, поэтому файл другой версии
+// компилятора (COMPILER_VERSION) или повреждённый файл не проходит проверку
+typedef struct {
+    char magic[4];
+    uint32_t version;
+    uint32_t pass_mask;
+    uint32_t fragment_count;
+    uint64_t payload_length;
+    CacheKey checksum;
+} StateHeader;
+
+// Фрагменты с поиском по ключу. Фрагмент прошлой генерации, взятый
+// текущей, остаётся в обеих таблицах: в прошлой он помечен как отданный,
+// в текущей — как чужой, и освобождает его только одна из них
+typedef struct {
+    StatementFragment **items;
+    unsigned char *lent;        // 1 — фрагмент принадлежит другой таблице
+    size_t count;
+    size_t capacity;
+    size_t *slots;              // номер в items + 1, 0 — пустая ячейка
+    size_t slot_capacity;       // степень двойки
+} FragmentTable;
+
+struct IncrementalState {
+    unsigned pass_mask;
+    FragmentTable previous;     // прошлая успешная генерация
+    FragmentTable current;      // текущая генерация
+    long reused;
+    long regenerated;
+};
+
+static size_t key_slot(const CacheKey *key, size_t slot_capacity) {
+    return (size_t) (key->low ^ key->high) & (slot_capacity - 1);
+}
+
+// Номер фрагмента с ключом или -1
+static long table_find(const FragmentTable *table, const CacheKey *key) {
+    if (table->slot_capacity == 0) return -1;
+    for (size_t s = key_slot(key, table->slot_capacity); table->slots[s] != 0;
+         s = (s + 1) & (table->slot_capacity - 1)) {
+        const CacheKey *other = &table->items[table->slots[s] - 1]->key;
+        if (other->high == key->high && other->low == key->low) return (long) (table->slots[s] - 1);
+    }
+    return -1;
+}
+
+static int table_add(FragmentTable *table, StatementFragment *fragment, int lent) {
+    if (table->count >= table->capacity) {
+        size_t new_capacity = table->capacity == 0 ? 64 : table->capacity * 2;
+        StatementFragment **new_items = (StatementFragment **) realloc(table->items,
+                                                                       new_capacity * sizeof(*new_items));
+        if (!new_items) return -1;
+        table->items = new_items;
+        unsigned char *new_lent = (unsigned char *) realloc(table->lent, new_capacity);
+        if (!new_lent) return -1;
+        table->lent = new_lent;
+        table->capacity = new_capacity;
+    }
+    if ((table->count + 1) * 2 > table->slot_capacity) {
+        size_t new_capacity = table->slot_capacity == 0 ? 128 : table->slot_capacity * 2;
+        size_t *new_slots = (size_t *) calloc(new_capacity, sizeof(size_t));
+        if (!new_slots) return -1;
+        for (size_t i = 0; i < table->count; i++) {
+            size_t s = key_slot(&table->items[i]->key, new_capacity);
+            while (new_slots[s] != 0) s = (s + 1) & (new_capacity - 1);
+            new_slots[s] = i + 1;
+        }
+        free(table->slots);
+        table->slots = new_slots;
+        table->slot_capacity = new_capacity;
+    }
+    size_t s = key_slot(&fragment->key, table->slot_capacity);
+    while (table->slots[s] != 0) s = (s + 1) & (table->slot_capacity - 1);
+    table->items[table->count] = fragment;
+    table->lent[table->count] = (unsigned char) lent;
+    table->slots[s] = ++table->count;
+    return 0;
+}
+
+// Освобождает таблицу вместе с фрагментами, которые ей принадлежат
+static void table_free(FragmentTable *table) {
+    for (size_t i = 0; i < table->count; i++) {
+        if (!table->lent[i]) statement_fragment_free(table->items[i]);
+    }
+    free(table->items);
+    free(table->lent);
+    free(table->slots);
+    memset(table, 0, sizeof(*table));
+}
+
+void statement_fragment_free(StatementFragment *fragment) {
+    if (!fragment) return;
+    tagged_free(ALLOC_OUTPUT, fragment->code);
+    tagged_free(ALLOC_OUTPUT, fragment->data);
+    tagged_free(ALLOC_OUTPUT, fragment->frame_events);
+    for (size_t i = 0; i < fragment->variable_count; i++) {
+        tagged_free(ALLOC_SYMBOLS, fragment->variables[i].name);
+        tagged_free(ALLOC_SYMBOLS, fragment->variables[i].type);
+    }
+    tagged_free(ALLOC_OUTPUT, fragment->variables);
+    for (size_t i = 0; i < fragment->import_count; i++) {
+        tagged_free(ALLOC_SYMBOLS, fragment->imports[i].name);
+    }
+    tagged_free(ALLOC_OUTPUT, fragment->imports);
+    tagged_free(ALLOC_OUTPUT, fragment);
+}
+
+void incremental_state_begin(IncrementalState *state) {
+    table_free(&state->current);
+    for (size_t i = 0; i < state->previous.count; i++) {
+        state->previous.lent[i] = 0;
+    }
+    state->reused = 0;
+    state->regenerated = 0;
+}
+
+const StatementFragment *incremental_state_find(IncrementalState *state, const CacheKey *key) {
+    long index = table_find(&state->current, key);
+    if (index < 0) {
+        index = table_find(&state->previous, key);
+        if (index < 0) return NULL;
+        StatementFragment *fragment = state->previous.items[index];
+        if (table_add(&state->current, fragment, 1) != 0) return NULL;
+        state->previous.lent[index] = 1;
+        state->reused++;
+        return fragment;
+    }
+    state->reused++;
+    return state->current.items[index];
+}
+
+int incremental_state_add(IncrementalState *state, StatementFragment *fragment) {
+    if (table_add(&state->current, fragment, 0) != 0) return -1;
+    state->regenerated++;
+    return 0;
+}
+
+void incremental_state_finish(IncrementalState *state, int success) {
+    if (success) {
+        // Фрагменты прошлой генерации, не взятые текущей, больше не нужны
+        table_free(&state->previous);
+        for (size_t i = 0; i < state->current.count; i++) {
+            state->current.lent[i] = 0;
+        }
+        state->previous = state->current;
+        memset(&state->current, 0, sizeof(state->current));
+    } else {
+        incremental_state_begin(state);
+    }
+}
+
+void incremental_state_get_stats(const IncrementalState *state, long *reused, long *regenerated) {
+    *reused = state->reused;
+    *regenerated = state->regenerated;
+}
+
+void incremental_state_free(IncrementalState *state) {
+    if (!state) return;
+    incremental_state_begin(state);
+    table_free(&state->previous);
+    free(state);
+}
+
+static void key_add_string(CacheKey *key, const char *s) {
+    if (s) {
+        compile_cache_key_add(key, s, strlen(s) + 1);
+    } else {
+        compile_cache_key_add_long(key, -1);
+    }
+}
+
+static int add_name(const char *name, const char ***names, size_t *count, size_t *capacity) {
+    if (!name) return 0;
+    if (*count >= *capacity) {
+        size_t new_capacity = *capacity == 0 ? 16 : *capacity * 2;
+        const char **new_names = (const char **) tagged_realloc(ALLOC_TEMP, (void *) *names, *capacity * sizeof(char *),
+                                                                new_capacity * sizeof(char *));
+        if (!new_names) return -1;
+        *names = new_names;
+        *capacity = new_capacity;
+    }
+    (*names)[(*count)++] = name;
+    return 0;
+}
+
+int incremental_fingerprint(const ASTNode *statement, CacheKey *key,
+                            const char ***names, size_t *name_count, size_t *name_capacity) {
+    size_t count = 0;
+    size_t capacity = 16;
+    const ASTNode **stack = (const ASTNode **) tagged_malloc(ALLOC_TEMP, capacity * sizeof(ASTNode *));
+    if (!stack) return -1;
+    stack[count++] = statement;
+    int status = 0;
+    while (count > 0 && status == 0) {
+        const ASTNode *node = stack[--count];
+        if (!node) {
+            compile_cache_key_add_long(key, -1);
+            continue;
+        }
+        const ASTNode *children[4] = {NULL, NULL, NULL, NULL};
+        size_t child_count = 0;
+        compile_cache_key_add_long(key, node->type);
+        switch (node->type) {
+            case NODE_PROGRAM:
+            case NODE_BLOCK:
+                child_count = node->block.children.size;
+                compile_cache_key_add_long(key, (long) child_count);
+                break;
+            case NODE_VARIABLE_DECLARATION:
+                key_add_string(key, node->variable.name);
+                key_add_string(key, node->variable.var_type);
+                compile_cache_key_add_long(key, node->variable.is_global);
+                status = add_name(node->variable.name, names, name_count, name_capacity);
+                children[child_count++] = node->variable.initializer;
+                break;
+            case NODE_BINARY_OPERATION:
+                key_add_string(key, node->binary_op.op_type);
+                children[child_count++] = node->binary_op.left;
+                children[child_count++] = node->binary_op.right;
+                break;
+            case NODE_LITERAL:
+                key_add_string(key, node->literal.type);
+                if (node->literal.type && strcmp(node->literal.type, "string") == 0) {
+                    key_add_string(key, node->literal.string_value);
+                } else if (node->literal.type && strcmp(node->literal.type, "float") == 0) {
+                    compile_cache_key_add(key, &node->literal.float_value, sizeof(float));
+                } else {
+                    compile_cache_key_add_long(key, node->literal.int_value);
+                }
+                break;
+            case NODE_IDENTIFIER:
+                key_add_string(key, node->identifier.name);
+                status = add_name(node->identifier.name, names, name_count, name_capacity);
+                break;
+            case NODE_ASSIGNMENT:
+                key_add_string(key, node->assignment.target);
+                status = add_name(node->assignment.target, names, name_count, name_capacity);
+                children[child_count++] = node->assignment.value;
+                break;
+            case NODE_IF_STATEMENT:
+                children[child_count++] = node->if_stmt.condition;
+                children[child_count++] = node->if_stmt.then_branch;
+                children[child_count++] = node->if_stmt.else_branch;
+                break;
+            case NODE_WHILE_LOOP:
+                children[child_count++] = node->while_loop.condition;
+                children[child_count++] = node->while_loop.body;
+                break;
+            case NODE_ROUND_LOOP:
+                key_add_string(key, node->round_loop.variable);
+                status = add_name(node->round_loop.variable, names, name_count, name_capacity);
+                children[child_count++] = node->round_loop.start;
+                children[child_count++] = node->round_loop.end;
+                children[child_count++] = node->round_loop.step;
+                children[child_count++] = node->round_loop.body;
+                break;
+            case NODE_PRINT:
+                children[child_count++] = node->print.expression;
+                break;
+        }
+        if (count + child_count > capacity) {
+            size_t new_capacity = (count + child_count) * 2;
+            const ASTNode **new_stack = (const ASTNode **) tagged_realloc(ALLOC_TEMP, (void *) stack,
+                                                                          capacity * sizeof(ASTNode *),
+                                                                          new_capacity * sizeof(ASTNode *));
+            if (!new_stack) {
+                status = -1;
+                break;
+            }
+            stack = new_stack;
+            capacity = new_capacity;
+        }
+        // Дети кладутся в обратном порядке и выходят слева направо
+        if (node->type == NODE_PROGRAM || node->type == NODE_BLOCK) {
+            for (size_t i = child_count; i > 0; i--) {
+                stack[count++] = node->block.children.items[i - 1];
+            }
+        } else {
+            for (size_t i = child_count; i > 0; i--) {
+                stack[count++] = children[i - 1];
+            }
+        }
+    }
+    tagged_free(ALLOC_TEMP, (void *) stack);
+    return status;
+}
+
+// Чтение и запись файла состояния: числа — int32 в порядке байтов машины,
+// строки завершены нулём
+typedef struct {
+    const char *data;
+    size_t length;
+    size_t pos;
+    int failed;
+} StateReader;
+
+static const char *read_bytes(StateReader *reader, size_t length) {
+    if (reader->failed || length > reader->length - reader->pos) {
+        reader->failed = 1;
+        return NULL;
+    }
+    const char *bytes = reader->data + reader->pos;
+    reader->pos += length;
+    return bytes;
+}
+
+static int read_int(StateReader *reader) {
+    int32_t value = 0;
+    const char *bytes = read_bytes(reader, sizeof(value));
+    if (bytes) memcpy(&value, bytes, sizeof(value));
+    return (int) value;
+}
+
+// Число элементов, каждый из которых занимает не меньше min_size байт
+static size_t read_count(StateReader *reader, size_t min_size) {
+    int value = read_int(reader);
+    if (value < 0 || (size_t) value > (reader->length - reader->pos) / min_size) {
+        reader->failed = 1;
+        return 0;
+    }
+    return (size_t) value;
+}
+
+static char *read_string(StateReader *reader) {
+    if (reader->failed) return NULL;
+    const char *start = reader->data + reader->pos;
+    const char *end = (const char *) memchr(start, '\0', reader->length - reader->pos);
+    if (!end) {
+        reader->failed = 1;
+        return NULL;
+    }
+    reader->pos += (size_t) (end - start) + 1;
+    char *copy = (char *) tagged_malloc(ALLOC_SYMBOLS, (size_t) (end - start) + 1);
+    if (!copy) {
+        reader->failed = 1;
+        return NULL;
+    }
+    memcpy(copy, start, (size_t) (end - start) + 1);
+    return copy;
+}
+
+static StatementFragment *read_fragment(StateReader *reader) {
+    StatementFragment *fragment = (StatementFragment *) tagged_calloc(ALLOC_OUTPUT, 1, sizeof(StatementFragment));
+    if (!fragment) return NULL;
+    const char *key = read_bytes(reader, sizeof(CacheKey));
+    if (key) memcpy(&fragment->key, key, sizeof(CacheKey));
+    fragment->memory_size = read_int(reader);
+    fragment->label_count = read_int(reader);
+    size_t code_length = read_count(reader, 1);
+    const char *code = read_bytes(reader, code_length);
+    fragment->code = code ? (char *) tagged_malloc(ALLOC_OUTPUT, code_length + 1) : NULL;
+    if (fragment->code) {
+        memcpy(fragment->code, code, code_length);
+        fragment->code[code_length] = '\0';
+        fragment->code_length = code_length;
+    } else {
+        reader->failed = 1;
+    }
+    size_t count = read_count(reader, 3 * sizeof(int32_t));
+    if (count > 0 && !reader->failed) {
+        fragment->data = (FragmentWord *) tagged_malloc(ALLOC_OUTPUT, count * sizeof(FragmentWord));
+        if (!fragment->data) reader->failed = 1;
+    }
+    for (size_t i = 0; i < count && !reader->failed; i++) {
+        fragment->data[i].address = read_int(reader);
+        fragment->data[i].value = read_int(reader);
+        fragment->data[i].relocate_value = read_int(reader);
+        fragment->data_count++;
+    }
+    count = read_count(reader, 2 * sizeof(int32_t));
+    if (count > 0 && !reader->failed) {
+        fragment->frame_events = (FragmentFrameEvent *) tagged_malloc(ALLOC_OUTPUT, count * sizeof(FragmentFrameEvent));
+        if (!fragment->frame_events) reader->failed = 1;
+    }
+    for (size_t i = 0; i < count && !reader->failed; i++) {
+        fragment->frame_events[i].slot = read_int(reader);
+        fragment->frame_events[i].position = read_int(reader);
+        fragment->frame_event_count++;
+    }
+    count = read_count(reader, 4 * sizeof(int32_t) + 2);
+    if (count > 0 && !reader->failed) {
+        fragment->variables = (FragmentVariable *) tagged_calloc(ALLOC_OUTPUT, count, sizeof(FragmentVariable));
+        if (!fragment->variables) reader->failed = 1;
+    }
+    for (size_t i = 0; i < count && !reader->failed; i++) {
+        FragmentVariable *var = &fragment->variables[fragment->variable_count++];
+        var->is_global = read_int(reader);
+        var->block_level = read_int(reader);
+        var->live = read_int(reader);
+        var->address = read_int(reader);
+        var->name = read_string(reader);
+        var->type = read_string(reader);
+    }
+    count = read_count(reader, sizeof(int32_t) + 1);
+    if (count > 0 && !reader->failed) {
+        fragment->imports = (FragmentImport *) tagged_calloc(ALLOC_OUTPUT, count, sizeof(FragmentImport));
+        if (!fragment->imports) reader->failed = 1;
+    }
+    for (size_t i = 0; i < count && !reader->failed; i++) {
+        FragmentImport *import = &fragment->imports[fragment->import_count++];
+        import->ordinal = read_int(reader);
+        import->name = read_string(reader);
+    }
+    if (reader->failed) {
+        statement_fragment_free(fragment);
+        return NULL;
+    }
+    return fragment;
+}
+
+// Заполняет прошлую генерацию из файла; -1, если файл прочитан не целиком
+static int read_fragments(IncrementalState *state, const char *data, size_t length, size_t count) {
+    StateReader reader = {data, length, 0, 0};
+    for (size_t i = 0; i < count; i++) {
+        StatementFragment *fragment = read_fragment(&reader);
+        if (!fragment) return -1;
+        if (table_add(&state->previous, fragment, 0) != 0) {
+            statement_fragment_free(fragment);
+            return -1;
+        }
+    }
+    return reader.pos == length ? 0 : -1;
+}
+
+typedef struct {
+    char *data;
+    size_t length;
+    size_t capacity;
+    int failed;
+} StateWriter;
+
+static void write_bytes(StateWriter *writer, const void *bytes, size_t length) {
+    if (writer->failed) return;
+    if (writer->length + length > writer->capacity) {
+        size_t new_capacity = writer->capacity == 0 ? 4096 : writer->capacity;
+        while (new_capacity < writer->length + length) new_capacity *= 2;
+        char *new_data = (char *) realloc(writer->data, new_capacity);
+        if (!new_data) {
+            writer->failed = 1;
+            return;
+        }
+        writer->data = new_data;
+        writer->capacity = new_capacity;
+    }
+    memcpy(writer->data + writer->length, bytes, length);
+    writer->length += length;
+}
+
+static void write_int(StateWriter *writer, int value) {
+    int32_t stored = (int32_t) value;
+    write_bytes(writer, &stored, sizeof(stored));
+}
+
+static void write_string(StateWriter *writer, const char *s) {
+    write_bytes(writer, s, strlen(s) + 1);
+}
+
+static void write_fragment(StateWriter *writer, const StatementFragment *fragment) {
+    write_bytes(writer, &fragment->key, sizeof(CacheKey));
+    write_int(writer, fragment->memory_size);
+    write_int(writer, fragment->label_count);
+    write_int(writer, (int) fragment->code_length);
+    write_bytes(writer, fragment->code, fragment->code_length);
+    write_int(writer, (int) fragment->data_count);
+    for (size_t i = 0; i < fragment->data_count; i++) {
+        write_int(writer, fragment->data[i].address);
+        write_int(writer, fragment->data[i].value);
+        write_int(writer, fragment->data[i].relocate_value);
+    }
+    write_int(writer, (int) fragment->frame_event_count);
+    for (size_t i = 0; i < fragment->frame_event_count; i++) {
+        write_int(writer, fragment->frame_events[i].slot);
+        write_int(writer, fragment->frame_events[i].position);
+    }
+    write_int(writer, (int) fragment->variable_count);
+    for (size_t i = 0; i < fragment->variable_count; i++) {
+        const FragmentVariable *var = &fragment->variables[i];
+        write_int(writer, var->is_global);
+        write_int(writer, var->block_level);
+        write_int(writer, var->live);
+        write_int(writer, var->address);
+        write_string(writer, var->name);
+        write_string(writer, var->type);
+    }
+    write_int(writer, (int) fragment->import_count);
+    for (size_t i = 0; i < fragment->import_count; i++) {
+        write_int(writer, fragment->imports[i].ordinal);
+        write_string(writer, fragment->imports[i].name);
+    }
+}
+
+// Переименование с заменой существующего файла
+static int replace_file(const char *from, const char *to) {
+#ifdef _WIN32
+    return MoveFileExA(from, to, MOVEFILE_REPLACE_EXISTING) ? 0 : -1;
+#else
+    return rename(from, to);
+#endif
+}
+
+int incremental_state_save(const IncrementalState *state, const char *filename) {
+    StateWriter writer = {NULL, 0, 0, 0};
+    for (size_t i = 0; i < state->previous.count; i++) {
+        write_fragment(&writer, state->previous.items[i]);
+    }
+    if (writer.failed) {
+        free(writer.data);
+        return -1;
+    }
+    StateHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, STATE_MAGIC, sizeof(header.magic));
+    header.version = STATE_VERSION;
+    header.pass_mask = state->pass_mask;
+    header.fragment_count = (uint32_t) state->previous.count;
+    header.payload_length = writer.length;
+    compile_cache_key_init(&header.checksum);
+    compile_cache_key_add(&header.checksum, writer.data, writer.length);
+
+    // Файл пишется целиком под временным именем и заменяет прежний одним переименованием
+    size_t name_length = strlen(filename);
+    char *temp = (char *) malloc(name_length + 5);
+    if (!temp) {
+        free(writer.data);
+        return -1;
+    }
+    memcpy(temp, filename, name_length);
+    strcpy(temp + name_length, ".tmp");
+    FILE *fp = fopen(temp, "wb");
+    int status = -1;
+    if (fp) {
+        status = fwrite(&header, sizeof(header), 1, fp) == 1 &&
+                 (writer.length == 0 || fwrite(writer.data, writer.length, 1, fp) == 1) ? 0 : -1;
+        if (fclose(fp) != 0) status = -1;
+        if (status == 0 && replace_file(temp, filename) != 0) status = -1;
+        if (status != 0) remove(temp);
+    }
+    free(temp);
+    free(writer.data);
+    return status;
+}
+
+IncrementalState *incremental_state_load(const char *filename, unsigned pass_mask) {
+    IncrementalState *state = (IncrementalState *) calloc(1, sizeof(IncrementalState));
+    if (!state) return NULL;
+    state->pass_mask = pass_mask;
+    SourceBuffer file;
+    if (source_buffer_open(&file, filename) != 0) return state;
+    StateHeader header;
+    if (file.length >= sizeof(header)) {
+        memcpy(&header, file.data, sizeof(header));
+        CacheKey checksum;
+        compile_cache_key_init(&checksum);
+        if (memcmp(header.magic, STATE_MAGIC, sizeof(header.magic)) == 0 && header.version == STATE_VERSION &&
+            header.pass_mask == pass_mask && header.payload_length == file.length - sizeof(header)) {
+            compile_cache_key_add(&checksum, file.data + sizeof(header), (size_t) header.payload_length);
+            if (checksum.high == header.checksum.high && checksum.low == header.checksum.low &&
+                read_fragments(state, file.data + sizeof(header), (size_t) header.payload_length,
+                               header.fragment_count) != 0) {
+                table_free(&state->previous);
+            }
+        }
+    }
+    source_buffer_close(&file);
+    return state;
+}
@@ -0,0 +1,105 @@
+#ifndef INCREMENTAL_H
+#define INCREMENTAL_H
+
+#include <stddef.h>
+#include "../ast/ast.h"
+#include "../compile_cache.h"
+
+/**
+ * Код одного оператора верхнего уровня в перемещаемом виде (как участок
+ * параллельной генерации): собственные ячейки от 0, метки от 0, ячейки
+ * кадра по номеру. Обращения к переменным предыдущих операторов записаны
+ * как REGION_EXTERN_BASE + номер импорта; импорт — имя и порядковый номер
+ * среди объявлений с этим именем, поэтому фрагмент не зависит от того,
+ * сколько объявлений стоит перед ним.
+ */
+typedef struct {
+    char *name;
+    char *type;
+    int is_global;
+    int block_level;
+    int live;
+    int address;                // перемещаемый адрес
+} FragmentVariable;
+
+typedef struct {
+    char *name;
+    int ordinal;
+} FragmentImport;
+
+typedef struct {
+    int address;
+    int value;
+    int relocate_value;
+} FragmentWord;
+
+typedef struct {
+    int slot;
+    int position;
+} FragmentFrameEvent;
+
+typedef struct {
+    CacheKey key;               // отпечаток оператора и нужных ему объявлений
+    char *code;                 // строки листинга через '\n' с пометками перемещения
+    size_t code_length;
+    FragmentWord *data;         // слова образа данных
+    size_t data_count;
+    FragmentFrameEvent *frame_events;
+    size_t frame_event_count;
+    FragmentVariable *variables;    // объявления оператора по порядку
+    size_t variable_count;
+    FragmentImport *imports;
+    size_t import_count;
+    int memory_size;            // собственных ячеек
+    int label_count;
+} StatementFragment;
+
+/**
+ * Фрагменты прошлой компиляции программы. Генератор кода берёт из него
+ * фрагменты операторов, у которых совпал отпечаток, и генерирует заново
+ * только изменившиеся операторы и те, что зависят от изменившихся объявлений.
+ */
+typedef struct IncrementalState IncrementalState;
+
+/**
+ * Читает состояние из файла. Отсутствующий, повреждённый или записанный
+ * другой сборкой или с другим набором проходов файл даёт пустое состояние.
+ * @param pass_mask pass_manager_enabled_mask текущей компиляции
+ * @return NULL только при нехватке памяти
+ */
+IncrementalState *incremental_state_load(const char *filename, unsigned pass_mask);
+
+// Записывает фрагменты последней успешной генерации; 0 при успехе
+int incremental_state_save(const IncrementalState *state, const char *filename);
+
+void incremental_state_free(IncrementalState *state);
+
+// Операторов, взятых из состояния и сгенерированных заново при последней генерации
+void incremental_state_get_stats(const IncrementalState *state, long *reused, long *regenerated);
+
+/**
+ * Отпечаток оператора: вид, строки и числа всех узлов поддерева.
+ * Имена переменных, которые упоминает оператор, дописываются в names.
+ * @return 0 при успехе, -1 при нехватке памяти
+ */
+int incremental_fingerprint(const ASTNode *statement, CacheKey *key,
+                            const char ***names, size_t *name_count, size_t *name_capacity);
+
+// Для генератора кода: фрагменты новой генерации собираются отдельно от прошлых
+void incremental_state_begin(IncrementalState *state);
+
+/**
+ * Фрагмент с ключом из текущей генерации или прошлой компиляции.
+ * Фрагмент прошлой компиляции переходит в текущую.
+ */
+const StatementFragment *incremental_state_find(IncrementalState *state, const CacheKey *key);
+
+// Добавляет сгенерированный фрагмент в текущую генерацию; -1 при нехватке памяти
+int incremental_state_add(IncrementalState *state, StatementFragment *fragment);
+
+// Генерация удалась: её фрагменты заменяют прошлые. Иначе прошлые остаются
+void incremental_state_finish(IncrementalState *state, int success);
+
+void statement_fragment_free(StatementFragment *fragment);
+
+#endif /* INCREMENTAL_H */
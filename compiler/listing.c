@@ -0,0 +1,103 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "listing.h"
+#include "../tagged_alloc.h"
+
+static const char *mnemonics[] = {
+    "li", "lw", "sw", "add", "addi", "sub", "mul", "div", "rem",
+    "slt", "sge", "seq", "sne", "xori", "and", "or",
+    "beq", "bne", "blt", "bge", "jal", "ewrite", "ebreak", NULL
+};
+
+int listing_is_label(const char *line) {
+    size_t len = strlen(line);
+    if (len < 2 || line[len - 1] != ':') return 0;
+    for (size_t i = 0; i + 1 < len; i++) {
+        if (line[i] == ' ' || line[i] == '\t' || line[i] == ',') return 0;
+    }
+    return 1;
+}
+
+int listing_is_instruction(const char *line) {
+    char op[16];
+    if (sscanf(line, "%15s", op) != 1) return 0;
+    for (int i = 0; mnemonics[i]; i++) {
+        if (strcmp(op, mnemonics[i]) == 0) return 1;
+    }
+    return 0;
+}
+
+int listing_parse_jump(const char *line, char *target, size_t size) {
+    char op[8], rd[16], fmt[32];
+    snprintf(fmt, sizeof(fmt), "%%7s %%15[^,], %%%zu[^ #]", size - 1);
+    if (sscanf(line, fmt, op, rd, target) != 3) return 0;
+    return strcmp(op, "jal") == 0 && strcmp(rd, "x0") == 0;
+}
+
+int listing_parse_branch(const char *line, char *op, char *r1, char *r2, char *target, size_t size) {
+    char fmt[48];
+    snprintf(fmt, sizeof(fmt), "%%7s %%15[^,], %%15[^,], %%%zu[^ #]", size - 1);
+    if (sscanf(line, fmt, op, r1, r2, target) != 4) return 0;
+    return strcmp(op, "beq") == 0 || strcmp(op, "bne") == 0 ||
+           strcmp(op, "blt") == 0 || strcmp(op, "bge") == 0;
+}
+
+int listing_branch_target(const char *line, char *target, size_t size) {
+    char op[8], r1[16], r2[16];
+    return listing_parse_jump(line, target, size) ||
+           listing_parse_branch(line, op, r1, r2, target, size);
+}
+
+size_t listing_compact(char **lines, size_t count) {
+    size_t kept = 0;
+    for (size_t i = 0; i < count; i++) {
+        if (lines[i]) lines[kept++] = lines[i];
+    }
+    return kept;
+}
+
+static unsigned long hash_name(const char *name, size_t len) {
+    unsigned long h = 2166136261u;
+    for (size_t i = 0; i < len; i++) {
+        h = (h ^ (unsigned char) name[i]) * 16777619u;
+    }
+    return h;
+}
+
+static int label_matches(const char *line, const char *name, size_t len) {
+    return strncmp(line, name, len) == 0 && line[len] == ':' && line[len + 1] == '\0';
+}
+
+int label_index_build(LabelIndex *index, char **lines, size_t count) {
+    size_t capacity = 64;
+    while (capacity < count * 2) capacity *= 2;
+    index->slots = (size_t *) tagged_malloc(ALLOC_TEMP, capacity * sizeof(size_t));
+    if (!index->slots) return -1;
+    index->capacity = capacity;
+    for (size_t i = 0; i < capacity; i++) index->slots[i] = (size_t) -1;
+    for (size_t i = 0; i < count; i++) {
+        if (!lines[i] || !listing_is_label(lines[i])) continue;
+        size_t pos = hash_name(lines[i], strlen(lines[i]) - 1) & (capacity - 1);
+        while (index->slots[pos] != (size_t) -1) pos = (pos + 1) & (capacity - 1);
+        index->slots[pos] = i;
+    }
+    return 0;
+}
+
+size_t label_index_find(const LabelIndex *index, char **lines, const char *name) {
+    size_t len = strlen(name);
+    size_t pos = hash_name(name, len) & (index->capacity - 1);
+    while (index->slots[pos] != (size_t) -1) {
+        size_t i = index->slots[pos];
+        if (lines[i] && label_matches(lines[i], name, len)) return i;
+        pos = (pos + 1) & (index->capacity - 1);
+    }
+    return (size_t) -1;
+}
+
+void label_index_free(LabelIndex *index) {
+    tagged_free(ALLOC_TEMP, index->slots);
+    index->slots = NULL;
+    index->capacity = 0;
+}
@@ -0,0 +1,45 @@
+#ifndef LISTING_H
+#define LISTING_H
+
+#include <stddef.h>
+
+// Листинг RISC-кода: строки выделены через malloc, удалённая строка — NULL
+typedef struct {
+    char **lines;
+    size_t count;
+} RiscListing;
+
+// Индекс меток листинга: имя метки -> номер строки
+typedef struct {
+    size_t *slots;
+    size_t capacity;
+} LabelIndex;
+
+// Строка-метка вида "__while_0:"
+int listing_is_label(const char *line);
+
+int listing_is_instruction(const char *line);
+
+// jal x0, L — безусловный переход
+int listing_parse_jump(const char *line, char *target, size_t size);
+
+// bXX r1, r2, L — условный переход
+int listing_parse_branch(const char *line, char *op, char *r1, char *r2, char *target, size_t size);
+
+// Метка, на которую ссылается переход или ветвление
+int listing_branch_target(const char *line, char *target, size_t size);
+
+// Удаляет NULL-строки, возвращает новое количество строк
+size_t listing_compact(char **lines, size_t count);
+
+int label_index_build(LabelIndex *index, char **lines, size_t count);
+
+/**
+ * Ищет строку с меткой name.
+ * @return Номер первой такой строки или (size_t) -1
+ */
+size_t label_index_find(const LabelIndex *index, char **lines, const char *name);
+
+void label_index_free(LabelIndex *index);
+
+#endif /* LISTING_H */
@@ -0,0 +1,293 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "pass_manager.h"
+#include "block_layout.h"
+#include "../time_report.h"
+#include "../tagged_alloc.h"
+
+// Анализы листинга
+#define ANALYSIS_LABELS     (1u << 0)   // индекс меток
+#define ANALYSIS_LABEL_REFS (1u << 1)   // множество меток, на которые есть переходы
+#define ANALYSIS_ALL        (ANALYSIS_LABELS | ANALYSIS_LABEL_REFS)
+
+#define LEVEL(level) (1u << (level))
+#define LEVELS_OPT (LEVEL(OPT_LEVEL_1) | LEVEL(OPT_LEVEL_2))
+#define LEVELS_ALL (LEVELS_OPT | LEVEL(OPT_LEVEL_S))
+
+typedef struct {
+    char **names;
+    size_t capacity;
+} LabelRefs;
+
+// Настройки проходов; во время компиляции только читаются
+struct PassManager {
+    OptLevel level;
+    int overrides[PASS_COUNT];  // -1 — по уровню, иначе явное значение
+    int verify;                 // проверять листинг между проходами
+};
+
+// Кэш анализов одного запуска конвейера над одним листингом
+typedef struct {
+    unsigned valid;             // какие анализы актуальны
+    LabelIndex labels;
+    LabelRefs refs;
+} AnalysisCache;
+
+typedef struct {
+    const char *name;
+    PassKind kind;
+    unsigned levels;            // уровни, на которых проход включён
+    unsigned requires;          // анализы, нужные проходу
+    unsigned invalidates;       // анализы, которые проход портит
+    void (*run)(AnalysisCache *cache, RiscListing *listing);
+} PassInfo;
+
+static void run_block_layout(AnalysisCache *cache, RiscListing *listing);
+static void run_dead_labels(AnalysisCache *cache, RiscListing *listing);
+
+// Порядок совпадает с PassId и задаёт порядок выполнения
+static const PassInfo passes[PASS_COUNT] = {
+    {"loop-rotate",  PASS_KIND_CODEGEN, LEVELS_OPT,             0, 0, NULL},
+    {"slot-reuse",   PASS_KIND_CODEGEN, LEVELS_ALL,             0, 0, NULL},
+    {"static-data",  PASS_KIND_CODEGEN, LEVELS_ALL,             0, 0, NULL},
+    {"partial-eval", PASS_KIND_PROGRAM, LEVEL(OPT_LEVEL_2),     0, 0, NULL},
+    {"block-layout", PASS_KIND_LISTING, LEVELS_ALL,
+        ANALYSIS_LABELS, ANALYSIS_ALL, run_block_layout},
+    {"dead-labels",  PASS_KIND_LISTING, LEVEL(OPT_LEVEL_2) | LEVEL(OPT_LEVEL_S),
+        ANALYSIS_LABEL_REFS, ANALYSIS_ALL, run_dead_labels},
+};
+
+static const char *level_names[] = {"-O0", "-O1", "-O2", "-Os"};
+
+PassManager *pass_manager_create(OptLevel level) {
+    PassManager *pm = (PassManager *) malloc(sizeof(PassManager));
+    if (!pm) return NULL;
+    pm->level = level;
+    for (int i = 0; i < PASS_COUNT; i++) pm->overrides[i] = -1;
+    pm->verify = 0;
+    return pm;
+}
+
+static void free_label_refs(LabelRefs *refs) {
+    for (size_t i = 0; i < refs->capacity; i++) {
+        tagged_free(ALLOC_TEMP, refs->names[i]);
+    }
+    tagged_free(ALLOC_TEMP, refs->names);
+    refs->names = NULL;
+    refs->capacity = 0;
+}
+
+static void invalidate(AnalysisCache *cache, unsigned analyses) {
+    if ((analyses & ANALYSIS_LABELS) && (cache->valid & ANALYSIS_LABELS)) {
+        label_index_free(&cache->labels);
+    }
+    if ((analyses & ANALYSIS_LABEL_REFS) && (cache->valid & ANALYSIS_LABEL_REFS)) {
+        free_label_refs(&cache->refs);
+    }
+    cache->valid &= ~analyses;
+}
+
+void pass_manager_free(PassManager *pm) {
+    free(pm);
+}
+
+void pass_manager_set_level(PassManager *pm, OptLevel level) {
+    pm->level = level;
+}
+
+void pass_manager_set_verify(PassManager *pm, int enabled) {
+    pm->verify = enabled;
+}
+
+static int find_pass(const char *name) {
+    for (int i = 0; i < PASS_COUNT; i++) {
+        if (strcmp(passes[i].name, name) == 0) return i;
+    }
+    return -1;
+}
+
+int pass_manager_set_enabled(PassManager *pm, const char *name, int enabled) {
+    int id = find_pass(name);
+    if (id < 0) return -1;
+    pm->overrides[id] = enabled ? 1 : 0;
+    return 0;
+}
+
+int pass_manager_parse_option(PassManager *pm, const char *arg) {
+    if (strncmp(arg, "-O", 2) == 0) {
+        for (int level = OPT_LEVEL_0; level <= OPT_LEVEL_S; level++) {
+            if (strcmp(arg, level_names[level]) == 0) {
+                pm->level = (OptLevel) level;
+                return 1;
+            }
+        }
+        return -1;
+    }
+    // Проверка листинга не меняет код, поэтому она не проход и не входит в enabled_mask
+    if (strcmp(arg, "-fverify-ir") == 0 || strcmp(arg, "-fno-verify-ir") == 0) {
+        pm->verify = arg[2] != 'n';
+        return 1;
+    }
+    if (strncmp(arg, "-fno-", 5) == 0) {
+        return pass_manager_set_enabled(pm, arg + 5, 0) == 0 ? 1 : -1;
+    }
+    if (strncmp(arg, "-f", 2) == 0) {
+        return pass_manager_set_enabled(pm, arg + 2, 1) == 0 ? 1 : -1;
+    }
+    return 0;
+}
+
+int pass_manager_is_enabled(const PassManager *pm, PassId id) {
+    if (id < 0 || id >= PASS_COUNT) return 0;
+    if (!pm) return (passes[id].levels & LEVEL(OPT_LEVEL_1)) != 0;
+    if (pm->overrides[id] >= 0) return pm->overrides[id];
+    return (passes[id].levels & LEVEL(pm->level)) != 0;
+}
+
+unsigned pass_manager_enabled_mask(const PassManager *pm) {
+    unsigned mask = 0;
+    for (int i = 0; i < PASS_COUNT; i++) {
+        if (pass_manager_is_enabled(pm, (PassId) i)) mask |= 1u << i;
+    }
+    return mask;
+}
+
+static unsigned long hash_name(const char *name) {
+    unsigned long h = 2166136261u;
+    for (const char *p = name; *p; p++) {
+        h = (h ^ (unsigned char) *p) * 16777619u;
+    }
+    return h;
+}
+
+static int build_label_refs(LabelRefs *refs, RiscListing *listing) {
+    char target[256];
+    size_t capacity = 64;
+    while (capacity < listing->count * 2) capacity *= 2;
+    refs->names = (char **) tagged_calloc(ALLOC_TEMP, capacity, sizeof(char *));
+    if (!refs->names) return -1;
+    refs->capacity = capacity;
+    for (size_t i = 0; i < listing->count; i++) {
+        if (!listing->lines[i] || !listing_branch_target(listing->lines[i], target, sizeof(target))) {
+            continue;
+        }
+        size_t pos = hash_name(target) & (capacity - 1);
+        while (refs->names[pos] && strcmp(refs->names[pos], target) != 0) {
+            pos = (pos + 1) & (capacity - 1);
+        }
+        if (!refs->names[pos]) refs->names[pos] = tagged_strdup(ALLOC_TEMP, target);
+    }
+    return 0;
+}
+
+static int label_is_referenced(const LabelRefs *refs, const char *name) {
+    size_t pos = hash_name(name) & (refs->capacity - 1);
+    while (refs->names[pos]) {
+        if (strcmp(refs->names[pos], name) == 0) return 1;
+        pos = (pos + 1) & (refs->capacity - 1);
+    }
+    return 0;
+}
+
+// Анализ считается заново только если он не актуален
+static int require_analyses(AnalysisCache *cache, RiscListing *listing, unsigned analyses) {
+    unsigned missing = analyses & ~cache->valid;
+    if (missing & ANALYSIS_LABELS) {
+        if (label_index_build(&cache->labels, listing->lines, listing->count) != 0) return -1;
+        cache->valid |= ANALYSIS_LABELS;
+    }
+    if (missing & ANALYSIS_LABEL_REFS) {
+        if (build_label_refs(&cache->refs, listing) != 0) return -1;
+        cache->valid |= ANALYSIS_LABEL_REFS;
+    }
+    return 0;
+}
+
+static void run_block_layout(AnalysisCache *cache, RiscListing *listing) {
+    listing->count = block_layout(listing->lines, listing->count, &cache->labels);
+}
+
+// Метки без входящих переходов не нужны: на них только проваливаются
+static void run_dead_labels(AnalysisCache *cache, RiscListing *listing) {
+    for (size_t i = 0; i < listing->count; i++) {
+        char *line = listing->lines[i];
+        if (!line || !listing_is_label(line)) continue;
+        line[strlen(line) - 1] = '\0';
+        int referenced = label_is_referenced(&cache->refs, line);
+        line[strlen(line)] = ':';
+        if (!referenced) {
+            tagged_free(ALLOC_OUTPUT, line);
+            listing->lines[i] = NULL;
+        }
+    }
+    listing->count = listing_compact(listing->lines, listing->count);
+}
+
+// Каждая метка определена один раз, каждый переход ведёт на существующую метку
+static void verify_listing(AnalysisCache *cache, RiscListing *listing, const char *stage) {
+    char target[256];
+    const char *problem = NULL;
+    size_t at = 0;
+    if (require_analyses(cache, listing, ANALYSIS_LABELS) != 0) return;
+    for (size_t i = 0; i < listing->count && !problem; i++) {
+        const char *line = listing->lines[i];
+        at = i;
+        if (!line) {
+            problem = "missing line";
+        } else if (listing_is_label(line)) {
+            snprintf(target, sizeof(target), "%.*s", (int) (strlen(line) - 1), line);
+            if (label_index_find(&cache->labels, listing->lines, target) != i) {
+                problem = "duplicate label";
+            }
+        } else if (listing_branch_target(line, target, sizeof(target))) {
+            if (label_index_find(&cache->labels, listing->lines, target) == (size_t) -1) {
+                problem = "jump to undefined label";
+            }
+        }
+    }
+    if (problem) {
+        fprintf(stderr, "IR verification failed after %s: %s at line %zu: %s\n",
+                stage, problem, at + 1, listing->lines[at] ? listing->lines[at] : "(null)");
+        abort();
+    }
+}
+
+void pass_manager_run_listing(const PassManager *pm, RiscListing *listing) {
+    AnalysisCache cache;
+    cache.valid = 0;
+    int verify = pm && pm->verify;
+    if (verify) {
+        TIME_REPORT_BEGIN("verify");
+        verify_listing(&cache, listing, "code generation");
+        TIME_REPORT_END();
+    }
+    for (int i = 0; i < PASS_COUNT; i++) {
+        if (passes[i].kind != PASS_KIND_LISTING || !pass_manager_is_enabled(pm, (PassId) i)) {
+            continue;
+        }
+        // Время прохода включает построение нужных ему анализов
+        TIME_REPORT_BEGIN(passes[i].name);
+        if (require_analyses(&cache, listing, passes[i].requires) == 0) {
+            passes[i].run(&cache, listing);
+            invalidate(&cache, passes[i].invalidates);
+        }
+        TIME_REPORT_END();
+        if (verify) {
+            TIME_REPORT_BEGIN("verify");
+            verify_listing(&cache, listing, passes[i].name);
+            TIME_REPORT_END();
+        }
+    }
+    invalidate(&cache, ANALYSIS_ALL);
+}
+
+void pass_manager_print(const PassManager *pm, FILE *out) {
+    static const char *kind_names[] = {"codegen", "program", "listing"};
+    fprintf(out, "Optimization level: %s\n", level_names[pm ? pm->level : OPT_LEVEL_1]);
+    for (int i = 0; i < PASS_COUNT; i++) {
+        fprintf(out, "  %-14s %-8s %s\n", passes[i].name, kind_names[passes[i].kind],
+                pass_manager_is_enabled(pm, (PassId) i) ? "on" : "off");
+    }
+    fprintf(out, "  %-14s %-8s %s\n", "verify-ir", "check", pm && pm->verify ? "on" : "off");
+}
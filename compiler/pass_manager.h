@@ -0,0 +1,74 @@
+#ifndef PASS_MANAGER_H
+#define PASS_MANAGER_H
+
+#include <stdio.h>
+#include "listing.h"
+
+// Уровни оптимизации
+typedef enum {
+    OPT_LEVEL_0,    // -O0: прямолинейная генерация без оптимизаций
+    OPT_LEVEL_1,    // -O1: уровень по умолчанию
+    OPT_LEVEL_2,    // -O2: плюс вычисление при компиляции
+    OPT_LEVEL_S     // -Os: минимальный размер кода
+} OptLevel;
+
+// Зарегистрированные проходы
+typedef enum {
+    PASS_LOOP_ROTATE,   // генерация: while в форме guarded do-while
+    PASS_SLOT_REUSE,    // генерация: переиспользование ячеек блочных переменных
+    PASS_STATIC_DATA,   // генерация: константные инициализаторы в .data
+    PASS_PARTIAL_EVAL,  // программа: вычисление при компиляции
+    PASS_BLOCK_LAYOUT,  // листинг: раскладка базовых блоков
+    PASS_DEAD_LABELS,   // листинг: удаление меток без переходов на них
+    PASS_COUNT
+} PassId;
+
+typedef enum {
+    PASS_KIND_CODEGEN,  // меняет способ генерации кода
+    PASS_KIND_PROGRAM,  // работает над AST программы целиком
+    PASS_KIND_LISTING   // преобразует готовый листинг
+} PassKind;
+
+typedef struct PassManager PassManager;
+
+PassManager *pass_manager_create(OptLevel level);
+
+void pass_manager_free(PassManager *pm);
+
+void pass_manager_set_level(PassManager *pm, OptLevel level);
+
+/**
+ * Явно включает или выключает проход; явная настройка сильнее уровня
+ * независимо от порядка флагов.
+ * @return 0 при успехе, -1 если прохода с таким именем нет
+ */
+int pass_manager_set_enabled(PassManager *pm, const char *name, int enabled);
+
+// Проверка листинга после генерации и после каждого прохода (-fverify-ir); по умолчанию выключена
+void pass_manager_set_verify(PassManager *pm, int enabled);
+
+/**
+ * Разбирает флаг командной строки: -O0, -O1, -O2, -Os, -f<проход>, -fno-<проход>,
+ * -fverify-ir и -fno-verify-ir.
+ * @return 1 если флаг распознан, 0 если это не флаг оптимизации,
+ *         -1 если флаг оптимизации некорректен
+ */
+int pass_manager_parse_option(PassManager *pm, const char *arg);
+
+// pm == NULL означает уровень -O1 без явных настроек
+int pass_manager_is_enabled(const PassManager *pm, PassId id);
+
+// Набор включённых проходов (бит 1 << PassId): одинаковый набор даёт одинаковый код
+unsigned pass_manager_enabled_mask(const PassManager *pm);
+
+/**
+ * Выполняет включённые проходы над листингом в порядке регистрации.
+ * Анализы кэшируются между проходами, пока проход их не инвалидирует.
+ * pm только читается, поэтому один менеджер можно использовать из разных потоков.
+ * С -fverify-ir листинг проверяется после каждого прохода; ошибка останавливает компилятор.
+ */
+void pass_manager_run_listing(const PassManager *pm, RiscListing *listing);
+
+void pass_manager_print(const PassManager *pm, FILE *out);
+
+#endif /* PASS_MANAGER_H */
@@ -2,14 +2,53 @@
 #include <stdlib.h>
 #include <string.h>
 #include "risc_generator.h"
+#include "pass_manager.h"
+#include "evaluator.h"
+#include "incremental.h"
+#include "listing.h"
 #include "../ast/ast.h"
 #include "../error_handler.h"
+#include "../compile_context.h"
+#include "../thread_pool.h"
+#include "../time_report.h"
+#include "../tagged_alloc.h"
 extern int get_current_line(void);
 extern int get_current_column(void);
 extern const char* get_parser_filename(void);
 
 // Прототипы функций
 
+// Состояние области видимости на момент входа в блок
+typedef struct {
+    int block_level;
+    int scope_is_global;
+    size_t var_count;
+    size_t frame_top;
+} ScopeMark;
+
+// Кадр обхода выражения (см. evaluate_expression): stage — сколько
+// операндов уже вычислено
+typedef struct {
+    ASTNode *node;
+    const char *target_reg;
+    const char *left_reg;
+    const char *right_reg;
+    const char *left_type;
+    const char *right_type;
+    int stage;
+} ExpressionFrame;
+
+// Кадр обхода операторов (см. process_node): index — следующий оператор
+// блока, labels и address — метки и адрес переменной цикла между стадиями
+typedef struct {
+    ASTNode *node;
+    int stage;
+    size_t index;
+    ScopeMark mark;
+    int address;
+    char *labels[3];
+} StatementFrame;
+
 typedef struct {
     char **output;
     size_t output_size;
@@ -19,10 +58,10 @@ typedef struct {
         char *type;
         int is_global;
         int block_level;
+        int live;
     } *variables;
     size_t var_count;
     size_t var_capacity;
-    int temp_counter;
     int label_counter;
     int data_counter;
     int block_level;
@@ -34,18 +73,68 @@ typedef struct {
     } *var_addresses;
     size_t addr_count;
     size_t addr_capacity;
+    // Кадр переиспользуемых ячеек для блочных переменных lim
+    int *frame_slots;
+    size_t frame_size;
+    size_t frame_capacity;
+    size_t frame_top;
+    // Образ статических данных: слова, заполненные до старта программы;
+    // relocate_value — значение является адресом участка (см. add_data_address)
+    FragmentWord *data;
+    size_t data_count;
+    size_t data_capacity;
+    // Проходы, влияющие на генерацию кода
+    int rotate_loops;
+    int reuse_slots;
+    int static_data;
+    // Позиция оператора, к которому относятся выводимые команды, и последняя
+    // выведенная строкой .loc (при line_info)
+    int line_info;
+    int location_line;
+    int location_column;
+    int emitted_line;
+    int emitted_column;
     char current_file[256];
     int current_scope_is_global;
+    // Участок программы при параллельной генерации: адреса и номера меток
+    // локальные и выводятся с пометкой, которую заменяет relocate_line
+    int relocatable;
+    // Первые shared_count переменных и адресов взяты из таблицы предыдущих
+    // участков: имена принадлежат ей и здесь не освобождаются
+    size_t shared_count;
+    // Новые ячейки кадра в порядке выделения: номер ячейки и memory_pos на тот момент
+    FragmentFrameEvent *frame_events;
+    size_t frame_event_count;
+    size_t frame_event_capacity;
+    // Явные стеки обхода: глубина AST не ограничена стеком потока
+    ExpressionFrame *expr_stack;
+    size_t expr_count;
+    size_t expr_capacity;
+    StatementFrame *stmt_stack;
+    size_t stmt_count;
+    size_t stmt_capacity;
 } RISCGenerator;
 
+// Кодировка адресов участка: ниже REGION_FRAME_BASE — собственные ячейки
+// участка от 0, затем ячейки кадра по номеру и переменные предыдущих
+// участков по порядку объявления
+#define REGION_FRAME_BASE (1 << 29)
+#define REGION_EXTERN_BASE (1 << 30)
+// Пометка в тексте участка: RELOC_MARK, вид ('A' — адрес, 'L' — метка), число, RELOC_MARK
+#define RELOC_MARK '\x01'
+#define RELOC_TEXT_SIZE 24
+// Участки короче не выгодно отдавать другому потоку
+#define REGION_MIN_STATEMENTS 128
+#define REGIONS_PER_THREAD 4
+
 static void register_variable(RISCGenerator *gen, const char *name, const char *type, int is_global);
-static int register_variable_address(RISCGenerator *gen, const char *name);
+static int register_variable_address(RISCGenerator *gen, const char *name, int in_frame);
 static void process_variable_declaration(RISCGenerator *gen, ASTNode *node);
 static void process_assignment(RISCGenerator *gen, ASTNode *node);
-static void process_if_statement(RISCGenerator *gen, ASTNode *node);
-static void process_while_loop(RISCGenerator *gen, ASTNode *node);
-static void process_round_loop(RISCGenerator *gen, ASTNode *node);
 static void process_print(RISCGenerator *gen, ASTNode *node);
+static int if_statement_step(RISCGenerator *gen, StatementFrame *frame, ASTNode **child);
+static int while_loop_step(RISCGenerator *gen, StatementFrame *frame, ASTNode **child);
+static int round_loop_step(RISCGenerator *gen, StatementFrame *frame, ASTNode **child);
 static void evaluate_expression(RISCGenerator *gen, ASTNode *node, const char *target_reg);
 static int add_string_literal(RISCGenerator *gen, const char *str);
 static int concatenate_strings(RISCGenerator *gen, const char *reg1, const char *reg2);
@@ -53,19 +142,42 @@ static int is_string_variable(RISCGenerator *gen, const char *name);
 static int declare_variable(RISCGenerator *gen, const char *name, const char *type, int is_global);
 static int check_division_by_zero(RISCGenerator *gen, ASTNode *left, ASTNode *right, const char *op);
 
-static char current_filename[256] = "unknown";
-
+// Настройки генератора хранятся в контексте компиляции текущего потока
 void set_risc_generator_filename(const char *filename) {
+    CompileContext *ctx = compile_context_current();
     if (filename) {
-        strncpy(current_filename, filename, sizeof(current_filename) - 1);
-        current_filename[sizeof(current_filename) - 1] = '\0';
+        strncpy(ctx->filename, filename, sizeof(ctx->filename) - 1);
+        ctx->filename[sizeof(ctx->filename) - 1] = '\0';
     } else {
-        strcpy(current_filename, "unknown");
+        strcpy(ctx->filename, "unknown");
     }
 }
 
+void set_risc_generator_eval_budget(long max_steps, size_t max_memory) {
+    CompileContext *ctx = compile_context_current();
+    ctx->eval_budget.max_steps = max_steps;
+    ctx->eval_budget.max_memory = max_memory;
+}
+
+void set_risc_generator_pass_manager(const PassManager *pm) {
+    compile_context_current()->pass_manager = pm;
+}
+
+void set_risc_generator_threads(int threads) {
+    compile_context_current()->codegen_threads = threads;
+}
+
+void set_risc_generator_line_info(int enabled) {
+    compile_context_current()->line_info = enabled;
+}
+
+void set_risc_generator_incremental(IncrementalState *state) {
+    compile_context_current()->incremental = state;
+}
+
 static RISCGenerator *init_generator(const char *filename) {
-    RISCGenerator *gen = (RISCGenerator *) malloc(sizeof(RISCGenerator));
+    const PassManager *pass_manager = compile_context_current()->pass_manager;
+    RISCGenerator *gen = (RISCGenerator *) tagged_malloc(ALLOC_TEMP, sizeof(RISCGenerator));
     if (!gen) return NULL;
     gen->output = NULL;
     gen->output_size = 0;
@@ -73,7 +185,6 @@ static RISCGenerator *init_generator(const char *filename) {
     gen->variables = NULL;
     gen->var_count = 0;
     gen->var_capacity = 0;
-    gen->temp_counter = 0;
     gen->label_counter = 0;
     gen->data_counter = 0;
     gen->block_level = 0;
@@ -82,6 +193,21 @@ static RISCGenerator *init_generator(const char *filename) {
     gen->var_addresses = NULL;
     gen->addr_count = 0;
     gen->addr_capacity = 0;
+    gen->frame_slots = NULL;
+    gen->frame_size = 0;
+    gen->frame_capacity = 0;
+    gen->frame_top = 0;
+    gen->data = NULL;
+    gen->data_count = 0;
+    gen->data_capacity = 0;
+    gen->rotate_loops = pass_manager_is_enabled(pass_manager, PASS_LOOP_ROTATE);
+    gen->reuse_slots = pass_manager_is_enabled(pass_manager, PASS_SLOT_REUSE);
+    gen->static_data = pass_manager_is_enabled(pass_manager, PASS_STATIC_DATA);
+    gen->line_info = compile_context_current()->line_info;
+    gen->location_line = 0;
+    gen->location_column = 0;
+    gen->emitted_line = 0;
+    gen->emitted_column = 0;
     if (filename) {
         strncpy(gen->current_file, filename, sizeof(gen->current_file) - 1);
         gen->current_file[sizeof(gen->current_file) - 1] = '\0';
@@ -89,6 +215,17 @@ static RISCGenerator *init_generator(const char *filename) {
         strcpy(gen->current_file, "unknown");
     }
     gen->current_scope_is_global = 1;
+    gen->relocatable = 0;
+    gen->shared_count = 0;
+    gen->frame_events = NULL;
+    gen->frame_event_count = 0;
+    gen->frame_event_capacity = 0;
+    gen->expr_stack = NULL;
+    gen->expr_count = 0;
+    gen->expr_capacity = 0;
+    gen->stmt_stack = NULL;
+    gen->stmt_count = 0;
+    gen->stmt_capacity = 0;
     error_init();
     return gen;
 }
@@ -96,52 +233,112 @@ static RISCGenerator *init_generator(const char *filename) {
 static void free_generator(RISCGenerator *gen) {
     if (gen->output) {
         for (size_t i = 0; i < gen->output_size; i++) {
-            free(gen->output[i]);
+            tagged_free(ALLOC_OUTPUT, gen->output[i]);
         }
-        free(gen->output);
+        tagged_free(ALLOC_OUTPUT, gen->output);
     }
     if (gen->variables) {
-        for (size_t i = 0; i < gen->var_count; i++) {
-            free(gen->variables[i].name);
-            free(gen->variables[i].type);
+        for (size_t i = gen->shared_count; i < gen->var_count; i++) {
+            tagged_free(ALLOC_SYMBOLS, gen->variables[i].name);
+            tagged_free(ALLOC_SYMBOLS, gen->variables[i].type);
         }
-        free(gen->variables);
+        tagged_free(ALLOC_SYMBOLS, gen->variables);
     }
     if (gen->var_addresses) {
-        for (size_t i = 0; i < gen->addr_count; i++) {
-            free(gen->var_addresses[i].name);
+        for (size_t i = gen->shared_count; i < gen->addr_count; i++) {
+            tagged_free(ALLOC_SYMBOLS, gen->var_addresses[i].name);
         }
-        free(gen->var_addresses);
+        tagged_free(ALLOC_SYMBOLS, gen->var_addresses);
     }
-    free(gen);
+    tagged_free(ALLOC_TEMP, gen->frame_slots);
+    tagged_free(ALLOC_OUTPUT, gen->data);
+    tagged_free(ALLOC_TEMP, gen->frame_events);
+    tagged_free(ALLOC_TEMP, gen->expr_stack);
+    tagged_free(ALLOC_TEMP, gen->stmt_stack);
+    tagged_free(ALLOC_TEMP, gen);
 }
 
-static void add_output(RISCGenerator *gen, const char *line) {
+static void append_output(RISCGenerator *gen, const char *line) {
     if (gen->output_size >= gen->output_capacity) {
         size_t new_capacity = gen->output_capacity == 0 ? 16 : gen->output_capacity * 2;
-        char **new_output = (char **) realloc(gen->output, new_capacity * sizeof(char *));
+        char **new_output = (char **) tagged_realloc(ALLOC_OUTPUT, gen->output, gen->output_capacity * sizeof(char *),
+                                                     new_capacity * sizeof(char *));
         if (!new_output) return;
         gen->output = new_output;
         gen->output_capacity = new_capacity;
     }
-    gen->output[gen->output_size] = strdup(line);
+    gen->output[gen->output_size] = tagged_strdup(ALLOC_OUTPUT, line);
     if (!gen->output[gen->output_size]) return;
     gen->output_size++;
 }
 
+// Команда перед первой командой другого оператора получает строку .loc
+static void add_output(RISCGenerator *gen, const char *line) {
+    if (gen->line_info && gen->location_line > 0 &&
+        (gen->location_line != gen->emitted_line || gen->location_column != gen->emitted_column) &&
+        listing_is_instruction(line)) {
+        char directive[48];
+        snprintf(directive, sizeof(directive), ".loc %d %d", gen->location_line, gen->location_column);
+        append_output(gen, directive);
+        gen->emitted_line = gen->location_line;
+        gen->emitted_column = gen->location_column;
+    }
+    append_output(gen, line);
+}
+
+// Следующие команды относятся к оператору node
+static void set_location(RISCGenerator *gen, const ASTNode *node) {
+    if (node && node->line > 0) {
+        gen->location_line = node->line;
+        gen->location_column = node->column;
+    }
+}
+
+// Позиция для сообщения об ошибке: узла, иначе текущего оператора, иначе лексера
+static void error_position(const RISCGenerator *gen, const ASTNode *node, int *line, int *column) {
+    if (node && node->line > 0) {
+        *line = node->line;
+        *column = node->column;
+    } else if (gen->location_line > 0) {
+        *line = gen->location_line;
+        *column = gen->location_column;
+    } else {
+        *line = get_current_line();
+        *column = get_current_column();
+    }
+}
+
+// Число в тексте команды: адрес ('A') или номер метки ('L')
+static const char *reloc_text(const RISCGenerator *gen, char kind, int value, char *text) {
+    if (gen->relocatable) {
+        snprintf(text, RELOC_TEXT_SIZE, "%c%c%d%c", RELOC_MARK, kind, value, RELOC_MARK);
+    } else {
+        snprintf(text, RELOC_TEXT_SIZE, "%d", value);
+    }
+    return text;
+}
+
+static const char *address_text(const RISCGenerator *gen, int address, char *text) {
+    return reloc_text(gen, 'A', address, text);
+}
+
+static const char *label_number(const RISCGenerator *gen, int number, char *text) {
+    return reloc_text(gen, 'L', number, text);
+}
+
 static int get_variable_address(RISCGenerator *gen, const char *name) {
-    int line = get_current_line();
-    int column = get_current_column();
+    int line, column;
+    error_position(gen, NULL, &line, &column);
     int found = 0;
     int is_global = 0;
     int var_block_level = -1;
-    size_t var_index = 0;
+    int live = 1;
     for (size_t i = 0; i < gen->var_count; i++) {
         if (strcmp(gen->variables[i].name, name) == 0) {
             found = 1;
             is_global = gen->variables[i].is_global;
             var_block_level = gen->variables[i].block_level;
-            var_index = i;
+            live = gen->variables[i].live;
             break;
         }
     }
@@ -156,7 +353,7 @@ static int get_variable_address(RISCGenerator *gen, const char *name) {
                        "Cannot access local variable '%s' from global scope", name);
             return -1;
         }
-        if (var_block_level > gen->block_level) {
+        if (var_block_level > gen->block_level || !live) {
             error_report(ERROR_SCOPE, line, column, gen->current_file,
                        "Cannot access variable '%s' outside its declaring block", name);
             return -1;
@@ -167,51 +364,225 @@ static int get_variable_address(RISCGenerator *gen, const char *name) {
             return gen->var_addresses[i].address;
         }
     }
-    return register_variable_address(gen, name);
+    return register_variable_address(gen, name, !is_global && gen->block_level > 0);
+}
+
+// Ячейка кадра на текущей глубине; новые ячейки берутся из memory_pos
+static int allocate_frame_slot(RISCGenerator *gen) {
+    if (gen->frame_top >= gen->frame_size) {
+        if (gen->frame_size >= gen->frame_capacity) {
+            size_t new_capacity = gen->frame_capacity == 0 ? 8 : gen->frame_capacity * 2;
+            int *new_slots = (int *) tagged_realloc(ALLOC_TEMP, gen->frame_slots, gen->frame_capacity * sizeof(int),
+                                                    new_capacity * sizeof(int));
+            if (!new_slots) return -1;
+            gen->frame_slots = new_slots;
+            gen->frame_capacity = new_capacity;
+        }
+        if (gen->relocatable) {
+            // Есть ли ячейка с этим номером в кадре предыдущих участков,
+            // известно только при сборке, поэтому выделение откладывается до неё
+            if (gen->frame_event_count >= gen->frame_event_capacity) {
+                size_t new_capacity = gen->frame_event_capacity == 0 ? 8 : gen->frame_event_capacity * 2;
+                void *new_events = tagged_realloc(ALLOC_TEMP, gen->frame_events,
+                                                  gen->frame_event_capacity * sizeof(*gen->frame_events),
+                                                  new_capacity * sizeof(*gen->frame_events));
+                if (!new_events) return -1;
+                gen->frame_events = new_events;
+                gen->frame_event_capacity = new_capacity;
+            }
+            gen->frame_events[gen->frame_event_count].slot = (int) gen->frame_size;
+            gen->frame_events[gen->frame_event_count].position = gen->memory_pos;
+            gen->frame_event_count++;
+            gen->frame_slots[gen->frame_size] = REGION_FRAME_BASE + (int) gen->frame_size;
+            gen->frame_size++;
+        } else {
+            gen->frame_slots[gen->frame_size++] = gen->memory_pos;
+            gen->memory_pos += 1;
+        }
+    }
+    return gen->frame_slots[gen->frame_top++];
+}
+
+static void enter_scope(RISCGenerator *gen, ScopeMark *mark) {
+    mark->block_level = gen->block_level;
+    mark->scope_is_global = gen->current_scope_is_global;
+    mark->var_count = gen->var_count;
+    mark->frame_top = gen->frame_top;
+    gen->block_level++;
+    gen->current_scope_is_global = 0;
+}
+
+// Переменные блока после выхода из него мертвы: их ячейки кадра
+// возвращаются и достаются следующим объявлениям на той же глубине
+static void leave_scope(RISCGenerator *gen, const ScopeMark *mark) {
+    for (size_t i = mark->var_count; i < gen->var_count; i++) {
+        if (!gen->variables[i].is_global) {
+            gen->variables[i].live = 0;
+        }
+    }
+    gen->frame_top = mark->frame_top;
+    gen->current_scope_is_global = mark->scope_is_global;
+    gen->block_level = mark->block_level;
 }
 
-static int register_variable_address(RISCGenerator *gen, const char *name) {
+static int register_variable_address(RISCGenerator *gen, const char *name, int in_frame) {
     if (!gen || !name) return -1;
     if (gen->addr_count >= gen->addr_capacity) {
         size_t new_capacity = gen->addr_capacity == 0 ? 8 : gen->addr_capacity * 2;
-        void *new_addrs = realloc(gen->var_addresses, new_capacity * sizeof(*gen->var_addresses));
+        void *new_addrs = tagged_realloc(ALLOC_SYMBOLS, gen->var_addresses,
+                                         gen->addr_capacity * sizeof(*gen->var_addresses),
+                                         new_capacity * sizeof(*gen->var_addresses));
         if (!new_addrs) return -1;
         gen->var_addresses = new_addrs;
         gen->addr_capacity = new_capacity;
     }
-    gen->var_addresses[gen->addr_count].name = strdup(name);
-    gen->var_addresses[gen->addr_count].address = gen->memory_pos;
-    gen->memory_pos += 1;
+    int address;
+    if (in_frame && gen->reuse_slots) {
+        address = allocate_frame_slot(gen);
+        if (address < 0) return -1;
+    } else {
+        address = gen->memory_pos;
+        gen->memory_pos += 1;
+    }
+    gen->var_addresses[gen->addr_count].name = tagged_strdup(ALLOC_SYMBOLS, name);
+    gen->var_addresses[gen->addr_count].address = address;
     return gen->var_addresses[gen->addr_count++].address;
 }
 
-static char *get_new_temp(RISCGenerator *gen) {
-    char temp_name[32];
-    snprintf(temp_name, sizeof(temp_name), "__tmp%d", gen->temp_counter++);
-    register_variable(gen, temp_name, "int", 0);
-    register_variable_address(gen, temp_name);
-    return strdup(temp_name);
+static void add_data_word(RISCGenerator *gen, int address, int value) {
+    if (gen->data_count >= gen->data_capacity) {
+        size_t new_capacity = gen->data_capacity == 0 ? 16 : gen->data_capacity * 2;
+        void *new_data = tagged_realloc(ALLOC_OUTPUT, gen->data, gen->data_capacity * sizeof(*gen->data),
+                                        new_capacity * sizeof(*gen->data));
+        if (!new_data) return;
+        gen->data = new_data;
+        gen->data_capacity = new_capacity;
+    }
+    gen->data[gen->data_count].address = address;
+    gen->data[gen->data_count].value = value;
+    gen->data[gen->data_count].relocate_value = 0;
+    gen->data_count++;
+}
+
+// Слово образа данных, значение которого — адрес (например, строки)
+static void add_data_address(RISCGenerator *gen, int address, int target) {
+    size_t index = gen->data_count;
+    add_data_word(gen, address, target);
+    if (gen->data_count > index) {
+        gen->data[index].relocate_value = 1;
+    }
+}
+
+// Деление на литеральный 0 не сворачивается, чтобы ошибку
+// по-прежнему выдал evaluate_expression
+static int fold_binary(const char *op, int l, int r, int *value) {
+    if (strcmp(op, "+") == 0) *value = (int) ((unsigned) l + (unsigned) r);
+    else if (strcmp(op, "-") == 0) *value = (int) ((unsigned) l - (unsigned) r);
+    else if (strcmp(op, "*") == 0) *value = (int) ((unsigned) l * (unsigned) r);
+    else if (strcmp(op, "/") == 0 || strcmp(op, "%") == 0) {
+        if (r == 0 || (l == -2147483647 - 1 && r == -1)) return 0;
+        *value = op[0] == '/' ? l / r : l % r;
+    }
+    else if (strcmp(op, "<") == 0) *value = l < r;
+    else if (strcmp(op, ">") == 0) *value = l > r;
+    else if (strcmp(op, "<=") == 0) *value = l <= r;
+    else if (strcmp(op, ">=") == 0) *value = l >= r;
+    else if (strcmp(op, "==") == 0 || strcmp(op, "=") == 0) *value = l == r;
+    else if (strcmp(op, "!=") == 0) *value = l != r;
+    else if (strcmp(op, "and") == 0) *value = l != 0 && r != 0;
+    else if (strcmp(op, "or") == 0) *value = l != 0 || r != 0;
+    else return 0;
+    return 1;
+}
+
+// Кадр свёртки: узел, значение левого операнда и шаг (0 — левый, 1 — правый, 2 — операция)
+typedef struct {
+    ASTNode *node;
+    int left;
+    int stage;
+} FoldFrame;
+
+#define FOLD_STACK_LOCAL 32
+
+// Свёртка целочисленного константного выражения обходом с явным стеком
+static int fold_int_constant(ASTNode *node, int *value) {
+    FoldFrame local[FOLD_STACK_LOCAL];
+    FoldFrame *stack = local;
+    size_t count = 0;
+    size_t capacity = FOLD_STACK_LOCAL;
+    int result = 0;
+    int ok = 1;
+    stack[count].node = node;
+    stack[count].stage = 0;
+    count++;
+    while (ok && count > 0) {
+        FoldFrame *frame = &stack[count - 1];
+        ASTNode *current = frame->node;
+        ASTNode *child = NULL;
+        if (!current) {
+            ok = 0;
+        } else if (current->type == NODE_LITERAL) {
+            ok = strcmp(current->literal.type, "int") == 0;
+            result = current->literal.int_value;
+            count--;
+        } else if (current->type != NODE_BINARY_OPERATION) {
+            ok = 0;
+        } else if (frame->stage == 0) {
+            frame->stage = 1;
+            child = current->binary_op.left;
+        } else if (frame->stage == 1) {
+            frame->left = result;
+            frame->stage = 2;
+            child = current->binary_op.right;
+        } else {
+            ok = fold_binary(current->binary_op.op_type, frame->left, result, &result);
+            count--;
+        }
+        if (ok && child) {
+            if (count >= capacity) {
+                FoldFrame *new_stack = (FoldFrame *) tagged_malloc(ALLOC_TEMP, capacity * 2 * sizeof(FoldFrame));
+                if (!new_stack) {
+                    ok = 0;
+                    break;
+                }
+                memcpy(new_stack, stack, count * sizeof(FoldFrame));
+                if (stack != local) tagged_free(ALLOC_TEMP, stack);
+                stack = new_stack;
+                capacity *= 2;
+            }
+            stack[count].node = child;
+            stack[count].stage = 0;
+            count++;
+        }
+    }
+    if (stack != local) tagged_free(ALLOC_TEMP, stack);
+    if (ok) *value = result;
+    return ok;
 }
 
 static char *get_new_label(RISCGenerator *gen, const char *prefix) {
     char label_name[64];
-    snprintf(label_name, sizeof(label_name), "__%s_%d", prefix, gen->label_counter++);
-    return strdup(label_name);
+    char number[RELOC_TEXT_SIZE];
+    snprintf(label_name, sizeof(label_name), "__%s_%s", prefix,
+             label_number(gen, gen->label_counter++, number));
+    return tagged_strdup(ALLOC_TEMP, label_name);
 }
 
 static void register_variable(RISCGenerator *gen, const char *name, const char *type, int is_global) {
     if (!name) return;
     if (gen->var_count >= gen->var_capacity) {
         size_t new_capacity = gen->var_capacity == 0 ? 8 : gen->var_capacity * 2;
-        void *new_vars = realloc(gen->variables, new_capacity * sizeof(*gen->variables));
+        void *new_vars = tagged_realloc(ALLOC_SYMBOLS, gen->variables, gen->var_capacity * sizeof(*gen->variables),
+                                        new_capacity * sizeof(*gen->variables));
         if (!new_vars) return;
         gen->variables = new_vars;
         gen->var_capacity = new_capacity;
     }
-    gen->variables[gen->var_count].name = strdup(name);
-    gen->variables[gen->var_count].type = type ? strdup(type) : strdup("unknown");
+    gen->variables[gen->var_count].name = tagged_strdup(ALLOC_SYMBOLS, name);
+    gen->variables[gen->var_count].type = tagged_strdup(ALLOC_SYMBOLS, type ? type : "unknown");
     gen->variables[gen->var_count].is_global = is_global;
     gen->variables[gen->var_count].block_level = is_global ? 0 : gen->block_level;
+    gen->variables[gen->var_count].live = 1;
     gen->var_count++;
 }
 
@@ -236,8 +607,8 @@ static int declare_variable(RISCGenerator *gen, const char *name, const char *ty
 
 static void process_variable_declaration(RISCGenerator *gen, ASTNode *node) {
     if (!gen || !node) return;
-    int line = get_current_line();
-    int column = get_current_column();
+    int line, column;
+    error_position(gen, node, &line, &column);
     const char *name = node->variable.name;
     const char *type = node->variable.var_type;
     int is_global = node->variable.is_global;
@@ -255,7 +626,7 @@ static void process_variable_declaration(RISCGenerator *gen, ASTNode *node) {
         }
     }
     register_variable(gen, name, type, is_global);
-    int var_addr = register_variable_address(gen, name);
+    int var_addr = register_variable_address(gen, name, !is_global && gen->block_level > 0);
     if (node->variable.initializer) {
         char buffer[256];
         if (node->variable.initializer->type == NODE_LITERAL) {
@@ -290,84 +661,146 @@ static void process_variable_declaration(RISCGenerator *gen, ASTNode *node) {
             }
         }
         if (!error_is_critical()) {
-            snprintf(buffer, sizeof(buffer), "Initialize %s (address %d)", name, var_addr);
+            char address[RELOC_TEXT_SIZE];
+            // Объявление верхнего уровня выполняется ровно один раз и получает
+            // свежую ячейку, поэтому константное значение кладётся в образ данных
+            int value;
+            ASTNode *init = node->variable.initializer;
+            if (gen->static_data && gen->block_level == 0 && fold_int_constant(init, &value)) {
+                add_data_word(gen, var_addr, value);
+                return;
+            }
+            if (gen->static_data && gen->block_level == 0 && init->type == NODE_LITERAL &&
+                strcmp(init->literal.type, "string") == 0) {
+                add_data_address(gen, var_addr, add_string_literal(gen, init->literal.string_value));
+                return;
+            }
+            snprintf(buffer, sizeof(buffer), "Initialize %s (address %s)", name,
+                     address_text(gen, var_addr, address));
             add_output(gen, buffer);
             evaluate_expression(gen, node->variable.initializer, "x1");
-            snprintf(buffer, sizeof(buffer), "li x2, %d", var_addr);
+            snprintf(buffer, sizeof(buffer), "li x2, %s", address);
             add_output(gen, buffer);
             add_output(gen, "sw x2, 0, x1");
         }
-    } else {
+    } else if (gen->block_level > 0 || !gen->static_data) {
+        // С образом данных память обнулена при загрузке, и явная запись 0 нужна только
+        // для ячеек кадра, которые могли остаться от предыдущих блоков. Без него
+        // (-fno-static-data, поток) объявления инициализируются кодом, как раньше
         char buffer[256];
-        snprintf(buffer, sizeof(buffer), "Initialize %s with default value 0 (address %d)", name, var_addr);
+        char address[RELOC_TEXT_SIZE];
+        snprintf(buffer, sizeof(buffer), "Initialize %s with default value 0 (address %s)", name,
+                 address_text(gen, var_addr, address));
         add_output(gen, buffer);
         add_output(gen, "li x1, 0");
-        snprintf(buffer, sizeof(buffer), "li x2, %d", var_addr);
+        snprintf(buffer, sizeof(buffer), "li x2, %s", address);
         add_output(gen, buffer);
         add_output(gen, "sw x2, 0, x1");
     }
 }
 
-static void process_node(RISCGenerator *gen, ASTNode *node) {
-    if (!gen || !node) {
-        add_output(gen, "Warning: NULL node detected!");
-        return;
+static int push_statement(RISCGenerator *gen, ASTNode *node) {
+    if (gen->stmt_count >= gen->stmt_capacity) {
+        size_t new_capacity = gen->stmt_capacity == 0 ? 16 : gen->stmt_capacity * 2;
+        StatementFrame *new_stack = (StatementFrame *) tagged_realloc(ALLOC_TEMP, gen->stmt_stack,
+                                                                      gen->stmt_capacity * sizeof(StatementFrame),
+                                                                      new_capacity * sizeof(StatementFrame));
+        if (!new_stack) return -1;
+        gen->stmt_stack = new_stack;
+        gen->stmt_capacity = new_capacity;
+    }
+    StatementFrame *frame = &gen->stmt_stack[gen->stmt_count++];
+    memset(frame, 0, sizeof(*frame));
+    frame->node = node;
+    return 0;
+}
+
+static void pop_statement(RISCGenerator *gen) {
+    StatementFrame *frame = &gen->stmt_stack[--gen->stmt_count];
+    for (int i = 0; i < 3; i++) {
+        tagged_free(ALLOC_TEMP, frame->labels[i]);
     }
+}
+
+// Один шаг оператора: 1 — оператор обработан, 0 — в *child следующий
+// вложенный оператор (возможно NULL)
+static int statement_step(RISCGenerator *gen, StatementFrame *frame, ASTNode **child) {
     char buffer[1024];
+    ASTNode *node = frame->node;
+    if (!node) {
+        add_output(gen, "Warning: NULL node detected!");
+        return 1;
+    }
     switch (node->type) {
         case NODE_PROGRAM:
-            gen->current_scope_is_global = 1;
-            gen->block_level = 0;
-            for (size_t i = 0; i < node->block.children.size; i++) {
-                process_node(gen, node->block.children.items[i]);
+        case NODE_BLOCK:
+            if (frame->stage == 0) {
+                if (node->type == NODE_PROGRAM) {
+                    gen->current_scope_is_global = 1;
+                    gen->block_level = 0;
+                } else {
+                    enter_scope(gen, &frame->mark);
+                }
+                frame->stage = 1;
             }
-            break;
+            if (frame->index < node->block.children.size) {
+                *child = node->block.children.items[frame->index++];
+                return 0;
+            }
+            if (node->type == NODE_BLOCK) {
+                leave_scope(gen, &frame->mark);
+            }
+            return 1;
+        case NODE_IF_STATEMENT:
+            return if_statement_step(gen, frame, child);
+        case NODE_WHILE_LOOP:
+            return while_loop_step(gen, frame, child);
+        case NODE_ROUND_LOOP:
+            return round_loop_step(gen, frame, child);
         case NODE_VARIABLE_DECLARATION:
             process_variable_declaration(gen, node);
-            break;
+            return 1;
         case NODE_ASSIGNMENT:
             process_assignment(gen, node);
-            break;
+            return 1;
+        case NODE_PRINT:
+            process_print(gen, node);
+            return 1;
         case NODE_BINARY_OPERATION:
-            break;
         case NODE_LITERAL:
-            break;
         case NODE_IDENTIFIER:
-            break;
-        case NODE_IF_STATEMENT:
-            process_if_statement(gen, node);
-            break;
-        case NODE_WHILE_LOOP:
-            process_while_loop(gen, node);
-            break;
-        case NODE_ROUND_LOOP:
-            process_round_loop(gen, node);
-            break;
-        case NODE_BLOCK:
-            {
-                int prev_scope = gen->current_scope_is_global;
-                gen->block_level++;
-                gen->current_scope_is_global = 0;
-            for (size_t i = 0; i < node->block.children.size; i++) {
-                process_node(gen, node->block.children.items[i]);
-                }
-                gen->current_scope_is_global = prev_scope;
-                gen->block_level--;
-            }
-            break;
-        case NODE_PRINT:
-            process_print(gen, node);
-            break;
+            return 1;
         default:
             snprintf(buffer, sizeof(buffer), "Warning: Unknown node type %d", node->type);
             add_output(gen, buffer);
-            break;
+            return 1;
+    }
+}
+
+// Операторы обходятся с явным стеком кадров (gen->stmt_stack), поэтому
+// глубина вложенности блоков и циклов не ограничена стеком потока
+static void process_node(RISCGenerator *gen, ASTNode *node) {
+    if (!gen) return;
+    size_t base = gen->stmt_count;
+    if (push_statement(gen, node) != 0) return;
+    while (gen->stmt_count > base) {
+        ASTNode *child = NULL;
+        // После вложенного оператора команды снова относятся к внешнему (переход цикла и т.п.)
+        set_location(gen, gen->stmt_stack[gen->stmt_count - 1].node);
+        if (statement_step(gen, &gen->stmt_stack[gen->stmt_count - 1], &child)) {
+            pop_statement(gen);
+        } else if (push_statement(gen, child) != 0) {
+            // Нехватка памяти: обработка оператора обрывается
+            while (gen->stmt_count > base) {
+                pop_statement(gen);
+            }
+        }
     }
 }
 
 static int check_division_by_zero(RISCGenerator *gen, ASTNode *left, ASTNode *right, const char *op) {
-    int line = get_current_line();
-    int column = get_current_column();
+    int line, column;
+    error_position(gen, right, &line, &column);
     if (strcmp(op, "/") == 0 || strcmp(op, "%") == 0) {
         if (right->type == NODE_LITERAL && 
             strcmp(right->literal.type, "int") == 0 && 
@@ -381,8 +814,8 @@ static int check_division_by_zero(RISCGenerator *gen, ASTNode *left, ASTNode *ri
                 if (strcmp(gen->variables[i].name, right->identifier.name) == 0) {
                     int var_addr = get_variable_address(gen, right->identifier.name);
                     if (var_addr != -1) {
-                        fprintf(stderr, "Warning: Potential division by zero at %s:%d:%d: Check variable '%s'\n",
-                                gen->current_file, line, column, right->identifier.name);
+                        error_message("Warning: Potential division by zero at %s:%d:%d: Check variable '%s'\n",
+                                      gen->current_file, line, column, right->identifier.name);
                     }
                     break;
                 }
@@ -394,23 +827,229 @@ static int check_division_by_zero(RISCGenerator *gen, ASTNode *left, ASTNode *ri
     return 0;
 }
 
-static void evaluate_expression(RISCGenerator *gen, ASTNode *node, const char *target_reg) {
+// Выражение вычисляется обходом с явным стеком кадров (gen->expr_stack):
+// левоассоциативные цепочки "a + b + ..." дают деревья глубиной в длину
+// цепочки, и рекурсия переполнила бы стек потока
+static int push_expression(RISCGenerator *gen, ASTNode *node, const char *target_reg) {
+    if (gen->expr_count >= gen->expr_capacity) {
+        size_t new_capacity = gen->expr_capacity == 0 ? 16 : gen->expr_capacity * 2;
+        ExpressionFrame *new_stack = (ExpressionFrame *) tagged_realloc(ALLOC_TEMP, gen->expr_stack,
+                                                                        gen->expr_capacity * sizeof(ExpressionFrame),
+                                                                        new_capacity * sizeof(ExpressionFrame));
+        if (!new_stack) return -1;
+        gen->expr_stack = new_stack;
+        gen->expr_capacity = new_capacity;
+    }
+    ExpressionFrame *frame = &gen->expr_stack[gen->expr_count++];
+    frame->node = node;
+    frame->target_reg = target_reg;
+    frame->left_reg = NULL;
+    frame->right_reg = NULL;
+    frame->left_type = NULL;
+    frame->right_type = NULL;
+    frame->stage = 0;
+    return 0;
+}
+
+// Команда бинарной операции над уже вычисленными операндами
+static void emit_binary_operation(RISCGenerator *gen, const ExpressionFrame *frame) {
+    char buffer[128];
+    ASTNode *node = frame->node;
+    int line, column;
+    error_position(gen, node, &line, &column);
+    const char *target_reg = frame->target_reg;
+    const char *left_reg = frame->left_reg;
+    const char *right_reg = frame->right_reg;
+    const char *left_type = frame->left_type;
+    const char *right_type = frame->right_type;
+    const char *op = node->binary_op.op_type;
+    if (!error_is_critical()) {
+        if (strcmp(op, "+") == 0) {
+            snprintf(buffer, sizeof(buffer), "add %s, %s, %s", 
+                    target_reg, left_reg, right_reg);
+            add_output(gen, buffer);
+        } else if (strcmp(op, "-") == 0) {
+            snprintf(buffer, sizeof(buffer), "sub %s, %s, %s", 
+                    target_reg, left_reg, right_reg);
+            add_output(gen, buffer);
+        } else if (strcmp(op, "*") == 0) {
+            snprintf(buffer, sizeof(buffer), "mul %s, %s, %s", 
+                    target_reg, left_reg, right_reg);
+            add_output(gen, buffer);
+        } else if (strcmp(op, "/") == 0) {
+            char number[RELOC_TEXT_SIZE];
+            label_number(gen, gen->label_counter, number);
+            add_output(gen, "Check for division by zero at runtime");
+            snprintf(buffer, sizeof(buffer), "beq %s, x0, __division_by_zero_%s", 
+                    right_reg, number);
+            add_output(gen, buffer);
+            snprintf(buffer, sizeof(buffer), "div %s, %s, %s", 
+                    target_reg, left_reg, right_reg);
+            add_output(gen, buffer);
+            snprintf(buffer, sizeof(buffer), "jal x0, __after_division_%s", 
+                    number);
+            add_output(gen, buffer);
+            snprintf(buffer, sizeof(buffer), "__division_by_zero_%s:", 
+                    number);
+            add_output(gen, buffer);
+            snprintf(buffer, sizeof(buffer), "li %s, 0", 
+                    target_reg);
+            add_output(gen, buffer);
+            snprintf(buffer, sizeof(buffer), "__after_division_%s:", 
+                    number);
+            add_output(gen, buffer);
+            gen->label_counter++;
+        } else if (strcmp(op, "%") == 0) {
+            if ((left_type && strcmp(left_type, "string") == 0) || 
+                (right_type && strcmp(right_type, "string") == 0)) {
+                error_report(ERROR_TYPE_MISMATCH, line, column, gen->current_file,
+                    "Modulo operation requires integer operands, got %s and %s",
+                    left_type ? left_type : "unknown", right_type ? right_type : "unknown");
+                snprintf(buffer, sizeof(buffer), "Ошибка: операция модуля применима только к целым числам");
+                add_output(gen, buffer);
+                error_set_critical();
+                return;
+            }
+            char number[RELOC_TEXT_SIZE];
+            label_number(gen, gen->label_counter, number);
+            add_output(gen, "Check for modulo by zero at runtime");
+            snprintf(buffer, sizeof(buffer), "beq %s, x0, __modulo_by_zero_%s", 
+                    right_reg, number);
+            add_output(gen, buffer);
+            add_output(gen, "Compute modulo using rem instruction (remainder)");
+            snprintf(buffer, sizeof(buffer), "rem %s, %s, %s", 
+                    target_reg, left_reg, right_reg);
+            add_output(gen, buffer);
+            snprintf(buffer, sizeof(buffer), "jal x0, __after_modulo_%s", 
+                    number);
+            add_output(gen, buffer);
+            snprintf(buffer, sizeof(buffer), "__modulo_by_zero_%s:", 
+                    number);
+            add_output(gen, buffer);
+            snprintf(buffer, sizeof(buffer), "li %s, 0", 
+                    target_reg);
+            add_output(gen, buffer);
+            snprintf(buffer, sizeof(buffer), "__after_modulo_%s:", 
+                    number);
+            add_output(gen, buffer);
+            gen->label_counter++;
+        } else if (strcmp(op, "<") == 0) {
+            snprintf(buffer, sizeof(buffer), "slt %s, %s, %s", 
+                    target_reg, left_reg, right_reg);
+            add_output(gen, buffer);
+        } else if (strcmp(op, ">") == 0) {
+            snprintf(buffer, sizeof(buffer), "slt %s, %s, %s", 
+                    target_reg, right_reg, left_reg);
+            add_output(gen, buffer);
+        } else if (strcmp(op, "=") == 0 || strcmp(op, "==") == 0) {
+            add_output(gen, "Equality comparison (==)");
+            snprintf(buffer, sizeof(buffer), "seq %s, %s, %s", 
+                    target_reg, left_reg, right_reg);
+            add_output(gen, buffer);
+        } else if (strcmp(op, "!=") == 0) {
+            add_output(gen, "Inequality comparison (!=)");
+            snprintf(buffer, sizeof(buffer), "sne %s, %s, %s", 
+                    target_reg, left_reg, right_reg);
+            add_output(gen, buffer);
+        } else if (strcmp(op, "<=") == 0) {
+            add_output(gen, "Less or equal comparison (<=)");
+            snprintf(buffer, sizeof(buffer), "slt x5, %s, %s", 
+                    right_reg, left_reg);
+            add_output(gen, buffer);
+            snprintf(buffer, sizeof(buffer), "xori %s, x5, 1", 
+                    target_reg);
+            add_output(gen, buffer);
+        } else if (strcmp(op, ">=") == 0) {
+            add_output(gen, "Greater or equal comparison (>=)");
+            snprintf(buffer, sizeof(buffer), "sge %s, %s, %s", 
+                    target_reg, left_reg, right_reg);
+            add_output(gen, buffer);
+        } else if (strcmp(op, "and") == 0) {
+            add_output(gen, "Logical AND (optimized)");
+            if (node->binary_op.left->type == NODE_LITERAL && 
+                strcmp(node->binary_op.left->literal.type, "int") == 0 &&
+                node->binary_op.left->literal.int_value == 0) {
+                snprintf(buffer, sizeof(buffer), "li %s, 0", target_reg);
+                add_output(gen, buffer);
+            } else if (node->binary_op.right->type == NODE_LITERAL && 
+                       strcmp(node->binary_op.right->literal.type, "int") == 0 &&
+                       node->binary_op.right->literal.int_value == 0) {
+                snprintf(buffer, sizeof(buffer), "li %s, 0", target_reg);
+                add_output(gen, buffer);
+            } else {
+                snprintf(buffer, sizeof(buffer), "sne x5, %s, x0", left_reg);
+                add_output(gen, buffer);
+                snprintf(buffer, sizeof(buffer), "sne x6, %s, x0", right_reg);
+                add_output(gen, buffer);
+                snprintf(buffer, sizeof(buffer), "and %s, x5, x6", target_reg);
+                add_output(gen, buffer);
+            }
+        } else if (strcmp(op, "or") == 0) {
+            add_output(gen, "Logical OR (optimized)");
+            if ((node->binary_op.left->type == NODE_LITERAL && 
+                 strcmp(node->binary_op.left->literal.type, "int") == 0 &&
+                 node->binary_op.left->literal.int_value != 0) ||
+                (node->binary_op.right->type == NODE_LITERAL && 
+                 strcmp(node->binary_op.right->literal.type, "int") == 0 &&
+                 node->binary_op.right->literal.int_value != 0)) {
+                snprintf(buffer, sizeof(buffer), "li %s, 1", target_reg);
+                add_output(gen, buffer);
+            } else {
+                snprintf(buffer, sizeof(buffer), "sne x5, %s, x0", left_reg);
+                add_output(gen, buffer);
+                snprintf(buffer, sizeof(buffer), "sne x6, %s, x0", right_reg);
+                add_output(gen, buffer);
+                snprintf(buffer, sizeof(buffer), "or %s, x5, x6", target_reg);
+                add_output(gen, buffer);
+            }
+        } else {
+            snprintf(buffer, sizeof(buffer), "Warning: Unknown operation %s", op);
+            add_output(gen, buffer);
+        }
+    }
+}
+
+/**
+ * Выполняет очередной шаг кадра выражения.
+ * @param child Операнд, который нужно вычислить перед следующим шагом
+ * @return 1, если кадр обработан полностью
+ */
+static int expression_step(RISCGenerator *gen, ExpressionFrame *frame, ASTNode **child, const char **child_reg) {
     char buffer[128];
-    int line = get_current_line();
-    int column = get_current_column();
+    ASTNode *node = frame->node;
+    const char *target_reg = frame->target_reg;
     switch (node->type) {
         case NODE_BINARY_OPERATION:
             if (strcmp(node->binary_op.op_type, ".") == 0) {
-                if (node->binary_op.left->type == NODE_BINARY_OPERATION &&
-                    strcmp(node->binary_op.left->binary_op.op_type, ".") == 0) {
-                    evaluate_expression(gen, node->binary_op.left, "x10");
-                    add_output(gen, "addi x5, x10, 0");
-                } else {
-                    evaluate_expression(gen, node->binary_op.left, "x5");
+                if (frame->stage == 0) {
+                    frame->stage = 1;
+                    *child = node->binary_op.left;
+                    *child_reg = "x5";
+                    return 0;
                 }
-                evaluate_expression(gen, node->binary_op.right, "x6");
-                process_concat(gen, node, target_reg);
-            } else {
+                if (frame->stage == 1) {
+                    frame->stage = 2;
+                    *child = node->binary_op.right;
+                    *child_reg = "x6";
+                    return 0;
+                }
+                char address[RELOC_TEXT_SIZE];
+                int new_addr = concatenate_strings(gen, "x5", "x6");
+                snprintf(buffer, sizeof(buffer), "li %s, %s", target_reg, address_text(gen, new_addr, address));
+                add_output(gen, buffer);
+                return 1;
+            }
+            if (frame->stage == 1) {
+                frame->stage = 2;
+                *child = node->binary_op.right;
+                *child_reg = frame->right_reg;
+                return 0;
+            }
+            if (frame->stage == 2) {
+                emit_binary_operation(gen, frame);
+                return 1;
+            }
+            {
                 const char *left_type = NULL;
                 const char *right_type = NULL;
                 if (node->binary_op.left->type == NODE_LITERAL) {
@@ -444,173 +1083,37 @@ static void evaluate_expression(RISCGenerator *gen, ASTNode *node, const char *t
                     if (node->binary_op.right->type == NODE_LITERAL &&
                         strcmp(node->binary_op.right->literal.type, "int") == 0 &&
                         node->binary_op.right->literal.int_value == 0) {
-                        error_report(ERROR_DIVISION_BY_ZERO, line, column, gen->current_file,
-                                    "Division by zero detected at compile-time");
+                        int line, column;
+                        error_position(gen, node, &line, &column);
+                        error_report(ERROR_DIVISION_BY_ZERO, line, column,
+                                    gen->current_file, "Division by zero detected at compile-time");
                         snprintf(buffer, sizeof(buffer), "li %s, 0", target_reg);
                         add_output(gen, buffer);
-                        return;
+                        return 1;
                     }
                 }
-                char left_reg[8], right_reg[8];
+                frame->left_type = left_type;
+                frame->right_type = right_type;
                 if (strcmp(target_reg, "x1") == 0) {
-                    strcpy(left_reg, "x3");
-                    strcpy(right_reg, "x4");
+                    frame->left_reg = "x3";
+                    frame->right_reg = "x4";
                 } else {
-                    strcpy(left_reg, "x1");
-                    strcpy(right_reg, "x2");
-                }
-                evaluate_expression(gen, node->binary_op.left, left_reg);
-                evaluate_expression(gen, node->binary_op.right, right_reg);
-                const char *op = node->binary_op.op_type;
-                if (!error_is_critical()) {
-                    if (strcmp(op, "+") == 0) {
-                        snprintf(buffer, sizeof(buffer), "add %s, %s, %s", 
-                                target_reg, left_reg, right_reg);
-                        add_output(gen, buffer);
-                    } else if (strcmp(op, "-") == 0) {
-                        snprintf(buffer, sizeof(buffer), "sub %s, %s, %s", 
-                                target_reg, left_reg, right_reg);
-                        add_output(gen, buffer);
-                    } else if (strcmp(op, "*") == 0) {
-                        snprintf(buffer, sizeof(buffer), "mul %s, %s, %s", 
-                                target_reg, left_reg, right_reg);
-                        add_output(gen, buffer);
-                    } else if (strcmp(op, "/") == 0) {
-                        add_output(gen, "Check for division by zero at runtime");
-                        snprintf(buffer, sizeof(buffer), "beq %s, x0, __division_by_zero_%d", 
-                                right_reg, gen->label_counter);
-                        add_output(gen, buffer);
-                        snprintf(buffer, sizeof(buffer), "div %s, %s, %s", 
-                                target_reg, left_reg, right_reg);
-                        add_output(gen, buffer);
-                        snprintf(buffer, sizeof(buffer), "jal x0, __after_division_%d", 
-                                gen->label_counter);
-                        add_output(gen, buffer);
-                        snprintf(buffer, sizeof(buffer), "__division_by_zero_%d:", 
-                                gen->label_counter);
-                        add_output(gen, buffer);
-                        snprintf(buffer, sizeof(buffer), "li %s, 0", 
-                                target_reg);
-                        add_output(gen, buffer);
-                        snprintf(buffer, sizeof(buffer), "__after_division_%d:", 
-                                gen->label_counter);
-                        add_output(gen, buffer);
-                        gen->label_counter++;
-                    } else if (strcmp(op, "%") == 0) {
-                        if ((left_type && strcmp(left_type, "string") == 0) || 
-                            (right_type && strcmp(right_type, "string") == 0)) {
-                            error_report(ERROR_TYPE_MISMATCH, line, column, gen->current_file,
-                                "Modulo operation requires integer operands, got %s and %s",
-                                left_type ? left_type : "unknown", right_type ? right_type : "unknown");
-                            snprintf(buffer, sizeof(buffer), "Ошибка: операция модуля применима только к целым числам");
-                            add_output(gen, buffer);
-                            error_set_critical();
-                            return;
-                        }
-                        add_output(gen, "Check for modulo by zero at runtime");
-                        snprintf(buffer, sizeof(buffer), "beq %s, x0, __modulo_by_zero_%d", 
-                                right_reg, gen->label_counter);
-                        add_output(gen, buffer);
-                        add_output(gen, "Compute modulo using rem instruction (remainder)");
-                        snprintf(buffer, sizeof(buffer), "rem %s, %s, %s", 
-                                target_reg, left_reg, right_reg);
-                        add_output(gen, buffer);
-                        snprintf(buffer, sizeof(buffer), "jal x0, __after_modulo_%d", 
-                                gen->label_counter);
-                        add_output(gen, buffer);
-                        snprintf(buffer, sizeof(buffer), "__modulo_by_zero_%d:", 
-                                gen->label_counter);
-                        add_output(gen, buffer);
-                        snprintf(buffer, sizeof(buffer), "li %s, 0", 
-                                target_reg);
-                        add_output(gen, buffer);
-                        snprintf(buffer, sizeof(buffer), "__after_modulo_%d:", 
-                                gen->label_counter);
-                        add_output(gen, buffer);
-                        gen->label_counter++;
-                    } else if (strcmp(op, "<") == 0) {
-                        snprintf(buffer, sizeof(buffer), "slt %s, %s, %s", 
-                                target_reg, left_reg, right_reg);
-                        add_output(gen, buffer);
-                    } else if (strcmp(op, ">") == 0) {
-                        snprintf(buffer, sizeof(buffer), "slt %s, %s, %s", 
-                                target_reg, right_reg, left_reg);
-                        add_output(gen, buffer);
-                    } else if (strcmp(op, "=") == 0 || strcmp(op, "==") == 0) {
-                        add_output(gen, "Equality comparison (==)");
-                        snprintf(buffer, sizeof(buffer), "seq %s, %s, %s", 
-                                target_reg, left_reg, right_reg);
-                        add_output(gen, buffer);
-                    } else if (strcmp(op, "!=") == 0) {
-                        add_output(gen, "Inequality comparison (!=)");
-                        snprintf(buffer, sizeof(buffer), "sne %s, %s, %s", 
-                                target_reg, left_reg, right_reg);
-                        add_output(gen, buffer);
-                    } else if (strcmp(op, "<=") == 0) {
-                        add_output(gen, "Less or equal comparison (<=)");
-                        snprintf(buffer, sizeof(buffer), "slt x5, %s, %s", 
-                                right_reg, left_reg);
-                        add_output(gen, buffer);
-                        snprintf(buffer, sizeof(buffer), "xori %s, x5, 1", 
-                                target_reg);
-                        add_output(gen, buffer);
-                    } else if (strcmp(op, ">=") == 0) {
-                        add_output(gen, "Greater or equal comparison (>=)");
-                        snprintf(buffer, sizeof(buffer), "sge %s, %s, %s", 
-                                target_reg, left_reg, right_reg);
-                        add_output(gen, buffer);
-                    } else if (strcmp(op, "and") == 0) {
-                        add_output(gen, "Logical AND (optimized)");
-                        if (node->binary_op.left->type == NODE_LITERAL && 
-                            strcmp(node->binary_op.left->literal.type, "int") == 0 &&
-                            node->binary_op.left->literal.int_value == 0) {
-                            snprintf(buffer, sizeof(buffer), "li %s, 0", target_reg);
-                            add_output(gen, buffer);
-                        } else if (node->binary_op.right->type == NODE_LITERAL && 
-                                   strcmp(node->binary_op.right->literal.type, "int") == 0 &&
-                                   node->binary_op.right->literal.int_value == 0) {
-                            snprintf(buffer, sizeof(buffer), "li %s, 0", target_reg);
-                            add_output(gen, buffer);
-                        } else {
-                            snprintf(buffer, sizeof(buffer), "sne x5, %s, x0", left_reg);
-                            add_output(gen, buffer);
-                            snprintf(buffer, sizeof(buffer), "sne x6, %s, x0", right_reg);
-                            add_output(gen, buffer);
-                            snprintf(buffer, sizeof(buffer), "and %s, x5, x6", target_reg);
-                            add_output(gen, buffer);
-                        }
-                    } else if (strcmp(op, "or") == 0) {
-                        add_output(gen, "Logical OR (optimized)");
-                        if ((node->binary_op.left->type == NODE_LITERAL && 
-                             strcmp(node->binary_op.left->literal.type, "int") == 0 &&
-                             node->binary_op.left->literal.int_value != 0) ||
-                            (node->binary_op.right->type == NODE_LITERAL && 
-                             strcmp(node->binary_op.right->literal.type, "int") == 0 &&
-                             node->binary_op.right->literal.int_value != 0)) {
-                            snprintf(buffer, sizeof(buffer), "li %s, 1", target_reg);
-                            add_output(gen, buffer);
-                        } else {
-                            snprintf(buffer, sizeof(buffer), "sne x5, %s, x0", left_reg);
-                            add_output(gen, buffer);
-                            snprintf(buffer, sizeof(buffer), "sne x6, %s, x0", right_reg);
-                            add_output(gen, buffer);
-                            snprintf(buffer, sizeof(buffer), "or %s, x5, x6", target_reg);
-                            add_output(gen, buffer);
-                        }
-                    } else {
-                        snprintf(buffer, sizeof(buffer), "Warning: Unknown operation %s", op);
-                        add_output(gen, buffer);
-                    }
+                    frame->left_reg = "x1";
+                    frame->right_reg = "x2";
                 }
+                frame->stage = 1;
+                *child = node->binary_op.left;
+                *child_reg = frame->left_reg;
+                return 0;
             }
-            break;
         case NODE_LITERAL:
             if (strcmp(node->literal.type, "int") == 0) {
                 snprintf(buffer, sizeof(buffer), "li %s, %d", target_reg, node->literal.int_value);
                 add_output(gen, buffer);
             } else if (strcmp(node->literal.type, "string") == 0) {
+                char address[RELOC_TEXT_SIZE];
                 int str_id = add_string_literal(gen, node->literal.string_value);
-                snprintf(buffer, sizeof(buffer), "li %s, %d", target_reg, str_id);
+                snprintf(buffer, sizeof(buffer), "li %s, %s", target_reg, address_text(gen, str_id, address));
                 add_output(gen, buffer);
             }
             break;
@@ -618,8 +1121,9 @@ static void evaluate_expression(RISCGenerator *gen, ASTNode *node, const char *t
             {
                 int var_addr = get_variable_address(gen, node->identifier.name);
                 if (var_addr != -1) {
-                    snprintf(buffer, sizeof(buffer), "li x2, %d", 
-                            var_addr, node->identifier.name);
+                    char address[RELOC_TEXT_SIZE];
+                    snprintf(buffer, sizeof(buffer), "li x2, %s", 
+                            address_text(gen, var_addr, address));
             add_output(gen, buffer);
                     add_output(gen, "lw x31, x2, 0");
                     snprintf(buffer, sizeof(buffer), "add %s, x31, x0", target_reg);
@@ -636,33 +1140,61 @@ static void evaluate_expression(RISCGenerator *gen, ASTNode *node, const char *t
             add_output(gen, buffer);
             break;
     }
+    return 1;
 }
 
-static void process_concat(RISCGenerator *gen, ASTNode *node, const char *target_reg) {
-    char buffer[128];
-    evaluate_expression(gen, node->binary_op.left, "x5");
-    evaluate_expression(gen, node->binary_op.right, "x6");
-    int new_addr = concatenate_strings(gen, "x5", "x6");
-    snprintf(buffer, sizeof(buffer), "li %s, %d", target_reg, new_addr);
-    add_output(gen, buffer);
+static void evaluate_expression(RISCGenerator *gen, ASTNode *node, const char *target_reg) {
+    size_t base = gen->expr_count;
+    if (push_expression(gen, node, target_reg) != 0) return;
+    while (gen->expr_count > base) {
+        ASTNode *child = NULL;
+        const char *child_reg = NULL;
+        if (expression_step(gen, &gen->expr_stack[gen->expr_count - 1], &child, &child_reg)) {
+            gen->expr_count--;
+        } else if (push_expression(gen, child, child_reg) != 0) {
+            // Нехватка памяти: вычисление выражения обрывается
+            gen->expr_count = base;
+        }
+    }
 }
 
 static int add_string_literal(RISCGenerator *gen, const char *str) {
     if (!str) return -1;
     int str_addr = gen->memory_pos;
-    char buffer[128];
     const char *start = str;
     if (*start == '"') start++;
-    snprintf(buffer, sizeof(buffer), "li x2, %d", str_addr);
-    add_output(gen, buffer);
-    for (const char *p = start; *p && *p != '"'; p++) {
-        snprintf(buffer, sizeof(buffer), "li x1, %d", *p, *p);
+    if (gen->static_data) {
+        // Строковые литералы неизменяемы: символы попадают в образ данных
+        int addr = str_addr;
+        for (const char *p = start; *p && *p != '"'; p++) {
+            add_data_word(gen, addr++, *p);
+        }
+        add_data_word(gen, addr, 0);
+    } else {
+        char buffer[128];
+        char address[RELOC_TEXT_SIZE];
+        snprintf(buffer, sizeof(buffer), "li x2, %s", address_text(gen, str_addr, address));
         add_output(gen, buffer);
+        for (const char *p = start; *p && *p != '"'; p++) {
+            snprintf(buffer, sizeof(buffer), "li x1, %d", *p);
+            add_output(gen, buffer);
+            add_output(gen, "sw x2, 0, x1");
+            add_output(gen, "addi x2, x2, 1");
+        }
+        add_output(gen, "li x1, 0");
         add_output(gen, "sw x2, 0, x1");
-        add_output(gen, "addi x2, x2, 1");
     }
-    add_output(gen, "li x1, 0");
-    add_output(gen, "sw x2, 0, x1");
+    gen->memory_pos = str_addr + strlen(str) + 10;
+    return str_addr;
+}
+
+static int add_string_data(RISCGenerator *gen, const char *str) {
+    int str_addr = gen->memory_pos;
+    int addr = str_addr;
+    for (const char *p = str; *p; p++) {
+        add_data_word(gen, addr++, *p);
+    }
+    add_data_word(gen, addr, 0);
     gen->memory_pos = str_addr + strlen(str) + 10;
     return str_addr;
 }
@@ -681,8 +1213,6 @@ static void process_print(RISCGenerator *gen, ASTNode *node) {
         add_output(gen, "Warning: Invalid print statement");
         return;
     }
-    int line = get_current_line();
-    int column = get_current_column();
     char buffer[128];
     if (node->print.expression->type == NODE_IDENTIFIER) {
         const char *var_name = node->print.expression->identifier.name;
@@ -702,22 +1232,23 @@ static void process_print(RISCGenerator *gen, ASTNode *node) {
          is_string_variable(gen, node->print.expression->identifier.name))) {
         char *print_loop_label = get_new_label(gen, "print_loop");
         char *print_done_label = get_new_label(gen, "print_done");
-        snprintf(buffer, sizeof(buffer), "%s:", print_loop_label);
-        add_output(gen, buffer);
-    add_output(gen, "lw x2, x1, 0");
+        add_output(gen, "lw x2, x1, 0");
         snprintf(buffer, sizeof(buffer), "beq x2, x0, %s", print_done_label);
         add_output(gen, buffer);
-    add_output(gen, "ewrite x2");
-    add_output(gen, "addi x1, x1, 1");
-        snprintf(buffer, sizeof(buffer), "jal x0, %s", print_loop_label);
+        snprintf(buffer, sizeof(buffer), "%s:", print_loop_label);
+        add_output(gen, buffer);
+        add_output(gen, "ewrite x2");
+        add_output(gen, "addi x1, x1, 1");
+        add_output(gen, "lw x2, x1, 0");
+        snprintf(buffer, sizeof(buffer), "bne x2, x0, %s", print_loop_label);
         add_output(gen, buffer);
         snprintf(buffer, sizeof(buffer), "%s:", print_done_label);
         add_output(gen, buffer);
-        free(print_loop_label);
-        free(print_done_label);
+        tagged_free(ALLOC_TEMP, print_loop_label);
+        tagged_free(ALLOC_TEMP, print_done_label);
     } else {
         add_output(gen, "addi x10, x0, 10");
-        add_output(gen, "addi x11, x0, 1023");
+        add_output(gen, "addi x11, x0, 999");
         add_output(gen, "addi x12, x1, 0");
         add_output(gen, "addi x13, x0, 0");
         add_output(gen, "addi x14, x11, 0");
@@ -749,8 +1280,8 @@ static void process_print(RISCGenerator *gen, ASTNode *node) {
     }
     add_output(gen, "li x2, 10");
     add_output(gen, "ewrite x2");
-    free(producer_loop_label);
-    free(after_minus_label);
+    tagged_free(ALLOC_TEMP, producer_loop_label);
+    tagged_free(ALLOC_TEMP, after_minus_label);
 }
 
 static void process_assignment(RISCGenerator *gen, ASTNode *node) {
@@ -762,10 +1293,11 @@ static void process_assignment(RISCGenerator *gen, ASTNode *node) {
         return;
     }
     if (!error_is_critical()) {
+        char address[RELOC_TEXT_SIZE];
         snprintf(buffer, sizeof(buffer), "Assignment to %s", target);
     add_output(gen, buffer);
         evaluate_expression(gen, node->assignment.value, "x1");
-        snprintf(buffer, sizeof(buffer), "li x2, %d", var_addr, target);
+        snprintf(buffer, sizeof(buffer), "li x2, %s", address_text(gen, var_addr, address));
             add_output(gen, buffer);
         add_output(gen, "sw x2, 0, x1");
     }
@@ -773,6 +1305,7 @@ static void process_assignment(RISCGenerator *gen, ASTNode *node) {
 
 static int concatenate_strings(RISCGenerator *gen, const char *reg1, const char *reg2) {
     char buffer[128];
+    char address[RELOC_TEXT_SIZE];
     int result_addr = gen->memory_pos;
     char* first_loop_label = get_new_label(gen, "copy_first");
     char* second_loop_label = get_new_label(gen, "copy_second");
@@ -784,16 +1317,18 @@ static int concatenate_strings(RISCGenerator *gen, const char *reg1, const char
     snprintf(buffer, sizeof(buffer), "add x4, %s, x0", reg2);
     add_output(gen, buffer);
     add_output(gen, "Copy first string");
-    snprintf(buffer, sizeof(buffer), "li x2, %d", result_addr);
+    snprintf(buffer, sizeof(buffer), "li x2, %s", address_text(gen, result_addr, address));
+    add_output(gen, buffer);
+    // Завершающий ноль первой строки не копируется: пустая строка пропускает цикл
+    add_output(gen, "lw x1, x3, 0");
+    snprintf(buffer, sizeof(buffer), "beq x1, x0, %s", first_done_label);
     add_output(gen, buffer);
     snprintf(buffer, sizeof(buffer), "%s:", first_loop_label);
     add_output(gen, buffer);
-    add_output(gen, "lw x1, x3, 0");
     add_output(gen, "sw x2, 0, x1");
     add_output(gen, "addi x2, x2, 1");
     add_output(gen, "addi x3, x3, 1");
-    snprintf(buffer, sizeof(buffer), "lw x1, x3, 0");
-    add_output(gen, buffer);
+    add_output(gen, "lw x1, x3, 0");
     snprintf(buffer, sizeof(buffer), "bne x1, x0, %s", first_loop_label);
     add_output(gen, buffer);
     snprintf(buffer, sizeof(buffer), "%s:", first_done_label);
@@ -802,174 +1337,1145 @@ static int concatenate_strings(RISCGenerator *gen, const char *reg1, const char
     add_output(gen, buffer);
     add_output(gen, "lw x1, x4, 0");
     add_output(gen, "sw x2, 0, x1");
-    snprintf(buffer, sizeof(buffer), "beq x1, x0, %s", second_done_label);
-    add_output(gen, buffer);
     add_output(gen, "addi x2, x2, 1");
     add_output(gen, "addi x4, x4, 1");
-    snprintf(buffer, sizeof(buffer), "jal x0, %s", second_loop_label);
+    snprintf(buffer, sizeof(buffer), "bne x1, x0, %s", second_loop_label);
     add_output(gen, buffer);
     snprintf(buffer, sizeof(buffer), "%s:", second_done_label);
     add_output(gen, buffer);
     gen->memory_pos = result_addr + 100;
-    free(first_loop_label);
-    free(second_loop_label);
-    free(first_done_label);
-    free(second_done_label);
+    tagged_free(ALLOC_TEMP, first_loop_label);
+    tagged_free(ALLOC_TEMP, second_loop_label);
+    tagged_free(ALLOC_TEMP, first_done_label);
+    tagged_free(ALLOC_TEMP, second_done_label);
     return result_addr;
 }
 
-static void process_if_statement(RISCGenerator *gen, ASTNode *node) {
-    if (!gen || !node) return;
+// Шаги операторов с вложенными операторами: каждый шаг выводит код до
+// очередного вложенного оператора и возвращает его в *child (0) или
+// завершает оператор (1). Вложенный оператор обрабатывает process_node
+static int if_statement_step(RISCGenerator *gen, StatementFrame *frame, ASTNode **child) {
     char buffer[1024];
-    char *else_label = get_new_label(gen, "else");
-    char *end_label = get_new_label(gen, "endif");
-    add_output(gen, "Begin if-statement");
-    evaluate_expression(gen, node->if_stmt.condition, "x1");
-    snprintf(buffer, sizeof(buffer), "beq x1, x0, %s", else_label);
-    add_output(gen, buffer);
-    int prev_scope = gen->current_scope_is_global;
-    int prev_block_level = gen->block_level;
-    gen->block_level++;
-    gen->current_scope_is_global = 0;
-    process_node(gen, node->if_stmt.then_branch);
-    gen->current_scope_is_global = prev_scope;
-    gen->block_level = prev_block_level;
-    snprintf(buffer, sizeof(buffer), "jal x0, %s", end_label);
-    add_output(gen, buffer);
-    snprintf(buffer, sizeof(buffer), "%s:", else_label);
-    add_output(gen, buffer);
-    if (node->if_stmt.else_branch) {
-        int prev_scope_else = gen->current_scope_is_global;
-        int prev_block_level_else = gen->block_level;
-        gen->block_level++;
-        gen->current_scope_is_global = 0;
-        process_node(gen, node->if_stmt.else_branch);
-        gen->current_scope_is_global = prev_scope_else;
-        gen->block_level = prev_block_level_else;
+    ASTNode *node = frame->node;
+    if (frame->stage == 0) {
+        frame->labels[0] = get_new_label(gen, "else");
+        frame->labels[1] = get_new_label(gen, "endif");
+        add_output(gen, "Begin if-statement");
+        evaluate_expression(gen, node->if_stmt.condition, "x1");
+        snprintf(buffer, sizeof(buffer), "beq x1, x0, %s", frame->labels[0]);
+        add_output(gen, buffer);
+        enter_scope(gen, &frame->mark);
+        frame->stage = 1;
+        *child = node->if_stmt.then_branch;
+        return 0;
     }
-    snprintf(buffer, sizeof(buffer), "%s:", end_label);
+    leave_scope(gen, &frame->mark);
+    if (frame->stage == 1) {
+        snprintf(buffer, sizeof(buffer), "jal x0, %s", frame->labels[1]);
+        add_output(gen, buffer);
+        snprintf(buffer, sizeof(buffer), "%s:", frame->labels[0]);
+        add_output(gen, buffer);
+        if (node->if_stmt.else_branch) {
+            enter_scope(gen, &frame->mark);
+            frame->stage = 2;
+            *child = node->if_stmt.else_branch;
+            return 0;
+        }
+    }
+    snprintf(buffer, sizeof(buffer), "%s:", frame->labels[1]);
     add_output(gen, buffer);
     add_output(gen, "End if-statement");
-    free(else_label);
-    free(end_label);
+    return 1;
 }
 
-static void process_while_loop(RISCGenerator *gen, ASTNode *node) {
-    if (!gen || !node) return;
+static int while_loop_step(RISCGenerator *gen, StatementFrame *frame, ASTNode **child) {
     char buffer[1024];
-    char *loop_label = get_new_label(gen, "while");
-    char *end_label = get_new_label(gen, "endwhile");
-    add_output(gen, "Begin while-loop");
-    snprintf(buffer, sizeof(buffer), "%s:", loop_label);
-    add_output(gen, buffer);
-    evaluate_expression(gen, node->while_loop.condition, "x1");
-    snprintf(buffer, sizeof(buffer), "beq x1, x0, %s", end_label);
-    add_output(gen, buffer);
-    int prev_scope = gen->current_scope_is_global;
-    int prev_block_level = gen->block_level;
-    gen->block_level++;
-    gen->current_scope_is_global = 0;
-    process_node(gen, node->while_loop.body);
-    gen->current_scope_is_global = prev_scope;
-    gen->block_level = prev_block_level;
-    snprintf(buffer, sizeof(buffer), "jal x0, %s", loop_label);
-    add_output(gen, buffer);
+    ASTNode *node = frame->node;
+    char *loop_label = frame->labels[0];
+    char *end_label = frame->labels[1];
+    if (frame->stage == 0) {
+        loop_label = frame->labels[0] = get_new_label(gen, "while");
+        end_label = frame->labels[1] = get_new_label(gen, "endwhile");
+        add_output(gen, "Begin while-loop");
+        if (!gen->rotate_loops) {
+            // Условие в заголовке: короче, но каждая итерация платит за переход назад
+            snprintf(buffer, sizeof(buffer), "%s:", loop_label);
+            add_output(gen, buffer);
+            evaluate_expression(gen, node->while_loop.condition, "x1");
+            snprintf(buffer, sizeof(buffer), "beq x1, x0, %s", end_label);
+            add_output(gen, buffer);
+        } else {
+            // Цикл развёрнут в форму guarded do-while: условие проверяется один раз
+            // перед входом и затем в конце каждой итерации, без безусловного перехода
+            evaluate_expression(gen, node->while_loop.condition, "x1");
+            snprintf(buffer, sizeof(buffer), "beq x1, x0, %s", end_label);
+            add_output(gen, buffer);
+            snprintf(buffer, sizeof(buffer), "%s:", loop_label);
+            add_output(gen, buffer);
+        }
+        enter_scope(gen, &frame->mark);
+        frame->stage = 1;
+        *child = node->while_loop.body;
+        return 0;
+    }
+    leave_scope(gen, &frame->mark);
+    if (!gen->rotate_loops) {
+        snprintf(buffer, sizeof(buffer), "jal x0, %s", loop_label);
+        add_output(gen, buffer);
+    } else {
+        // Условие уже сгенерировано перед входом в цикл: его ошибки не выводятся второй раз
+        ErrorState *errors = &compile_context_current()->errors;
+        errors->repeat++;
+        evaluate_expression(gen, node->while_loop.condition, "x1");
+        errors->repeat--;
+        snprintf(buffer, sizeof(buffer), "bne x1, x0, %s", loop_label);
+        add_output(gen, buffer);
+    }
     snprintf(buffer, sizeof(buffer), "%s:", end_label);
     add_output(gen, buffer);
     add_output(gen, "End while-loop");
-    free(loop_label);
-    free(end_label);
+    return 1;
 }
 
-static void process_round_loop(RISCGenerator *gen, ASTNode *node) {
-    if (!gen || !node) return;
+static int round_loop_step(RISCGenerator *gen, StatementFrame *frame, ASTNode **child) {
     char buffer[1024];
-    char *var_name = node->round_loop.variable;
-    int var_addr = get_variable_address(gen, var_name);
-    char *loop_label = get_new_label(gen, "round");
-    char *end_label = get_new_label(gen, "endround");
-    char *body_label = get_new_label(gen, "body");
-    add_output(gen, "Begin round loop");
-    evaluate_expression(gen, node->round_loop.start, "x1");
-    add_output(gen, "add x20, x1, x0");
-    snprintf(buffer, sizeof(buffer), "li x2, %d", var_addr);
-    add_output(gen, buffer);
-    add_output(gen, "sw x2, 0, x20");
-    evaluate_expression(gen, node->round_loop.end, "x1");
-    add_output(gen, "add x21, x1, x0");
-    if (node->round_loop.step) {
-        evaluate_expression(gen, node->round_loop.step, "x1");
-        add_output(gen, "add x22, x1, x0");
-    } else {
-        add_output(gen, "addi x22, x0, 1");
+    char address[RELOC_TEXT_SIZE];
+    ASTNode *node = frame->node;
+    if (frame->stage == 0) {
+        frame->address = get_variable_address(gen, node->round_loop.variable);
+        address_text(gen, frame->address, address);
+        frame->labels[0] = get_new_label(gen, "round");
+        frame->labels[1] = get_new_label(gen, "endround");
+        frame->labels[2] = get_new_label(gen, "body");
+        add_output(gen, "Begin round loop");
+        evaluate_expression(gen, node->round_loop.start, "x1");
+        add_output(gen, "add x20, x1, x0");
+        snprintf(buffer, sizeof(buffer), "li x2, %s", address);
+        add_output(gen, buffer);
+        add_output(gen, "sw x2, 0, x20");
+        evaluate_expression(gen, node->round_loop.end, "x1");
+        add_output(gen, "add x21, x1, x0");
+        if (node->round_loop.step) {
+            evaluate_expression(gen, node->round_loop.step, "x1");
+            add_output(gen, "add x22, x1, x0");
+        } else {
+            add_output(gen, "addi x22, x0, 1");
+        }
+        snprintf(buffer, sizeof(buffer), "jal x0, %s", frame->labels[0]);
+        add_output(gen, buffer);
+        snprintf(buffer, sizeof(buffer), "%s:", frame->labels[2]);
+        add_output(gen, buffer);
+        snprintf(buffer, sizeof(buffer), "li x2, %s", address);
+        add_output(gen, buffer);
+        add_output(gen, "sw x2, 0, x20");
+        enter_scope(gen, &frame->mark);
+        frame->stage = 1;
+        *child = node->round_loop.body;
+        return 0;
     }
-    snprintf(buffer, sizeof(buffer), "jal x0, %s", loop_label);
-    add_output(gen, buffer);
-    snprintf(buffer, sizeof(buffer), "%s:", body_label);
-    add_output(gen, buffer);
-    snprintf(buffer, sizeof(buffer), "li x2, %d", var_addr);
-    add_output(gen, buffer);
-    add_output(gen, "sw x2, 0, x20");
-    int prev_scope = gen->current_scope_is_global;
-    int prev_block_level = gen->block_level;
-    gen->block_level++;
-    gen->current_scope_is_global = 0;
-    process_node(gen, node->round_loop.body);
-    gen->current_scope_is_global = prev_scope;
-    gen->block_level = prev_block_level;
+    leave_scope(gen, &frame->mark);
+    address_text(gen, frame->address, address);
     add_output(gen, "Increment loop variable in dedicated register");
     add_output(gen, "add x20, x20, x22");
-    snprintf(buffer, sizeof(buffer), "li x2, %d", var_addr);
+    snprintf(buffer, sizeof(buffer), "li x2, %s", address);
     add_output(gen, buffer);
     add_output(gen, "sw x2, 0, x20");
-    snprintf(buffer, sizeof(buffer), "%s:", loop_label);
+    snprintf(buffer, sizeof(buffer), "%s:", frame->labels[0]);
     add_output(gen, buffer);
     add_output(gen, "Check loop condition using dedicated registers");
     add_output(gen, "slt x5, x20, x21");
-    snprintf(buffer, sizeof(buffer), "bne x5, x0, %s", body_label);
+    snprintf(buffer, sizeof(buffer), "bne x5, x0, %s", frame->labels[2]);
     add_output(gen, buffer);
-    snprintf(buffer, sizeof(buffer), "%s:", end_label);
+    snprintf(buffer, sizeof(buffer), "%s:", frame->labels[1]);
     add_output(gen, buffer);
     add_output(gen, "End round loop");
-    free(loop_label);
-    free(end_label);
-    free(body_label);
+    return 1;
 }
 
-char *generate_risc_code(ASTNode *ast_root) {
-    if (!ast_root) return NULL;
-    if (error_is_critical()) {
-        fprintf(stderr, "Critical errors found. Code generation aborted.\n");
-        return NULL;
-    }
-    RISCGenerator *gen = init_generator(current_filename);
-    if (!gen) return NULL;
-    process_node(gen, ast_root);
-    if (error_is_critical()) {
-        fprintf(stderr, "Critical errors found during code generation. Output aborted.\n");
-        free_generator(gen);
-        return NULL;
+// Секция .data: ".word <адрес>, <значение>[, ...]" по подряд идущим адресам
+static char *format_data_section(RISCGenerator *gen) {
+    if (gen->data_count == 0) return NULL;
+    size_t capacity = 32 + gen->data_count * 40;
+    char *section = (char *) tagged_malloc(ALLOC_OUTPUT, capacity);
+    if (!section) return NULL;
+    char *pos = section;
+    pos += sprintf(pos, ".data\n");
+    for (size_t i = 0; i < gen->data_count; i++) {
+        if (i > 0 && gen->data[i].address == gen->data[i - 1].address + 1) {
+            pos += sprintf(pos, ", %d", gen->data[i].value);
+        } else {
+            if (i > 0) pos += sprintf(pos, "\n");
+            pos += sprintf(pos, ".word %d, %d", gen->data[i].address, gen->data[i].value);
+        }
     }
+    pos += sprintf(pos, "\n.text\n");
+    return section;
+}
+
+static char *finish_generator(RISCGenerator *gen) {
     add_output(gen, "Exit program");
     add_output(gen, "ebreak");
-    size_t total_length = 0;
+    RiscListing listing = {gen->output, gen->output_size};
+    pass_manager_run_listing(compile_context_current()->pass_manager, &listing);
+    gen->output_size = listing.count;
+    TIME_REPORT_BEGIN("emit");
+    char *data_section = format_data_section(gen);
+    size_t total_length = data_section ? strlen(data_section) : 0;
     for (size_t i = 0; i < gen->output_size; i++) {
         total_length += strlen(gen->output[i]) + 1;
     }
+    // Готовый код принадлежит вызывающему и освобождается free_risc_code
     char *result = (char *) malloc(total_length + 1);
     if (!result) {
+        tagged_free(ALLOC_OUTPUT, data_section);
         free_generator(gen);
+        TIME_REPORT_END();
         return NULL;
     }
-    result[0] = '\0';
+    char *pos = result;
+    if (data_section) {
+        pos += sprintf(pos, "%s", data_section);
+        tagged_free(ALLOC_OUTPUT, data_section);
+    }
+    *pos = '\0';
     for (size_t i = 0; i < gen->output_size; i++) {
-        strcat(result, gen->output[i]);
-        strcat(result, "\n");
+        pos += sprintf(pos, "%s\n", gen->output[i]);
     }
     free_generator(gen);
+    TIME_REPORT_END();
+    return result;
+}
+
+// Выполненная при компиляции часть программы сводится к записи её вывода;
+// состояние переменных попадает в образ данных, а оставшиеся операторы
+// верхнего уровня компилируются как обычно
+static char *generate_evaluated_code(ASTNode *ast_root) {
+    EvalResult result;
+    char buffer[128];
+    CompileContext *ctx = compile_context_current();
+    if (evaluate_program(ast_root, &ctx->eval_budget, &result) != 0) return NULL;
+    if (result.resume_index == 0) {
+        eval_result_free(&result);
+        return NULL;
+    }
+    RISCGenerator *gen = init_generator(ctx->filename);
+    if (!gen) {
+        eval_result_free(&result);
+        return NULL;
+    }
+    if (result.output_length > 0) {
+        add_output(gen, "Output precomputed at compile time");
+    }
+    int last_char = -1;
+    for (size_t i = 0; i < result.output_length; i++) {
+        int c = (signed char) result.output[i];
+        if (c != last_char) {
+            snprintf(buffer, sizeof(buffer), "li x2, %d", c);
+            add_output(gen, buffer);
+            last_char = c;
+        }
+        add_output(gen, "ewrite x2");
+    }
+    for (size_t i = 0; i < result.variable_count; i++) {
+        EvalVariable *var = &result.variables[i];
+        register_variable(gen, var->name, var->type, var->is_global);
+        int var_addr = register_variable_address(gen, var->name, 0);
+        if (var->is_string) {
+            add_data_word(gen, var_addr, add_string_data(gen, var->string_value));
+        } else if (var->int_value != 0) {
+            add_data_word(gen, var_addr, var->int_value);
+        }
+    }
+    gen->current_scope_is_global = 1;
+    gen->block_level = 0;
+    for (size_t i = result.resume_index; i < ast_root->block.children.size; i++) {
+        process_node(gen, ast_root->block.children.items[i]);
+    }
+    eval_result_free(&result);
+    if (error_is_critical()) {
+        free_generator(gen);
+        return NULL;
+    }
+    return finish_generator(gen);
+}
+
+// Шаг collect_declarations: области видимости те же, что у statement_step
+static int declaration_step(RISCGenerator *gen, StatementFrame *frame, ASTNode **child) {
+    ASTNode *node = frame->node;
+    if (!node) return 1;
+    switch (node->type) {
+        case NODE_VARIABLE_DECLARATION:
+            register_variable(gen, node->variable.name, node->variable.var_type, node->variable.is_global);
+            return 1;
+        case NODE_IF_STATEMENT:
+        case NODE_WHILE_LOOP:
+        case NODE_ROUND_LOOP:
+            if (frame->stage > 0) {
+                leave_scope(gen, &frame->mark);
+            }
+            if (frame->stage == 0) {
+                *child = node->type == NODE_IF_STATEMENT ? node->if_stmt.then_branch
+                       : node->type == NODE_WHILE_LOOP ? node->while_loop.body
+                       : node->round_loop.body;
+            } else if (frame->stage == 1 && node->type == NODE_IF_STATEMENT && node->if_stmt.else_branch) {
+                *child = node->if_stmt.else_branch;
+            } else {
+                return 1;
+            }
+            enter_scope(gen, &frame->mark);
+            frame->stage++;
+            return 0;
+        case NODE_BLOCK:
+            if (frame->stage == 0) {
+                enter_scope(gen, &frame->mark);
+                frame->stage = 1;
+            }
+            if (frame->index < node->block.children.size) {
+                *child = node->block.children.items[frame->index++];
+                return 0;
+            }
+            leave_scope(gen, &frame->mark);
+            return 1;
+        default:
+            return 1;
+    }
+}
+
+// Таблица переменных без генерации кода: тот же обход областей видимости,
+// что в process_node, поэтому порядок объявлений и уровни блоков совпадают
+static void collect_declarations(RISCGenerator *gen, ASTNode *node) {
+    size_t base = gen->stmt_count;
+    if (push_statement(gen, node) != 0) return;
+    while (gen->stmt_count > base) {
+        ASTNode *child = NULL;
+        if (declaration_step(gen, &gen->stmt_stack[gen->stmt_count - 1], &child)) {
+            gen->stmt_count--;
+        } else if (push_statement(gen, child) != 0) {
+            gen->stmt_count = base;
+        }
+    }
+}
+
+// Участок подряд идущих операторов верхнего уровня
+typedef struct {
+    ASTNode **statements;
+    size_t count;
+    const RISCGenerator *symbols;   // объявления всей программы
+    size_t first_variable;          // объявлений до участка
+    size_t end_variable;            // объявлений до конца участка
+    const CompileContext *parent;
+    RISCGenerator *gen;
+    int status;                     // 0 — код получен без диагностик
+} CodegenRegion;
+
+// Объявления предыдущих участков с адресами REGION_EXTERN_BASE + номер
+static int share_variables(RISCGenerator *gen, const RISCGenerator *symbols, size_t count) {
+    if (count == 0) return 0;
+    gen->variables = tagged_malloc(ALLOC_SYMBOLS, count * sizeof(*gen->variables));
+    gen->var_addresses = tagged_malloc(ALLOC_SYMBOLS, count * sizeof(*gen->var_addresses));
+    if (!gen->variables || !gen->var_addresses) return -1;
+    memcpy(gen->variables, symbols->variables, count * sizeof(*gen->variables));
+    for (size_t i = 0; i < count; i++) {
+        gen->var_addresses[i].name = symbols->variables[i].name;
+        gen->var_addresses[i].address = REGION_EXTERN_BASE + (int) i;
+    }
+    gen->var_count = gen->addr_count = gen->shared_count = count;
+    gen->var_capacity = gen->addr_capacity = count;
+    return 0;
+}
+
+// Задача пула: участок генерируется в собственном контексте без печати
+// диагностик; при любой из них вся программа генерируется заново последовательно
+static void generate_region(void *arg) {
+    CodegenRegion *region = (CodegenRegion *) arg;
+    CompileContext ctx;
+    compile_context_init(&ctx, region->parent->filename);
+    ctx.line_num = region->parent->line_num;
+    ctx.column_num = region->parent->column_num;
+    ctx.pass_manager = region->parent->pass_manager;
+    ctx.line_info = region->parent->line_info;
+    ctx.errors.quiet = 1;
+    CompileContext *previous = compile_context_bind(&ctx);
+    RISCGenerator *gen = init_generator(ctx.filename);
+    if (gen && share_variables(gen, region->symbols, region->first_variable) == 0) {
+        gen->relocatable = 1;
+        gen->memory_pos = 0;
+        for (size_t i = 0; i < region->count; i++) {
+            process_node(gen, region->statements[i]);
+        }
+        if (!error_has_errors() && !error_is_critical() &&
+            gen->var_count == region->end_variable && gen->addr_count == region->end_variable) {
+            region->status = 0;
+        }
+    }
+    region->gen = gen;
+    error_free();
+    compile_context_bind(previous);
+    compile_context_free(&ctx);
+}
+
+// Размещение участка или фрагмента в собранной программе
+typedef struct {
+    RISCGenerator *program;         // собранный код, memory_pos, кадр и счётчик меток
+    const int *addresses;           // итоговые адреса объявлений по порядку
+    const size_t *imports;          // номер объявления по номеру импорта или NULL
+    const FragmentFrameEvent *frame_events;
+    size_t frame_event_count;
+    int memory_base;
+    int label_base;
+    int *frame_allocated;           // новых ячеек кадра по событие включительно
+} RegionPlacement;
+
+static int place_address(const RegionPlacement *placement, int address) {
+    if (address >= REGION_EXTERN_BASE) {
+        size_t index = (size_t) (address - REGION_EXTERN_BASE);
+        return placement->addresses[placement->imports ? placement->imports[index] : index];
+    }
+    if (address >= REGION_FRAME_BASE) {
+        return placement->program->frame_slots[address - REGION_FRAME_BASE];
+    }
+    // Собственная ячейка участка сдвигается на ячейки кадра, выделенные раньше неё
+    size_t low = 0;
+    size_t high = placement->frame_event_count;
+    while (low < high) {
+        size_t middle = (low + high) / 2;
+        if (placement->frame_events[middle].position <= address) {
+            low = middle + 1;
+        } else {
+            high = middle;
+        }
+    }
+    return placement->memory_base + address + (low > 0 ? placement->frame_allocated[low - 1] : 0);
+}
+
+// Текст с пометками, в которых адреса и номера меток заменены итоговыми
+static char *relocate_text(const RegionPlacement *placement, const char *text, size_t length, size_t marks) {
+    // Пометка длиной не меньше 4 символов заменяется числом не длиннее 11
+    char *result = (char *) tagged_malloc(ALLOC_OUTPUT, length + marks * 4 + 1);
+    if (!result) return NULL;
+    char *pos = result;
+    const char *c = text;
+    const char *end_text = text + length;
+    while (c < end_text) {
+        if (*c != RELOC_MARK) {
+            *pos++ = *c++;
+            continue;
+        }
+        char *end;
+        int value = (int) strtol(c + 2, &end, 10);
+        if (c[1] == 'L') {
+            pos += sprintf(pos, "%d", placement->label_base + value);
+        } else {
+            pos += sprintf(pos, "%d", place_address(placement, value));
+        }
+        c = *end == RELOC_MARK ? end + 1 : end;
+    }
+    *pos = '\0';
     return result;
 }
 
+// Заменяет пометки в строке участка итоговыми адресами и номерами меток
+static char *relocate_line(const RegionPlacement *placement, char *line) {
+    size_t marks = 0;
+    for (const char *c = line; *c; c++) {
+        if (*c == RELOC_MARK) marks++;
+    }
+    if (marks == 0) return line;
+    char *result = relocate_text(placement, line, strlen(line), marks);
+    if (!result) return NULL;
+    tagged_free(ALLOC_OUTPUT, line);
+    return result;
+}
+
+// Переносит готовую строку в листинг без копирования
+static int take_output(RISCGenerator *gen, char *line) {
+    if (gen->output_size >= gen->output_capacity) {
+        size_t new_capacity = gen->output_capacity == 0 ? 16 : gen->output_capacity * 2;
+        char **new_output = (char **) tagged_realloc(ALLOC_OUTPUT, gen->output, gen->output_capacity * sizeof(char *),
+                                                     new_capacity * sizeof(char *));
+        if (!new_output) return -1;
+        gen->output = new_output;
+        gen->output_capacity = new_capacity;
+    }
+    gen->output[gen->output_size++] = line;
+    return 0;
+}
+
+/**
+ * Выделяет новые ячейки кадра участка в том же порядке, что и при
+ * последовательной генерации: ячейка, уже выделенная предыдущими
+ * участками, переиспользуется.
+ * @return Число новых ячеек или -1 при нехватке памяти
+ */
+static int place_frame_events(RegionPlacement *placement) {
+    RISCGenerator *program = placement->program;
+    if (placement->frame_event_count > 0) {
+        placement->frame_allocated = (int *) tagged_malloc(ALLOC_TEMP, placement->frame_event_count * sizeof(int));
+        if (!placement->frame_allocated) return -1;
+    }
+    int allocated = 0;
+    for (size_t i = 0; i < placement->frame_event_count; i++) {
+        size_t slot = (size_t) placement->frame_events[i].slot;
+        if (slot > program->frame_size) return -1;
+        if (slot == program->frame_size) {
+            if (program->frame_size >= program->frame_capacity) {
+                size_t new_capacity = program->frame_capacity == 0 ? 8 : program->frame_capacity * 2;
+                int *new_slots = (int *) tagged_realloc(ALLOC_TEMP, program->frame_slots,
+                                                        program->frame_capacity * sizeof(int),
+                                                        new_capacity * sizeof(int));
+                if (!new_slots) return -1;
+                program->frame_slots = new_slots;
+                program->frame_capacity = new_capacity;
+            }
+            program->frame_slots[program->frame_size++] =
+                placement->memory_base + placement->frame_events[i].position + allocated;
+            allocated++;
+        }
+        placement->frame_allocated[i] = allocated;
+    }
+    return allocated;
+}
+
+/**
+ * Дописывает участок к собранной программе.
+ * @param addresses Итоговые адреса объявлений; дополняются объявлениями участка
+ */
+static int place_region(RISCGenerator *program, int *addresses, const CodegenRegion *region) {
+    RISCGenerator *gen = region->gen;
+    RegionPlacement placement = {program, addresses, NULL, gen->frame_events, gen->frame_event_count,
+                                 program->memory_pos, program->label_counter, NULL};
+    int allocated = place_frame_events(&placement);
+    if (allocated < 0) {
+        tagged_free(ALLOC_TEMP, placement.frame_allocated);
+        return -1;
+    }
+    for (size_t i = gen->shared_count; i < gen->addr_count; i++) {
+        addresses[i] = place_address(&placement, gen->var_addresses[i].address);
+    }
+    int status = 0;
+    for (size_t i = 0; i < gen->output_size && status == 0; i++) {
+        char *line = relocate_line(&placement, gen->output[i]);
+        if (!line || take_output(program, line) != 0) {
+            status = -1;
+            if (line) gen->output[i] = line;
+        } else {
+            gen->output[i] = NULL;
+        }
+    }
+    for (size_t i = 0; i < gen->data_count && status == 0; i++) {
+        int value = gen->data[i].value;
+        if (gen->data[i].relocate_value) {
+            value = place_address(&placement, value);
+        }
+        add_data_word(program, place_address(&placement, gen->data[i].address), value);
+    }
+    program->memory_pos = placement.memory_base + gen->memory_pos + allocated;
+    program->label_counter += gen->label_counter;
+    tagged_free(ALLOC_TEMP, placement.frame_allocated);
+    return status;
+}
+
+// Генерирует участки на пуле и собирает их по порядку; NULL при любой неудаче
+static RISCGenerator *run_regions(CodegenRegion *regions, size_t region_count, int threads,
+                                  size_t variable_count) {
+    ThreadPool *pool = thread_pool_create(threads);
+    if (!pool) return NULL;
+    for (size_t r = 0; r < region_count; r++) {
+        if (thread_pool_submit(pool, generate_region, &regions[r]) != 0) {
+            generate_region(&regions[r]);
+        }
+    }
+    thread_pool_wait(pool);
+    thread_pool_free(pool);
+    for (size_t r = 0; r < region_count; r++) {
+        if (regions[r].status != 0) return NULL;
+    }
+    int *addresses = (int *) tagged_malloc(ALLOC_TEMP, (variable_count > 0 ? variable_count : 1) * sizeof(int));
+    if (!addresses) return NULL;
+    RISCGenerator *program = init_generator(compile_context_current()->filename);
+    for (size_t r = 0; program && r < region_count; r++) {
+        if (place_region(program, addresses, &regions[r]) != 0) {
+            free_generator(program);
+            program = NULL;
+        }
+    }
+    tagged_free(ALLOC_TEMP, addresses);
+    return program;
+}
+
+/**
+ * Делит программу на участки подряд идущих операторов верхнего уровня
+ * и генерирует их параллельно. Метки и адреса участка локальны; при сборке
+ * они сдвигаются так, что код совпадает с последовательной генерацией.
+ * @return Генератор с собранным кодом или NULL, если программу нужно
+ *         генерировать последовательно (она мала или в ней есть ошибки)
+ */
+static RISCGenerator *generate_parallel(ASTNode *program, int threads) {
+    size_t count = program->block.children.size;
+    size_t region_count = (size_t) threads * REGIONS_PER_THREAD;
+    if (region_count > count / REGION_MIN_STATEMENTS) {
+        region_count = count / REGION_MIN_STATEMENTS;
+    }
+    if (region_count < 2) return NULL;
+    CompileContext *ctx = compile_context_current();
+    RISCGenerator *symbols = init_generator(ctx->filename);
+    CodegenRegion *regions = (CodegenRegion *) tagged_calloc(ALLOC_TEMP, region_count, sizeof(CodegenRegion));
+    RISCGenerator *result = NULL;
+    if (symbols && regions) {
+        size_t first = 0;
+        for (size_t r = 0; r < region_count; r++) {
+            size_t last = count * (r + 1) / region_count;
+            regions[r].statements = program->block.children.items + first;
+            regions[r].count = last - first;
+            regions[r].symbols = symbols;
+            regions[r].first_variable = symbols->var_count;
+            regions[r].parent = ctx;
+            regions[r].status = -1;
+            for (size_t i = first; i < last; i++) {
+                collect_declarations(symbols, program->block.children.items[i]);
+            }
+            regions[r].end_variable = symbols->var_count;
+            first = last;
+        }
+        result = run_regions(regions, region_count, threads, symbols->var_count);
+        if (result) {
+            // Завершение программы относится к ней самой, как при последовательной генерации
+            const RISCGenerator *last = regions[region_count - 1].gen;
+            result->emitted_line = last->emitted_line;
+            result->emitted_column = last->emitted_column;
+            set_location(result, program);
+        }
+        for (size_t r = 0; r < region_count; r++) {
+            if (regions[r].gen) free_generator(regions[r].gen);
+        }
+    }
+    tagged_free(ALLOC_TEMP, regions);
+    if (symbols) free_generator(symbols);
+    return result;
+}
+
+// Объявления с одним именем: от них зависит код любого оператора, который
+// упоминает это имя (поиск в таблице переменных всегда идёт по имени)
+typedef struct {
+    const char *name;               // имя в таблице переменных генератора
+    size_t *indices;                // номера объявлений по порядку
+    size_t count;
+    size_t capacity;
+    CacheKey entries;               // хэш типа, области и уровня блока этих объявлений
+} SymbolName;
+
+// Состояние инкрементальной генерации программы
+typedef struct {
+    RISCGenerator *gen;             // генератор фрагментов: объявления всех операторов
+    RISCGenerator *program;         // собранный код
+    IncrementalState *state;
+    SymbolName *names;              // открытая адресация по имени
+    size_t name_capacity;           // степень двойки
+    size_t name_count;
+    int *addresses;                 // итоговые адреса объявлений
+    int *ordinals;                  // номер объявления среди объявлений с тем же именем
+    int *import_ids;                // номер импорта объявления в текущем фрагменте или -1
+    size_t symbol_capacity;
+    size_t *imports;                // номер объявления по номеру импорта текущего фрагмента
+    size_t import_capacity;
+    const char **statement_names;   // имена, которые упоминает текущий оператор
+    size_t statement_name_count;
+    size_t statement_name_capacity;
+} IncrementalBuild;
+
+static unsigned long hash_string(const char *s) {
+    unsigned long h = 2166136261u;
+    for (; *s; s++) {
+        h = (h ^ (unsigned char) *s) * 16777619u;
+    }
+    return h;
+}
+
+static SymbolName *find_symbol_name(const IncrementalBuild *build, const char *name) {
+    if (build->name_capacity == 0) return NULL;
+    for (size_t s = hash_string(name) & (build->name_capacity - 1); build->names[s].name;
+         s = (s + 1) & (build->name_capacity - 1)) {
+        if (strcmp(build->names[s].name, name) == 0) return &build->names[s];
+    }
+    return NULL;
+}
+
+static SymbolName *add_symbol_name(IncrementalBuild *build, const char *name) {
+    SymbolName *entry = find_symbol_name(build, name);
+    if (entry) return entry;
+    if ((build->name_count + 1) * 2 > build->name_capacity) {
+        size_t new_capacity = build->name_capacity == 0 ? 64 : build->name_capacity * 2;
+        SymbolName *new_names = (SymbolName *) tagged_calloc(ALLOC_TEMP, new_capacity, sizeof(SymbolName));
+        if (!new_names) return NULL;
+        for (size_t i = 0; i < build->name_capacity; i++) {
+            if (!build->names[i].name) continue;
+            size_t s = hash_string(build->names[i].name) & (new_capacity - 1);
+            while (new_names[s].name) s = (s + 1) & (new_capacity - 1);
+            new_names[s] = build->names[i];
+        }
+        tagged_free(ALLOC_TEMP, build->names);
+        build->names = new_names;
+        build->name_capacity = new_capacity;
+    }
+    size_t s = hash_string(name) & (build->name_capacity - 1);
+    while (build->names[s].name) s = (s + 1) & (build->name_capacity - 1);
+    entry = &build->names[s];
+    entry->name = name;
+    compile_cache_key_init(&entry->entries);
+    build->name_count++;
+    return entry;
+}
+
+static int reserve_symbols(IncrementalBuild *build, size_t count) {
+    if (count <= build->symbol_capacity) return 0;
+    size_t new_capacity = build->symbol_capacity == 0 ? 64 : build->symbol_capacity;
+    while (new_capacity < count) new_capacity *= 2;
+    size_t old_size = build->symbol_capacity * sizeof(int);
+    int *addresses = (int *) tagged_realloc(ALLOC_TEMP, build->addresses, old_size, new_capacity * sizeof(int));
+    if (!addresses) return -1;
+    build->addresses = addresses;
+    int *ordinals = (int *) tagged_realloc(ALLOC_TEMP, build->ordinals, old_size, new_capacity * sizeof(int));
+    if (!ordinals) return -1;
+    build->ordinals = ordinals;
+    int *import_ids = (int *) tagged_realloc(ALLOC_TEMP, build->import_ids, old_size, new_capacity * sizeof(int));
+    if (!import_ids) return -1;
+    for (size_t i = build->symbol_capacity; i < new_capacity; i++) import_ids[i] = -1;
+    build->import_ids = import_ids;
+    build->symbol_capacity = new_capacity;
+    return 0;
+}
+
+// Объявления оператора становятся видны следующим операторам по имени
+static int index_declarations(IncrementalBuild *build, size_t first) {
+    RISCGenerator *gen = build->gen;
+    for (size_t i = first; i < gen->var_count; i++) {
+        SymbolName *entry = add_symbol_name(build, gen->variables[i].name);
+        if (!entry) return -1;
+        if (entry->count >= entry->capacity) {
+            size_t new_capacity = entry->capacity == 0 ? 4 : entry->capacity * 2;
+            size_t *new_indices = (size_t *) tagged_realloc(ALLOC_TEMP, entry->indices, entry->capacity * sizeof(size_t),
+                                                            new_capacity * sizeof(size_t));
+            if (!new_indices) return -1;
+            entry->indices = new_indices;
+            entry->capacity = new_capacity;
+        }
+        build->ordinals[i] = (int) entry->count;
+        entry->indices[entry->count++] = i;
+        compile_cache_key_add(&entry->entries, gen->variables[i].type, strlen(gen->variables[i].type) + 1);
+        compile_cache_key_add_long(&entry->entries, gen->variables[i].is_global);
+        compile_cache_key_add_long(&entry->entries, gen->variables[i].block_level);
+        compile_cache_key_add_long(&entry->entries, gen->variables[i].live);
+        // Дальше объявление — чужая ячейка для следующих фрагментов
+        gen->var_addresses[i].address = REGION_EXTERN_BASE + (int) i;
+    }
+    return 0;
+}
+
+// Ключ оператора: его поддерево и объявления всех имён, которые он упоминает
+static int statement_key(IncrementalBuild *build, ASTNode *statement, CacheKey *key) {
+    build->statement_name_count = 0;
+    compile_cache_key_init(key);
+    if (incremental_fingerprint(statement, key, &build->statement_names, &build->statement_name_count,
+                                &build->statement_name_capacity) != 0) {
+        return -1;
+    }
+    for (size_t i = 0; i < build->statement_name_count; i++) {
+        const SymbolName *entry = find_symbol_name(build, build->statement_names[i]);
+        if (entry) {
+            compile_cache_key_add(key, &entry->entries, sizeof(entry->entries));
+        } else {
+            compile_cache_key_add_long(key, -1);
+        }
+    }
+    return 0;
+}
+
+// Адрес объявления предыдущего оператора заменяется номером импорта фрагмента
+static int import_address(IncrementalBuild *build, StatementFragment *fragment, int address) {
+    if (address < REGION_EXTERN_BASE) return address;
+    size_t index = (size_t) (address - REGION_EXTERN_BASE);
+    if (build->import_ids[index] < 0) {
+        if (fragment->import_count >= build->import_capacity) {
+            size_t new_capacity = build->import_capacity == 0 ? 16 : build->import_capacity * 2;
+            size_t *new_imports = (size_t *) tagged_realloc(ALLOC_TEMP, build->imports,
+                                                            build->import_capacity * sizeof(size_t),
+                                                            new_capacity * sizeof(size_t));
+            FragmentImport *new_list = (FragmentImport *) tagged_realloc(ALLOC_OUTPUT, fragment->imports,
+                                                                         build->import_capacity * sizeof(FragmentImport),
+                                                                         new_capacity * sizeof(FragmentImport));
+            if (new_imports) build->imports = new_imports;
+            if (new_list) fragment->imports = new_list;
+            if (!new_imports || !new_list) return -1;
+            build->import_capacity = new_capacity;
+        }
+        FragmentImport *import = &fragment->imports[fragment->import_count];
+        import->name = tagged_strdup(ALLOC_SYMBOLS, build->gen->variables[index].name);
+        if (!import->name) return -1;
+        import->ordinal = build->ordinals[index];
+        build->imports[fragment->import_count] = index;
+        build->import_ids[index] = (int) fragment->import_count++;
+    }
+    return REGION_EXTERN_BASE + build->import_ids[index];
+}
+
+// Код одного оператора из генератора фрагментов; генератор готовится к следующему
+static StatementFragment *take_fragment(IncrementalBuild *build, size_t first) {
+    RISCGenerator *gen = build->gen;
+    StatementFragment *fragment = (StatementFragment *) tagged_calloc(ALLOC_OUTPUT, 1, sizeof(StatementFragment));
+    int status = fragment ? 0 : -1;
+    // import_capacity относится к build->imports; список импортов фрагмента растёт вместе с ним
+    if (fragment && build->import_capacity > 0) {
+        fragment->imports = (FragmentImport *) tagged_malloc(ALLOC_OUTPUT, build->import_capacity * sizeof(FragmentImport));
+        if (!fragment->imports) status = -1;
+    }
+    size_t length = 0;
+    for (size_t i = 0; i < gen->output_size; i++) {
+        length += strlen(gen->output[i]) + 1;
+    }
+    if (status == 0) {
+        fragment->code = (char *) tagged_malloc(ALLOC_OUTPUT, length + 1);
+        if (!fragment->code) status = -1;
+    }
+    char *pos = fragment && fragment->code ? fragment->code : NULL;
+    for (size_t i = 0; i < gen->output_size && status == 0; i++) {
+        // Номер импорта не длиннее номера объявления, поэтому текст не растёт
+        for (const char *c = gen->output[i]; *c && status == 0;) {
+            if (*c != RELOC_MARK) {
+                *pos++ = *c++;
+                continue;
+            }
+            char *end;
+            int value = (int) strtol(c + 2, &end, 10);
+            if (c[1] == 'A') {
+                value = import_address(build, fragment, value);
+                if (value < 0) status = -1;
+            }
+            pos += sprintf(pos, "%c%c%d%c", RELOC_MARK, c[1], value, RELOC_MARK);
+            c = *end == RELOC_MARK ? end + 1 : end;
+        }
+        *pos++ = '\n';
+    }
+    if (status == 0) {
+        *pos = '\0';
+        fragment->code_length = (size_t) (pos - fragment->code);
+    }
+    if (status == 0 && gen->data_count > 0) {
+        fragment->data = (FragmentWord *) tagged_malloc(ALLOC_OUTPUT, gen->data_count * sizeof(FragmentWord));
+        if (!fragment->data) status = -1;
+    }
+    for (size_t i = 0; i < gen->data_count && status == 0; i++) {
+        FragmentWord word = gen->data[i];
+        word.address = import_address(build, fragment, word.address);
+        if (word.relocate_value) word.value = import_address(build, fragment, word.value);
+        if (word.address < 0 || word.value < 0) status = -1;
+        fragment->data[fragment->data_count++] = word;
+    }
+    if (status == 0 && gen->frame_event_count > 0) {
+        fragment->frame_events = (FragmentFrameEvent *) tagged_malloc(ALLOC_OUTPUT,
+                                                                      gen->frame_event_count * sizeof(FragmentFrameEvent));
+        if (fragment->frame_events) {
+            memcpy(fragment->frame_events, gen->frame_events, gen->frame_event_count * sizeof(FragmentFrameEvent));
+            fragment->frame_event_count = gen->frame_event_count;
+        } else {
+            status = -1;
+        }
+    }
+    if (status == 0 && gen->var_count > first) {
+        fragment->variables = (FragmentVariable *) tagged_calloc(ALLOC_OUTPUT, gen->var_count - first,
+                                                                 sizeof(FragmentVariable));
+        if (!fragment->variables) status = -1;
+    }
+    for (size_t i = first; i < gen->var_count && status == 0; i++) {
+        FragmentVariable *var = &fragment->variables[fragment->variable_count++];
+        var->name = tagged_strdup(ALLOC_SYMBOLS, gen->variables[i].name);
+        var->type = tagged_strdup(ALLOC_SYMBOLS, gen->variables[i].type);
+        var->is_global = gen->variables[i].is_global;
+        var->block_level = gen->variables[i].block_level;
+        var->live = gen->variables[i].live;
+        var->address = gen->var_addresses[i].address;
+        if (!var->name || !var->type) status = -1;
+    }
+    if (fragment) {
+        fragment->memory_size = gen->memory_pos;
+        fragment->label_count = gen->label_counter;
+        for (size_t i = 0; i < fragment->import_count; i++) {
+            build->import_ids[build->imports[i]] = -1;
+        }
+    }
+    for (size_t i = 0; i < gen->output_size; i++) {
+        tagged_free(ALLOC_OUTPUT, gen->output[i]);
+    }
+    gen->output_size = 0;
+    gen->data_count = 0;
+    gen->frame_event_count = 0;
+    gen->frame_size = 0;
+    gen->memory_pos = 0;
+    gen->label_counter = 0;
+    if (status != 0) {
+        statement_fragment_free(fragment);
+        return NULL;
+    }
+    return fragment;
+}
+
+// Объявления фрагмента из состояния дописываются в генератор фрагментов;
+// импорты сопоставляются объявлениям по имени и порядковому номеру
+static int restore_fragment(IncrementalBuild *build, const StatementFragment *fragment) {
+    RISCGenerator *gen = build->gen;
+    if (fragment->import_count > build->import_capacity) {
+        size_t *new_imports = (size_t *) tagged_realloc(ALLOC_TEMP, build->imports,
+                                                        build->import_capacity * sizeof(size_t),
+                                                        fragment->import_count * sizeof(size_t));
+        if (!new_imports) return -1;
+        build->imports = new_imports;
+        build->import_capacity = fragment->import_count;
+    }
+    for (size_t i = 0; i < fragment->import_count; i++) {
+        const SymbolName *entry = find_symbol_name(build, fragment->imports[i].name);
+        int ordinal = fragment->imports[i].ordinal;
+        if (!entry || ordinal < 0 || (size_t) ordinal >= entry->count) return -1;
+        build->imports[i] = entry->indices[ordinal];
+    }
+    // Ячейки фрагмента размещает place_fragment; счётчик генератора фрагментов не меняется
+    int memory_pos = gen->memory_pos;
+    for (size_t i = 0; i < fragment->variable_count; i++) {
+        const FragmentVariable *var = &fragment->variables[i];
+        size_t index = gen->var_count;
+        register_variable(gen, var->name, var->type, var->is_global);
+        if (gen->var_count != index + 1 || register_variable_address(gen, var->name, 0) < 0 ||
+            gen->addr_count != gen->var_count) {
+            return -1;
+        }
+        gen->variables[index].block_level = var->block_level;
+        gen->variables[index].live = var->live;
+        gen->var_addresses[index].address = var->address;
+    }
+    gen->memory_pos = memory_pos;
+    return 0;
+}
+
+// Дописывает фрагмент к собранной программе (как place_region)
+static int place_fragment(IncrementalBuild *build, const StatementFragment *fragment, size_t first) {
+    RISCGenerator *program = build->program;
+    RegionPlacement placement = {program, build->addresses, build->imports, fragment->frame_events,
+                                 fragment->frame_event_count, program->memory_pos, program->label_counter, NULL};
+    int allocated = place_frame_events(&placement);
+    int status = allocated < 0 ? -1 : 0;
+    for (size_t i = 0; i < fragment->variable_count && status == 0; i++) {
+        build->addresses[first + i] = place_address(&placement, fragment->variables[i].address);
+    }
+    const char *line = fragment->code;
+    const char *code_end = fragment->code + fragment->code_length;
+    while (line < code_end && status == 0) {
+        const char *end = line;
+        size_t marks = 0;
+        while (end < code_end && *end != '\n') {
+            if (*end == RELOC_MARK) marks++;
+            end++;
+        }
+        char *text = relocate_text(&placement, line, (size_t) (end - line), marks);
+        if (!text || take_output(program, text) != 0) {
+            tagged_free(ALLOC_OUTPUT, text);
+            status = -1;
+        }
+        line = end + 1;
+    }
+    for (size_t i = 0; i < fragment->data_count && status == 0; i++) {
+        int value = fragment->data[i].value;
+        if (fragment->data[i].relocate_value) {
+            value = place_address(&placement, value);
+        }
+        add_data_word(program, place_address(&placement, fragment->data[i].address), value);
+    }
+    if (status == 0) {
+        program->memory_pos = placement.memory_base + fragment->memory_size + allocated;
+        program->label_counter += fragment->label_count;
+    }
+    tagged_free(ALLOC_TEMP, placement.frame_allocated);
+    return status;
+}
+
+static int incremental_statement(IncrementalBuild *build, ASTNode *statement) {
+    RISCGenerator *gen = build->gen;
+    size_t first = gen->var_count;
+    CacheKey key;
+    if (statement_key(build, statement, &key) != 0) return -1;
+    const StatementFragment *fragment = incremental_state_find(build->state, &key);
+    if (fragment) {
+        if (restore_fragment(build, fragment) != 0) return -1;
+    } else {
+        process_node(gen, statement);
+        if (error_has_errors() || error_is_critical() || gen->addr_count != gen->var_count) return -1;
+        StatementFragment *fresh = take_fragment(build, first);
+        if (!fresh) return -1;
+        fresh->key = key;
+        if (incremental_state_add(build->state, fresh) != 0) {
+            statement_fragment_free(fresh);
+            return -1;
+        }
+        fragment = fresh;
+    }
+    if (reserve_symbols(build, gen->var_count) != 0) return -1;
+    if (place_fragment(build, fragment, first) != 0) return -1;
+    return index_declarations(build, first);
+}
+
+/**
+ * Генерирует программу по операторам верхнего уровня: каждый оператор —
+ * перемещаемый фрагмент, как участок generate_parallel из одного оператора.
+ * Фрагмент берётся из состояния, если совпали поддерево оператора и все
+ * объявления имён, которые он упоминает; иначе оператор генерируется заново.
+ * @return Генератор с собранным кодом или NULL, если программу нужно
+ *         генерировать обычным способом (в ней есть ошибки)
+ */
+static RISCGenerator *generate_incremental(ASTNode *program, IncrementalState *state) {
+    CompileContext *parent = compile_context_current();
+    IncrementalBuild build;
+    memset(&build, 0, sizeof(build));
+    build.state = state;
+    build.program = init_generator(parent->filename);
+    if (!build.program) return NULL;
+    // Диагностики не печатаются: при любой из них программа генерируется заново
+    CompileContext ctx;
+    compile_context_init(&ctx, parent->filename);
+    ctx.line_num = parent->line_num;
+    ctx.column_num = parent->column_num;
+    ctx.pass_manager = parent->pass_manager;
+    ctx.errors.quiet = 1;
+    CompileContext *previous = compile_context_bind(&ctx);
+    build.gen = init_generator(ctx.filename);
+    int status = build.gen ? 0 : -1;
+    if (build.gen) {
+        build.gen->relocatable = 1;
+        build.gen->memory_pos = 0;
+    }
+    incremental_state_begin(state);
+    for (size_t i = 0; i < program->block.children.size && status == 0; i++) {
+        status = incremental_statement(&build, program->block.children.items[i]);
+    }
+    incremental_state_finish(state, status == 0);
+    if (build.gen) free_generator(build.gen);
+    error_free();
+    compile_context_bind(previous);
+    compile_context_free(&ctx);
+    for (size_t i = 0; i < build.name_capacity; i++) {
+        tagged_free(ALLOC_TEMP, build.names[i].indices);
+    }
+    tagged_free(ALLOC_TEMP, build.names);
+    tagged_free(ALLOC_TEMP, build.addresses);
+    tagged_free(ALLOC_TEMP, build.ordinals);
+    tagged_free(ALLOC_TEMP, build.import_ids);
+    tagged_free(ALLOC_TEMP, build.imports);
+    tagged_free(ALLOC_TEMP, (void *) build.statement_names);
+    if (status != 0) {
+        free_generator(build.program);
+        return NULL;
+    }
+    return build.program;
+}
+
+char *generate_risc_code(ASTNode *ast_root) {
+    CompileContext *ctx = compile_context_current();
+    if (!ast_root) return NULL;
+    if (error_is_critical()) {
+        error_message("Critical errors found. Code generation aborted.\n");
+        return NULL;
+    }
+    RISCGenerator *gen = NULL;
+    TIME_REPORT_BEGIN("generate");
+    if (ctx->incremental && !ctx->line_info && ast_root->type == NODE_PROGRAM) {
+        gen = generate_incremental(ast_root, ctx->incremental);
+    }
+    if (!gen && ctx->codegen_threads > 1 && ast_root->type == NODE_PROGRAM) {
+        gen = generate_parallel(ast_root, ctx->codegen_threads);
+    }
+    if (!gen) {
+        gen = init_generator(ctx->filename);
+        if (gen) process_node(gen, ast_root);
+    }
+    TIME_REPORT_END();
+    if (!gen) return NULL;
+    if (error_is_critical()) {
+        error_message("Critical errors found during code generation. Output aborted.\n");
+        free_generator(gen);
+        return NULL;
+    }
+    if (pass_manager_is_enabled(ctx->pass_manager, PASS_PARTIAL_EVAL) &&
+        ctx->eval_budget.max_steps > 0 && ast_root->type == NODE_PROGRAM) {
+        // Программа уже проверена обычной генерацией
+        TIME_REPORT_BEGIN("partial-eval");
+        char *evaluated = generate_evaluated_code(ast_root);
+        TIME_REPORT_END();
+        if (evaluated) {
+            free_generator(gen);
+            return evaluated;
+        }
+    }
+    return finish_generator(gen);
+}
+
+struct RiscStream {
+    RISCGenerator *gen;
+    FILE *out;
+};
+
+RiscStream *risc_stream_create(FILE *out) {
+    RiscStream *stream = (RiscStream *) tagged_malloc(ALLOC_TEMP, sizeof(RiscStream));
+    if (!stream) return NULL;
+    stream->gen = init_generator(compile_context_current()->filename);
+    if (!stream->gen) {
+        tagged_free(ALLOC_TEMP, stream);
+        return NULL;
+    }
+    // Образ данных стоит перед кодом, а код к его концу уже выведен,
+    // поэтому константы и строки записываются командами
+    stream->gen->static_data = 0;
+    stream->out = out;
+    return stream;
+}
+
+// Проходы над листингом применяются к коду одного оператора: метки
+// и переходы не выходят за его пределы
+static int flush_stream(RiscStream *stream) {
+    RISCGenerator *gen = stream->gen;
+    RiscListing listing = {gen->output, gen->output_size};
+    pass_manager_run_listing(compile_context_current()->pass_manager, &listing);
+    gen->output_size = listing.count;
+    for (size_t i = 0; i < gen->output_size; i++) {
+        fprintf(stream->out, "%s\n", gen->output[i]);
+        tagged_free(ALLOC_OUTPUT, gen->output[i]);
+    }
+    gen->output_size = 0;
+    return ferror(stream->out) ? -1 : 0;
+}
+
+int risc_stream_add(RiscStream *stream, ASTNode *statement) {
+    RISCGenerator *gen = stream->gen;
+    gen->current_scope_is_global = 1;
+    gen->block_level = 0;
+    process_node(gen, statement);
+    if (error_is_critical()) {
+        error_message("Critical errors found during code generation. Output aborted.\n");
+        return -1;
+    }
+    return flush_stream(stream);
+}
+
+int risc_stream_finish(RiscStream *stream) {
+    add_output(stream->gen, "Exit program");
+    add_output(stream->gen, "ebreak");
+    int status = flush_stream(stream);
+    if (fflush(stream->out) != 0) status = -1;
+    risc_stream_free(stream);
+    return status;
+}
+
+void risc_stream_free(RiscStream *stream) {
+    if (!stream) return;
+    free_generator(stream->gen);
+    tagged_free(ALLOC_TEMP, stream);
+}
+
 void free_risc_code(char *code) {
     free(code);
 } 
@@ -1,12 +1,62 @@
 #ifndef RISC_GENERATOR_H
 #define RISC_GENERATOR_H
 
-#include "ast.h"
+#include <stdio.h>
+#include "../ast/ast.h"
+#include "pass_manager.h"
+#include "incremental.h"
 
 char *generate_risc_code(ASTNode *ast_root);
 
 void free_risc_code(char *code);
 
+/**
+ * Потоковая генерация: код каждого оператора верхнего уровня пишется в out
+ * сразу после его разбора. Образ статических данных и частичное
+ * вычисление требуют всей программы и в этом режиме не применяются.
+ */
+typedef struct RiscStream RiscStream;
+
+RiscStream *risc_stream_create(FILE *out);
+
+// Генерирует и выводит код оператора; -1 при критических ошибках или ошибке записи
+int risc_stream_add(RiscStream *stream, ASTNode *statement);
+
+// Выводит завершение программы и освобождает генератор; 0 при успехе
+int risc_stream_finish(RiscStream *stream);
+
+// Освобождает генератор без вывода завершения (после ошибки)
+void risc_stream_free(RiscStream *stream);
+
 void set_risc_generator_filename(const char *filename);
 
+void set_risc_generator_eval_budget(long max_steps, size_t max_memory);
+
+// NULL — набор проходов уровня -O1
+void set_risc_generator_pass_manager(const PassManager *pm);
+
+/**
+ * Число потоков generate_risc_code. При threads > 1 большая программа делится
+ * на участки, которые генерируются параллельно; результат не отличается от
+ * последовательной генерации.
+ */
+void set_risc_generator_threads(int threads);
+
+/**
+ * Таблица строк (-g): перед командами, которые относятся к другому оператору
+ * исходного текста, выводится строка ".loc строка столбец". Строка не
+ * исполняется, проходы над листингом её пропускают, поэтому код не меняется.
+ * Инкрементальная генерация с таблицей строк не используется: отпечатки
+ * операторов не учитывают их позицию.
+ */
+void set_risc_generator_line_info(int enabled);
+
+/**
+ * Инкрементальная генерация: код операторов верхнего уровня, которые не
+ * изменились и видят те же объявления, берётся из state, остальные
+ * генерируются заново; state обновляется фрагментами этой программы.
+ * Результат не отличается от обычной генерации. NULL — выключено.
+ */
+void set_risc_generator_incremental(IncrementalState *state);
+
 #endif /* RISC_GENERATOR_H */ 
\ No newline at end of file
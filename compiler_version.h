@@ -0,0 +1,15 @@
+#ifndef COMPILER_VERSION_H
+#define COMPILER_VERSION_H
+
+/**
+ * Версия результата компиляции: входит в ключи кэша (-cache) и в контрольную
+ * сумму файла -incremental, поэтому записи другой версии не находятся.
+ * Не зависит от времени сборки: одинаковые исходники компилятора дают одни
+ * и те же ключи, и кэш можно переносить между машинами.
+ * Увеличивается при каждом изменении, после которого тот же исходный текст
+ * с теми же настройками даёт другой код, AST или диагностику: лексер, парсер,
+ * генератор, проходы, вычисление при компиляции, разбор настроек в main.c.
+ */
+#define COMPILER_VERSION 2
+
+#endif /* COMPILER_VERSION_H */
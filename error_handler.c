@@ -1,4 +1,6 @@
 #include "error_handler.h"
+#include "compile_context.h"
+#include "tagged_alloc.h"
 #include <stdlib.h>
 #include <string.h>
 #include <stdarg.h>
@@ -7,51 +9,96 @@ extern int get_current_line(void);
 extern int get_current_column(void);
 extern const char* get_parser_filename(void);
 
-#define MAX_ERRORS 3
+static ErrorState *error_state(void) {
+    return &compile_context_current()->errors;
+}
 
-static Error errors[MAX_ERRORS];
-static int error_count_value = 0;
-static int initialized = 0;
-static int critical_error = 0;
+void error_init(void) {
+    ErrorState *es = error_state();
+    if (!es->initialized) {
+        es->error_count = 0;
+        es->symbol_count = 0;
+        memset(es->errors, 0, sizeof(es->errors));
+        memset(es->symbols, 0, sizeof(es->symbols));
+        es->initialized = 1;
+    }
+}
 
-static int current_scope_is_global = 1;
+void error_free(void) {
+    ErrorState *es = error_state();
+    if (es->initialized) {
+        for (int i = 0; i < es->symbol_count; i++) {
+            tagged_free(ALLOC_SYMBOLS, es->symbols[i].name);
+            tagged_free(ALLOC_SYMBOLS, es->symbols[i].type);
+        }
+        es->error_count = 0;
+        es->symbol_count = 0;
+        es->initialized = 0;
+    }
+    free(es->text);
+    es->text = NULL;
+    es->text_length = 0;
+    es->text_capacity = 0;
+}
 
-typedef struct {
-    char *name;
-    char *type;
-    int is_global;
-    int defined;
-} SymbolEntry;
+// При нехватке памяти текст обрывается: ошибки в errors и error_count не теряются
+void error_collect_text(ErrorState *es, const char *text) {
+    size_t length = strlen(text);
+    if (es->text_length + length + 1 > es->text_capacity) {
+        size_t capacity = es->text_capacity ? es->text_capacity * 2 : 256;
+        while (capacity < es->text_length + length + 1) capacity *= 2;
+        char *new_text = (char *) realloc(es->text, capacity);
+        if (!new_text) return;
+        es->text = new_text;
+        es->text_capacity = capacity;
+    }
+    memcpy(es->text + es->text_length, text, length + 1);
+    es->text_length += length;
+}
 
-#define MAX_SYMBOLS 1000
-static SymbolEntry symbols[MAX_SYMBOLS];
-static int symbol_count = 0;
+static void emit_text(ErrorState *es, const char *text) {
+    if (!es->quiet) fputs(text, stderr);
+    if (es->collect) error_collect_text(es, text);
+}
 
-void error_init(void) {
-    if (!initialized) {
-        error_count_value = 0;
-        symbol_count = 0;
-        memset(errors, 0, sizeof(errors));
-        memset(symbols, 0, sizeof(symbols));
-        initialized = 1;
+void error_message(const char *format, ...) {
+    if (error_state()->repeat) return;
+    char text[640];
+    va_list args;
+    va_start(args, format);
+    vsnprintf(text, sizeof(text), format, args);
+    va_end(args);
+    emit_text(error_state(), text);
+}
+
+static const char *error_kind(ErrorType type) {
+    switch (type) {
+        case ERROR_UNDEFINED_VARIABLE: return "Undefined variable";
+        case ERROR_TYPE_MISMATCH: return "Type mismatch";
+        case ERROR_DIVISION_BY_ZERO: return "Division by zero";
+        case ERROR_SCOPE: return "Scope violation";
+        case ERROR_REDECLARATION: return "Variable redeclaration";
+        default: return "Unknown error";
     }
 }
 
-void error_free(void) {
-    if (initialized) {
-        for (int i = 0; i < symbol_count; i++) {
-            free(symbols[i].name);
-            free(symbols[i].type);
-        }
-        error_count_value = 0;
-        symbol_count = 0;
-        initialized = 0;
+int error_format(const Error *error, char *buffer, size_t size) {
+    if (error->type == ERROR_SYNTAX) {
+        return snprintf(buffer, size, "Parser error at %s:%d:%d: %s\n",
+                        error->filename, error->line, error->column, error->message);
     }
+    return snprintf(buffer, size, "Error: %s in %s:%d:%d: %s\n", error_kind(error->type),
+                    error->filename, error->line, error->column, error->message);
 }
 
 void error_report(ErrorType type, int line, int column, const char *file, const char *format, ...) {
+    ErrorState *es = error_state();
+    if (es->repeat) return;
+    char message[256];
     va_list args;
     va_start(args, format);
+    vsnprintf(message, sizeof(message), format, args);
+    va_end(args);
 
     if (line == 0 && column == 0) {
         line = get_current_line();
@@ -62,30 +109,23 @@ void error_report(ErrorType type, int line, int column, const char *file, const
         file = get_parser_filename();
     }
 
-    switch (type) {
-        case ERROR_UNDEFINED_VARIABLE:
-            fprintf(stderr, "Error: Undefined variable in %s:%d:%d: ", file, line, column);
-            break;
-        case ERROR_TYPE_MISMATCH:
-            fprintf(stderr, "Error: Type mismatch in %s:%d:%d: ", file, line, column);
-            break;
-        case ERROR_DIVISION_BY_ZERO:
-            fprintf(stderr, "Error: Division by zero in %s:%d:%d: ", file, line, column);
-            break;
-        case ERROR_SCOPE:
-            fprintf(stderr, "Error: Scope violation in %s:%d:%d: ", file, line, column);
-            break;
-        case ERROR_REDECLARATION:
-            fprintf(stderr, "Error: Variable redeclaration in %s:%d:%d: ", file, line, column);
-            break;
-        default:
-            fprintf(stderr, "Error: Unknown error in %s:%d:%d: ", file, line, column);
-            break;
+    Error error;
+    error.type = type;
+    error.line = line;
+    error.column = column;
+    snprintf(error.message, sizeof(error.message), "%s", message);
+    snprintf(error.filename, sizeof(error.filename), "%s", file);
+
+    // Первые MAX_ERRORS ошибок сохраняются, чтобы их мог забрать вызывающий код
+    if (es->error_count < MAX_ERRORS) {
+        es->errors[es->error_count] = error;
     }
 
-    vfprintf(stderr, format, args);
-    fprintf(stderr, "\n");
-    va_end(args);
+    if (!es->quiet || es->collect) {
+        char text[640];
+        error_format(&error, text, sizeof(text));
+        emit_text(es, text);
+    }
 
     if (type == ERROR_UNDEFINED_VARIABLE || 
         type == ERROR_TYPE_MISMATCH || 
@@ -96,62 +136,65 @@ void error_report(ErrorType type, int line, int column, const char *file, const
     }
 
     // Увеличиваем счетчик ошибок
-    error_count_value++;
+    es->error_count++;
 }
 
 int error_has_errors(void) {
-    return error_count_value > 0;
+    return error_state()->error_count > 0;
 }
 
 int error_count(void) {
-    return error_count_value;
+    return error_state()->error_count;
 }
 
 void error_clear(void) {
-    error_count_value = 0;
+    error_state()->error_count = 0;
 }
 
 void error_print_all(FILE *output) {
-    if (error_count_value == 0) {
+    ErrorState *es = error_state();
+    if (es->error_count == 0) {
         fprintf(stderr, "No errors detected.\n");
         return;
     }
 
-    fprintf(stderr, "%d compilation errors detected.\n", error_count_value);
+    fprintf(stderr, "%d compilation errors detected.\n", es->error_count);
 }
 
 static int add_symbol(const char *name, const char *type, int is_global, int defined) {
-    if (symbol_count >= MAX_SYMBOLS) {
+    ErrorState *es = error_state();
+    if (es->symbol_count >= MAX_SYMBOLS) {
         return -1;
     }
 
-    for (int i = 0; i < symbol_count; i++) {
-        if (strcmp(symbols[i].name, name) == 0) {
-            symbols[i].defined = defined;
+    for (int i = 0; i < es->symbol_count; i++) {
+        if (strcmp(es->symbols[i].name, name) == 0) {
+            es->symbols[i].defined = defined;
             return i;
         }
     }
 
-    SymbolEntry *entry = &symbols[symbol_count];
-    entry->name = strdup(name);
-    entry->type = strdup(type);
+    SymbolEntry *entry = &es->symbols[es->symbol_count];
+    entry->name = tagged_strdup(ALLOC_SYMBOLS, name);
+    entry->type = tagged_strdup(ALLOC_SYMBOLS, type);
     entry->is_global = is_global;
     entry->defined = defined;
 
-    return symbol_count++;
+    return es->symbol_count++;
 }
 
 static SymbolEntry *find_symbol(const char *name) {
-    for (int i = 0; i < symbol_count; i++) {
-        if (strcmp(symbols[i].name, name) == 0) {
-            return &symbols[i];
+    ErrorState *es = error_state();
+    for (int i = 0; i < es->symbol_count; i++) {
+        if (strcmp(es->symbols[i].name, name) == 0) {
+            return &es->symbols[i];
         }
     }
     return NULL;
 }
 
 void set_current_scope(int is_global) {
-    current_scope_is_global = is_global;
+    error_state()->current_scope_is_global = is_global;
 }
 
 int declare_variable(const char *name, const char *type, int is_global, int line, int column, const char *filename) {
@@ -204,7 +247,7 @@ int error_check_type_compatibility(const char *type1, const char *type2, const c
             } else {
                 error_report(ERROR_TYPE_MISMATCH, line, column, filename, 
                             "Operation '%s' requires integer operands", operation);
-                critical_error = 1;
+                error_set_critical();
                 return 0;
             }
         }
@@ -222,7 +265,7 @@ int error_check_type_compatibility(const char *type1, const char *type2, const c
     error_report(ERROR_TYPE_MISMATCH, line, column, filename, 
                 "Incompatible types: '%s' and '%s' for operation '%s'", 
                 type1, type2, operation);
-    critical_error = 1;
+    error_set_critical();
     return 0;
 }
 
@@ -257,9 +300,10 @@ int error_check_variable_scope(const char *name, int is_global, int current_scop
 }
 
 int error_is_critical(void) {
-    return critical_error || error_count_value > 0;
+    ErrorState *es = error_state();
+    return es->critical || es->error_count > 0;
 }
 
 void error_set_critical(void) {
-    critical_error = 1;
+    error_state()->critical = 1;
 } 
\ No newline at end of file
@@ -24,6 +24,33 @@ typedef struct {
     char filename[256];
 } Error;
 
+#define MAX_ERRORS 3
+#define MAX_SYMBOLS 1000
+
+typedef struct {
+    char *name;
+    char *type;
+    int is_global;
+    int defined;
+} SymbolEntry;
+
+// Состояние обработчика ошибок одной компиляции (хранится в CompileContext)
+typedef struct {
+    Error errors[MAX_ERRORS];
+    int error_count;
+    int initialized;
+    int critical;
+    int quiet;                  // не печатать ошибки в stderr
+    int collect;                // копить напечатанное (или подавленное quiet) в text
+    int repeat;                 // код генерируется повторно: его диагностика уже выдана
+    char *text;                 // диагностика в том виде, в каком она идёт в stderr
+    size_t text_length;
+    size_t text_capacity;
+    int current_scope_is_global;
+    SymbolEntry symbols[MAX_SYMBOLS];
+    int symbol_count;
+} ErrorState;
+
 void error_init(void);
 
 void error_free(void);
@@ -36,6 +63,15 @@ int error_count(void);
 
 void error_print_all(FILE *output);
 
+// Строка сообщения об ошибке в том виде, в каком её печатает error_report; длина как у snprintf
+int error_format(const Error *error, char *buffer, size_t size);
+
+// Печатает предупреждение или итог в stderr (если не quiet) и добавляет его в text (если collect)
+void error_message(const char *format, ...);
+
+// Добавляет к es->text уже напечатанный текст (например, из другого контекста)
+void error_collect_text(ErrorState *es, const char *text);
+
 void error_clear(void);
 
 int error_check_division_by_zero(int divisor, int line, int column, const char *filename);
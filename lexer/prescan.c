@@ -0,0 +1,192 @@
+#include <stdint.h>
+#include "prescan.h"
+
+#if defined(__GNUC__) && defined(__AVX2__)
+#include <immintrin.h>
+#define PRESCAN_WIDTH 32
+#define PRESCAN_NAME "avx2"
+typedef __m256i Chunk;
+
+static inline Chunk chunk_load(const char *p) {
+    return _mm256_loadu_si256((const __m256i *) p);
+}
+
+static inline uint32_t chunk_eq(Chunk c, char b) {
+    return (uint32_t) _mm256_movemask_epi8(_mm256_cmpeq_epi8(c, _mm256_set1_epi8(b)));
+}
+
+// Байты из [lo, hi]; байты >= 0x80 отрицательны и в диапазон не попадают
+static inline uint32_t chunk_in_range(Chunk c, char lo, char hi) {
+    __m256i above = _mm256_cmpgt_epi8(c, _mm256_set1_epi8((char) (lo - 1)));
+    __m256i below = _mm256_cmpgt_epi8(_mm256_set1_epi8((char) (hi + 1)), c);
+    return (uint32_t) _mm256_movemask_epi8(_mm256_and_si256(above, below));
+}
+
+static inline Chunk chunk_lower(Chunk c) {
+    return _mm256_or_si256(c, _mm256_set1_epi8(0x20));
+}
+#elif defined(__GNUC__) && defined(__SSE2__)
+#include <emmintrin.h>
+#define PRESCAN_WIDTH 16
+#define PRESCAN_NAME "sse2"
+typedef __m128i Chunk;
+
+static inline Chunk chunk_load(const char *p) {
+    return _mm_loadu_si128((const __m128i *) p);
+}
+
+static inline uint32_t chunk_eq(Chunk c, char b) {
+    return (uint32_t) _mm_movemask_epi8(_mm_cmpeq_epi8(c, _mm_set1_epi8(b)));
+}
+
+static inline uint32_t chunk_in_range(Chunk c, char lo, char hi) {
+    __m128i above = _mm_cmpgt_epi8(c, _mm_set1_epi8((char) (lo - 1)));
+    __m128i below = _mm_cmpgt_epi8(_mm_set1_epi8((char) (hi + 1)), c);
+    return (uint32_t) _mm_movemask_epi8(_mm_and_si128(above, below));
+}
+
+static inline Chunk chunk_lower(Chunk c) {
+    return _mm_or_si128(c, _mm_set1_epi8(0x20));
+}
+#else
+#define PRESCAN_NAME "scalar"
+#endif
+
+#ifdef PRESCAN_WIDTH
+#define FULL_MASK ((uint32_t) ((1ULL << PRESCAN_WIDTH) - 1))
+
+// Биты первых n байт блока
+static inline uint32_t mask_below(int n) {
+    return (uint32_t) ((1ULL << n) - 1);
+}
+
+/**
+ * Сдвигает позицию на n байт блока, среди которых нет конца комментария.
+ * @param newlines Маска '\n' среди этих байт
+ * @param breaks Маска байт, после которых столбец начинается с 1
+ */
+static inline void advance_position(int n, uint32_t newlines, uint32_t breaks, int *line, int *column) {
+    *line += __builtin_popcount(newlines);
+    if (breaks) {
+        *column = n - (31 - __builtin_clz(breaks));
+    } else {
+        *column += n;
+    }
+}
+#endif
+
+static const char *skip_spaces(const char *p, const char *end, int *line, int *column) {
+#ifdef PRESCAN_WIDTH
+    while (end - p >= PRESCAN_WIDTH) {
+        Chunk c = chunk_load(p);
+        uint32_t newlines = chunk_eq(c, '\n');
+        uint32_t breaks = newlines | chunk_eq(c, '\r');
+        uint32_t blank = breaks | chunk_eq(c, ' ') | chunk_eq(c, '\t');
+        if (blank != FULL_MASK) {
+            int n = __builtin_ctz(~blank);
+            uint32_t limit = mask_below(n);
+            advance_position(n, newlines & limit, breaks & limit, line, column);
+            return p + n;
+        }
+        advance_position(PRESCAN_WIDTH, newlines, breaks, line, column);
+        p += PRESCAN_WIDTH;
+    }
+#endif
+    for (; p < end; p++) {
+        if (*p == ' ' || *p == '\t') {
+            (*column)++;
+        } else if (*p == '\n') {
+            (*line)++;
+            *column = 1;
+        } else if (*p == '\r') {
+            *column = 1;
+        } else {
+            break;
+        }
+    }
+    return p;
+}
+
+static const char *find_newline(const char *p, const char *end) {
+#ifdef PRESCAN_WIDTH
+    while (end - p >= PRESCAN_WIDTH) {
+        uint32_t newlines = chunk_eq(chunk_load(p), '\n');
+        if (newlines) return p + __builtin_ctz(newlines);
+        p += PRESCAN_WIDTH;
+    }
+#endif
+    while (p < end && *p != '\n') p++;
+    return p;
+}
+
+// p — первый байт после "/*"; возвращает позицию после "*/" или end
+static const char *skip_block_comment(const char *p, const char *end, int *line, int *column) {
+#ifdef PRESCAN_WIDTH
+    // Второй блок сдвинут на байт: "*/" на границе блоков тоже находится
+    while (end - p > PRESCAN_WIDTH) {
+        Chunk c = chunk_load(p);
+        uint32_t newlines = chunk_eq(c, '\n');
+        uint32_t close = chunk_eq(c, '*') & chunk_eq(chunk_load(p + 1), '/');
+        if (close) {
+            int n = __builtin_ctz(close);
+            uint32_t limit = mask_below(n);
+            advance_position(n, newlines & limit, newlines & limit, line, column);
+            *column += 2;
+            return p + n + 2;
+        }
+        advance_position(PRESCAN_WIDTH, newlines, newlines, line, column);
+        p += PRESCAN_WIDTH;
+    }
+#endif
+    for (; p < end; p++) {
+        if (*p == '*' && end - p >= 2 && p[1] == '/') {
+            *column += 2;
+            return p + 2;
+        }
+        if (*p == '\n') {
+            (*line)++;
+            *column = 1;
+        } else {
+            (*column)++;
+        }
+    }
+    return p;
+}
+
+const char *prescan_skip_blank(const char *p, const char *end, int *line, int *column) {
+    for (;;) {
+        p = skip_spaces(p, end, line, column);
+        if (end - p < 2 || p[0] != '/') return p;
+        if (p[1] == '/') {
+            const char *comment_end = find_newline(p + 2, end);
+            *column += (int) (comment_end - p);
+            p = comment_end;
+        } else if (p[1] == '*') {
+            *column += 2;
+            p = skip_block_comment(p + 2, end, line, column);
+        } else {
+            return p;
+        }
+    }
+}
+
+static inline int is_identifier_char(char c) {
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c == '_';
+}
+
+const char *prescan_identifier_end(const char *p, const char *end) {
+#ifdef PRESCAN_WIDTH
+    while (end - p >= PRESCAN_WIDTH) {
+        Chunk c = chunk_load(p);
+        uint32_t word = chunk_in_range(chunk_lower(c), 'a', 'z') | chunk_in_range(c, '0', '9') | chunk_eq(c, '_');
+        if (word != FULL_MASK) return p + __builtin_ctz(~word);
+        p += PRESCAN_WIDTH;
+    }
+#endif
+    while (p < end && is_identifier_char(*p)) p++;
+    return p;
+}
+
+const char *prescan_implementation(void) {
+    return PRESCAN_NAME;
+}
@@ -0,0 +1,26 @@
+#ifndef PRESCAN_H
+#define PRESCAN_H
+
+/**
+ * Быстрый путь лексера: длинные последовательности пробелов, комментариев
+ * и символов идентификатора пропускаются блоками по 16 (SSE2) или 32 (AVX2)
+ * байта вместо одного байта на переход автомата flex. Без SSE2 работает
+ * обычный побайтовый цикл. Позиция считается так же, как в правилах
+ * lexer.l: '\r' вне комментария сбрасывает столбец, внутри — сдвигает его.
+ */
+
+/**
+ * Пропускает пробелы, переводы строк и комментарии обоих видов.
+ * @param p Начало пропуска; end — конец исходного текста
+ * @param line, column Позиция p; обновляются до позиции результата
+ * @return Первый значимый символ или end
+ */
+const char *prescan_skip_blank(const char *p, const char *end, int *line, int *column);
+
+// Первый символ после p, не входящий в [a-zA-Z0-9_], или end
+const char *prescan_identifier_end(const char *p, const char *end);
+
+// Используемая реализация: "avx2", "sse2" или "scalar"
+const char *prescan_implementation(void);
+
+#endif /* PRESCAN_H */
@@ -0,0 +1,117 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#ifndef _WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+#include "source_buffer.h"
+
+// flex требует два символа YY_END_OF_BUFFER_CHAR в конце буфера
+#define SOURCE_PADDING 2
+
+static int read_to_heap(SourceBuffer *buffer, FILE *fp) {
+    size_t capacity = 4096;
+    size_t length = 0;
+    char *data = (char *) malloc(capacity);
+    if (!data) return -1;
+    for (;;) {
+        if (capacity - length <= SOURCE_PADDING) {
+            char *new_data = (char *) realloc(data, capacity * 2);
+            if (!new_data) {
+                free(data);
+                return -1;
+            }
+            data = new_data;
+            capacity *= 2;
+        }
+        size_t read = fread(data + length, 1, capacity - length - SOURCE_PADDING, fp);
+        if (read == 0) break;
+        length += read;
+    }
+    if (ferror(fp)) {
+        free(data);
+        return -1;
+    }
+    memset(data + length, 0, SOURCE_PADDING);
+    buffer->data = data;
+    buffer->length = length;
+    buffer->mapped = 0;
+    return 0;
+}
+
+#ifndef _WIN32
+/**
+ * Отображает файл поверх анонимной области, которая на страницу длиннее,
+ * если текст заканчивается ровно на границе страницы. Хвост последней
+ * страницы файла и анонимная страница заполнены нулями, так что
+ * завершающие нули для flex есть без копирования текста.
+ * Отображение MAP_PRIVATE: запись flex в буфер файл не меняет.
+ */
+static int map_file(SourceBuffer *buffer, int fd, size_t length) {
+    size_t page = (size_t) sysconf(_SC_PAGESIZE);
+    size_t mapped = (length + SOURCE_PADDING + page - 1) / page * page;
+    char *data = (char *) mmap(NULL, mapped, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (data == MAP_FAILED) return -1;
+    if (length > 0 && mmap(data, length, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_FIXED, fd, 0) == MAP_FAILED) {
+        munmap(data, mapped);
+        return -1;
+    }
+    buffer->data = data;
+    buffer->length = length;
+    buffer->mapped = mapped;
+    return 0;
+}
+#endif
+
+int source_buffer_open(SourceBuffer *buffer, const char *filename) {
+#ifndef _WIN32
+    int fd = open(filename, O_RDONLY);
+    if (fd < 0) return -1;
+    struct stat st;
+    if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && map_file(buffer, fd, (size_t) st.st_size) == 0) {
+        close(fd);
+        return 0;
+    }
+    close(fd);
+#endif
+    // Не обычный файл (канал, устройство) или отображение недоступно
+    FILE *fp = fopen(filename, "rb");
+    if (!fp) return -1;
+    int status = read_to_heap(buffer, fp);
+    fclose(fp);
+    return status;
+}
+
+int source_buffer_from_memory(SourceBuffer *buffer, const char *source, size_t length) {
+    char *data = (char *) malloc(length + SOURCE_PADDING);
+    if (!data) return -1;
+    if (length > 0) memcpy(data, source, length);
+    memset(data + length, 0, SOURCE_PADDING);
+    buffer->data = data;
+    buffer->length = length;
+    buffer->mapped = 0;
+    return 0;
+}
+
+void source_buffer_close(SourceBuffer *buffer) {
+    if (!buffer->data) return;
+#ifndef _WIN32
+    if (buffer->mapped) {
+        munmap(buffer->data, buffer->mapped);
+    } else {
+        free(buffer->data);
+    }
+#else
+    free(buffer->data);
+#endif
+    buffer->data = NULL;
+    buffer->length = 0;
+    buffer->mapped = 0;
+}
+
+size_t source_buffer_scan_size(const SourceBuffer *buffer) {
+    return buffer->length + SOURCE_PADDING;
+}
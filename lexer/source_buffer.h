@@ -0,0 +1,38 @@
+#ifndef SOURCE_BUFFER_H
+#define SOURCE_BUFFER_H
+
+#include <stddef.h>
+
+/**
+ * Исходный текст, который лексер читает на месте через yy_scan_buffer.
+ * За текстом всегда идут два нулевых байта (конец буфера для flex),
+ * а сам буфер доступен на запись: flex временно пишет '\0' после yytext.
+ */
+typedef struct {
+    char *data;
+    size_t length;      // длина текста без завершающих нулей
+    size_t mapped;      // размер отображения файла; 0 — буфер в куче
+} SourceBuffer;
+
+// Фрагмент исходного текста: токен передаётся парсеру без копирования
+typedef struct {
+    size_t offset;
+    size_t length;
+} SourceSlice;
+
+/**
+ * Отображает файл в память. Если отображение недоступно,
+ * файл читается в буфер в куче.
+ * @return 0 при успехе, -1 если файл не удалось открыть или прочитать
+ */
+int source_buffer_open(SourceBuffer *buffer, const char *filename);
+
+// Копирует текст из памяти, добавляя завершающие нули; 0 при успехе
+int source_buffer_from_memory(SourceBuffer *buffer, const char *source, size_t length);
+
+void source_buffer_close(SourceBuffer *buffer);
+
+// Размер буфера для yy_scan_buffer (вместе с завершающими нулями)
+size_t source_buffer_scan_size(const SourceBuffer *buffer);
+
+#endif /* SOURCE_BUFFER_H */
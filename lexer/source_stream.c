@@ -0,0 +1,136 @@
+#include <stdlib.h>
+#include <string.h>
+#include "source_stream.h"
+
+#define STREAM_CHUNK 65536
+
+// Состояние автомата, который ищет границы порций
+enum {
+    STREAM_CODE,
+    STREAM_SLASH,           // '/' в коде: может начаться комментарий
+    STREAM_LINE_COMMENT,
+    STREAM_BLOCK_COMMENT,
+    STREAM_BLOCK_STAR,      // '*' в блочном комментарии
+    STREAM_STRING
+};
+
+void source_stream_init(SourceStream *stream, FILE *input) {
+    memset(stream, 0, sizeof(*stream));
+    stream->input = input;
+    stream->state = STREAM_CODE;
+}
+
+/**
+ * Проходит байты [from, filled) и возвращает позицию после последнего
+ * перевода строки в коде или 0, если такой границы нет.
+ */
+static size_t find_boundary(SourceStream *stream, size_t from) {
+    size_t boundary = 0;
+    int state = stream->state;
+    for (size_t i = from; i < stream->filled; i++) {
+        char c = stream->data[i];
+        switch (state) {
+            case STREAM_SLASH:
+                if (c == '/') {
+                    state = STREAM_LINE_COMMENT;
+                    break;
+                }
+                if (c == '*') {
+                    state = STREAM_BLOCK_COMMENT;
+                    break;
+                }
+                state = STREAM_CODE;
+                /* fall through */
+            case STREAM_CODE:
+                if (c == '\n') boundary = i + 1;
+                else if (c == '/') state = STREAM_SLASH;
+                else if (c == '"') state = STREAM_STRING;
+                break;
+            case STREAM_LINE_COMMENT:
+                if (c == '\n') {
+                    state = STREAM_CODE;
+                    boundary = i + 1;
+                }
+                break;
+            case STREAM_BLOCK_STAR:
+                if (c == '/') {
+                    state = STREAM_CODE;
+                    break;
+                }
+                state = STREAM_BLOCK_COMMENT;
+                /* fall through */
+            case STREAM_BLOCK_COMMENT:
+                if (c == '*') state = STREAM_BLOCK_STAR;
+                break;
+            case STREAM_STRING:
+                if (c == '"') state = STREAM_CODE;
+                break;
+        }
+    }
+    stream->state = state;
+    return boundary;
+}
+
+static int reserve(SourceStream *stream, size_t size) {
+    if (size <= stream->capacity) return 0;
+    size_t capacity = stream->capacity ? stream->capacity : STREAM_CHUNK;
+    while (capacity < size) capacity *= 2;
+    char *data = (char *) realloc(stream->data, capacity);
+    if (!data) return -1;
+    stream->data = data;
+    stream->capacity = capacity;
+    return 0;
+}
+
+long source_stream_next(SourceStream *stream, size_t keep, char **segment) {
+    // Возвращаем на место байты, закрытые нулями прошлой порции
+    size_t tail = stream->filled - stream->length;
+    if (tail > 0) {
+        memcpy(stream->data + stream->length, stream->saved, tail < 2 ? tail : 2);
+    }
+    size_t drop = keep > stream->base ? keep - stream->base : 0;
+    if (drop > stream->length) drop = stream->length;
+    if (drop > 0) {
+        memmove(stream->data, stream->data + drop, stream->filled - drop);
+        stream->base += drop;
+        stream->length -= drop;
+        stream->filled -= drop;
+    }
+    // Прочитанный после прошлой границы хвост уже пройден автоматом
+    // и границ не содержит, поэтому искать нужно только в новых байтах
+    size_t start = stream->length;
+    size_t scanned = stream->filled;
+    size_t end = 0;
+    for (;;) {
+        if (scanned < stream->filled) {
+            end = find_boundary(stream, scanned);
+            scanned = stream->filled;
+            if (end > start) break;
+        }
+        if (stream->eof) {
+            end = stream->filled;
+            break;
+        }
+        if (reserve(stream, stream->filled + STREAM_CHUNK + 2) != 0) return -1;
+        size_t read = fread(stream->data + stream->filled, 1, STREAM_CHUNK, stream->input);
+        if (read == 0) {
+            if (ferror(stream->input)) return -1;
+            stream->eof = 1;
+        }
+        stream->filled += read;
+    }
+    if (reserve(stream, stream->filled + 2) != 0) return -1;
+    stream->length = end;
+    tail = stream->filled - end;
+    memcpy(stream->saved, stream->data + end, tail < 2 ? tail : 2);
+    stream->data[end] = '\0';
+    stream->data[end + 1] = '\0';
+    *segment = stream->data + start;
+    return (long) (end - start);
+}
+
+void source_stream_close(SourceStream *stream) {
+    free(stream->data);
+    stream->data = NULL;
+    stream->capacity = 0;
+}
@@ -0,0 +1,38 @@
+#ifndef SOURCE_STREAM_H
+#define SOURCE_STREAM_H
+
+#include <stdio.h>
+#include <stddef.h>
+
+/**
+ * Исходный текст из канала или stdin, который читается порциями.
+ * Порция заканчивается переводом строки вне комментария и строкового
+ * литерала, поэтому ни один токен не попадает сразу в две порции.
+ * Окно data начинается со смещения base от начала потока и хранит текст,
+ * на который ещё могут ссылаться срезы токенов, и текущую порцию.
+ */
+typedef struct {
+    FILE *input;
+    char *data;
+    size_t base;        // смещение data[0] в потоке
+    size_t length;      // конец текущей порции в окне; за ним два нуля
+    size_t filled;      // прочитано в окно, включая начало следующей порции
+    size_t capacity;
+    char saved[2];      // байты следующей порции на месте завершающих нулей
+    int state;          // лексическое состояние на позиции filled
+    int eof;
+} SourceStream;
+
+void source_stream_init(SourceStream *stream, FILE *input);
+
+/**
+ * Отбрасывает текст до смещения keep и читает следующую порцию.
+ * @param keep Смещение в потоке, с которого текст ещё нужен (не больше конца порции)
+ * @param segment Начало новой порции в окне; за ней два нулевых байта
+ * @return Длина порции, 0 в конце потока, -1 при ошибке чтения или памяти
+ */
+long source_stream_next(SourceStream *stream, size_t keep, char **segment);
+
+void source_stream_close(SourceStream *stream);
+
+#endif /* SOURCE_STREAM_H */
@@ -0,0 +1,283 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "libcompiler.h"
+#include "compile_context.h"
+#include "compiler/risc_generator.h"
+#include "lexer/source_buffer.h"
+#include "ast/flat_ast.h"
+#include "pipeline.h"
+
+extern int parser_parse_source(SourceBuffer *source);
+extern int parser_parse_stream(FILE *input, int (*handle_statement)(ASTNode *, void *), void *arg);
+
+struct Compiler {
+    CompilerOptions options;
+    PassManager *own_pass_manager;
+};
+
+void compiler_options_init(CompilerOptions *options) {
+    options->opt_level = OPT_LEVEL_1;
+    options->pass_manager = NULL;
+    options->eval_steps = COMPILER_DEFAULT_EVAL_STEPS;
+    options->eval_memory = COMPILER_DEFAULT_EVAL_MEMORY;
+    options->print_diagnostics = 0;
+    options->collect_diagnostics = 0;
+    options->codegen_threads = 1;
+    options->line_info = 0;
+    options->cache = NULL;
+}
+
+Compiler *compiler_create(const CompilerOptions *options) {
+    Compiler *compiler = (Compiler *) malloc(sizeof(Compiler));
+    if (!compiler) return NULL;
+    if (options) {
+        compiler->options = *options;
+    } else {
+        compiler_options_init(&compiler->options);
+    }
+    compiler->own_pass_manager = NULL;
+    if (!compiler->options.pass_manager) {
+        compiler->own_pass_manager = pass_manager_create(compiler->options.opt_level);
+        if (!compiler->own_pass_manager) {
+            free(compiler);
+            return NULL;
+        }
+        compiler->options.pass_manager = compiler->own_pass_manager;
+    }
+    return compiler;
+}
+
+void compiler_free(Compiler *compiler) {
+    if (!compiler) return;
+    pass_manager_free(compiler->own_pass_manager);
+    free(compiler);
+}
+
+// Свежий контекст компиляции, привязанный к текущему потоку
+static CompileContext *begin_compile(Compiler *compiler, const char *name, CompileContext **previous) {
+    CompileContext *ctx = (CompileContext *) malloc(sizeof(CompileContext));
+    if (!ctx) return NULL;
+    compile_context_init(ctx, name);
+    ctx->pass_manager = compiler->options.pass_manager;
+    ctx->eval_budget.max_steps = compiler->options.eval_steps;
+    ctx->eval_budget.max_memory = compiler->options.eval_memory;
+    ctx->errors.quiet = !compiler->options.print_diagnostics;
+    ctx->errors.collect = compiler->options.collect_diagnostics;
+    ctx->codegen_threads = compiler->options.codegen_threads;
+    ctx->line_info = compiler->options.line_info;
+    *previous = compile_context_bind(ctx);
+    error_init();
+    return ctx;
+}
+
+// Переносит ошибки в результат и освобождает контекст
+static void end_compile(CompileContext *ctx, CompileContext *previous, CompileResult *result) {
+    // Синтаксическая ошибка без сообщения бывает только при нехватке памяти в парсере
+    if (result->status == COMPILE_SYNTAX_ERROR && ctx->errors.error_count == 0) {
+        result->status = COMPILE_INTERNAL_ERROR;
+    }
+    result->error_count = ctx->errors.error_count;
+    int stored = result->error_count < MAX_ERRORS ? result->error_count : MAX_ERRORS;
+    memcpy(result->errors, ctx->errors.errors, stored * sizeof(Error));
+    result->diagnostics = ctx->errors.text;
+    result->diagnostics_length = ctx->errors.text_length;
+    ctx->errors.text = NULL;
+    error_free();
+
+    compile_context_bind(previous);
+    compile_context_free(ctx);
+    free(ctx);
+}
+
+static void generate_code(CompileContext *ctx, CompileResult *result) {
+    result->code = generate_risc_code(ctx->ast_root);
+    if (result->code) {
+        result->status = COMPILE_OK;
+        result->code_length = strlen(result->code);
+    } else {
+        result->status = error_is_critical() ? COMPILE_SEMANTIC_ERROR : COMPILE_INTERNAL_ERROR;
+    }
+}
+
+// Ключ кэша: исходный текст и всё, от чего зависит сгенерированный код.
+// Число потоков генерации не входит: код от него не зависит
+static void make_cache_key(const Compiler *compiler, const SourceBuffer *source, CacheKey *key) {
+    compile_cache_key_init(key);
+    compile_cache_key_add_long(key, (long) pass_manager_enabled_mask(compiler->options.pass_manager));
+    compile_cache_key_add_long(key, compiler->options.eval_steps);
+    compile_cache_key_add_long(key, (long) compiler->options.eval_memory);
+    compile_cache_key_add_long(key, compiler->options.line_info);
+    compile_cache_key_add(key, source->data, source->length);
+}
+
+static CompileResult *compile_source(Compiler *compiler, const char *name, SourceBuffer *source,
+                                     IncrementalState *incremental) {
+    CompileResult *result = (CompileResult *) calloc(1, sizeof(CompileResult));
+    if (!result) return NULL;
+    CompileCache *cache = compiler->options.cache;
+    CacheKey key;
+    if (cache) {
+        make_cache_key(compiler, source, &key);
+        result->cache_entry = compile_cache_lookup(cache, &key, source->length);
+        if (result->cache_entry) {
+            result->status = COMPILE_OK;
+            result->code = (char *) result->cache_entry->code;
+            result->code_length = result->cache_entry->code_length;
+            return result;
+        }
+    }
+    CompileContext *previous;
+    CompileContext *ctx = begin_compile(compiler, name, &previous);
+    if (!ctx) {
+        free(result);
+        return NULL;
+    }
+    ctx->incremental = incremental;
+    if (parser_parse_source(source) != 0 || !ctx->ast_root) {
+        result->status = COMPILE_SYNTAX_ERROR;
+    } else if (error_has_errors()) {
+        result->status = COMPILE_SEMANTIC_ERROR;
+    } else {
+        generate_code(ctx, result);
+    }
+    end_compile(ctx, previous, result);
+    if (cache && result->status == COMPILE_OK) {
+        // Неудачная запись не мешает компиляции: результат просто не кэшируется
+        compile_cache_store(cache, &key, source->length, result->code, result->code_length, NULL, 0);
+    }
+    return result;
+}
+
+CompileResult *compile(Compiler *compiler, const char *name, const char *source, size_t length) {
+    SourceBuffer buffer;
+    if (source_buffer_from_memory(&buffer, source, length) != 0) return NULL;
+    CompileResult *result = compile_source(compiler, name, &buffer, NULL);
+    source_buffer_close(&buffer);
+    return result;
+}
+
+CompileResult *compile_file(Compiler *compiler, const char *filename) {
+    SourceBuffer buffer;
+    if (source_buffer_open(&buffer, filename) != 0) return NULL;
+    CompileResult *result = compile_source(compiler, filename, &buffer, NULL);
+    source_buffer_close(&buffer);
+    return result;
+}
+
+CompileResult *compile_file_incremental(Compiler *compiler, const char *filename, const char *state_file) {
+    SourceBuffer buffer;
+    if (source_buffer_open(&buffer, filename) != 0) return NULL;
+    IncrementalState *state = incremental_state_load(state_file,
+                                                     pass_manager_enabled_mask(compiler->options.pass_manager));
+    if (!state) {
+        source_buffer_close(&buffer);
+        return NULL;
+    }
+    CompileResult *result = compile_source(compiler, filename, &buffer, state);
+    if (result && result->status == COMPILE_OK && !result->cache_entry) {
+        // Не сохранённое состояние только замедлит следующую компиляцию
+        incremental_state_save(state, state_file);
+    }
+    incremental_state_free(state);
+    source_buffer_close(&buffer);
+    return result;
+}
+
+CompileResult *compile_ast_file(Compiler *compiler, const char *filename) {
+    FlatAST *flat = flat_ast_load(filename);
+    if (!flat) return NULL;
+    CompileResult *result = (CompileResult *) calloc(1, sizeof(CompileResult));
+    CompileContext *previous;
+    CompileContext *ctx = result ? begin_compile(compiler, filename, &previous) : NULL;
+    if (!ctx) {
+        free(result);
+        flat_ast_free(flat);
+        return NULL;
+    }
+    ctx->ast_root = flat_ast_to_node(flat);
+    flat_ast_free(flat);
+    if (ctx->ast_root) {
+        generate_code(ctx, result);
+    } else {
+        result->status = COMPILE_INTERNAL_ERROR;
+    }
+    end_compile(ctx, previous, result);
+    return result;
+}
+
+static int emit_statement(ASTNode *statement, void *arg) {
+    return risc_stream_add((RiscStream *) arg, statement) == 0 ? 0 : 1;
+}
+
+static int has_syntax_error(const CompileContext *ctx) {
+    int stored = ctx->errors.error_count < MAX_ERRORS ? ctx->errors.error_count : MAX_ERRORS;
+    for (int i = 0; i < stored; i++) {
+        if (ctx->errors.errors[i].type == ERROR_SYNTAX) return 1;
+    }
+    return 0;
+}
+
+CompileResult *compile_stream(Compiler *compiler, const char *name, FILE *input, FILE *output) {
+    CompileResult *result = (CompileResult *) calloc(1, sizeof(CompileResult));
+    if (!result) return NULL;
+    CompileContext *previous;
+    CompileContext *ctx = begin_compile(compiler, name, &previous);
+    if (!ctx) {
+        free(result);
+        return NULL;
+    }
+    RiscStream *stream = risc_stream_create(output);
+    if (!stream) {
+        result->status = COMPILE_INTERNAL_ERROR;
+    } else if (parser_parse_stream(input, emit_statement, stream) != 0 || error_has_errors()) {
+        if (has_syntax_error(ctx)) {
+            result->status = COMPILE_SYNTAX_ERROR;
+        } else {
+            result->status = error_has_errors() ? COMPILE_SEMANTIC_ERROR : COMPILE_INTERNAL_ERROR;
+        }
+        risc_stream_free(stream);
+    } else {
+        result->status = risc_stream_finish(stream) == 0 ? COMPILE_OK : COMPILE_INTERNAL_ERROR;
+    }
+    end_compile(ctx, previous, result);
+    return result;
+}
+
+CompileResult *compile_file_pipelined(Compiler *compiler, const char *filename, FILE *output) {
+    SourceBuffer source;
+    if (source_buffer_open(&source, filename) != 0) return NULL;
+    CompileResult *result = (CompileResult *) calloc(1, sizeof(CompileResult));
+    if (!result) {
+        source_buffer_close(&source);
+        return NULL;
+    }
+    CompileContext *previous;
+    CompileContext *ctx = begin_compile(compiler, filename, &previous);
+    if (!ctx) {
+        free(result);
+        source_buffer_close(&source);
+        return NULL;
+    }
+    if (pipeline_run(&source, output) == 0 && !error_has_errors()) {
+        result->status = COMPILE_OK;
+    } else if (has_syntax_error(ctx)) {
+        result->status = COMPILE_SYNTAX_ERROR;
+    } else {
+        result->status = error_has_errors() ? COMPILE_SEMANTIC_ERROR : COMPILE_INTERNAL_ERROR;
+    }
+    end_compile(ctx, previous, result);
+    source_buffer_close(&source);
+    return result;
+}
+
+void compile_result_free(CompileResult *result) {
+    if (!result) return;
+    if (result->cache_entry) {
+        compile_cache_entry_free(result->cache_entry);
+    } else {
+        free_risc_code(result->code);
+    }
+    free(result->diagnostics);
+    free(result);
+}
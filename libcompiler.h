@@ -0,0 +1,107 @@
+#ifndef LIBCOMPILER_H
+#define LIBCOMPILER_H
+
+#include <stdio.h>
+#include <stddef.h>
+#include "error_handler.h"
+#include "compiler/pass_manager.h"
+#include "compile_cache.h"
+
+#define COMPILER_DEFAULT_EVAL_STEPS 1000000L
+#define COMPILER_DEFAULT_EVAL_MEMORY (16L * 1024 * 1024)
+
+typedef enum {
+    COMPILE_OK = 0,
+    COMPILE_SYNTAX_ERROR,       // исходный текст не разобран
+    COMPILE_SEMANTIC_ERROR,     // ошибки областей видимости, типов и т.п.
+    COMPILE_INTERNAL_ERROR      // нехватка памяти
+} CompileStatus;
+
+typedef struct {
+    OptLevel opt_level;
+    const PassManager *pass_manager;    // если задан, opt_level не используется
+    long eval_steps;                    // бюджет -fpartial-eval
+    size_t eval_memory;
+    int print_diagnostics;              // дублировать ошибки в stderr
+    int collect_diagnostics;            // вернуть текст диагностики в CompileResult.diagnostics
+    int codegen_threads;                // потоков генерации кода одной программы
+    int line_info;                      // строки .loc в коде (см. set_risc_generator_line_info)
+    CompileCache *cache;                // кэш результатов compile и compile_file или NULL
+} CompilerOptions;
+
+typedef struct {
+    CompileStatus status;
+    char *code;                 // RISC-код при status == COMPILE_OK
+    size_t code_length;
+    int error_count;            // всего ошибок
+    Error errors[MAX_ERRORS];   // первые min(error_count, MAX_ERRORS) ошибок
+    char *diagnostics;          // все ошибки и предупреждения, как в stderr compiler.exe,
+                                // при collect_diagnostics; NULL, если их нет
+    size_t diagnostics_length;
+    CacheEntry *cache_entry;    // если код взят из кэша, code указывает в эту запись
+} CompileResult;
+
+// Настройки, общие для всех компиляций одного клиента
+typedef struct Compiler Compiler;
+
+// Настройки по умолчанию: -O1, бюджет вычисления COMPILER_DEFAULT_EVAL_*,
+// генерация кода в одном потоке и без кэша
+void compiler_options_init(CompilerOptions *options);
+
+/**
+ * Создаёт компилятор; options == NULL — настройки по умолчанию.
+ * Компилятор только читается при компиляции, поэтому compile() можно
+ * вызывать с ним одновременно из нескольких потоков.
+ */
+Compiler *compiler_create(const CompilerOptions *options);
+
+void compiler_free(Compiler *compiler);
+
+/**
+ * Компилирует исходный текст из буфера. Всё состояние компиляции
+ * освобождается до возврата; процесс не завершается ни при каких ошибках.
+ * С кэшем успешный результат сохраняется, а при попадании возвращается
+ * без запуска лексера, парсера и генератора. Ошибки в кэш не попадают.
+ * @param name Имя источника для сообщений об ошибках (может быть NULL)
+ * @return Результат или NULL при нехватке памяти; освобождается compile_result_free
+ */
+CompileResult *compile(Compiler *compiler, const char *name, const char *source, size_t length);
+
+// Отображает файл в память и компилирует его; при ошибке чтения возвращает NULL
+CompileResult *compile_file(Compiler *compiler, const char *filename);
+
+/**
+ * То же, что compile_file, но код операторов верхнего уровня хранится
+ * в state_file между компиляциями: после правки программы заново
+ * генерируются только изменённые операторы и зависящие от них.
+ * Файл состояния обновляется при успешной компиляции. Один state_file
+ * нельзя использовать из нескольких компиляций одновременно.
+ */
+CompileResult *compile_file_incremental(Compiler *compiler, const char *filename, const char *state_file);
+
+/**
+ * Компилирует двоичный AST, сохранённый flat_ast_save (-emit-ast):
+ * лексер и парсер не запускаются.
+ * @return NULL, если файл не удалось загрузить или он повреждён
+ */
+CompileResult *compile_ast_file(Compiler *compiler, const char *filename);
+
+/**
+ * Компилирует текст из канала или stdin по мере чтения: код каждого оператора
+ * верхнего уровня сразу пишется в output, память не растёт с длиной программы.
+ * Образ статических данных и частичное вычисление в этом режиме не применяются.
+ * При ошибке уже выведенный код остаётся в output без завершения программы.
+ * @return Результат без кода (code == NULL) или NULL при нехватке памяти
+ */
+CompileResult *compile_stream(Compiler *compiler, const char *name, FILE *input, FILE *output);
+
+/**
+ * То же, что compile_stream, но для файла: лексер, парсер и генератор кода
+ * работают в трёх потоках, и большой файл занимает несколько ядер.
+ * @return NULL, если файл не удалось открыть, или при нехватке памяти
+ */
+CompileResult *compile_file_pipelined(Compiler *compiler, const char *filename, FILE *output);
+
+void compile_result_free(CompileResult *result);
+
+#endif /* LIBCOMPILER_H */
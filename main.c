@@ -1,20 +1,238 @@
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include "ast/ast.h"
 #include "compiler/risc_generator.h"
 #include "ast/ast_visualizer.h"
+#include "ast/flat_ast.h"
+#include "compile_cache.h"
+#include "compile_context.h"
 #include "error_handler.h"
+#include "libcompiler.h"
+#include "batch.h"
+#include "compile_server.h"
+#include "compile_protocol.h"
+#include "thread_pool.h"
+#include "time_report.h"
+#include "tagged_alloc.h"
+#include "simulator/risc_sim.h"
 
 extern int parser_init(const char *filename);
 
 extern ASTNode *get_ast_root();
 
+#define DEFAULT_EVAL_STEPS COMPILER_DEFAULT_EVAL_STEPS
+#define DEFAULT_EVAL_MEMORY COMPILER_DEFAULT_EVAL_MEMORY
+// Строк и циклов в отчёте -sim-profile
+#define PROFILE_TOP 10
+
 void show_usage(const char *program_name) {
     fprintf(stderr, "Usage: %s <file> [options]\n", program_name);
+    fprintf(stderr, "       %s - [options]      (read the program from stdin)\n", program_name);
+    fprintf(stderr, "       %s -batch [options] <file>...\n", program_name);
+    fprintf(stderr, "       %s -server [-socket <path>] [-j <n>] [-cache <dir>]\n", program_name);
     fprintf(stderr, "Options:\n");
     fprintf(stderr, "  -o <file>    Save RISC code to file\n");
     fprintf(stderr, "  -ast         Show AST\n");
     fprintf(stderr, "  -ast-file <file>  Save AST to file\n");
+    fprintf(stderr, "  -emit-ast <file>  Save binary AST to file\n");
+    fprintf(stderr, "  -load-ast    Input is a binary AST from -emit-ast: skip lexing and parsing\n");
+    fprintf(stderr, "  -O0 | -O1 | -O2 | -Os  Optimization level (default -O1)\n");
+    fprintf(stderr, "  -g           Mark the code with .loc lines: source line and column of each statement\n");
+    fprintf(stderr, "  -f<pass> | -fno-<pass>  Enable or disable a single pass\n");
+    fprintf(stderr, "  -print-passes  Show passes enabled for this run\n");
+    fprintf(stderr, "  -fverify-ir  Check labels and jumps of the code after each pass\n");
+    fprintf(stderr, "  -ftime-report[=json]  Show time and memory per phase and pass (build with INSTRUMENT=1)\n");
+    fprintf(stderr, "  -falloc-report[=json]  Show allocations per subsystem at exit (build with INSTRUMENT=1)\n");
+    fprintf(stderr, "  -eval        Evaluate the program at compile time (same as -fpartial-eval)\n");
+    fprintf(stderr, "  -eval-steps <n>   Step budget for -eval (default %ld)\n", DEFAULT_EVAL_STEPS);
+    fprintf(stderr, "  -eval-memory <n>  Memory budget in bytes for -eval (default %ld)\n", DEFAULT_EVAL_MEMORY);
+    fprintf(stderr, "  -pipeline    Lex, parse and generate code on separate threads\n");
+    fprintf(stderr, "  -j <n>       Generate code on n threads (0: number of cores)\n");
+    fprintf(stderr, "  -incremental <file>  Keep per-statement code in file and regenerate only changed statements\n");
+    fprintf(stderr, "  -incremental-stats  Show how many statements were reused\n");
+    fprintf(stderr, "  -cache <dir>      Reuse results of earlier compilations stored in dir\n");
+    fprintf(stderr, "  -cache-size <n>   Cache size limit in bytes (default %ld)\n", COMPILE_CACHE_DEFAULT_SIZE);
+    fprintf(stderr, "  -cache-stats      Show cache hits and misses\n");
+    fprintf(stderr, "  -run         Run the generated code on the built-in RISC simulator\n");
+    fprintf(stderr, "  -sim-stats   Run and show retired instructions, memory operations, branches and cycles\n");
+    fprintf(stderr, "  -sim-cost <class=n,...>  Cycles per instruction class for -sim-stats:\n");
+    fprintf(stderr, "               alu, mul, div, load, store, branch, jump, system; taken = taken branch penalty\n");
+    fprintf(stderr, "  -sim-timing  Run on a pipeline model with a branch predictor and a data cache\n");
+    fprintf(stderr, "               and show stall cycles by cause\n");
+    fprintf(stderr, "  -sim-timing-config <param=value,...>  Pipeline model for -sim-timing: depth, load, mul, div,\n");
+    fprintf(stderr, "               mispredict, jump, predictor (not-taken, btfn, bimodal), entries, sets, ways,\n");
+    fprintf(stderr, "               line, miss\n");
+    fprintf(stderr, "  -sim-profile  Run and show the source lines and loops that take the most cycles\n");
+    fprintf(stderr, "               (implies -g; with -sim-timing the cycles come from the pipeline model)\n");
+    fprintf(stderr, "  -sim-steps <n>    Instruction budget for -run (default %ld)\n", RISC_SIM_DEFAULT_MAX_STEPS);
+    fprintf(stderr, "  -sim-memory <n>   Simulator memory in words (default %ld)\n", RISC_SIM_DEFAULT_MEMORY_WORDS);
+    fprintf(stderr, "Stdin and -pipeline modes write code to stdout (or -o <file>) statement by statement\n");
+    fprintf(stderr, "and do not use the cache (nor does -emit-ast), -incremental or -run\n");
+    fprintf(stderr, "Batch options:\n");
+    fprintf(stderr, "  -o <dir>     Output directory (default output)\n");
+    fprintf(stderr, "  -j <n>       Number of threads (default: number of cores)\n");
+    fprintf(stderr, "Server options (requests come from compiler_client with their own compile options):\n");
+    fprintf(stderr, "  -socket <path>  Listen on this Unix socket (default %s)\n", COMPILE_SERVER_DEFAULT_SOCKET);
+    fprintf(stderr, "  -j <n>       Compile n requests at once (default: number of cores)\n");
+}
+
+static void save_risc_code(const char *output_file, const char *risc_code) {
+    FILE *fp = fopen(output_file, "w");
+    if (fp) {
+        fprintf(fp, "%s", risc_code);
+        fclose(fp);
+        printf("RISC code saved to file %s\n", output_file);
+    } else {
+        fprintf(stderr, "Failed to open file %s for writing\n", output_file);
+    }
+}
+
+/**
+ * Ключ кэша для компиляции одного файла: содержимое файла, настройки
+ * генератора и то, нужен ли текст AST (-ast, -ast-file).
+ * @return 0 при успехе, -1 если файл не удалось прочитать
+ */
+static int make_cache_key(const char *filename, int load_ast, int need_ast, int line_info,
+                          const PassManager *pm, long eval_steps, long eval_memory, CacheKey *key,
+                          size_t *length) {
+    SourceBuffer source;
+    if (source_buffer_open(&source, filename) != 0) return -1;
+    compile_cache_key_init(key);
+    compile_cache_key_add_long(key, (long) pass_manager_enabled_mask(pm));
+    compile_cache_key_add_long(key, eval_steps);
+    compile_cache_key_add_long(key, eval_memory);
+    compile_cache_key_add_long(key, load_ast);
+    compile_cache_key_add_long(key, need_ast);
+    compile_cache_key_add_long(key, line_info);
+    compile_cache_key_add(key, source.data, source.length);
+    *length = source.length;
+    source_buffer_close(&source);
+    return 0;
+}
+
+// Повторяет вывод обычной компиляции по записи кэша
+static void print_cached_result(const CacheEntry *entry, int show_ast, const char *ast_output_file,
+                                const char *output_file) {
+    if (show_ast) {
+        printf("#AST:\n");
+        fwrite(entry->ast, 1, entry->ast_length, stdout);
+        printf("\n");
+    }
+    if (ast_output_file) {
+        FILE *fp = fopen(ast_output_file, "w");
+        if (!fp || fwrite(entry->ast, 1, entry->ast_length, fp) != entry->ast_length) {
+            fprintf(stderr, "Error saving AST to file %s\n", ast_output_file);
+        } else {
+            printf("AST saved to file %s\n", ast_output_file);
+        }
+        if (fp) fclose(fp);
+    }
+    printf("#RISC-code:\n%s\n", entry->code);
+    if (output_file) {
+        save_risc_code(output_file, entry->code);
+    }
+}
+
+// Отчёт -sim-profile; строки исходного текста берутся из source_file, если он задан
+static void print_profile(const SimProfile *profile, const RiscProgram *program, const char *source_file) {
+    SourceBuffer source;
+    int have_source = source_file && source_buffer_open(&source, source_file) == 0;
+    sim_profile_print(profile, program, have_source ? source.data : NULL, have_source ? source.length : 0,
+                      PROFILE_TOP, stderr);
+    if (have_source) source_buffer_close(&source);
+}
+
+/**
+ * Выполняет код симулятором (-run): вывод программы идёт в stdout после кода,
+ * счётчики — в stderr с -sim-stats или при ошибке выполнения.
+ * @param profile_source Исходный текст для -sim-profile (NULL — без текста строк)
+ * @return 0, если программа дошла до ebreak или конца кода
+ */
+static int run_risc_code(const char *code, const SimOptions *options, int print_stats, int profile,
+                         const char *profile_source) {
+    char error[256];
+    RiscProgram *program = risc_program_parse(code, strlen(code), error, sizeof(error));
+    if (!program) {
+        fprintf(stderr, "Cannot run the code: %s\n", error);
+        return 1;
+    }
+    SimOptions run_options = *options;
+    if (profile) {
+        run_options.profile = sim_profile_create(program);
+        if (!run_options.profile) fprintf(stderr, "Out of memory: running without -sim-profile\n");
+    }
+    printf("#Run:\n");
+    fflush(stdout);
+    SimStats stats;
+    SimStatus status = risc_simulate(program, &run_options, &stats);
+    fflush(stdout);
+    if (print_stats || status != SIM_OK) {
+        sim_print_stats(&stats, status, stderr);
+    }
+    if (run_options.profile) {
+        print_profile(run_options.profile, program, profile_source);
+        sim_profile_free(run_options.profile);
+    }
+    risc_program_free(program);
+    return status == SIM_OK ? 0 : 1;
+}
+
+// Текст AST, как его выводит visualize_ast; NULL при ошибке
+static char *render_ast(ASTNode *root, size_t *length) {
+    FILE *tmp = tmpfile();
+    if (!tmp) return NULL;
+    visualize_ast(root, tmp);
+    long size = ftell(tmp);
+    char *text = size >= 0 ? (char *) malloc((size_t) size + 1) : NULL;
+    rewind(tmp);
+    if (text && fread(text, 1, (size_t) size, tmp) != (size_t) size) {
+        free(text);
+        text = NULL;
+    }
+    fclose(tmp);
+    if (text) {
+        text[size] = '\0';
+        *length = (size_t) size;
+    }
+    return text;
+}
+
+static void print_cache_stats(CompileCache *cache) {
+    CacheStats stats;
+    compile_cache_get_stats(cache, &stats);
+    fprintf(stderr, "Cache: %ld hits, %ld misses, %ld stores, %ld evictions, %lu bytes\n",
+            stats.hits, stats.misses, stats.stores, stats.evictions, (unsigned long) stats.size);
+}
+
+// Печатает отчёт -ftime-report при выходе из main
+static void close_time_report(TimeReport *report, const char *filename, int json) {
+#ifdef COMPILER_INSTRUMENT
+    if (!report) return;
+    compile_context_current()->time_report = NULL;
+    time_report_print(report, filename, json, stderr);
+    time_report_free(report);
+#else
+    (void) report;
+    (void) filename;
+    (void) json;
+#endif
+}
+
+#ifdef COMPILER_INSTRUMENT
+static int alloc_report_json = 0;
+
+// Отчёт -falloc-report: счётчики общие для процесса, поэтому печатается при выходе в любом режиме
+static void print_alloc_report(void) {
+    tagged_alloc_print_report(alloc_report_json, stderr);
+}
+#endif
+
+// Закрывает кэш при выходе из main
+static void close_cache(CompileCache *cache, int print_stats) {
+    if (!cache) return;
+    if (print_stats) print_cache_stats(cache);
+    compile_cache_close(cache);
 }
 
 int main(int argc, char **argv) {
@@ -24,40 +242,353 @@ int main(int argc, char **argv) {
         return 1;
     }
 
+    int batch = strcmp(argv[1], "-batch") == 0;
+    int server = strcmp(argv[1], "-server") == 0;
     const char *filename = argv[1];
+    const char **batch_files = NULL;
+    int batch_count = 0;
+    int threads = 0;
+    int codegen_threads = 1;
     const char *output_file = NULL;
     const char *ast_output_file = NULL;
+    const char *ast_binary_file = NULL;
+    int load_ast = 0;
     int show_ast = 0;
+    int print_passes = 0;
+    int pipeline = 0;
+    long eval_steps = DEFAULT_EVAL_STEPS;
+    long eval_memory = DEFAULT_EVAL_MEMORY;
+    const char *cache_dir = NULL;
+    long cache_size = COMPILE_CACHE_DEFAULT_SIZE;
+    int cache_stats = 0;
+    const char *incremental_file = NULL;
+    int incremental_stats = 0;
+    const char *socket_path = COMPILE_SERVER_DEFAULT_SOCKET;
+    int time_report_format = -1;    // -1 — без отчёта, 0 — таблица, 1 — JSON
+    int run = 0;
+    int sim_stats = 0;
+    int sim_profile = 0;
+    int line_info = 0;
+    SimOptions sim_options;
+    sim_options_init(&sim_options);
+    sim_options.output = stdout;
+    SimTiming sim_timing;
+    sim_timing_init(&sim_timing);
+
+    PassManager *pass_manager = pass_manager_create(OPT_LEVEL_1);
+    if (!pass_manager) {
+        fprintf(stderr, "Out of memory\n");
+        return 1;
+    }
+    if (batch) {
+        batch_files = (const char **) malloc(argc * sizeof(const char *));
+        if (!batch_files) {
+            fprintf(stderr, "Out of memory\n");
+            pass_manager_free(pass_manager);
+            return 1;
+        }
+    }
 
     for (int i = 2; i < argc; i++) {
+        // До разбора -f<pass>: time-report — не проход
+        if (strcmp(argv[i], "-ftime-report") == 0 || strcmp(argv[i], "-ftime-report=json") == 0) {
+            time_report_format = argv[i][strlen("-ftime-report")] == '=' ? 1 : 0;
+            continue;
+        }
+        if (strcmp(argv[i], "-falloc-report") == 0 || strcmp(argv[i], "-falloc-report=json") == 0) {
+#ifdef COMPILER_INSTRUMENT
+            alloc_report_json = argv[i][strlen("-falloc-report")] == '=';
+            atexit(print_alloc_report);
+#else
+            fprintf(stderr, "-falloc-report needs a build with COMPILER_INSTRUMENT (make INSTRUMENT=1)\n");
+#endif
+            continue;
+        }
+        int parsed = pass_manager_parse_option(pass_manager, argv[i]);
+        if (parsed > 0) {
+            continue;
+        }
+        if (parsed < 0) {
+            fprintf(stderr, "Unknown optimization option: %s\n", argv[i]);
+            show_usage(argv[0]);
+            pass_manager_free(pass_manager);
+            return 1;
+        }
         if (strcmp(argv[i], "-o") == 0 && i + 1 < argc) {
             output_file = argv[++i];
         } else if (strcmp(argv[i], "-ast") == 0) {
             show_ast = 1;
         } else if (strcmp(argv[i], "-ast-file") == 0 && i + 1 < argc) {
             ast_output_file = argv[++i];
+        } else if (strcmp(argv[i], "-emit-ast") == 0 && i + 1 < argc) {
+            ast_binary_file = argv[++i];
+        } else if (strcmp(argv[i], "-load-ast") == 0) {
+            load_ast = 1;
+        } else if (strcmp(argv[i], "-g") == 0) {
+            line_info = 1;
+        } else if (strcmp(argv[i], "-print-passes") == 0) {
+            print_passes = 1;
+        } else if (strcmp(argv[i], "-pipeline") == 0) {
+            pipeline = 1;
+        } else if (strcmp(argv[i], "-eval") == 0) {
+            pass_manager_set_enabled(pass_manager, "partial-eval", 1);
+        } else if (strcmp(argv[i], "-eval-steps") == 0 && i + 1 < argc) {
+            pass_manager_set_enabled(pass_manager, "partial-eval", 1);
+            eval_steps = atol(argv[++i]);
+        } else if (strcmp(argv[i], "-eval-memory") == 0 && i + 1 < argc) {
+            pass_manager_set_enabled(pass_manager, "partial-eval", 1);
+            eval_memory = atol(argv[++i]);
+        } else if (strcmp(argv[i], "-j") == 0 && i + 1 < argc) {
+            threads = atoi(argv[++i]);
+            codegen_threads = threads > 0 ? threads : thread_pool_cpu_count();
+        } else if (strcmp(argv[i], "-incremental") == 0 && i + 1 < argc) {
+            incremental_file = argv[++i];
+        } else if (strcmp(argv[i], "-incremental-stats") == 0) {
+            incremental_stats = 1;
+        } else if (strcmp(argv[i], "-cache") == 0 && i + 1 < argc) {
+            cache_dir = argv[++i];
+        } else if (strcmp(argv[i], "-cache-size") == 0 && i + 1 < argc) {
+            cache_size = atol(argv[++i]);
+        } else if (strcmp(argv[i], "-cache-stats") == 0) {
+            cache_stats = 1;
+        } else if (strcmp(argv[i], "-socket") == 0 && i + 1 < argc) {
+            socket_path = argv[++i];
+        } else if (strcmp(argv[i], "-run") == 0) {
+            run = 1;
+        } else if (strcmp(argv[i], "-sim-stats") == 0) {
+            run = 1;
+            sim_stats = 1;
+        } else if (strcmp(argv[i], "-sim-cost") == 0 && i + 1 < argc) {
+            run = 1;
+            sim_stats = 1;
+            if (sim_costs_parse(&sim_options.costs, argv[++i]) != 0) {
+                fprintf(stderr, "Bad -sim-cost: %s\n", argv[i]);
+                free(batch_files);
+                pass_manager_free(pass_manager);
+                return 1;
+            }
+        } else if (strcmp(argv[i], "-sim-timing") == 0) {
+            run = 1;
+            sim_stats = 1;
+            sim_options.timing = &sim_timing;
+        } else if (strcmp(argv[i], "-sim-timing-config") == 0 && i + 1 < argc) {
+            run = 1;
+            sim_stats = 1;
+            sim_options.timing = &sim_timing;
+            if (sim_timing_parse(&sim_timing, argv[++i]) != 0) {
+                fprintf(stderr, "Bad -sim-timing-config: %s\n", argv[i]);
+                free(batch_files);
+                pass_manager_free(pass_manager);
+                return 1;
+            }
+        } else if (strcmp(argv[i], "-sim-profile") == 0) {
+            run = 1;
+            sim_profile = 1;
+            line_info = 1;
+        } else if (strcmp(argv[i], "-sim-steps") == 0 && i + 1 < argc) {
+            run = 1;
+            sim_options.max_steps = atol(argv[++i]);
+        } else if (strcmp(argv[i], "-sim-memory") == 0 && i + 1 < argc) {
+            run = 1;
+            sim_options.memory_words = (size_t) atol(argv[++i]);
+        } else if (batch && argv[i][0] != '-') {
+            batch_files[batch_count++] = argv[i];
         } else {
             fprintf(stderr, "Unknown option: %s\n", argv[i]);
             show_usage(argv[0]);
+            free(batch_files);
+            pass_manager_free(pass_manager);
             return 1;
         }
     }
 
-    error_init();
+    if (print_passes) {
+        pass_manager_print(pass_manager, stderr);
+    }
 
-    if (parser_init(filename) != 0) {
-        fprintf(stderr, "Error parsing file %s\n", filename);
-        error_free();
-        return 1;
+    CompileCache *cache = NULL;
+    if (cache_dir) {
+        cache = compile_cache_open(cache_dir, cache_size > 0 ? (size_t) cache_size : 0);
+        if (!cache) {
+            fprintf(stderr, "Cannot open cache directory %s; compiling without cache\n", cache_dir);
+        }
     }
 
-    ASTNode *ast_root = get_ast_root();
-    if (!ast_root) {
-        fprintf(stderr, "Failed to build AST for file %s\n", filename);
-        error_free();
-        return 1;
+    int from_stdin = strcmp(filename, "-") == 0;
+    if (time_report_format >= 0 && (batch || server || ((from_stdin || pipeline) && !load_ast))) {
+        fprintf(stderr, "-ftime-report is supported only when compiling a single file\n");
+        time_report_format = -1;
+    }
+    if (run && (batch || server || ((from_stdin || pipeline) && !load_ast))) {
+        fprintf(stderr, "-run is supported only when compiling a single file\n");
+        run = 0;
+    }
+
+    if (server) {
+        CompileServerOptions options;
+        options.socket_path = socket_path;
+        options.threads = threads;
+        options.cache = cache;
+        CompileServerStats stats;
+        fprintf(stderr, "Starting compile server on %s\n", socket_path);
+        int status = compile_server_run(&options, &stats);
+        if (status == -1) {
+            fprintf(stderr, "Cannot listen on %s (is another server running?)\n", socket_path);
+        } else if (status != 0) {
+            fprintf(stderr, "Server stopped: cannot accept connections on %s after %ld requests\n",
+                    socket_path, stats.requests);
+        } else {
+            fprintf(stderr, "Server stopped: %ld requests, %ld failed\n", stats.requests, stats.failed);
+        }
+        close_cache(cache, cache_stats);
+        pass_manager_free(pass_manager);
+        return status != 0 ? 1 : 0;
+    }
+
+    if (batch) {
+        if (show_ast || ast_output_file || ast_binary_file) {
+            fprintf(stderr, "AST output is not supported in batch mode\n");
+        }
+        CompilerOptions compiler_options;
+        compiler_options_init(&compiler_options);
+        compiler_options.pass_manager = pass_manager;
+        compiler_options.eval_steps = eval_steps;
+        compiler_options.eval_memory = (size_t) eval_memory;
+        compiler_options.print_diagnostics = 1;
+        compiler_options.cache = cache;
+        compiler_options.line_info = line_info;
+        BatchOptions options;
+        options.compiler = compiler_create(&compiler_options);
+        options.output_dir = output_file ? output_file : "output";
+        options.threads = threads;
+        options.load_ast = load_ast;
+        int failed = options.compiler ? compile_batch(batch_files, batch_count, &options) : batch_count;
+        compiler_free(options.compiler);
+        free(batch_files);
+        close_cache(cache, cache_stats);
+        pass_manager_free(pass_manager);
+        return failed > 0 ? 1 : 0;
+    }
+
+    if ((from_stdin || pipeline) && !load_ast) {
+        if (show_ast || ast_output_file || ast_binary_file) {
+            fprintf(stderr, "AST output is not supported in stdin and -pipeline modes\n");
+        }
+        if (from_stdin && pipeline) {
+            fprintf(stderr, "-pipeline needs a file; reading stdin on one thread\n");
+        }
+        FILE *out = output_file ? fopen(output_file, "w") : stdout;
+        if (!out) {
+            fprintf(stderr, "Failed to open file %s for writing\n", output_file);
+            close_cache(cache, cache_stats);
+            pass_manager_free(pass_manager);
+            return 1;
+        }
+        CompilerOptions compiler_options;
+        compiler_options_init(&compiler_options);
+        compiler_options.pass_manager = pass_manager;
+        compiler_options.print_diagnostics = 1;
+        compiler_options.line_info = line_info;
+        Compiler *compiler = compiler_create(&compiler_options);
+        CompileResult *result = NULL;
+        if (!compiler) {
+            fprintf(stderr, "Out of memory\n");
+        } else if (from_stdin) {
+            result = compile_stream(compiler, "stdin", stdin, out);
+        } else {
+            result = compile_file_pipelined(compiler, filename, out);
+            if (!result) {
+                fprintf(stderr, "Cannot open file: %s\n", filename);
+            }
+        }
+        // Итоговая строка та же, что при компиляции файла целиком
+        if (result && result->status == COMPILE_SYNTAX_ERROR) {
+            fprintf(stderr, "Error parsing file %s\n", from_stdin ? "stdin" : filename);
+        } else if (result && result->status != COMPILE_OK) {
+            fprintf(stderr, "Error generating RISC code\n");
+        }
+        int status = result && result->status == COMPILE_OK ? 0 : 1;
+        compile_result_free(result);
+        compiler_free(compiler);
+        if (out != stdout) {
+            fclose(out);
+            // Код пишется по мере разбора: после ошибки в файле осталось бы начало программы
+            if (status != 0) remove(output_file);
+        }
+        close_cache(cache, cache_stats);
+        pass_manager_free(pass_manager);
+        return status;
+    }
+
+    // Дальше все пути выходят через done: отчёт о времени печатается на любом из них
+    int status = 1;
+    ASTNode *ast_root = NULL;
+    char *risc_code = NULL;
+    TimeReport *time_report = NULL;
+    if (time_report_format >= 0) {
+#ifdef COMPILER_INSTRUMENT
+        time_report = time_report_create();
+        compile_context_current()->time_report = time_report;
+#else
+        fprintf(stderr, "-ftime-report needs a build with COMPILER_INSTRUMENT (make INSTRUMENT=1)\n");
+#endif
+    }
+
+    // -emit-ast пишет файл, которого нет в записи кэша, поэтому компилирует всегда
+    int need_ast = show_ast || ast_output_file;
+    CacheKey cache_key;
+    size_t source_length = 0;
+    TIME_REPORT_BEGIN("cache");
+    if (cache && (ast_binary_file ||
+                  make_cache_key(filename, load_ast, need_ast, line_info, pass_manager, eval_steps, eval_memory,
+                                 &cache_key, &source_length) != 0)) {
+        close_cache(cache, cache_stats);
+        cache = NULL;
+    }
+    if (cache) {
+        CacheEntry *entry = compile_cache_lookup(cache, &cache_key, source_length);
+        if (entry && (!need_ast || entry->ast)) {
+            TIME_REPORT_END();
+            print_cached_result(entry, show_ast, ast_output_file, output_file);
+            status = run ? run_risc_code(entry->code, &sim_options, sim_stats, sim_profile,
+                                         load_ast ? NULL : filename) : 0;
+            compile_cache_entry_free(entry);
+            goto done;
+        }
+        compile_cache_entry_free(entry);
+    }
+    TIME_REPORT_END();
+
+    error_init();
+
+    if (load_ast) {
+        // Двоичный AST уже разобран: лексер и парсер не нужны
+        TIME_REPORT_BEGIN("load-ast");
+        FlatAST *flat = flat_ast_load(filename);
+        ast_root = flat ? flat_ast_to_node(flat) : NULL;
+        flat_ast_free(flat);
+        TIME_REPORT_END();
+        if (!ast_root) {
+            fprintf(stderr, "Cannot load AST file %s\n", filename);
+            goto done;
+        }
+    } else {
+        TIME_REPORT_BEGIN("parse");
+        int parse_status = parser_init(filename);
+        TIME_REPORT_END();
+        if (parse_status != 0) {
+            fprintf(stderr, "Error parsing file %s\n", filename);
+            goto done;
+        }
+
+        ast_root = get_ast_root();
+        if (!ast_root) {
+            fprintf(stderr, "Failed to build AST for file %s\n", filename);
+            goto done;
+        }
     }
 
+    TIME_REPORT_BEGIN("ast-output");
     if (show_ast) {
         printf("#AST:\n");
         visualize_ast(ast_root, stdout);
@@ -72,37 +603,93 @@ int main(int argc, char **argv) {
         }
     }
 
+    if (ast_binary_file) {
+        FlatAST *flat = flat_ast_from_node(ast_root);
+        if (!flat || flat_ast_save(flat, ast_binary_file) != 0) {
+            fprintf(stderr, "Error saving AST to file %s\n", ast_binary_file);
+        } else {
+            printf("Binary AST saved to file %s\n", ast_binary_file);
+        }
+        flat_ast_free(flat);
+    }
+    TIME_REPORT_END();
+
     if (error_has_errors()) {
         fprintf(stderr, "\nCompilation aborted due to errors.\n");
         error_print_all(stderr);
-        error_free();
-        return 1;
+        goto done;
     }
 
     set_risc_generator_filename(filename);
+    set_risc_generator_eval_budget(eval_steps, (size_t) eval_memory);
+    set_risc_generator_pass_manager(pass_manager);
+    set_risc_generator_threads(codegen_threads);
+    set_risc_generator_line_info(line_info);
 
-    char *risc_code = generate_risc_code(ast_root);
+    TIME_REPORT_BEGIN("codegen");
+    IncrementalState *incremental = NULL;
+    if (incremental_file && line_info) {
+        // Сохранённые фрагменты не содержат строк .loc
+        fprintf(stderr, "-incremental is not used with -g: generating all statements\n");
+    } else if (incremental_file) {
+        incremental = incremental_state_load(incremental_file, pass_manager_enabled_mask(pass_manager));
+        set_risc_generator_incremental(incremental);
+    }
+
+    risc_code = generate_risc_code(ast_root);
+
+    if (incremental) {
+        if (risc_code && incremental_state_save(incremental, incremental_file) != 0) {
+            fprintf(stderr, "Failed to save incremental state to %s\n", incremental_file);
+        }
+        if (incremental_stats) {
+            long reused, regenerated;
+            incremental_state_get_stats(incremental, &reused, &regenerated);
+            fprintf(stderr, "Incremental: %ld statements reused, %ld regenerated\n", reused, regenerated);
+        }
+        set_risc_generator_incremental(NULL);
+        incremental_state_free(incremental);
+    }
+    TIME_REPORT_END();
     if (!risc_code) {
         fprintf(stderr, "Error generating RISC code\n");
-        error_free();
-        return 1;
+        goto done;
     }
 
+    TIME_REPORT_BEGIN("output");
     printf("#RISC-code:\n%s\n", risc_code);
 
     if (output_file) {
-        FILE *fp = fopen(output_file, "w");
-        if (fp) {
-            fprintf(fp, "%s", risc_code);
-            fclose(fp);
-            printf("RISC code saved to file %s\n", output_file);
-        } else {
-            fprintf(stderr, "Failed to open file %s for writing\n", output_file);
+        save_risc_code(output_file, risc_code);
+    }
+
+    if (cache) {
+        size_t ast_length = 0;
+        char *ast_text = need_ast ? render_ast(ast_root, &ast_length) : NULL;
+        if (!need_ast || ast_text) {
+            compile_cache_store(cache, &cache_key, source_length, risc_code, strlen(risc_code),
+                                ast_text, ast_length);
         }
+        free(ast_text);
     }
+    TIME_REPORT_END();
 
+    status = 0;
+    if (run) {
+        TIME_REPORT_BEGIN("run");
+        status = run_risc_code(risc_code, &sim_options, sim_stats, sim_profile,
+                               load_ast ? NULL : filename);
+        TIME_REPORT_END();
+    }
+
+done:
     free_risc_code(risc_code);
     error_free();
+    // Дерево парсера живёт до выхода, загруженное принадлежит main
+    if (load_ast) free_node(ast_root);
+    close_time_report(time_report, filename, time_report_format);
+    close_cache(cache, cache_stats);
+    pass_manager_free(pass_manager);
 
-    return 0;
+    return status;
 } 
\ No newline at end of file
@@ -1,49 +1,54 @@
+%code requires {
+#include "../compile_context.h"
+
+#ifndef YY_TYPEDEF_YY_SCANNER_T
+#define YY_TYPEDEF_YY_SCANNER_T
+typedef void *yyscan_t;
+#endif
+}
+
 %{
 #include <stdio.h>
 #include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
-#include "../ast.h"
-
-
-extern int yylex();
-extern int yyparse();
-extern void yyerror(const char* s);
-extern FILE* yyin;
+#include "../ast/ast.h"
+#include "../compile_context.h"
+#include "../lexer/source_stream.h"
 
 extern int get_current_line(void);
 extern int get_current_column(void);
 extern void get_token_position(int *line, int *column);
 
-
-static char current_filename[256] = "";
-
-
 void set_parser_filename(const char* filename) {
+    CompileContext *ctx = compile_context_current();
     if (filename) {
-        strncpy(current_filename, filename, sizeof(current_filename) - 1);
-        current_filename[sizeof(current_filename) - 1] = '\0';
+        strncpy(ctx->filename, filename, sizeof(ctx->filename) - 1);
+        ctx->filename[sizeof(ctx->filename) - 1] = '\0';
     } else {
-        strcpy(current_filename, "unknown");
+        strcpy(ctx->filename, "unknown");
     }
 }
 
 const char* get_parser_filename(void) {
-    return current_filename;
+    return compile_context_current()->filename;
 }
-
-extern ASTNode* ast_root;
 %}
 
+%define api.pure full
+%define api.push-pull both
+%locations
+%lex-param {yyscan_t scanner}
+%parse-param {yyscan_t scanner} {CompileContext *ctx}
 
 %union{
    int ival;
-   char* sval;
+   SourceSlice slice;
    ASTNode* node;
 }
 
 %token <ival> INT_LITERAL
-%token <sval> IDENTIFIER STRING_LITERAL COMPARE
+%token <slice> IDENTIFIER STRING_LITERAL COMPARE
 
 %token IF ELSE WHILE ROUND IN RANGE
 %token EVERE LIM PRINT
@@ -51,7 +56,7 @@ extern ASTNode* ast_root;
 %token INT STRING
 %token UNKNOWN
 
-%type <node> program operation_list operation declaration
+%type <node> program top_level_list operation_list operation declaration
 %type <node> expr print_opr if_opr while_opr round_opr block_stmt
 %type <node> assignment scope_type
 
@@ -60,12 +65,68 @@ extern ASTNode* ast_root;
 %left '*' '/' '%'
 %left '.'
 
+%destructor { free_node($$); } <node>
+%destructor { } program top_level_list  /* дерево уже передано в ctx->ast_root */
+
 %start program
 
+// Функции лексера flex для парсера, конвейера и бенчмарков
+%code provides {
+int yylex(YYSTYPE *yylval_param, YYLTYPE *yylloc_param, yyscan_t yyscanner);
+int yylex_init_extra(CompileContext *extra, yyscan_t *scanner);
+int yylex_destroy(yyscan_t scanner);
+struct yy_buffer_state *yy_scan_buffer(char *base, size_t size, yyscan_t scanner);
+void yy_delete_buffer(struct yy_buffer_state *buffer, yyscan_t scanner);
+char *yyget_text(yyscan_t scanner);
+}
+
+%code {
+void yyerror(YYLTYPE *location, yyscan_t scanner, CompileContext *ctx, const char *s);
+
+// Позиция узла берётся из @$ (или @2 для бинарной операции) при разборе,
+// а не из текущей позиции лексера, которая к тому времени ушла вперёд
+static ASTNode *at(ASTNode *node, YYLTYPE location) {
+    set_node_location(node, location.first_line, location.first_column);
+    return node;
+}
+
+// Строка токена для конструкторов AST: они копируют имя себе, поэтому
+// срез собирается во временном буфере контекста, действительном до следующего вызова
+static const char *token_text(CompileContext *ctx, SourceSlice slice) {
+    if (slice.length + 1 > ctx->token_text_capacity) {
+        size_t capacity = ctx->token_text_capacity ? ctx->token_text_capacity : 64;
+        while (capacity < slice.length + 1) capacity *= 2;
+        char *text = (char *) realloc(ctx->token_text, capacity);
+        if (!text) return "";
+        ctx->token_text = text;
+        ctx->token_text_capacity = capacity;
+    }
+    memcpy(ctx->token_text, ctx->source + (slice.offset - ctx->source_offset), slice.length);
+    ctx->token_text[slice.length] = '\0';
+    return ctx->token_text;
+}
+}
+
 %%
 
 program
-    : operation_list  { ast_root = $1; }
+    : top_level_list  { ctx->ast_root = $1; $$ = $1; }
+    ;
+
+/* Узел программы попадает в ctx->ast_root сразу при создании: при потоковом
+   разборе готовые операторы верхнего уровня забираются из него по мере разбора */
+top_level_list
+    : top_level_list operation
+    {
+        $$ = $1;
+        if ($2) { add_child($$, $2); }
+    }
+    | operation
+    {
+        $$ = at(create_program_node(), @$);
+        ctx->ast_root = $$;
+        if ($1) { add_child($$, $1); }
+    }
     ;
 
 operation_list
@@ -76,7 +137,7 @@ operation_list
     }
     | operation 
     { 
-        $$ = create_program_node(); 
+        $$ = create_block_node(); 
         if ($1) { add_child($$, $1); }
     }
     ;
@@ -100,128 +161,112 @@ declaration
     : INT scope_type IDENTIFIER  
     { 
         int is_global = $2->literal.int_value;
-        $$ = create_variable_declaration($3, "int", is_global);
+        $$ = at(create_variable_declaration(token_text(ctx, $3), "int", is_global), @$);
         free_node($2);
-        free($3);
     }
     | STRING scope_type IDENTIFIER  
     { 
         int is_global = $2->literal.int_value;
-        $$ = create_variable_declaration($3, "string", is_global);
+        $$ = at(create_variable_declaration(token_text(ctx, $3), "string", is_global), @$);
         free_node($2);
-        free($3);
     }
     | INT scope_type IDENTIFIER '=' expr
     { 
         int is_global = $2->literal.int_value;
-        $$ = create_variable_declaration_with_init($3, "int", is_global, $5);
+        $$ = at(create_variable_declaration_with_init(token_text(ctx, $3), "int", is_global, $5), @$);
         free_node($2);
-        free($3);
     }
     | STRING scope_type IDENTIFIER '=' expr
     { 
         int is_global = $2->literal.int_value;
-        $$ = create_variable_declaration_with_init($3, "string", is_global, $5);
+        $$ = at(create_variable_declaration_with_init(token_text(ctx, $3), "string", is_global, $5), @$);
         free_node($2);
-        free($3);
     }
     ;
 
 assignment
     : IDENTIFIER '=' expr 
     { 
-        $$ = create_assignment_node($1, $3);
-        free($1);
+        $$ = at(create_assignment_node(token_text(ctx, $1), $3), @$);
     }
     ;
 
 print_opr
     : PRINT '(' expr ')'
     { 
-        $$ = create_print_node($3);
+        $$ = at(create_print_node($3), @$);
     }
     ;
 
 if_opr
     : IF '(' expr ')' operation
     { 
-        $$ = create_if_node($3, $5, NULL);
+        $$ = at(create_if_node($3, $5, NULL), @$);
     }
     | IF '(' expr ')' operation ELSE operation
     { 
-        $$ = create_if_node($3, $5, $7);
+        $$ = at(create_if_node($3, $5, $7), @$);
     }
     ;
 
 while_opr
     : WHILE '(' expr ')' operation
     { 
-        $$ = create_while_node($3, $5);
+        $$ = at(create_while_node($3, $5), @$);
     }
     ;
 
 round_opr
     : ROUND IDENTIFIER IN RANGE '(' expr ',' expr ',' expr ')' operation
     { 
-        $$ = create_round_node($2, $6, $8, $10, $12);
-        free($2);
+        $$ = at(create_round_node(token_text(ctx, $2), $6, $8, $10, $12), @$);
     }
     ;
 
 block_stmt
     : '{' operation_list '}'
     { 
-        $$ = create_block_node();
-        // Копируем дочерние узлы из operation_list в block
-        if ($2 && ($2->type == NODE_PROGRAM || $2->type == NODE_BLOCK)) {
-            NodeList* children = &$2->block.children;
-            for (size_t i = 0; i < children->size; i++) {
-                add_child($$, children->items[i]);
-            }
-            // Очищаем родительский узел, но не его детей (они теперь принадлежат новому блоку)
-            children->size = 0;
-            free_node($2);
-        }
+        // operation_list сразу собирается в узел блока; позиция блока — его '{'
+        $$ = at($2, @1);
     }
     ;
 
 expr
     : expr '+' expr
     { 
-        $$ = create_binary_operation("+", $1, $3);
+        $$ = at(create_binary_operation("+", $1, $3), @2);
     }
     | expr '-' expr
     { 
-        $$ = create_binary_operation("-", $1, $3);
+        $$ = at(create_binary_operation("-", $1, $3), @2);
     }
     | expr '*' expr
     { 
-        $$ = create_binary_operation("*", $1, $3);
+        $$ = at(create_binary_operation("*", $1, $3), @2);
     }
     | expr '/' expr
     { 
-        $$ = create_binary_operation("/", $1, $3);
+        $$ = at(create_binary_operation("/", $1, $3), @2);
     }
     | expr '%' expr
     { 
-        $$ = create_binary_operation("%", $1, $3);
+        $$ = at(create_binary_operation("%", $1, $3), @2);
     }
     | expr '.' expr
     { 
-        $$ = create_binary_operation(".", $1, $3);
+        $$ = at(create_binary_operation(".", $1, $3), @2);
     }
     | expr COMPARE expr
     { 
-        $$ = create_binary_operation($2, $1, $3);
-        free($2);
+        $$ = at(create_binary_operation(token_text(ctx, $2), $1, $3), @2);
     }
     | expr AND expr
     { 
-        $$ = create_binary_operation("and", $1, $3);
+        $$ = at(create_binary_operation("and", $1, $3), @2);
     }
     | expr OR expr
     { 
-        $$ = create_binary_operation("or", $1, $3);
+        $$ = at(create_binary_operation("or", $1, $3), @2);
     }
     | '(' expr ')'
     { 
@@ -229,50 +274,155 @@ expr
     }
     | INT_LITERAL
     { 
-        $$ = create_literal_int($1);
+        $$ = at(create_literal_int($1), @$);
     }
     | STRING_LITERAL
     { 
-        $$ = create_literal_string($1);
-        free($1);
+        $$ = at(create_literal_string(token_text(ctx, $1)), @$);
     }
     | IDENTIFIER
     { 
-        $$ = create_identifier_node($1);
-        free($1);
+        $$ = at(create_identifier_node(token_text(ctx, $1)), @$);
     }
     ;
 
 %%
 
-void yyerror(const char* s) {
-    fprintf(stderr, "Parser error at %s:%d:%d: %s\n", 
-            current_filename, get_current_line(), get_current_column(), s);
-    exit(1);
+// Ошибка разбора завершает только текущую компиляцию: yyparse вернёт 1,
+// а частично построенные узлы освободит %destructor
+void yyerror(YYLTYPE *location, yyscan_t scanner, CompileContext *ctx, const char* s) {
+    error_report(ERROR_SYNTAX, location->first_line, location->first_column, ctx->filename, "%s", s);
+}
+
+// Разбор текста на месте: flex сканирует буфер без копирования,
+// токены ссылаются на него срезами, поэтому буфер живёт до конца разбора
+int parser_parse_source(SourceBuffer *source) {
+    CompileContext *ctx = compile_context_current();
+    yyscan_t scanner;
+    if (yylex_init_extra(ctx, &scanner) != 0) {
+        return 1;
+    }
+    if (!yy_scan_buffer(source->data, source_buffer_scan_size(source), scanner)) {
+        yylex_destroy(scanner);
+        return 1;
+    }
+    ctx->source = source->data;
+    ctx->source_length = source->length;
+    int status = yyparse(scanner, ctx);
+    ctx->source = NULL;
+    ctx->source_length = 0;
+    yylex_destroy(scanner);
+    return status == 0 ? 0 : 1;
+}
+
+// Отдаёт обработчику готовые операторы верхнего уровня и освобождает их
+static int drain_statements(CompileContext *ctx, int (*handle_statement)(ASTNode *, void *), void *arg) {
+    if (!ctx->ast_root) return 0;
+    NodeList *children = &ctx->ast_root->block.children;
+    int status = 0;
+    for (size_t i = 0; i < children->size; i++) {
+        if (status == 0 && handle_statement(children->items[i], arg) != 0) {
+            status = 1;
+        }
+        free_node(children->items[i]);
+    }
+    children->size = 0;
+    return status;
+}
+
+/**
+ * Потоковый разбор: вход читается порциями, токены передаются push-парсеру,
+ * и каждый оператор верхнего уровня уходит обработчику сразу после разбора.
+ * В памяти остаются только текст и дерево незаконченного оператора.
+ */
+int parser_parse_stream(FILE *input, int (*handle_statement)(ASTNode *, void *), void *arg) {
+    CompileContext *ctx = compile_context_current();
+    yyscan_t scanner;
+    if (yylex_init_extra(ctx, &scanner) != 0) {
+        return 1;
+    }
+    yypstate *parser = yypstate_new();
+    if (!parser) {
+        yylex_destroy(scanner);
+        return 1;
+    }
+    SourceStream stream;
+    source_stream_init(&stream, input);
+    struct yy_buffer_state *buffer = NULL;
+    // Позиция последнего токена: её получает и конец входа
+    YYLTYPE location = {1, 1, 1, 1};
+    // Текст до keep уже не нужен: ссылавшиеся на него операторы отданы обработчику
+    size_t keep = 0;
+    int status = YYPUSH_MORE;
+    while (status == YYPUSH_MORE) {
+        char *segment;
+        long length = source_stream_next(&stream, keep, &segment);
+        if (length < 0) {
+            status = 1;
+            break;
+        }
+        if (buffer) {
+            yy_delete_buffer(buffer, scanner);
+            buffer = NULL;
+        }
+        if (length == 0) {
+            status = yypush_parse(parser, 0, NULL, &location, scanner, ctx);
+            if (drain_statements(ctx, handle_statement, arg) != 0) status = 1;
+            break;
+        }
+        buffer = yy_scan_buffer(segment, (size_t) length + 2, scanner);
+        if (!buffer) {
+            status = 1;
+            break;
+        }
+        ctx->source = stream.data;
+        ctx->source_length = stream.length;
+        ctx->source_offset = stream.base;
+        YYSTYPE value;
+        int token;
+        while (status == YYPUSH_MORE && (token = yylex(&value, &location, scanner)) != 0) {
+            size_t token_start = stream.base + (size_t) (yyget_text(scanner) - stream.data);
+            status = yypush_parse(parser, token, &value, &location, scanner, ctx);
+            if (ctx->ast_root && ctx->ast_root->block.children.size > 0) {
+                // Оператор мог завершиться только при чтении этого токена,
+                // и сам токен ещё может лежать в стеке парсера
+                if (drain_statements(ctx, handle_statement, arg) != 0) status = 1;
+                keep = token_start;
+            }
+        }
+    }
+    if (buffer) {
+        yy_delete_buffer(buffer, scanner);
+    }
+    ctx->source = NULL;
+    ctx->source_length = 0;
+    ctx->source_offset = 0;
+    source_stream_close(&stream);
+    yypstate_delete(parser);
+    yylex_destroy(scanner);
+    return status == 0 ? 0 : 1;
 }
 
 int parser_init(const char* filename) {
-    // Открытие входного файла
-    FILE* input_file = fopen(filename, "r");
-    if (!input_file) {
+    // Отображение входного файла в память
+    SourceBuffer source;
+    if (source_buffer_open(&source, filename) != 0) {
         fprintf(stderr, "Cannot open file: %s\n", filename);
         return 1;
     }
-    yyin = input_file;
     
     // Установка имени файла
     set_parser_filename(filename);
     
     // Старт парсера
-    yyparse();
+    int status = parser_parse_source(&source);
     
     // Закрытие файла
-    fclose(input_file);
+    source_buffer_close(&source);
     
-    return 0;
+    return status;
 }
 
 ASTNode* get_ast_root() {
-    return ast_root;
+    return compile_context_current()->ast_root;
 }
-
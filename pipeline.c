@@ -0,0 +1,198 @@
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include "pipeline.h"
+#include "spsc_ring.h"
+#include "compile_context.h"
+#include "compiler/risc_generator.h"
+#include "parser/parser.tab.h"
+
+#define TOKEN_RING_SIZE 4096
+#define STATEMENT_RING_SIZE 256
+
+// Токен, его место в тексте и позиция лексера после него
+typedef struct {
+    int token;
+    int line;
+    int column;
+    YYSTYPE value;
+    YYLTYPE location;
+} PipelineToken;
+
+// Оператор верхнего уровня и позиция лексера на момент его завершения
+typedef struct {
+    ASTNode *node;
+    int line;
+    int column;
+} PipelineStatement;
+
+typedef struct {
+    yyscan_t scanner;
+    CompileContext *ctx;            // только позиция и исходный текст
+    SpscRing *tokens;
+} LexerStage;
+
+typedef struct {
+    CompileContext *ctx;            // собственные ошибки и настройки генератора
+    SpscRing *statements;
+    FILE *output;
+    int parse_failed;               // выставляется до закрытия очереди операторов
+    int status;
+} CodegenStage;
+
+static void *lexer_main(void *arg) {
+    LexerStage *stage = (LexerStage *) arg;
+    PipelineToken item;
+    while ((item.token = yylex(&item.value, &item.location, stage->scanner)) != 0) {
+        item.line = stage->ctx->line_num;
+        item.column = stage->ctx->column_num;
+        if (spsc_ring_push(stage->tokens, &item) != 0) break;
+    }
+    spsc_ring_close(stage->tokens);
+    return NULL;
+}
+
+static void *codegen_main(void *arg) {
+    CodegenStage *stage = (CodegenStage *) arg;
+    compile_context_bind(stage->ctx);
+    RiscStream *stream = risc_stream_create(stage->output);
+    stage->status = stream ? 0 : 1;
+    PipelineStatement item;
+    while (spsc_ring_pop(stage->statements, &item)) {
+        if (stage->status == 0) {
+            stage->ctx->line_num = item.line;
+            stage->ctx->column_num = item.column;
+            if (risc_stream_add(stream, item.node) != 0) {
+                stage->status = 1;
+                spsc_ring_cancel(stage->statements);
+            }
+        }
+        free_node(item.node);
+    }
+    if (stage->status == 0 && !stage->parse_failed) {
+        stage->status = risc_stream_finish(stream) == 0 ? 0 : 1;
+    } else {
+        risc_stream_free(stream);
+    }
+    compile_context_bind(NULL);
+    return NULL;
+}
+
+// Передаёт генератору готовые операторы; -1, если генератор остановился
+static int send_statements(CompileContext *ctx, SpscRing *statements) {
+    if (!ctx->ast_root) return 0;
+    NodeList *children = &ctx->ast_root->block.children;
+    int status = 0;
+    for (size_t i = 0; i < children->size; i++) {
+        PipelineStatement item = {children->items[i], ctx->line_num, ctx->column_num};
+        if (status == 0 && spsc_ring_push(statements, &item) == 0) continue;
+        status = -1;
+        free_node(children->items[i]);
+    }
+    children->size = 0;
+    return status;
+}
+
+// Ошибки генератора добавляются после ошибок разбора
+static void merge_errors(ErrorState *to, const ErrorState *from) {
+    int stored = from->error_count < MAX_ERRORS ? from->error_count : MAX_ERRORS;
+    for (int i = 0; i < stored; i++) {
+        if (to->error_count + i < MAX_ERRORS) {
+            to->errors[to->error_count + i] = from->errors[i];
+        }
+    }
+    to->error_count += from->error_count;
+    to->critical |= from->critical;
+    if (to->collect && from->text) error_collect_text(to, from->text);
+}
+
+static int run_parser(CompileContext *ctx, SpscRing *tokens, SpscRing *statements) {
+    yypstate *parser = yypstate_new();
+    if (!parser) return 1;
+    int status = YYPUSH_MORE;
+    PipelineToken item;
+    // Конец файла получает место последнего токена
+    YYLTYPE location = {1, 1, 1, 1};
+    while (status == YYPUSH_MORE) {
+        int more = spsc_ring_pop(tokens, &item);
+        if (more) {
+            ctx->line_num = item.line;
+            ctx->column_num = item.column;
+            location = item.location;
+            status = yypush_parse(parser, item.token, &item.value, &location, NULL, ctx);
+        } else {
+            status = yypush_parse(parser, 0, NULL, &location, NULL, ctx);
+        }
+        if (ctx->ast_root && ctx->ast_root->block.children.size > 0 &&
+            send_statements(ctx, statements) != 0) {
+            status = 1;
+        }
+    }
+    yypstate_delete(parser);
+    return status == 0 ? 0 : 1;
+}
+
+int pipeline_run(SourceBuffer *source, FILE *output) {
+    CompileContext *ctx = compile_context_current();
+    CompileContext *lexer_ctx = (CompileContext *) malloc(sizeof(CompileContext));
+    CompileContext *codegen_ctx = (CompileContext *) malloc(sizeof(CompileContext));
+    SpscRing tokens, statements;
+    int rings = 0;
+    if (lexer_ctx && codegen_ctx && spsc_ring_init(&tokens, TOKEN_RING_SIZE, sizeof(PipelineToken)) == 0) {
+        rings = 1;
+        if (spsc_ring_init(&statements, STATEMENT_RING_SIZE, sizeof(PipelineStatement)) == 0) {
+            rings = 2;
+        } else {
+            spsc_ring_destroy(&tokens);
+        }
+    }
+    if (rings < 2) {
+        free(lexer_ctx);
+        free(codegen_ctx);
+        return 1;
+    }
+    compile_context_init(lexer_ctx, ctx->filename);
+    lexer_ctx->source = source->data;
+    lexer_ctx->source_length = source->length;
+    compile_context_init(codegen_ctx, ctx->filename);
+    codegen_ctx->pass_manager = ctx->pass_manager;
+    codegen_ctx->eval_budget = ctx->eval_budget;
+    codegen_ctx->line_info = ctx->line_info;
+    codegen_ctx->errors.quiet = ctx->errors.quiet;
+    codegen_ctx->errors.collect = ctx->errors.collect;
+    // Срезы токенов ссылаются на текст, который читает парсер
+    ctx->source = source->data;
+    ctx->source_length = source->length;
+    ctx->source_offset = 0;
+
+    LexerStage lexer = {NULL, lexer_ctx, &tokens};
+    CodegenStage codegen = {codegen_ctx, &statements, output, 0, 1};
+    pthread_t lexer_thread, codegen_thread;
+    int status = 1;
+    if (yylex_init_extra(lexer_ctx, &lexer.scanner) == 0) {
+        if (yy_scan_buffer(source->data, source_buffer_scan_size(source), lexer.scanner) &&
+            pthread_create(&codegen_thread, NULL, codegen_main, &codegen) == 0) {
+            if (pthread_create(&lexer_thread, NULL, lexer_main, &lexer) == 0) {
+                status = run_parser(ctx, &tokens, &statements);
+                spsc_ring_cancel(&tokens);
+                pthread_join(lexer_thread, NULL);
+            }
+            codegen.parse_failed = status != 0;
+            spsc_ring_close(&statements);
+            pthread_join(codegen_thread, NULL);
+            if (codegen.status != 0) status = 1;
+        }
+        yylex_destroy(lexer.scanner);
+    }
+    merge_errors(&ctx->errors, &codegen_ctx->errors);
+
+    ctx->source = NULL;
+    ctx->source_length = 0;
+    spsc_ring_destroy(&tokens);
+    spsc_ring_destroy(&statements);
+    compile_context_free(codegen_ctx);
+    compile_context_free(lexer_ctx);
+    free(codegen_ctx);
+    free(lexer_ctx);
+    return status;
+}
@@ -0,0 +1,17 @@
+#ifndef PIPELINE_H
+#define PIPELINE_H
+
+#include <stdio.h>
+#include "lexer/source_buffer.h"
+
+/**
+ * Конвейерная компиляция текста source в текущем контексте: лексер,
+ * парсер и генератор кода работают в разных потоках. Токены передаются
+ * парсеру через кольцо SPSC, готовые операторы верхнего уровня — генератору
+ * через второе кольцо; код пишется в output по мере генерации, как в
+ * потоковом режиме. Ошибки генератора переносятся в текущий контекст.
+ * @return 0 при успехе, 1 при ошибке разбора, генерации или нехватке памяти
+ */
+int pipeline_run(SourceBuffer *source, FILE *output);
+
+#endif /* PIPELINE_H */
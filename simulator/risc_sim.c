@@ -0,0 +1,581 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <ctype.h>
+#include "risc_sim.h"
+#include "timing_model.h"
+#include "../compiler/listing.h"
+
+// Шитый код через адреса меток — расширение GCC и Clang
+#if defined(__GNUC__) && !defined(RISC_SIM_SWITCH_DISPATCH)
+#define SIM_THREADED 1
+#endif
+
+// OP_HALT не встречается в коде: им заканчивается массив команд,
+// поэтому выход за последнюю команду не требует проверки pc
+typedef enum {
+    OP_LI, OP_LW, OP_SW, OP_ADD, OP_ADDI, OP_SUB, OP_MUL, OP_DIV, OP_REM,
+    OP_SLT, OP_SGE, OP_SEQ, OP_SNE, OP_XORI, OP_AND, OP_OR,
+    OP_BEQ, OP_BNE, OP_BLT, OP_BGE, OP_JAL, OP_EWRITE, OP_EBREAK, OP_HALT
+} Opcode;
+
+// Формы операндов
+typedef enum {
+    FMT_RI,         // li rd, imm
+    FMT_LOAD,       // lw rd, base, off
+    FMT_STORE,      // sw base, off, rs
+    FMT_RRR,        // add rd, rs1, rs2
+    FMT_RRI,        // addi rd, rs, imm
+    FMT_BRANCH,     // beq rs1, rs2, label
+    FMT_JUMP,       // jal rd, label
+    FMT_R,          // ewrite rs
+    FMT_NONE        // ebreak
+} OperandFormat;
+
+typedef struct {
+    const char *name;
+    Opcode op;
+    OperandFormat format;
+} OpcodeInfo;
+
+static const OpcodeInfo opcodes[] = {
+    {"li", OP_LI, FMT_RI}, {"lw", OP_LW, FMT_LOAD}, {"sw", OP_SW, FMT_STORE},
+    {"add", OP_ADD, FMT_RRR}, {"addi", OP_ADDI, FMT_RRI}, {"sub", OP_SUB, FMT_RRR},
+    {"mul", OP_MUL, FMT_RRR}, {"div", OP_DIV, FMT_RRR}, {"rem", OP_REM, FMT_RRR},
+    {"slt", OP_SLT, FMT_RRR}, {"sge", OP_SGE, FMT_RRR}, {"seq", OP_SEQ, FMT_RRR},
+    {"sne", OP_SNE, FMT_RRR}, {"xori", OP_XORI, FMT_RRI}, {"and", OP_AND, FMT_RRR},
+    {"or", OP_OR, FMT_RRR}, {"beq", OP_BEQ, FMT_BRANCH}, {"bne", OP_BNE, FMT_BRANCH},
+    {"blt", OP_BLT, FMT_BRANCH}, {"bge", OP_BGE, FMT_BRANCH}, {"jal", OP_JAL, FMT_JUMP},
+    {"ewrite", OP_EWRITE, FMT_R}, {"ebreak", OP_EBREAK, FMT_NONE}, {NULL, 0, 0}
+};
+
+// Регистр, в который декодируется запись в x0: чтение x0 всегда даёт 0,
+// и командам не нужно проверять rd
+#define SINK_REGISTER 32
+
+// Декодированная команда: 8 байт, регистры и код операции — индексы
+typedef struct {
+    uint8_t op;
+    uint8_t rd;
+    uint8_t rs1;
+    uint8_t rs2;
+    int32_t imm;            // непосредственное значение, смещение или номер команды перехода
+} Instruction;
+
+typedef struct {
+    int32_t address;
+    int32_t value;
+} DataWord;
+
+struct RiscProgram {
+    Instruction *code;      // count команд и OP_HALT
+    int *lines;             // строка кода каждой команды, с 1
+    int *source_lines;      // позиция в исходном тексте по .loc; 0 — нет
+    int *source_columns;
+    size_t count;
+    DataWord *data;
+    size_t data_count;
+};
+
+static const char *class_names[SIM_CLASS_COUNT] = {
+    "alu", "mul", "div", "load", "store", "branch", "jump", "system"
+};
+
+// Класс команды для профиля без модели конвейера
+static const uint8_t opcode_classes[] = {
+    [OP_LI] = SIM_CLASS_ALU, [OP_LW] = SIM_CLASS_LOAD, [OP_SW] = SIM_CLASS_STORE, [OP_ADD] = SIM_CLASS_ALU,
+    [OP_ADDI] = SIM_CLASS_ALU, [OP_SUB] = SIM_CLASS_ALU, [OP_MUL] = SIM_CLASS_MUL, [OP_DIV] = SIM_CLASS_DIV,
+    [OP_REM] = SIM_CLASS_DIV, [OP_SLT] = SIM_CLASS_ALU, [OP_SGE] = SIM_CLASS_ALU, [OP_SEQ] = SIM_CLASS_ALU,
+    [OP_SNE] = SIM_CLASS_ALU, [OP_XORI] = SIM_CLASS_ALU, [OP_AND] = SIM_CLASS_ALU, [OP_OR] = SIM_CLASS_ALU,
+    [OP_BEQ] = SIM_CLASS_BRANCH, [OP_BNE] = SIM_CLASS_BRANCH, [OP_BLT] = SIM_CLASS_BRANCH,
+    [OP_BGE] = SIM_CLASS_BRANCH, [OP_JAL] = SIM_CLASS_JUMP, [OP_EWRITE] = SIM_CLASS_SYSTEM,
+    [OP_EBREAK] = SIM_CLASS_SYSTEM, [OP_HALT] = SIM_CLASS_SYSTEM
+};
+
+static const char *stall_names[STALL_COUNT] = {
+    "load-use", "mul/div result", "divider busy", "d-cache miss", "branch mispredict", "jump"
+};
+
+void sim_options_init(SimOptions *options) {
+    // Оценка для простого ядра без кэша: деление многотактное, загрузка — два такта
+    static const int default_latency[SIM_CLASS_COUNT] = {1, 3, 20, 2, 1, 1, 1, 1};
+    options->memory_words = (size_t) RISC_SIM_DEFAULT_MEMORY_WORDS;
+    options->max_steps = RISC_SIM_DEFAULT_MAX_STEPS;
+    options->output = NULL;
+    options->timing = NULL;
+    options->profile = NULL;
+    memcpy(options->costs.latency, default_latency, sizeof(default_latency));
+    options->costs.taken_branch_penalty = 2;
+}
+
+int sim_costs_parse(SimCosts *costs, const char *spec) {
+    const char *p = spec;
+    while (*p) {
+        size_t length = strcspn(p, "=,");
+        if (p[length] != '=') return -1;
+        char *end;
+        long value = strtol(p + length + 1, &end, 10);
+        if (end == p + length + 1 || (*end && *end != ',') || value < 0 || value > 1000000) return -1;
+        int found = 0;
+        if (length == 5 && strncmp(p, "taken", 5) == 0) {
+            costs->taken_branch_penalty = (int) value;
+            found = 1;
+        }
+        for (int c = 0; c < SIM_CLASS_COUNT && !found; c++) {
+            if (strlen(class_names[c]) == length && strncmp(p, class_names[c], length) == 0) {
+                costs->latency[c] = (int) value;
+                found = 1;
+            }
+        }
+        if (!found) return -1;
+        p = *end ? end + 1 : end;
+    }
+    return 0;
+}
+
+const char *sim_status_name(SimStatus status) {
+    switch (status) {
+        case SIM_OK: return "ok";
+        case SIM_STEP_LIMIT: return "step-limit";
+        case SIM_BAD_ADDRESS: return "bad-address";
+        case SIM_BAD_DATA: return "bad-data";
+        case SIM_NO_MEMORY: return "no-memory";
+    }
+    return "unknown";
+}
+
+static const OpcodeInfo *find_opcode(const char *name) {
+    for (int i = 0; opcodes[i].name; i++) {
+        if (strcmp(opcodes[i].name, name) == 0) return &opcodes[i];
+    }
+    return NULL;
+}
+
+// Делит строку на операнды по запятым и пробелам; возвращает их число
+static int split_operands(char *text, char **operands, int max) {
+    int count = 0;
+    char *p = text;
+    while (*p) {
+        while (*p == ' ' || *p == '\t' || *p == ',') p++;
+        if (!*p) break;
+        if (count == max) return max + 1;
+        operands[count++] = p;
+        while (*p && *p != ' ' && *p != '\t' && *p != ',') p++;
+        if (*p) *p++ = '\0';
+    }
+    return count;
+}
+
+static int parse_register(const char *text, uint8_t *reg) {
+    if (text[0] != 'x' || !isdigit((unsigned char) text[1])) return 0;
+    char *end;
+    long value = strtol(text + 1, &end, 10);
+    if (*end || value > 31) return 0;
+    *reg = (uint8_t) value;
+    return 1;
+}
+
+static int parse_immediate(const char *text, int32_t *value) {
+    char *end;
+    long long parsed = strtoll(text, &end, 10);
+    if (end == text || *end || parsed < INT32_MIN || parsed > UINT32_MAX) return 0;
+    *value = (int32_t) (uint32_t) parsed;
+    return 1;
+}
+
+// Строка .word: адрес и значения по следующим адресам
+static int parse_data(RiscProgram *program, const char *text, size_t *capacity) {
+    const char *p = text;
+    int32_t address = 0;
+    int first = 1;
+    for (;;) {
+        while (*p == ' ' || *p == '\t' || *p == ',') p++;
+        if (!*p) break;
+        char *end;
+        long long value = strtoll(p, &end, 10);
+        if (end == p || (*end && *end != ' ' && *end != '\t' && *end != ',')) return 0;
+        if (value < INT32_MIN || value > UINT32_MAX) return 0;
+        p = end;
+        if (first) {
+            address = (int32_t) value;
+            first = 0;
+            continue;
+        }
+        if (program->data_count == *capacity) {
+            size_t new_capacity = *capacity ? *capacity * 2 : 64;
+            DataWord *data = (DataWord *) realloc(program->data, new_capacity * sizeof(DataWord));
+            if (!data) return 0;
+            program->data = data;
+            *capacity = new_capacity;
+        }
+        program->data[program->data_count].address = address++;
+        program->data[program->data_count].value = (int32_t) (uint32_t) value;
+        program->data_count++;
+    }
+    return !first;
+}
+
+static char *trim(char *line) {
+    while (*line == ' ' || *line == '\t') line++;
+    char *comment = strchr(line, '#');
+    if (comment) *comment = '\0';
+    size_t len = strlen(line);
+    while (len > 0 && (line[len - 1] == ' ' || line[len - 1] == '\t' || line[len - 1] == '\r')) len--;
+    line[len] = '\0';
+    return line;
+}
+
+static int decode(const OpcodeInfo *info, char *operand_text, Instruction *ins, char **lines,
+                  const LabelIndex *labels, const size_t *line_pc, char *error, size_t error_size) {
+    char *ops[4];
+    static const int expected[] = {2, 3, 3, 3, 3, 3, 2, 1, 0};
+    int count = split_operands(operand_text, ops, 3);
+    if (count != expected[info->format]) {
+        snprintf(error, error_size, "expected %d operands for %s", expected[info->format], info->name);
+        return 0;
+    }
+    ins->op = (uint8_t) info->op;
+    ins->rd = ins->rs1 = ins->rs2 = 0;
+    ins->imm = 0;
+    int ok = 1;
+    const char *target = NULL;
+    switch (info->format) {
+        case FMT_RI:
+            ok = parse_register(ops[0], &ins->rd) && parse_immediate(ops[1], &ins->imm);
+            break;
+        case FMT_LOAD:
+            ok = parse_register(ops[0], &ins->rd) && parse_register(ops[1], &ins->rs1) &&
+                 parse_immediate(ops[2], &ins->imm);
+            break;
+        case FMT_STORE:
+            ok = parse_register(ops[0], &ins->rs1) && parse_immediate(ops[1], &ins->imm) &&
+                 parse_register(ops[2], &ins->rs2);
+            break;
+        case FMT_RRR:
+            ok = parse_register(ops[0], &ins->rd) && parse_register(ops[1], &ins->rs1) &&
+                 parse_register(ops[2], &ins->rs2);
+            break;
+        case FMT_RRI:
+            ok = parse_register(ops[0], &ins->rd) && parse_register(ops[1], &ins->rs1) &&
+                 parse_immediate(ops[2], &ins->imm);
+            break;
+        case FMT_BRANCH:
+            ok = parse_register(ops[0], &ins->rs1) && parse_register(ops[1], &ins->rs2);
+            target = ops[2];
+            break;
+        case FMT_JUMP:
+            ok = parse_register(ops[0], &ins->rd);
+            target = ops[1];
+            break;
+        case FMT_R:
+            ok = parse_register(ops[0], &ins->rs1);
+            break;
+        case FMT_NONE:
+            break;
+    }
+    if (!ok) {
+        snprintf(error, error_size, "bad operand in %s", info->name);
+        return 0;
+    }
+    if (ins->rd == 0) ins->rd = SINK_REGISTER;
+    if (target) {
+        size_t line = label_index_find(labels, lines, target);
+        if (line == (size_t) -1) {
+            snprintf(error, error_size, "undefined label %s", target);
+            return 0;
+        }
+        ins->imm = (int32_t) line_pc[line];
+    }
+    return 1;
+}
+
+RiscProgram *risc_program_parse(const char *code, size_t length, char *error, size_t error_size) {
+    error[0] = '\0';
+    RiscProgram *program = (RiscProgram *) calloc(1, sizeof(RiscProgram));
+    char *text = (char *) malloc(length + 1);
+    size_t line_count = 1;
+    for (size_t i = 0; i < length; i++) {
+        if (code[i] == '\n') line_count++;
+    }
+    char **lines = (char **) malloc(line_count * sizeof(char *));
+    size_t *line_pc = (size_t *) malloc(line_count * sizeof(size_t));
+    LabelIndex labels = {NULL, 0};
+    if (!program || !text || !lines || !line_pc) {
+        snprintf(error, error_size, "out of memory");
+        goto fail;
+    }
+    memcpy(text, code, length);
+    text[length] = '\0';
+
+    // Первый проход: строки, номера команд и метки
+    size_t count = 0;
+    size_t instructions = 0;
+    for (char *p = text; p; count++) {
+        char *next = strchr(p, '\n');
+        if (next) *next++ = '\0';
+        lines[count] = trim(p);
+        line_pc[count] = instructions;
+        if (listing_is_instruction(lines[count])) instructions++;
+        p = next;
+    }
+    if (instructions >= INT32_MAX) {
+        snprintf(error, error_size, "program too large");
+        goto fail;
+    }
+    if (label_index_build(&labels, lines, count) != 0) {
+        snprintf(error, error_size, "out of memory");
+        goto fail;
+    }
+    program->code = (Instruction *) malloc((instructions + 1) * sizeof(Instruction));
+    program->lines = (int *) malloc((instructions + 1) * sizeof(int));
+    program->source_lines = (int *) calloc(instructions + 1, sizeof(int));
+    program->source_columns = (int *) calloc(instructions + 1, sizeof(int));
+    if (!program->code || !program->lines || !program->source_lines || !program->source_columns) {
+        snprintf(error, error_size, "out of memory");
+        goto fail;
+    }
+
+    // Второй проход: данные и команды; строки-пояснения пропускаются
+    size_t data_capacity = 0;
+    int source_line = 0;
+    int source_column = 0;
+    for (size_t i = 0; i < count; i++) {
+        char *line = lines[i];
+        if (strncmp(line, ".word", 5) == 0 && (line[5] == ' ' || line[5] == '\t')) {
+            if (!parse_data(program, line + 5, &data_capacity)) {
+                snprintf(error, error_size, "line %zu: bad .word", i + 1);
+                goto fail;
+            }
+            continue;
+        }
+        if (strncmp(line, ".loc", 4) == 0 && (line[4] == ' ' || line[4] == '\t')) {
+            if (sscanf(line + 4, "%d %d", &source_line, &source_column) != 2 || source_line < 0) {
+                snprintf(error, error_size, "line %zu: bad .loc", i + 1);
+                goto fail;
+            }
+            continue;
+        }
+        if (!listing_is_instruction(line)) continue;
+        char name[16];
+        size_t name_length = strcspn(line, " \t");
+        memcpy(name, line, name_length);
+        name[name_length] = '\0';
+        char *operands = line + name_length;
+        Instruction *ins = &program->code[program->count];
+        char message[128];
+        if (!decode(find_opcode(name), operands, ins, lines, &labels, line_pc, message, sizeof(message))) {
+            snprintf(error, error_size, "line %zu: %s", i + 1, message);
+            goto fail;
+        }
+        program->lines[program->count] = (int) i + 1;
+        program->source_lines[program->count] = source_line;
+        program->source_columns[program->count] = source_column;
+        program->count++;
+    }
+    Instruction *halt = &program->code[program->count];
+    memset(halt, 0, sizeof(*halt));
+    halt->op = OP_HALT;
+    program->lines[program->count] = (int) count;
+    label_index_free(&labels);
+    free(line_pc);
+    free(lines);
+    free(text);
+    return program;
+
+fail:
+    label_index_free(&labels);
+    free(line_pc);
+    free(lines);
+    free(text);
+    risc_program_free(program);
+    return NULL;
+}
+
+void risc_program_free(RiscProgram *program) {
+    if (!program) return;
+    free(program->code);
+    free(program->lines);
+    free(program->source_lines);
+    free(program->source_columns);
+    free(program->data);
+    free(program);
+}
+
+size_t risc_program_size(const RiscProgram *program) {
+    return program->count;
+}
+
+int risc_program_source_line(const RiscProgram *program, size_t pc, int *column) {
+    if (pc >= program->count) return 0;
+    if (column) *column = program->source_columns[pc];
+    return program->source_lines[pc];
+}
+
+int risc_program_jump_target(const RiscProgram *program, size_t pc, size_t *target) {
+    if (pc >= program->count) return 0;
+    uint8_t command_class = opcode_classes[program->code[pc].op];
+    if (command_class != SIM_CLASS_BRANCH && command_class != SIM_CLASS_JUMP) return 0;
+    *target = (size_t) program->code[pc].imm;
+    return 1;
+}
+
+SimProfile *sim_profile_create(const RiscProgram *program) {
+    SimProfile *profile = (SimProfile *) calloc(1, sizeof(SimProfile));
+    if (!profile) return NULL;
+    profile->count = program->count;
+    profile->executed = (long *) calloc(program->count + 1, sizeof(long));
+    profile->taken = (long *) calloc(program->count + 1, sizeof(long));
+    profile->cycles = (long *) calloc(program->count + 1, sizeof(long));
+    if (!profile->executed || !profile->taken || !profile->cycles) {
+        sim_profile_free(profile);
+        return NULL;
+    }
+    return profile;
+}
+
+void sim_profile_free(SimProfile *profile) {
+    if (!profile) return;
+    free(profile->executed);
+    free(profile->taken);
+    free(profile->cycles);
+    free(profile);
+}
+
+#ifdef SIM_THREADED
+#define HANDLER(op) do_##op:
+#define NEXT() do { ins = &code[pc++]; retired++; goto *handlers[ins->op]; } while (0)
+#else
+#define HANDLER(op) case op:
+#define NEXT() continue
+#endif
+
+// Переход на команду target; бюджет проверяется только здесь, потому что
+// без переходов программа заканчивается сама
+#define JUMP_TO(target) do { \
+        pc = (size_t) (target); \
+        if (retired >= max_steps) goto step_limit; \
+    } while (0)
+
+// Без do-while: в варианте со switch NEXT() — это continue цикла выборки.
+// INSTRUMENT и INSTRUMENT_TAKEN определяются в risc_sim_loop.h
+#define BRANCH(condition) \
+    counts[SIM_CLASS_BRANCH]++; \
+    INSTRUMENT(timing_model_branch(timing, ins->rs1, ins->rs2, (uint32_t) (ins - code), \
+                                   (uint32_t) ins->imm, (condition))); \
+    if (condition) { \
+        taken++; \
+        INSTRUMENT_TAKEN(); \
+        JUMP_TO(ins->imm); \
+    } \
+    NEXT()
+
+#define SIM_LOOP run_fast
+#define SIM_LOOP_INSTRUMENTED 0
+#include "risc_sim_loop.h"
+#undef SIM_LOOP
+#undef SIM_LOOP_INSTRUMENTED
+
+#define SIM_LOOP run_instrumented
+#define SIM_LOOP_INSTRUMENTED 1
+#include "risc_sim_loop.h"
+#undef SIM_LOOP
+#undef SIM_LOOP_INSTRUMENTED
+
+// Профиль без модели конвейера: такты команд по SimCosts
+static void profile_estimate_cycles(const RiscProgram *program, const SimCosts *costs, SimProfile *profile) {
+    for (size_t pc = 0; pc < program->count; pc++) {
+        int command_class = opcode_classes[program->code[pc].op];
+        profile->cycles[pc] = profile->executed[pc] * costs->latency[command_class];
+        if (command_class == SIM_CLASS_BRANCH) {
+            profile->cycles[pc] += profile->taken[pc] * costs->taken_branch_penalty;
+        }
+    }
+}
+
+SimStatus risc_simulate(const RiscProgram *program, const SimOptions *options, SimStats *stats) {
+    SimOptions defaults;
+    if (!options) {
+        sim_options_init(&defaults);
+        options = &defaults;
+    }
+    memset(stats, 0, sizeof(*stats));
+    stats->output_hash = 2166136261u;
+    size_t memory_words = options->memory_words;
+    if (memory_words > UINT32_MAX) memory_words = UINT32_MAX;
+    int32_t *memory = (int32_t *) calloc(memory_words, sizeof(int32_t));
+    if (!memory) return SIM_NO_MEMORY;
+    for (size_t i = 0; i < program->data_count; i++) {
+        const DataWord *word = &program->data[i];
+        if (word->address < 0 || (size_t) word->address >= memory_words) {
+            free(memory);
+            return SIM_BAD_DATA;
+        }
+        memory[word->address] = word->value;
+    }
+
+    TimingModel *timing = NULL;
+    if (options->timing) {
+        timing = timing_model_create(options->timing);
+        if (!timing) {
+            free(memory);
+            return SIM_NO_MEMORY;
+        }
+    }
+    SimProfile *profile = options->profile;
+    if (profile) {
+        size_t words = profile->count + 1;
+        memset(profile->executed, 0, words * sizeof(long));
+        memset(profile->taken, 0, words * sizeof(long));
+        memset(profile->cycles, 0, words * sizeof(long));
+    }
+    SimStatus status = timing || profile
+                       ? run_instrumented(program, options, memory, memory_words, timing, stats)
+                       : run_fast(program, options, memory, memory_words, NULL, stats);
+    free(memory);
+    if (profile && !timing) profile_estimate_cycles(program, &options->costs, profile);
+    if (timing) {
+        timing_model_finish(timing, stats);
+        timing_model_free(timing);
+    }
+    long cycles = stats->taken_branches * options->costs.taken_branch_penalty;
+    for (int c = 0; c < SIM_CLASS_COUNT; c++) cycles += stats->class_counts[c] * options->costs.latency[c];
+    stats->cycles = cycles;
+    return status;
+}
+
+void sim_print_stats(const SimStats *stats, SimStatus status, FILE *out) {
+    fprintf(out, "Simulation: %s", sim_status_name(status));
+    if (stats->fault_line > 0) fprintf(out, " at line %d of the code", stats->fault_line);
+    fprintf(out, "\n");
+    fprintf(out, "  %-22s %14ld\n", "Instructions retired", stats->instructions);
+    for (int c = 0; c < SIM_CLASS_COUNT; c++) {
+        fprintf(out, "    %-20s %14ld\n", class_names[c], stats->class_counts[c]);
+    }
+    fprintf(out, "  %-22s %14ld\n", "Taken branches", stats->taken_branches);
+    fprintf(out, "  %-22s %14ld  CPI %.2f\n", "Cycles (estimate)", stats->cycles,
+            stats->instructions > 0 ? (double) stats->cycles / (double) stats->instructions : 0.0);
+    fprintf(out, "  %-22s %14ld\n", "Output bytes", stats->output_bytes);
+    const SimTimingStats *timing = &stats->timing;
+    if (!timing->enabled) return;
+    long stalled = 0;
+    for (int k = 0; k < STALL_COUNT; k++) stalled += timing->stalls[k];
+    fprintf(out, "  %-22s %14ld  CPI %.2f\n", "Cycles (pipeline)", timing->cycles,
+            stats->instructions > 0 ? (double) timing->cycles / (double) stats->instructions : 0.0);
+    fprintf(out, "    %-20s %14ld\n", "issue", stats->instructions);
+    fprintf(out, "    %-20s %14ld\n", "pipeline fill", timing->cycles - stats->instructions - stalled);
+    fprintf(out, "  %-22s %14ld  %5.1f%%\n", "Stall cycles", stalled,
+            timing->cycles > 0 ? (double) stalled * 100.0 / (double) timing->cycles : 0.0);
+    for (int k = 0; k < STALL_COUNT; k++) {
+        fprintf(out, "    %-20s %14ld  %5.1f%%\n", stall_names[k], timing->stalls[k],
+                timing->cycles > 0 ? (double) timing->stalls[k] * 100.0 / (double) timing->cycles : 0.0);
+    }
+    long accesses = timing->load_hits + timing->load_misses + timing->store_hits + timing->store_misses;
+    long misses = timing->load_misses + timing->store_misses;
+    fprintf(out, "  %-22s %14ld  miss rate %.2f%% (loads %ld/%ld, stores %ld/%ld missed)\n",
+            "D-cache accesses", accesses, accesses > 0 ? (double) misses * 100.0 / (double) accesses : 0.0, timing->load_misses,
+            stats->loads, timing->store_misses, stats->stores);
+    fprintf(out, "  %-22s %14ld  accuracy %.2f%%\n", "Mispredicted branches", timing->mispredicted,
+            stats->branches > 0 ? (double) (stats->branches - timing->mispredicted) * 100.0 /
+                                  (double) stats->branches : 100.0);
+}
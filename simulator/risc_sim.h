@@ -0,0 +1,207 @@
+#ifndef RISC_SIM_H
+#define RISC_SIM_H
+
+#include <stdio.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define RISC_SIM_DEFAULT_MEMORY_WORDS (4L * 1024 * 1024)
+#define RISC_SIM_DEFAULT_MAX_STEPS 100000000L
+
+/**
+ * Симулятор RISC-кода в том виде, в каком его выдаёт risc_generator:
+ * секция .data из строк ".word адрес, v1, v2...", метки, команды
+ * и строки-пояснения, которые не исполняются. Память адресуется словами,
+ * регистры x0..x31 32-битные, x0 всегда равен нулю. Программа завершается
+ * на ebreak или после последней команды.
+ * Код заранее декодируется в плотный массив команд по 8 байт и исполняется
+ * шитым кодом (computed goto в GCC и Clang, switch в остальных компиляторах).
+ */
+typedef enum {
+    SIM_OK = 0,
+    SIM_STEP_LIMIT,         // превышен бюджет команд
+    SIM_BAD_ADDRESS,        // lw или sw за пределами памяти
+    SIM_BAD_DATA,           // адрес из .data за пределами памяти
+    SIM_NO_MEMORY           // не удалось выделить память симулятора
+} SimStatus;
+
+// Классы команд для оценки тактов
+typedef enum {
+    SIM_CLASS_ALU = 0,      // li, add, addi, sub, сравнения и логика
+    SIM_CLASS_MUL,
+    SIM_CLASS_DIV,          // div и rem
+    SIM_CLASS_LOAD,
+    SIM_CLASS_STORE,
+    SIM_CLASS_BRANCH,       // условные переходы
+    SIM_CLASS_JUMP,         // jal
+    SIM_CLASS_SYSTEM,       // ewrite и ebreak
+    SIM_CLASS_COUNT
+} SimClass;
+
+// Модель тактов: каждая команда стоит latency своего класса,
+// выполненный условный переход — ещё taken_branch_penalty
+typedef struct {
+    int latency[SIM_CLASS_COUNT];
+    int taken_branch_penalty;
+} SimCosts;
+
+typedef enum {
+    PREDICT_NOT_TAKEN = 0,  // все условные переходы считаются невыполненными
+    PREDICT_BTFN,           // назад — выполняется, вперёд — нет
+    PREDICT_BIMODAL         // таблица двухбитных счётчиков по адресу перехода
+} BranchPredictor;
+
+/**
+ * Модель конвейера: скалярное ядро выдаёт не больше одной команды за такт
+ * в порядке программы. Команда ждёт готовности своих операндов, делитель
+ * не конвейеризован, промах кэша данных останавливает конвейер целиком,
+ * ошибка предсказания перехода сбрасывает конвейер. Точнее SimCosts,
+ * но заметно медленнее, поэтому включается только по запросу.
+ */
+typedef struct {
+    int pipeline_depth;     // стадий: заполнение конвейера добавляет depth - 1 тактов
+    int load_latency;       // через сколько тактов после lw результат доступен следующей команде
+    int mul_latency;
+    int div_latency;        // и время занятости делителя
+    int mispredict_penalty;
+    int jump_penalty;       // jal: адрес перехода известен только на декодировании
+    BranchPredictor predictor;
+    int predictor_entries;  // степень двойки
+    int cache_sets;         // степень двойки
+    int cache_ways;
+    int line_words;         // слов в строке кэша, степень двойки
+    int miss_penalty;       // промах и чтения, и записи (запись с размещением в кэше)
+} SimTiming;
+
+// Причины простоя конвейера
+typedef enum {
+    STALL_LOAD_USE = 0,     // операнд ещё загружается из памяти
+    STALL_MUL_DIV,          // операнд ещё вычисляется умножением или делением
+    STALL_DIVIDER,          // делитель занят предыдущим делением
+    STALL_DCACHE,           // промах кэша данных
+    STALL_MISPREDICT,       // неверно предсказанный условный переход
+    STALL_JUMP,             // jal
+    STALL_COUNT
+} StallKind;
+
+typedef struct {
+    int enabled;            // статистика заполнена: в SimOptions была модель
+    long cycles;            // instructions + простои + заполнение конвейера
+    long stalls[STALL_COUNT];
+    long load_hits;
+    long load_misses;
+    long store_hits;
+    long store_misses;
+    long mispredicted;      // из SimStats.branches
+} SimTimingStats;
+
+/**
+ * Профиль выполнения по номерам команд (см. sim_profile_create). Такты
+ * команды — по модели конвейера, если она включена (без заполнения конвейера),
+ * иначе оценка SimCosts; простой из-за зависимости относится к команде, которая ждала.
+ */
+typedef struct {
+    size_t count;           // команд программы
+    long *executed;
+    long *taken;            // сколько раз команда передала управление (jal — каждый раз)
+    long *cycles;
+} SimProfile;
+
+typedef struct {
+    size_t memory_words;
+    long max_steps;         // проверяется на переходах: линейный участок может его немного превысить
+    FILE *output;           // куда пишет ewrite; NULL — вывод только учитывается
+    SimCosts costs;
+    const SimTiming *timing;    // NULL — без модели конвейера
+    SimProfile *profile;        // NULL — без профиля; заполняется заново при каждом запуске
+} SimOptions;
+
+typedef struct {
+    long instructions;      // выполнено команд
+    long loads;
+    long stores;
+    long branches;          // условные переходы
+    long taken_branches;
+    long jumps;             // jal
+    long class_counts[SIM_CLASS_COUNT];
+    long cycles;            // оценка по SimCosts
+    long output_bytes;
+    uint32_t output_hash;   // FNV-1a вывода ewrite: сравнение результатов без записи в файл
+    int fault_line;         // строка кода с ошибкой выполнения или 0
+    SimTimingStats timing;
+} SimStats;
+
+typedef struct RiscProgram RiscProgram;
+
+// Память RISC_SIM_DEFAULT_MEMORY_WORDS, бюджет RISC_SIM_DEFAULT_MAX_STEPS, такты по умолчанию
+void sim_options_init(SimOptions *options);
+
+/**
+ * Меняет такты по списку "класс=такты,...": классы alu, mul, div, load,
+ * store, branch, jump, system и taken — штраф выполненного перехода.
+ * @return 0 или -1, если в списке неизвестный класс или плохое число
+ */
+int sim_costs_parse(SimCosts *costs, const char *spec);
+
+// Пятистадийный конвейер, двухбитный предсказатель на 256 переходов,
+// кэш 64 набора x 2 пути x 4 слова с промахом в 20 тактов
+void sim_timing_init(SimTiming *timing);
+
+/**
+ * Меняет модель конвейера по списку "параметр=значение,...": depth, load,
+ * mul, div, mispredict, jump, predictor (not-taken, btfn, bimodal),
+ * entries, sets, ways, line, miss.
+ * @return 0 или -1, если параметр неизвестен или значение недопустимо
+ */
+int sim_timing_parse(SimTiming *timing, const char *spec);
+
+/**
+ * Разбирает код и разрешает метки. Строки ".loc строка столбец" (см. -g)
+ * задают позицию в исходном тексте для следующих за ними команд.
+ * @param error Буфер для сообщения о неизвестной команде, операнде или метке
+ * @return Программа или NULL; освобождается risc_program_free
+ */
+RiscProgram *risc_program_parse(const char *code, size_t length, char *error, size_t error_size);
+
+void risc_program_free(RiscProgram *program);
+
+// Число исполняемых команд программы
+size_t risc_program_size(const RiscProgram *program);
+
+// Позиция команды pc в исходном тексте по строкам .loc; 0, если её нет
+int risc_program_source_line(const RiscProgram *program, size_t pc, int *column);
+
+/**
+ * Цель перехода команды pc.
+ * @return 1 для условного перехода и jal (номер команды цели в *target), иначе 0
+ */
+int risc_program_jump_target(const RiscProgram *program, size_t pc, size_t *target);
+
+// Профиль для команд program; NULL при нехватке памяти
+SimProfile *sim_profile_create(const RiscProgram *program);
+
+void sim_profile_free(SimProfile *profile);
+
+/**
+ * Горячие места: такты по строкам исходного текста и по циклам. Цикл —
+ * команды от цели обратного перехода до самого перехода; его строки —
+ * строки этих команд.
+ * @param source Исходный текст для показа строк или NULL
+ * @param top Сколько самых дорогих строк и циклов показать
+ */
+void sim_profile_print(const SimProfile *profile, const RiscProgram *program, const char *source,
+                       size_t source_length, int top, FILE *out);
+
+/**
+ * Выполняет программу с чистой памятью и регистрами. Программу можно
+ * выполнять одновременно из нескольких потоков.
+ * @param options NULL — настройки по умолчанию
+ */
+SimStatus risc_simulate(const RiscProgram *program, const SimOptions *options, SimStats *stats);
+
+const char *sim_status_name(SimStatus status);
+
+// Печатает счётчики, оценку тактов и, если была модель конвейера, разбивку простоев
+void sim_print_stats(const SimStats *stats, SimStatus status, FILE *out);
+
+#endif /* RISC_SIM_H */
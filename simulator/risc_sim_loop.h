@@ -0,0 +1,213 @@
+// Тело интерпретатора. risc_sim.c включает этот файл дважды: с SIM_LOOP_INSTRUMENTED 0 —
+// быстрый вариант, в котором вызовы модели конвейера и профиль исчезают при
+// препроцессировании, и с SIM_LOOP_INSTRUMENTED 1 — с вызовом TimingModel (если она есть)
+// и счётчиками профиля (если он есть) на каждой команде. Перед включением определяются
+// SIM_LOOP (имя функции) и SIM_LOOP_INSTRUMENTED; макросы выборки — в risc_sim.c.
+
+#if SIM_LOOP_INSTRUMENTED
+// timing_call возвращает такты, потраченные на команду
+#define INSTRUMENT(timing_call) do { \
+        long spent = timing ? (timing_call) : 0; \
+        if (profile) { \
+            profile->executed[ins - code]++; \
+            profile->cycles[ins - code] += spent; \
+        } \
+    } while (0)
+#define INSTRUMENT_TAKEN() do { if (profile) profile->taken[ins - code]++; } while (0)
+#else
+#define INSTRUMENT(timing_call)
+#define INSTRUMENT_TAKEN()
+#endif
+
+#define COMPUTE(command_class) \
+    INSTRUMENT(timing_model_compute(timing, command_class, ins->rd, ins->rs1, ins->rs2))
+
+/**
+ * Выполняет программу в подготовленной памяти.
+ * @param timing Модель конвейера или NULL; в быстром варианте не используется
+ * @return Статус; stats заполняется всем, кроме тактов
+ */
+static SimStatus SIM_LOOP(const RiscProgram *program, const SimOptions *options, int32_t *memory,
+                          size_t memory_words, TimingModel *timing, SimStats *stats) {
+    // Арифметика в uint32_t: переполнение заворачивается, как в железе.
+    // Счётчики — локальные переменные, чтобы компилятор держал их в регистрах
+    uint32_t regs[SINK_REGISTER + 1] = {0};
+    const Instruction *code = program->code;
+    const Instruction *ins;
+    size_t pc = 0;
+    long retired = 0;
+    long taken = 0;
+    long counts[SIM_CLASS_COUNT] = {0};
+    long max_steps = options->max_steps;
+    FILE *output = options->output;
+    uint32_t hash = stats->output_hash;
+    SimStatus status = SIM_OK;
+    SimProfile *profile = options->profile;
+    (void) timing;
+    (void) profile;
+
+#ifdef SIM_THREADED
+    static void *const handlers[] = {
+        [OP_LI] = &&do_OP_LI, [OP_LW] = &&do_OP_LW, [OP_SW] = &&do_OP_SW, [OP_ADD] = &&do_OP_ADD,
+        [OP_ADDI] = &&do_OP_ADDI, [OP_SUB] = &&do_OP_SUB, [OP_MUL] = &&do_OP_MUL, [OP_DIV] = &&do_OP_DIV,
+        [OP_REM] = &&do_OP_REM, [OP_SLT] = &&do_OP_SLT, [OP_SGE] = &&do_OP_SGE, [OP_SEQ] = &&do_OP_SEQ,
+        [OP_SNE] = &&do_OP_SNE, [OP_XORI] = &&do_OP_XORI, [OP_AND] = &&do_OP_AND, [OP_OR] = &&do_OP_OR,
+        [OP_BEQ] = &&do_OP_BEQ, [OP_BNE] = &&do_OP_BNE, [OP_BLT] = &&do_OP_BLT, [OP_BGE] = &&do_OP_BGE,
+        [OP_JAL] = &&do_OP_JAL, [OP_EWRITE] = &&do_OP_EWRITE, [OP_EBREAK] = &&do_OP_EBREAK,
+        [OP_HALT] = &&do_OP_HALT
+    };
+    NEXT();
+#else
+    for (;;) {
+        ins = &code[pc++];
+        retired++;
+        switch (ins->op) {
+#endif
+    HANDLER(OP_LI)
+        regs[ins->rd] = (uint32_t) ins->imm;
+        COMPUTE(SIM_CLASS_ALU);
+        NEXT();
+    HANDLER(OP_ADD)
+        regs[ins->rd] = regs[ins->rs1] + regs[ins->rs2];
+        COMPUTE(SIM_CLASS_ALU);
+        NEXT();
+    HANDLER(OP_ADDI)
+        regs[ins->rd] = regs[ins->rs1] + (uint32_t) ins->imm;
+        COMPUTE(SIM_CLASS_ALU);
+        NEXT();
+    HANDLER(OP_SUB)
+        regs[ins->rd] = regs[ins->rs1] - regs[ins->rs2];
+        COMPUTE(SIM_CLASS_ALU);
+        NEXT();
+    HANDLER(OP_SLT)
+        regs[ins->rd] = (int32_t) regs[ins->rs1] < (int32_t) regs[ins->rs2];
+        COMPUTE(SIM_CLASS_ALU);
+        NEXT();
+    HANDLER(OP_SGE)
+        regs[ins->rd] = (int32_t) regs[ins->rs1] >= (int32_t) regs[ins->rs2];
+        COMPUTE(SIM_CLASS_ALU);
+        NEXT();
+    HANDLER(OP_SEQ)
+        regs[ins->rd] = regs[ins->rs1] == regs[ins->rs2];
+        COMPUTE(SIM_CLASS_ALU);
+        NEXT();
+    HANDLER(OP_SNE)
+        regs[ins->rd] = regs[ins->rs1] != regs[ins->rs2];
+        COMPUTE(SIM_CLASS_ALU);
+        NEXT();
+    HANDLER(OP_XORI)
+        regs[ins->rd] = regs[ins->rs1] ^ (uint32_t) ins->imm;
+        COMPUTE(SIM_CLASS_ALU);
+        NEXT();
+    HANDLER(OP_AND)
+        regs[ins->rd] = regs[ins->rs1] & regs[ins->rs2];
+        COMPUTE(SIM_CLASS_ALU);
+        NEXT();
+    HANDLER(OP_OR)
+        regs[ins->rd] = regs[ins->rs1] | regs[ins->rs2];
+        COMPUTE(SIM_CLASS_ALU);
+        NEXT();
+    HANDLER(OP_MUL)
+        counts[SIM_CLASS_MUL]++;
+        regs[ins->rd] = regs[ins->rs1] * regs[ins->rs2];
+        COMPUTE(SIM_CLASS_MUL);
+        NEXT();
+    HANDLER(OP_DIV) {
+        // Деление на ноль и INT32_MIN / -1 — по правилам RISC-V
+        int32_t a = (int32_t) regs[ins->rs1];
+        int32_t b = (int32_t) regs[ins->rs2];
+        counts[SIM_CLASS_DIV]++;
+        if (b == 0) regs[ins->rd] = UINT32_MAX;
+        else if (a == INT32_MIN && b == -1) regs[ins->rd] = (uint32_t) a;
+        else regs[ins->rd] = (uint32_t) (a / b);
+        COMPUTE(SIM_CLASS_DIV);
+        NEXT();
+    }
+    HANDLER(OP_REM) {
+        int32_t a = (int32_t) regs[ins->rs1];
+        int32_t b = (int32_t) regs[ins->rs2];
+        counts[SIM_CLASS_DIV]++;
+        if (b == 0) regs[ins->rd] = (uint32_t) a;
+        else if (a == INT32_MIN && b == -1) regs[ins->rd] = 0;
+        else regs[ins->rd] = (uint32_t) (a % b);
+        COMPUTE(SIM_CLASS_DIV);
+        NEXT();
+    }
+    HANDLER(OP_LW) {
+        uint32_t address = regs[ins->rs1] + (uint32_t) ins->imm;
+        if (address >= memory_words) goto bad_address;
+        counts[SIM_CLASS_LOAD]++;
+        regs[ins->rd] = (uint32_t) memory[address];
+        INSTRUMENT(timing_model_memory(timing, SIM_CLASS_LOAD, ins->rd, ins->rs1, ins->rs2, address));
+        NEXT();
+    }
+    HANDLER(OP_SW) {
+        uint32_t address = regs[ins->rs1] + (uint32_t) ins->imm;
+        if (address >= memory_words) goto bad_address;
+        counts[SIM_CLASS_STORE]++;
+        memory[address] = (int32_t) regs[ins->rs2];
+        INSTRUMENT(timing_model_memory(timing, SIM_CLASS_STORE, ins->rd, ins->rs1, ins->rs2, address));
+        NEXT();
+    }
+    HANDLER(OP_BEQ)
+        BRANCH(regs[ins->rs1] == regs[ins->rs2]);
+    HANDLER(OP_BNE)
+        BRANCH(regs[ins->rs1] != regs[ins->rs2]);
+    HANDLER(OP_BLT)
+        BRANCH((int32_t) regs[ins->rs1] < (int32_t) regs[ins->rs2]);
+    HANDLER(OP_BGE)
+        BRANCH((int32_t) regs[ins->rs1] >= (int32_t) regs[ins->rs2]);
+    HANDLER(OP_JAL)
+        counts[SIM_CLASS_JUMP]++;
+        regs[ins->rd] = (uint32_t) pc;
+        INSTRUMENT(timing_model_jump(timing, ins->rd));
+        INSTRUMENT_TAKEN();
+        JUMP_TO(ins->imm);
+        NEXT();
+    HANDLER(OP_EWRITE) {
+        unsigned char c = (unsigned char) regs[ins->rs1];
+        counts[SIM_CLASS_SYSTEM]++;
+        if (output) fputc(c, output);
+        stats->output_bytes++;
+        hash = (hash ^ c) * 16777619u;
+        COMPUTE(SIM_CLASS_SYSTEM);
+        NEXT();
+    }
+    HANDLER(OP_EBREAK)
+        counts[SIM_CLASS_SYSTEM]++;
+        COMPUTE(SIM_CLASS_SYSTEM);
+        goto done;
+    HANDLER(OP_HALT)
+        // Не команда программы: выход за последнюю команду
+        retired--;
+        goto done;
+#ifndef SIM_THREADED
+        }
+    }
+#endif
+
+bad_address:
+    status = SIM_BAD_ADDRESS;
+    stats->fault_line = program->lines[ins - code];
+    goto done;
+step_limit:
+    status = SIM_STEP_LIMIT;
+    stats->fault_line = program->lines[ins - code];
+done:
+    stats->instructions = retired;
+    long others = 0;
+    for (int c = SIM_CLASS_MUL; c < SIM_CLASS_COUNT; c++) others += counts[c];
+    counts[SIM_CLASS_ALU] = retired - others;
+    memcpy(stats->class_counts, counts, sizeof(counts));
+    stats->loads = counts[SIM_CLASS_LOAD];
+    stats->stores = counts[SIM_CLASS_STORE];
+    stats->branches = counts[SIM_CLASS_BRANCH];
+    stats->taken_branches = taken;
+    stats->jumps = counts[SIM_CLASS_JUMP];
+    stats->output_hash = hash;
+    return status;
+}
+
+#undef COMPUTE
+#undef INSTRUMENT
+#undef INSTRUMENT_TAKEN
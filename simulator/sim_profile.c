@@ -0,0 +1,173 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "risc_sim.h"
+
+#define SOURCE_TEXT_WIDTH 60
+
+// Цикл: команды от цели обратного перехода (header) до последнего такого перехода (end)
+typedef struct {
+    size_t header;
+    size_t end;
+    long iterations;        // выполнения первой команды цикла
+    long cycles;
+    int first_line;
+    int last_line;
+} ProfileLoop;
+
+// Строка отчёта о строке исходного текста
+typedef struct {
+    int line;
+    long cycles;
+    long executed;
+} ProfileLine;
+
+static int compare_lines(const void *a, const void *b) {
+    const ProfileLine *x = (const ProfileLine *) a;
+    const ProfileLine *y = (const ProfileLine *) b;
+    if (x->cycles != y->cycles) return x->cycles < y->cycles ? 1 : -1;
+    return x->line - y->line;
+}
+
+static int compare_loops(const void *a, const void *b) {
+    const ProfileLoop *x = (const ProfileLoop *) a;
+    const ProfileLoop *y = (const ProfileLoop *) b;
+    if (x->cycles != y->cycles) return x->cycles < y->cycles ? 1 : -1;
+    return x->header < y->header ? -1 : x->header > y->header;
+}
+
+/**
+ * Начала строк исходного текста.
+ * @return Массив из max_line + 1 смещений (length для отсутствующих строк) или NULL
+ */
+static size_t *index_source(const char *source, size_t length, int max_line) {
+    size_t *starts = (size_t *) malloc(((size_t) max_line + 1) * sizeof(size_t));
+    if (!starts) return NULL;
+    int line = 1;
+    starts[0] = length;
+    starts[1] = 0;
+    for (size_t i = 0; i < length && line < max_line; i++) {
+        if (source[i] == '\n') starts[++line] = i + 1;
+    }
+    while (line < max_line) starts[++line] = length;
+    return starts;
+}
+
+// Текст строки line без ведущих пробелов, обрезанный до SOURCE_TEXT_WIDTH символов
+static void print_source_line(const char *source, size_t length, const size_t *starts, int line, FILE *out) {
+    if (!source || !starts || line <= 0) {
+        fprintf(out, "\n");
+        return;
+    }
+    size_t start = starts[line];
+    while (start < length && (source[start] == ' ' || source[start] == '\t')) start++;
+    size_t end = start;
+    while (end < length && source[end] != '\n' && source[end] != '\r') end++;
+    int width = (int) (end - start);
+    if (width > SOURCE_TEXT_WIDTH) {
+        fprintf(out, "  %.*s...\n", SOURCE_TEXT_WIDTH - 3, source + start);
+    } else {
+        fprintf(out, "  %.*s\n", width, source + start);
+    }
+}
+
+static double share(long part, long total) {
+    return total > 0 ? (double) part * 100.0 / (double) total : 0.0;
+}
+
+// Обратные переходы, объединённые по цели; возвращает число циклов
+static size_t find_loops(const SimProfile *profile, const RiscProgram *program, ProfileLoop *loops) {
+    size_t count = 0;
+    for (size_t pc = 0; pc < profile->count; pc++) {
+        size_t target;
+        if (profile->taken[pc] == 0 || !risc_program_jump_target(program, pc, &target) || target > pc) {
+            continue;
+        }
+        size_t k = 0;
+        while (k < count && loops[k].header != target) k++;
+        if (k == count) {
+            loops[count].header = target;
+            loops[count].end = pc;
+            loops[count].iterations = profile->executed[target];
+            count++;
+        }
+        if (pc > loops[k].end) loops[k].end = pc;
+    }
+    for (size_t k = 0; k < count; k++) {
+        ProfileLoop *loop = &loops[k];
+        loop->cycles = 0;
+        loop->first_line = 0;
+        loop->last_line = 0;
+        for (size_t pc = loop->header; pc <= loop->end; pc++) {
+            int line = risc_program_source_line(program, pc, NULL);
+            loop->cycles += profile->cycles[pc];
+            if (line > 0 && (loop->first_line == 0 || line < loop->first_line)) loop->first_line = line;
+            if (line > loop->last_line) loop->last_line = line;
+        }
+    }
+    return count;
+}
+
+void sim_profile_print(const SimProfile *profile, const RiscProgram *program, const char *source,
+                       size_t source_length, int top, FILE *out) {
+    long total = 0;
+    int max_line = 0;
+    for (size_t pc = 0; pc < profile->count; pc++) {
+        int line = risc_program_source_line(program, pc, NULL);
+        total += profile->cycles[pc];
+        if (line > max_line) max_line = line;
+    }
+    fprintf(out, "Profile: %ld cycles in %zu instructions\n", total, profile->count);
+    if (max_line == 0) {
+        fprintf(out, "  No .loc lines in the code: compile with -g to map cycles to source lines\n");
+        return;
+    }
+
+    ProfileLine *lines = (ProfileLine *) calloc((size_t) max_line + 1, sizeof(ProfileLine));
+    ProfileLoop *loops = (ProfileLoop *) malloc((profile->count + 1) * sizeof(ProfileLoop));
+    size_t *starts = source ? index_source(source, source_length, max_line) : NULL;
+    if (!lines || !loops) {
+        fprintf(out, "  Out of memory\n");
+        free(lines);
+        free(loops);
+        free(starts);
+        return;
+    }
+    for (int line = 0; line <= max_line; line++) lines[line].line = line;
+    for (size_t pc = 0; pc < profile->count; pc++) {
+        ProfileLine *entry = &lines[risc_program_source_line(program, pc, NULL)];
+        entry->cycles += profile->cycles[pc];
+        entry->executed += profile->executed[pc];
+    }
+    // Команды без .loc (пролог, данные времени выполнения) — отдельной строкой
+    long unattributed = lines[0].cycles;
+    qsort(lines + 1, (size_t) max_line, sizeof(ProfileLine), compare_lines);
+    fprintf(out, "Hot lines:\n");
+    fprintf(out, "  %6s %14s %7s %14s  %s\n", "Line", "Cycles", "Share", "Instructions", "Source");
+    for (int k = 1; k <= max_line && k <= top && lines[k].cycles > 0; k++) {
+        fprintf(out, "  %6d %14ld %6.1f%% %14ld", lines[k].line, lines[k].cycles,
+                share(lines[k].cycles, total), lines[k].executed);
+        print_source_line(source, source_length, starts, lines[k].line, out);
+    }
+    if (unattributed > 0) {
+        fprintf(out, "  %6s %14ld %6.1f%%\n", "-", unattributed, share(unattributed, total));
+    }
+
+    size_t loop_count = find_loops(profile, program, loops);
+    qsort(loops, loop_count, sizeof(ProfileLoop), compare_loops);
+    if (loop_count > 0) {
+        fprintf(out, "Hot loops (cycles include nested loops):\n");
+        fprintf(out, "  %13s %14s %7s %14s  %s\n", "Lines", "Cycles", "Share", "Iterations", "Source");
+    }
+    for (size_t k = 0; k < loop_count && k < (size_t) top && loops[k].cycles > 0; k++) {
+        char range[32];
+        if (loops[k].first_line == 0) snprintf(range, sizeof(range), "-");
+        else snprintf(range, sizeof(range), "%d-%d", loops[k].first_line, loops[k].last_line);
+        fprintf(out, "  %13s %14ld %6.1f%% %14ld", range, loops[k].cycles, share(loops[k].cycles, total),
+                loops[k].iterations);
+        print_source_line(source, source_length, starts, loops[k].first_line, out);
+    }
+    free(lines);
+    free(loops);
+    free(starts);
+}
@@ -0,0 +1,248 @@
+#include <stdlib.h>
+#include <string.h>
+#include "timing_model.h"
+
+// Регистры симулятора: x0..x31 и приёмник записей в x0
+#define REGISTER_COUNT 33
+#define MAX_CACHE_WAYS 64
+
+struct TimingModel {
+    SimTiming config;
+    long next_issue;                // такт, в который может выйти следующая команда
+    long ready[REGISTER_COUNT];     // такт готовности значения регистра
+    uint8_t producer[REGISTER_COUNT];   // класс команды, записавшей регистр последней
+    long divider_free;              // такт, когда делитель освободится
+    uint8_t *counters;              // двухбитные счётчики предсказателя
+    uint32_t *tags;                 // sets * ways тегов кэша
+    long *used;                     // последнее обращение к строке для LRU; 0 — строка пуста
+    long clock;                     // счётчик обращений к кэшу
+    int line_shift;
+    int set_shift;
+    SimTimingStats stats;
+};
+
+void sim_timing_init(SimTiming *timing) {
+    timing->pipeline_depth = 5;
+    timing->load_latency = 2;
+    timing->mul_latency = 3;
+    timing->div_latency = 20;
+    timing->mispredict_penalty = 3;
+    timing->jump_penalty = 1;
+    timing->predictor = PREDICT_BIMODAL;
+    timing->predictor_entries = 256;
+    timing->cache_sets = 64;
+    timing->cache_ways = 2;
+    timing->line_words = 4;
+    timing->miss_penalty = 20;
+}
+
+static int is_power_of_two(long value) {
+    return value > 0 && (value & (value - 1)) == 0;
+}
+
+static int log2_of(long value) {
+    int shift = 0;
+    while ((1L << shift) < value) shift++;
+    return shift;
+}
+
+int sim_timing_parse(SimTiming *timing, const char *spec) {
+    static const char *predictor_names[] = {"not-taken", "btfn", "bimodal"};
+    const char *p = spec;
+    while (*p) {
+        size_t length = strcspn(p, "=,");
+        if (p[length] != '=') return -1;
+        const char *value_text = p + length + 1;
+        size_t value_length = strcspn(value_text, ",");
+        const char *end = value_text + value_length;
+        if (length == 9 && strncmp(p, "predictor", 9) == 0) {
+            int found = 0;
+            for (int k = PREDICT_NOT_TAKEN; k <= PREDICT_BIMODAL; k++) {
+                if (strlen(predictor_names[k]) == value_length &&
+                    strncmp(value_text, predictor_names[k], value_length) == 0) {
+                    timing->predictor = (BranchPredictor) k;
+                    found = 1;
+                }
+            }
+            if (!found) return -1;
+            p = *end ? end + 1 : end;
+            continue;
+        }
+        char *number_end;
+        long value = strtol(value_text, &number_end, 10);
+        if (number_end != end || value_length == 0 || value < 0 || value > 1000000) return -1;
+        // Параметр, его поле и допустимые значения: 1 — не меньше единицы, 2 — степень двойки
+        struct { const char *name; int *field; int check; } params[] = {
+            {"depth", &timing->pipeline_depth, 1}, {"load", &timing->load_latency, 1},
+            {"mul", &timing->mul_latency, 1}, {"div", &timing->div_latency, 1},
+            {"mispredict", &timing->mispredict_penalty, 0}, {"jump", &timing->jump_penalty, 0},
+            {"entries", &timing->predictor_entries, 2}, {"sets", &timing->cache_sets, 2},
+            {"ways", &timing->cache_ways, 1}, {"line", &timing->line_words, 2},
+            {"miss", &timing->miss_penalty, 0}
+        };
+        int found = 0;
+        for (size_t k = 0; k < sizeof(params) / sizeof(params[0]) && !found; k++) {
+            if (strlen(params[k].name) != length || strncmp(p, params[k].name, length) != 0) continue;
+            if (params[k].check == 1 && value < 1) return -1;
+            if (params[k].check == 2 && !is_power_of_two(value)) return -1;
+            *params[k].field = (int) value;
+            found = 1;
+        }
+        if (!found) return -1;
+        p = *end ? end + 1 : end;
+    }
+    return timing->cache_ways <= MAX_CACHE_WAYS ? 0 : -1;
+}
+
+TimingModel *timing_model_create(const SimTiming *timing) {
+    TimingModel *model = (TimingModel *) calloc(1, sizeof(TimingModel));
+    if (!model) return NULL;
+    model->config = *timing;
+    size_t lines = (size_t) timing->cache_sets * (size_t) timing->cache_ways;
+    model->counters = (uint8_t *) malloc((size_t) timing->predictor_entries);
+    model->tags = (uint32_t *) calloc(lines, sizeof(uint32_t));
+    model->used = (long *) calloc(lines, sizeof(long));
+    if (!model->counters || !model->tags || !model->used) {
+        timing_model_free(model);
+        return NULL;
+    }
+    // Слабо «не выполняется»: одного выполнения хватает, чтобы предсказание сменилось
+    memset(model->counters, 1, (size_t) timing->predictor_entries);
+    model->line_shift = log2_of(timing->line_words);
+    model->set_shift = log2_of(timing->cache_sets);
+    model->stats.enabled = 1;
+    return model;
+}
+
+void timing_model_free(TimingModel *model) {
+    if (!model) return;
+    free(model->counters);
+    free(model->tags);
+    free(model->used);
+    free(model);
+}
+
+// Такт выдачи команды: ждёт готовности обоих операндов
+static long issue(TimingModel *model, int rs1, int rs2) {
+    long cycle = model->next_issue;
+    int late = model->ready[rs1] >= model->ready[rs2] ? rs1 : rs2;
+    if (model->ready[late] > cycle) {
+        StallKind kind = model->producer[late] == SIM_CLASS_LOAD ? STALL_LOAD_USE : STALL_MUL_DIV;
+        model->stats.stalls[kind] += model->ready[late] - cycle;
+        cycle = model->ready[late];
+    }
+    return cycle;
+}
+
+static void write_register(TimingModel *model, int rd, long ready, SimClass producer) {
+    model->ready[rd] = ready;
+    model->producer[rd] = (uint8_t) producer;
+}
+
+long timing_model_compute(TimingModel *model, SimClass command_class, int rd, int rs1, int rs2) {
+    long start = model->next_issue;
+    long cycle = issue(model, rs1, rs2);
+    long latency = 1;
+    if (command_class == SIM_CLASS_MUL) {
+        latency = model->config.mul_latency;
+    } else if (command_class == SIM_CLASS_DIV) {
+        if (model->divider_free > cycle) {
+            model->stats.stalls[STALL_DIVIDER] += model->divider_free - cycle;
+            cycle = model->divider_free;
+        }
+        latency = model->config.div_latency;
+        model->divider_free = cycle + latency;
+    }
+    write_register(model, rd, cycle + latency, command_class);
+    model->next_issue = cycle + 1;
+    return model->next_issue - start;
+}
+
+// Обращение к кэшу данных с LRU внутри набора; 1 — попадание
+static int cache_access(TimingModel *model, uint32_t address) {
+    uint32_t line = address >> model->line_shift;
+    uint32_t set = line & (uint32_t) (model->config.cache_sets - 1);
+    uint32_t tag = line >> model->set_shift;
+    int ways = model->config.cache_ways;
+    uint32_t *tags = &model->tags[(size_t) set * (size_t) ways];
+    long *used = &model->used[(size_t) set * (size_t) ways];
+    int victim = 0;
+    model->clock++;
+    for (int w = 0; w < ways; w++) {
+        if (used[w] != 0 && tags[w] == tag) {
+            used[w] = model->clock;
+            return 1;
+        }
+        if (used[w] < used[victim]) victim = w;
+    }
+    tags[victim] = tag;
+    used[victim] = model->clock;
+    return 0;
+}
+
+long timing_model_memory(TimingModel *model, SimClass command_class, int rd, int rs1, int rs2,
+                         uint32_t address) {
+    long start = model->next_issue;
+    long cycle = issue(model, rs1, rs2);
+    int hit = cache_access(model, address);
+    if (command_class == SIM_CLASS_LOAD) {
+        if (hit) model->stats.load_hits++;
+        else model->stats.load_misses++;
+    } else {
+        if (hit) model->stats.store_hits++;
+        else model->stats.store_misses++;
+    }
+    if (!hit) {
+        // Кэш блокирующий: конвейер ждёт, пока строка придёт из памяти
+        model->stats.stalls[STALL_DCACHE] += model->config.miss_penalty;
+        cycle += model->config.miss_penalty;
+    }
+    if (command_class == SIM_CLASS_LOAD) {
+        write_register(model, rd, cycle + model->config.load_latency, SIM_CLASS_LOAD);
+    }
+    model->next_issue = cycle + 1;
+    return model->next_issue - start;
+}
+
+// Верно предсказанный переход бесплатен: адрес назначения считается известным при выборке
+long timing_model_branch(TimingModel *model, int rs1, int rs2, uint32_t pc, uint32_t target, int taken) {
+    long start = model->next_issue;
+    long cycle = issue(model, rs1, rs2);
+    int predicted;
+    switch (model->config.predictor) {
+        case PREDICT_BTFN:
+            predicted = target <= pc;
+            break;
+        case PREDICT_BIMODAL: {
+            uint8_t *counter = &model->counters[pc & (uint32_t) (model->config.predictor_entries - 1)];
+            predicted = *counter >= 2;
+            if (taken && *counter < 3) (*counter)++;
+            if (!taken && *counter > 0) (*counter)--;
+            break;
+        }
+        default:
+            predicted = 0;
+            break;
+    }
+    if (predicted != taken) {
+        model->stats.mispredicted++;
+        model->stats.stalls[STALL_MISPREDICT] += model->config.mispredict_penalty;
+        cycle += model->config.mispredict_penalty;
+    }
+    model->next_issue = cycle + 1;
+    return model->next_issue - start;
+}
+
+long timing_model_jump(TimingModel *model, int rd) {
+    long cycle = model->next_issue;
+    write_register(model, rd, cycle + 1, SIM_CLASS_JUMP);
+    model->stats.stalls[STALL_JUMP] += model->config.jump_penalty;
+    model->next_issue = cycle + 1 + model->config.jump_penalty;
+    return model->next_issue - cycle;
+}
+
+void timing_model_finish(const TimingModel *model, SimStats *stats) {
+    stats->timing = model->stats;
+    // Последняя команда проходит остальные стадии конвейера
+    stats->timing.cycles = model->next_issue > 0 ? model->next_issue + model->config.pipeline_depth - 1 : 0;
+}
@@ -0,0 +1,41 @@
+#ifndef TIMING_MODEL_H
+#define TIMING_MODEL_H
+
+#include <stdint.h>
+#include "risc_sim.h"
+
+/**
+ * Модель конвейера для risc_simulate. Симулятор сообщает о каждой
+ * выполненной команде: какие регистры она читает и пишет, адрес обращения
+ * к памяти, исход перехода. Модель ведёт такт выдачи следующей команды
+ * и такт готовности каждого регистра и считает простои по причинам.
+ * Регистры — индексы симулятора: 0 (x0) всегда готов, 32 — запись в x0.
+ * Функции о командах возвращают такты, на которые команда сдвинула выдачу
+ * следующей: единица плюс простои перед ней и штрафы за неё (для профиля).
+ */
+typedef struct TimingModel TimingModel;
+
+// NULL, если не хватило памяти
+TimingModel *timing_model_create(const SimTiming *timing);
+
+void timing_model_free(TimingModel *model);
+
+// Команда без обращения к памяти и переходов: АЛУ, mul, div, ewrite, ebreak
+long timing_model_compute(TimingModel *model, SimClass command_class, int rd, int rs1, int rs2);
+
+// lw (rd — результат) или sw (rd — 32, rs2 — записываемое значение)
+long timing_model_memory(TimingModel *model, SimClass command_class, int rd, int rs1, int rs2,
+                         uint32_t address);
+
+/**
+ * Условный переход.
+ * @param pc Номер команды перехода, target — номер команды назначения
+ */
+long timing_model_branch(TimingModel *model, int rs1, int rs2, uint32_t pc, uint32_t target, int taken);
+
+long timing_model_jump(TimingModel *model, int rd);
+
+// Заполняет stats->timing
+void timing_model_finish(const TimingModel *model, SimStats *stats);
+
+#endif /* TIMING_MODEL_H */
@@ -0,0 +1,72 @@
+#include <stdlib.h>
+#include <string.h>
+#include <sched.h>
+#include "spsc_ring.h"
+
+#define SPIN_LIMIT 64
+
+// Ожидание другой стороны: сначала вращение, потом sched_yield
+static void backoff(unsigned *spins) {
+    if (*spins < SPIN_LIMIT) {
+        (*spins)++;
+    } else {
+        sched_yield();
+    }
+}
+
+int spsc_ring_init(SpscRing *ring, size_t capacity, size_t item_size) {
+    size_t size = 2;
+    while (size < capacity) size *= 2;
+    ring->items = (char *) malloc(size * item_size);
+    if (!ring->items) return -1;
+    ring->item_size = item_size;
+    ring->capacity = size;
+    atomic_init(&ring->head, 0);
+    atomic_init(&ring->tail, 0);
+    atomic_init(&ring->closed, 0);
+    atomic_init(&ring->cancelled, 0);
+    return 0;
+}
+
+void spsc_ring_destroy(SpscRing *ring) {
+    free(ring->items);
+    ring->items = NULL;
+}
+
+int spsc_ring_push(SpscRing *ring, const void *item) {
+    size_t tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+    unsigned spins = 0;
+    for (;;) {
+        if (atomic_load_explicit(&ring->cancelled, memory_order_relaxed)) return -1;
+        size_t head = atomic_load_explicit(&ring->head, memory_order_acquire);
+        if (tail - head < ring->capacity) break;
+        backoff(&spins);
+    }
+    memcpy(ring->items + (tail & (ring->capacity - 1)) * ring->item_size, item, ring->item_size);
+    atomic_store_explicit(&ring->tail, tail + 1, memory_order_release);
+    return 0;
+}
+
+int spsc_ring_pop(SpscRing *ring, void *item) {
+    size_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+    unsigned spins = 0;
+    while (atomic_load_explicit(&ring->tail, memory_order_acquire) == head) {
+        if (atomic_load_explicit(&ring->closed, memory_order_acquire)) {
+            // Последний элемент мог появиться перед закрытием
+            if (atomic_load_explicit(&ring->tail, memory_order_acquire) == head) return 0;
+            break;
+        }
+        backoff(&spins);
+    }
+    memcpy(item, ring->items + (head & (ring->capacity - 1)) * ring->item_size, ring->item_size);
+    atomic_store_explicit(&ring->head, head + 1, memory_order_release);
+    return 1;
+}
+
+void spsc_ring_close(SpscRing *ring) {
+    atomic_store_explicit(&ring->closed, 1, memory_order_release);
+}
+
+void spsc_ring_cancel(SpscRing *ring) {
+    atomic_store_explicit(&ring->cancelled, 1, memory_order_relaxed);
+}
@@ -0,0 +1,41 @@
+#ifndef SPSC_RING_H
+#define SPSC_RING_H
+
+#include <stddef.h>
+#include <stdatomic.h>
+
+/**
+ * Кольцевая очередь без блокировок для одного производителя и одного
+ * потребителя. Элементы копируются по значению. Ожидание на полной или
+ * пустой очереди — короткое вращение, затем уступка процессора.
+ */
+typedef struct {
+    char *items;
+    size_t item_size;
+    size_t capacity;                // степень двойки
+    // Счётчики растут монотонно, позиция в кольце — индекс & (capacity - 1).
+    // Каждый пишет только один поток; разнесены по строкам кэша
+    _Alignas(64) atomic_size_t head;    // следующий элемент для чтения
+    _Alignas(64) atomic_size_t tail;    // следующая ячейка для записи
+    _Alignas(64) atomic_int closed;     // производитель больше ничего не добавит
+    atomic_int cancelled;               // потребителю остальные элементы не нужны
+} SpscRing;
+
+// capacity округляется вверх до степени двойки; 0 при успехе
+int spsc_ring_init(SpscRing *ring, size_t capacity, size_t item_size);
+
+void spsc_ring_destroy(SpscRing *ring);
+
+// Ждёт свободную ячейку; -1, если потребитель отменил очередь
+int spsc_ring_push(SpscRing *ring, const void *item);
+
+// Ждёт элемент; 1 — элемент прочитан, 0 — очередь закрыта и пуста
+int spsc_ring_pop(SpscRing *ring, void *item);
+
+// Вызывает производитель после последнего элемента
+void spsc_ring_close(SpscRing *ring);
+
+// Вызывает потребитель, когда прекращает чтение
+void spsc_ring_cancel(SpscRing *ring);
+
+#endif /* SPSC_RING_H */
@@ -0,0 +1,110 @@
+#ifdef COMPILER_INSTRUMENT
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdatomic.h>
+#include "tagged_alloc.h"
+
+// Рост блока при realloc: new_size / old_size
+enum {
+    GROWTH_SHRINK = 0,          // < 1
+    GROWTH_SMALL,               // до 1.5
+    GROWTH_DOUBLE,              // до 2
+    GROWTH_LARGE,               // больше 2
+    GROWTH_BUCKETS
+};
+
+typedef struct {
+    atomic_long allocations;    // malloc, calloc, strdup и realloc(NULL, n)
+    atomic_long bytes;          // запрошено этими вызовами и приростом при realloc
+    atomic_long frees;
+    atomic_long reallocs;
+    atomic_long copied_bytes;   // старые размеры блоков при realloc: верхняя оценка копирования
+    atomic_long growth[GROWTH_BUCKETS];
+} TagStats;
+
+static TagStats stats[ALLOC_TAG_COUNT];
+
+static const char *tag_names[ALLOC_TAG_COUNT] = {"ast", "symbols", "output", "temp"};
+
+static void add(atomic_long *counter, long value) {
+    atomic_fetch_add_explicit(counter, value, memory_order_relaxed);
+}
+
+static long get(atomic_long *counter) {
+    return atomic_load_explicit(counter, memory_order_relaxed);
+}
+
+void *tagged_malloc(AllocTag tag, size_t size) {
+    add(&stats[tag].allocations, 1);
+    add(&stats[tag].bytes, (long) size);
+    return malloc(size);
+}
+
+void *tagged_calloc(AllocTag tag, size_t count, size_t size) {
+    add(&stats[tag].allocations, 1);
+    add(&stats[tag].bytes, (long) (count * size));
+    return calloc(count, size);
+}
+
+void *tagged_realloc(AllocTag tag, void *ptr, size_t old_size, size_t new_size) {
+    if (!ptr) return tagged_malloc(tag, new_size);
+    TagStats *s = &stats[tag];
+    add(&s->reallocs, 1);
+    add(&s->copied_bytes, (long) old_size);
+    if (new_size > old_size) add(&s->bytes, (long) (new_size - old_size));
+    int bucket;
+    if (new_size < old_size) {
+        bucket = GROWTH_SHRINK;
+    } else if (new_size * 2 <= old_size * 3) {
+        bucket = GROWTH_SMALL;
+    } else if (new_size <= old_size * 2) {
+        bucket = GROWTH_DOUBLE;
+    } else {
+        bucket = GROWTH_LARGE;
+    }
+    add(&s->growth[bucket], 1);
+    return realloc(ptr, new_size);
+}
+
+char *tagged_strdup(AllocTag tag, const char *s) {
+    add(&stats[tag].allocations, 1);
+    add(&stats[tag].bytes, (long) (strlen(s) + 1));
+    return strdup(s);
+}
+
+void tagged_free(AllocTag tag, void *ptr) {
+    if (!ptr) return;
+    add(&stats[tag].frees, 1);
+    free(ptr);
+}
+
+void tagged_alloc_print_report(int json, FILE *out) {
+    if (json) {
+        fprintf(out, "{\"allocations\": [");
+    } else {
+        fprintf(out, "Allocation report:\n");
+        fprintf(out, "%-8s %10s %12s %10s %10s %12s %8s %8s %8s %8s\n", "Tag", "Allocs", "Bytes", "Frees",
+                "Reallocs", "Copied", "<1x", "<=1.5x", "<=2x", ">2x");
+    }
+    for (int tag = 0; tag < ALLOC_TAG_COUNT; tag++) {
+        TagStats *s = &stats[tag];
+        if (json) {
+            fprintf(out, "%s\n  {\"tag\": \"%s\", \"allocations\": %ld, \"bytes\": %ld, \"frees\": %ld, "
+                         "\"reallocs\": %ld, \"copied_bytes\": %ld, \"shrink\": %ld, \"grow_1_5x\": %ld, "
+                         "\"grow_2x\": %ld, \"grow_over_2x\": %ld}",
+                    tag > 0 ? "," : "", tag_names[tag], get(&s->allocations), get(&s->bytes), get(&s->frees),
+                    get(&s->reallocs), get(&s->copied_bytes), get(&s->growth[GROWTH_SHRINK]),
+                    get(&s->growth[GROWTH_SMALL]), get(&s->growth[GROWTH_DOUBLE]), get(&s->growth[GROWTH_LARGE]));
+        } else {
+            fprintf(out, "%-8s %10ld %12ld %10ld %10ld %12ld %8ld %8ld %8ld %8ld\n", tag_names[tag],
+                    get(&s->allocations), get(&s->bytes), get(&s->frees), get(&s->reallocs),
+                    get(&s->copied_bytes), get(&s->growth[GROWTH_SHRINK]), get(&s->growth[GROWTH_SMALL]),
+                    get(&s->growth[GROWTH_DOUBLE]), get(&s->growth[GROWTH_LARGE]));
+        }
+    }
+    if (json) fprintf(out, "\n]}\n");
+}
+
+#endif /* COMPILER_INSTRUMENT */
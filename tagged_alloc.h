@@ -0,0 +1,76 @@
+#ifndef TAGGED_ALLOC_H
+#define TAGGED_ALLOC_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/**
+ * Выделение памяти структур компилятора с пометкой подсистемы.
+ * Память с одной пометкой освобождается tagged_free с той же пометкой,
+ * поэтому подсистему можно перевести на арену или пул, меняя только
+ * этот модуль. В сборке с COMPILER_INSTRUMENT считаются вызовы и байты
+ * по подсистемам и рост буферов через realloc (-falloc-report);
+ * в обычной сборке функции сводятся к malloc/realloc/free.
+ * Без пометки остаются готовая строка кода (её освобождает вызывающий код
+ * через free_risc_code), состояние -incremental и PassManager: они принадлежат
+ * вызывающему коду и живут дольше одной компиляции.
+ */
+typedef enum {
+    ALLOC_AST = 0,      // узлы, строки и списки дерева
+    ALLOC_SYMBOLS,      // таблицы переменных, символов и адресов
+    ALLOC_OUTPUT,       // строки листинга, образ данных и готовый код
+    ALLOC_TEMP,         // стеки обхода, индексы и буферы одного прохода
+    ALLOC_TAG_COUNT
+} AllocTag;
+
+#ifdef COMPILER_INSTRUMENT
+
+void *tagged_malloc(AllocTag tag, size_t size);
+
+void *tagged_calloc(AllocTag tag, size_t count, size_t size);
+
+// old_size — размер блока до изменения (0 для ptr == NULL); нужен для учёта роста
+void *tagged_realloc(AllocTag tag, void *ptr, size_t old_size, size_t new_size);
+
+char *tagged_strdup(AllocTag tag, const char *s);
+
+void tagged_free(AllocTag tag, void *ptr);
+
+/**
+ * Печатает по подсистемам: выделения, байты, освобождения, realloc
+ * с разбивкой по коэффициенту роста и байты, скопированные при росте.
+ */
+void tagged_alloc_print_report(int json, FILE *out);
+
+#else
+
+static inline void *tagged_malloc(AllocTag tag, size_t size) {
+    (void) tag;
+    return malloc(size);
+}
+
+static inline void *tagged_calloc(AllocTag tag, size_t count, size_t size) {
+    (void) tag;
+    return calloc(count, size);
+}
+
+static inline void *tagged_realloc(AllocTag tag, void *ptr, size_t old_size, size_t new_size) {
+    (void) tag;
+    (void) old_size;
+    return realloc(ptr, new_size);
+}
+
+static inline char *tagged_strdup(AllocTag tag, const char *s) {
+    (void) tag;
+    return strdup(s);
+}
+
+static inline void tagged_free(AllocTag tag, void *ptr) {
+    (void) tag;
+    free(ptr);
+}
+
+#endif /* COMPILER_INSTRUMENT */
+
+#endif /* TAGGED_ALLOC_H */
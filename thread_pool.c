@@ -0,0 +1,137 @@
+#include <stdlib.h>
+#include <pthread.h>
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <unistd.h>
+#endif
+#include "thread_pool.h"
+
+typedef struct Job {
+    ThreadPoolTask task;
+    void *arg;
+    struct Job *next;
+} Job;
+
+struct ThreadPool {
+    pthread_t *threads;
+    int thread_count;
+    Job *head;
+    Job *tail;
+    int pending;        // поставлено, но ещё не завершено
+    int stopping;
+    pthread_mutex_t lock;
+    pthread_cond_t has_work;
+    pthread_cond_t all_done;
+};
+
+static void *worker_main(void *arg) {
+    ThreadPool *pool = (ThreadPool *) arg;
+    pthread_mutex_lock(&pool->lock);
+    for (;;) {
+        while (!pool->head && !pool->stopping) {
+            pthread_cond_wait(&pool->has_work, &pool->lock);
+        }
+        if (!pool->head) break;
+        Job *job = pool->head;
+        pool->head = job->next;
+        if (!pool->head) pool->tail = NULL;
+        pthread_mutex_unlock(&pool->lock);
+
+        job->task(job->arg);
+        free(job);
+
+        pthread_mutex_lock(&pool->lock);
+        if (--pool->pending == 0) {
+            pthread_cond_broadcast(&pool->all_done);
+        }
+    }
+    pthread_mutex_unlock(&pool->lock);
+    return NULL;
+}
+
+int thread_pool_cpu_count(void) {
+#ifdef _WIN32
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    return info.dwNumberOfProcessors > 0 ? (int) info.dwNumberOfProcessors : 1;
+#else
+    long count = sysconf(_SC_NPROCESSORS_ONLN);
+    return count > 0 ? (int) count : 1;
+#endif
+}
+
+ThreadPool *thread_pool_create(int threads) {
+    if (threads <= 0) threads = thread_pool_cpu_count();
+    ThreadPool *pool = (ThreadPool *) malloc(sizeof(ThreadPool));
+    if (!pool) return NULL;
+    pool->threads = (pthread_t *) malloc(threads * sizeof(pthread_t));
+    if (!pool->threads) {
+        free(pool);
+        return NULL;
+    }
+    pool->thread_count = 0;
+    pool->head = NULL;
+    pool->tail = NULL;
+    pool->pending = 0;
+    pool->stopping = 0;
+    pthread_mutex_init(&pool->lock, NULL);
+    pthread_cond_init(&pool->has_work, NULL);
+    pthread_cond_init(&pool->all_done, NULL);
+    for (int i = 0; i < threads; i++) {
+        if (pthread_create(&pool->threads[i], NULL, worker_main, pool) != 0) break;
+        pool->thread_count++;
+    }
+    if (pool->thread_count == 0) {
+        thread_pool_free(pool);
+        return NULL;
+    }
+    return pool;
+}
+
+int thread_pool_submit(ThreadPool *pool, ThreadPoolTask task, void *arg) {
+    Job *job = (Job *) malloc(sizeof(Job));
+    if (!job) return -1;
+    job->task = task;
+    job->arg = arg;
+    job->next = NULL;
+    pthread_mutex_lock(&pool->lock);
+    if (pool->tail) {
+        pool->tail->next = job;
+    } else {
+        pool->head = job;
+    }
+    pool->tail = job;
+    pool->pending++;
+    pthread_cond_signal(&pool->has_work);
+    pthread_mutex_unlock(&pool->lock);
+    return 0;
+}
+
+void thread_pool_wait(ThreadPool *pool) {
+    pthread_mutex_lock(&pool->lock);
+    while (pool->pending > 0) {
+        pthread_cond_wait(&pool->all_done, &pool->lock);
+    }
+    pthread_mutex_unlock(&pool->lock);
+}
+
+void thread_pool_free(ThreadPool *pool) {
+    if (!pool) return;
+    pthread_mutex_lock(&pool->lock);
+    pool->stopping = 1;
+    pthread_cond_broadcast(&pool->has_work);
+    pthread_mutex_unlock(&pool->lock);
+    for (int i = 0; i < pool->thread_count; i++) {
+        pthread_join(pool->threads[i], NULL);
+    }
+    pthread_mutex_destroy(&pool->lock);
+    pthread_cond_destroy(&pool->has_work);
+    pthread_cond_destroy(&pool->all_done);
+    free(pool->threads);
+    free(pool);
+}
+
+int thread_pool_size(const ThreadPool *pool) {
+    return pool->thread_count;
+}
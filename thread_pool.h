@@ -0,0 +1,29 @@
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+typedef void (*ThreadPoolTask)(void *arg);
+
+typedef struct ThreadPool ThreadPool;
+
+/**
+ * Создаёт пул из threads рабочих потоков.
+ * @param threads Количество потоков; 0 — по числу ядер
+ * @return Пул или NULL при ошибке
+ */
+ThreadPool *thread_pool_create(int threads);
+
+// Ставит задачу в очередь; 0 при успехе, -1 при ошибке выделения памяти
+int thread_pool_submit(ThreadPool *pool, ThreadPoolTask task, void *arg);
+
+// Ждёт завершения всех поставленных задач
+void thread_pool_wait(ThreadPool *pool);
+
+// Дожидается задач, останавливает потоки и освобождает пул
+void thread_pool_free(ThreadPool *pool);
+
+int thread_pool_size(const ThreadPool *pool);
+
+// Число доступных процессорных ядер
+int thread_pool_cpu_count(void);
+
+#endif /* THREAD_POOL_H */
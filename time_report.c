@@ -0,0 +1,275 @@
+#ifdef COMPILER_INSTRUMENT
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdatomic.h>
+#include <time.h>
+#ifdef _WIN32
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#endif
+#include "time_report.h"
+#include "compile_context.h"
+
+#define MAX_PHASES 64
+#define MAX_DEPTH 16
+
+typedef struct {
+    double wall;                // мс
+    double cpu;                 // мс, все потоки процесса
+    long peak_rss;              // КБ
+    long allocations;
+    long bytes;
+} Sample;
+
+typedef struct {
+    const char *name;
+    int parent;                 // индекс родительской фазы или -1
+    int depth;
+    long calls;
+    double wall;
+    double cpu;
+    long peak_rss;
+    long allocations;
+    long bytes;
+} Phase;
+
+struct TimeReport {
+    Sample start;
+    Phase phases[MAX_PHASES];
+    int phase_count;
+    int open[MAX_DEPTH];        // начатые фазы
+    Sample open_start[MAX_DEPTH];
+    int depth;
+    int skipped;                // начатые фазы, не поместившиеся в отчёт
+};
+
+// Счётчики выделений всего процесса. Сборка с COMPILER_INSTRUMENT
+// компонуется с -Wl,--wrap=malloc (см. Makefile), и все вызовы malloc,
+// calloc, realloc и strdup проходят через обёртки ниже
+static atomic_long allocation_count;
+static atomic_long allocated_bytes;
+
+void *__real_malloc(size_t size);
+void *__real_calloc(size_t count, size_t size);
+void *__real_realloc(void *ptr, size_t size);
+char *__real_strdup(const char *s);
+
+static void count_allocation(size_t size) {
+    atomic_fetch_add_explicit(&allocation_count, 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&allocated_bytes, (long) size, memory_order_relaxed);
+}
+
+void *__wrap_malloc(size_t size) {
+    count_allocation(size);
+    return __real_malloc(size);
+}
+
+void *__wrap_calloc(size_t count, size_t size) {
+    count_allocation(count * size);
+    return __real_calloc(count, size);
+}
+
+void *__wrap_realloc(void *ptr, size_t size) {
+    count_allocation(size);
+    return __real_realloc(ptr, size);
+}
+
+char *__wrap_strdup(const char *s) {
+    count_allocation(strlen(s) + 1);
+    return __real_strdup(s);
+}
+
+static void take_sample(Sample *sample) {
+#ifdef _WIN32
+    LARGE_INTEGER counter, frequency;
+    QueryPerformanceCounter(&counter);
+    QueryPerformanceFrequency(&frequency);
+    sample->wall = (double) counter.QuadPart * 1000.0 / (double) frequency.QuadPart;
+    FILETIME created, exited, kernel, user;
+    GetProcessTimes(GetCurrentProcess(), &created, &exited, &kernel, &user);
+    ULARGE_INTEGER k, u;
+    k.LowPart = kernel.dwLowDateTime;
+    k.HighPart = kernel.dwHighDateTime;
+    u.LowPart = user.dwLowDateTime;
+    u.HighPart = user.dwHighDateTime;
+    sample->cpu = (double) (k.QuadPart + u.QuadPart) / 10000.0;
+    PROCESS_MEMORY_COUNTERS memory;
+    sample->peak_rss = GetProcessMemoryInfo(GetCurrentProcess(), &memory, sizeof(memory))
+                       ? (long) (memory.PeakWorkingSetSize / 1024) : 0;
+#else
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    sample->wall = (double) now.tv_sec * 1000.0 + (double) now.tv_nsec / 1e6;
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &now);
+    sample->cpu = (double) now.tv_sec * 1000.0 + (double) now.tv_nsec / 1e6;
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+#ifdef __APPLE__
+    sample->peak_rss = (long) (usage.ru_maxrss / 1024);
+#else
+    sample->peak_rss = (long) usage.ru_maxrss;
+#endif
+#endif
+    sample->allocations = atomic_load_explicit(&allocation_count, memory_order_relaxed);
+    sample->bytes = atomic_load_explicit(&allocated_bytes, memory_order_relaxed);
+}
+
+TimeReport *time_report_create(void) {
+    TimeReport *report = (TimeReport *) calloc(1, sizeof(TimeReport));
+    if (!report) return NULL;
+    take_sample(&report->start);
+    return report;
+}
+
+void time_report_free(TimeReport *report) {
+    free(report);
+}
+
+static int find_phase(TimeReport *report, int parent, const char *name) {
+    for (int i = 0; i < report->phase_count; i++) {
+        if (report->phases[i].parent == parent && strcmp(report->phases[i].name, name) == 0) return i;
+    }
+    if (report->phase_count >= MAX_PHASES) return -1;
+    Phase *phase = &report->phases[report->phase_count];
+    memset(phase, 0, sizeof(*phase));
+    phase->name = name;
+    phase->parent = parent;
+    phase->depth = report->depth;
+    return report->phase_count++;
+}
+
+void time_report_begin(const char *name) {
+    TimeReport *report = compile_context_current()->time_report;
+    if (!report) return;
+    int parent = report->depth > 0 ? report->open[report->depth - 1] : -1;
+    int index = report->skipped == 0 && report->depth < MAX_DEPTH ? find_phase(report, parent, name) : -1;
+    if (index < 0) {
+        report->skipped++;
+        return;
+    }
+    report->open[report->depth] = index;
+    take_sample(&report->open_start[report->depth]);
+    report->depth++;
+}
+
+void time_report_end(void) {
+    TimeReport *report = compile_context_current()->time_report;
+    if (!report) return;
+    if (report->skipped > 0) {
+        report->skipped--;
+        return;
+    }
+    if (report->depth == 0) return;
+    report->depth--;
+    Sample now;
+    take_sample(&now);
+    const Sample *start = &report->open_start[report->depth];
+    Phase *phase = &report->phases[report->open[report->depth]];
+    phase->calls++;
+    phase->wall += now.wall - start->wall;
+    phase->cpu += now.cpu - start->cpu;
+    phase->allocations += now.allocations - start->allocations;
+    phase->bytes += now.bytes - start->bytes;
+    if (now.peak_rss > phase->peak_rss) phase->peak_rss = now.peak_rss;
+}
+
+static void print_json_string(const char *text, FILE *out) {
+    fputc('"', out);
+    for (const char *p = text; *p; p++) {
+        unsigned char c = (unsigned char) *p;
+        if (c == '"' || c == '\\') {
+            fprintf(out, "\\%c", c);
+        } else if (c < 0x20) {
+            fprintf(out, "\\u%04x", c);
+        } else {
+            fputc(c, out);
+        }
+    }
+    fputc('"', out);
+}
+
+// Путь фазы через '/', как "codegen/block-layout"
+static void phase_path(const TimeReport *report, int index, char *path, size_t size) {
+    const char *names[MAX_DEPTH + 1];
+    int count = 0;
+    for (int i = index; i >= 0 && count <= MAX_DEPTH; i = report->phases[i].parent) {
+        names[count++] = report->phases[i].name;
+    }
+    size_t length = 0;
+    path[0] = '\0';
+    for (int i = count - 1; i >= 0; i--) {
+        length += snprintf(path + length, length < size ? size - length : 0, "%s%s",
+                           i == count - 1 ? "" : "/", names[i]);
+        if (length >= size) break;
+    }
+}
+
+// Фазы в порядке обхода: каждая сразу за родителем, соседи в порядке первого входа
+static int order_phases(const TimeReport *report, int *order) {
+    int count = 0;
+    int stack[MAX_PHASES];
+    int top = 0;
+    for (int i = report->phase_count - 1; i >= 0; i--) {
+        if (report->phases[i].parent < 0) stack[top++] = i;
+    }
+    while (top > 0) {
+        int index = stack[--top];
+        order[count++] = index;
+        for (int i = report->phase_count - 1; i > index; i--) {
+            if (report->phases[i].parent == index) stack[top++] = i;
+        }
+    }
+    return count;
+}
+
+void time_report_print(TimeReport *report, const char *name, int json, FILE *out) {
+    Sample now;
+    take_sample(&now);
+    double total_wall = now.wall - report->start.wall;
+    double total_cpu = now.cpu - report->start.cpu;
+    long total_allocations = now.allocations - report->start.allocations;
+    long total_bytes = now.bytes - report->start.bytes;
+    int order[MAX_PHASES];
+    int count = order_phases(report, order);
+
+    if (json) {
+        fprintf(out, "{\"file\": ");
+        print_json_string(name, out);
+        fprintf(out, ", \"total\": {\"wall_ms\": %.3f, \"cpu_ms\": %.3f, \"peak_rss_kb\": %ld, "
+                     "\"allocations\": %ld, \"allocated_bytes\": %ld}, \"phases\": [",
+                total_wall, total_cpu, now.peak_rss, total_allocations, total_bytes);
+        for (int i = 0; i < count; i++) {
+            const Phase *phase = &report->phases[order[i]];
+            char path[512];
+            phase_path(report, order[i], path, sizeof(path));
+            fprintf(out, "%s\n  {\"phase\": ", i > 0 ? "," : "");
+            print_json_string(path, out);
+            fprintf(out, ", \"calls\": %ld, \"wall_ms\": %.3f, \"cpu_ms\": %.3f, \"peak_rss_kb\": %ld, "
+                         "\"allocations\": %ld, \"allocated_bytes\": %ld}",
+                    phase->calls, phase->wall, phase->cpu, phase->peak_rss, phase->allocations, phase->bytes);
+        }
+        fprintf(out, "\n]}\n");
+        return;
+    }
+
+    fprintf(out, "Time report for %s:\n", name);
+    fprintf(out, "%-28s %6s %10s %6s %10s %12s %10s %12s\n",
+            "Phase", "Calls", "Wall ms", "%", "CPU ms", "Peak RSS KB", "Allocs", "Alloc KB");
+    for (int i = 0; i < count; i++) {
+        const Phase *phase = &report->phases[order[i]];
+        char label[64];
+        snprintf(label, sizeof(label), "%*s%s", phase->depth * 2, "", phase->name);
+        fprintf(out, "%-28s %6ld %10.3f %6.1f %10.3f %12ld %10ld %12.1f\n",
+                label, phase->calls, phase->wall, total_wall > 0 ? phase->wall * 100.0 / total_wall : 0.0,
+                phase->cpu, phase->peak_rss, phase->allocations, (double) phase->bytes / 1024.0);
+    }
+    fprintf(out, "%-28s %6s %10.3f %6.1f %10.3f %12ld %10ld %12.1f\n",
+            "Total", "", total_wall, 100.0, total_cpu, now.peak_rss, total_allocations,
+            (double) total_bytes / 1024.0);
+}
+
+#endif /* COMPILER_INSTRUMENT */
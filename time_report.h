@@ -0,0 +1,44 @@
+#ifndef TIME_REPORT_H
+#define TIME_REPORT_H
+
+#include <stdio.h>
+
+/**
+ * Отчёт -ftime-report: время (настенное и процессорное), пик RSS, число
+ * и объём выделений памяти по фазам компиляции и проходам. Фазы вложены;
+ * повторный вход в фазу с тем же именем под тем же родителем суммируется.
+ * Отчёт собирается только в сборке с COMPILER_INSTRUMENT (make INSTRUMENT=1);
+ * в обычной сборке макросы TIME_REPORT_* ничего не делают.
+ */
+typedef struct TimeReport TimeReport;
+
+#ifdef COMPILER_INSTRUMENT
+
+// Создаёт отчёт; отсчёт общего времени начинается здесь
+TimeReport *time_report_create(void);
+
+void time_report_free(TimeReport *report);
+
+// Начинает фазу name в отчёте текущего контекста компиляции (если он есть)
+void time_report_begin(const char *name);
+
+// Завершает последнюю начатую фазу
+void time_report_end(void);
+
+/**
+ * Печатает отчёт таблицей или JSON.
+ * @param name Имя компилируемого файла для заголовка
+ */
+void time_report_print(TimeReport *report, const char *name, int json, FILE *out);
+
+#define TIME_REPORT_BEGIN(name) time_report_begin(name)
+#define TIME_REPORT_END() time_report_end()
+
+#else
+
+#define TIME_REPORT_BEGIN(name) ((void) 0)
+#define TIME_REPORT_END() ((void) 0)
+
+#endif /* COMPILER_INSTRUMENT */
+
+#endif /* TIME_REPORT_H */